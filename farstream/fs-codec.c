@@ -184,34 +184,13 @@ fs_codec_copy (const FsCodec * codec)
   copy->channels = codec->channels;
   copy->minimum_reporting_interval = codec->minimum_reporting_interval;
 
-  copy->encoding_name = g_strdup (codec->encoding_name);
-
   for (lp = codec->optional_params; lp; lp = g_list_next (lp))
-  {
-    FsCodecParameter *param_copy;
-    FsCodecParameter *param = lp->data;;
-
-    param_copy = g_slice_new (FsCodecParameter);
-    param_copy->name = g_strdup (param->name);
-    param_copy->value = g_strdup (param->value);
-
-    g_queue_push_tail (&list_copy, param_copy);
-  }
+    g_queue_push_tail (&list_copy, fs_codec_parameter_copy (lp->data));
   copy->optional_params = list_copy.head;
 
   g_queue_init (&list_copy);
   for (lp = codec->feedback_params; lp; lp = g_list_next (lp))
-  {
-    FsFeedbackParameter *param_copy;
-    FsFeedbackParameter *param = lp->data;;
-
-    param_copy = g_slice_new (FsFeedbackParameter);
-    param_copy->type = g_strdup (param->type);
-    param_copy->subtype = g_strdup (param->subtype);
-    param_copy->extra_params = g_strdup (param->extra_params);
-
-    g_queue_push_tail (&list_copy, param_copy);
-  }
+    g_queue_push_tail (&list_copy, fs_feedback_parameter_copy (lp->data));
   copy->feedback_params = list_copy.head;
 
   return copy;
@@ -550,62 +529,111 @@ fs_codec_to_string (const FsCodec *codec)
 }
 
 
-static gboolean
-compare_optional_params (const gpointer p1, const gpointer p2)
+static gint
+order_optional_params (gconstpointer p1, gconstpointer p2)
 {
   const FsCodecParameter *param1 = p1;
   const FsCodecParameter *param2 = p2;
+  gint ret;
 
-  if (!g_ascii_strcasecmp (param1->name, param2->name) &&
-      !strcmp (param1->value, param2->value))
-    return TRUE;
-  else
-    return FALSE;
+  ret = g_ascii_strcasecmp (param1->name, param2->name);
+  if (ret)
+    return ret;
+
+  return strcmp (param1->value, param2->value);
 }
 
-static gboolean
-compare_feedback_params (const gpointer p1, const gpointer p2)
+static gint
+order_feedback_params (gconstpointer p1, gconstpointer p2)
 {
   const FsFeedbackParameter *param1 = p1;
   const FsFeedbackParameter *param2 = p2;
+  gint ret;
 
-  if (!g_ascii_strcasecmp (param1->subtype, param2->subtype) &&
-      !g_ascii_strcasecmp (param1->type, param2->type) &&
-      !g_strcmp0 (param1->extra_params, param2->extra_params))
-    return TRUE;
-  else
-    return FALSE;
+  ret = g_ascii_strcasecmp (param1->type, param2->type);
+  if (ret)
+    return ret;
+
+  ret = g_ascii_strcasecmp (param1->subtype, param2->subtype);
+  if (ret)
+    return ret;
+
+  return g_strcmp0 (param1->extra_params, param2->extra_params);
+}
+
+static gint
+order_pointed_params (gconstpointer p1, gconstpointer p2, gpointer user_data)
+{
+  GCompareFunc order = user_data;
+
+  return order (*(gconstpointer *) p1, *(gconstpointer *) p2);
+}
+
+static GPtrArray *
+sorted_params_array (GList *list, GCompareFunc order)
+{
+  GPtrArray *array = g_ptr_array_sized_new (g_list_length (list));
+
+  for (; list; list = g_list_next (list))
+    g_ptr_array_add (array, list->data);
+
+  g_ptr_array_sort_with_data (array, order_pointed_params, order);
+
+  return array;
 }
 
 /*
- * Check if all of the elements of list1 are in list2
- * It compares GLists of X using the comparison function
+ * Checks if both lists contain the same parameters, in any order. Duplicates
+ * are ignored.
+ *
+ * Copies keep the order of the parameters, so first try walking both lists
+ * together, if that fails, compare sorted arrays so it stays O(n log n)
+ * instead of searching for every element of one list in the other.
  */
 static gboolean
-compare_lists (GList *list1, GList *list2,
-    gboolean (*compare_params) (const gpointer p1, const gpointer p2))
+compare_lists (GList *list1, GList *list2, GCompareFunc order)
 {
-  GList *item1;
+  GPtrArray *array1, *array2;
+  GList *item1, *item2;
+  guint i = 0, j = 0;
+  gboolean ret = TRUE;
+
+  for (item1 = list1, item2 = list2;
+       item1 && item2;
+       item1 = g_list_next (item1), item2 = g_list_next (item2))
+    if (order (item1->data, item2->data))
+      break;
+
+  if (item1 == NULL && item2 == NULL)
+    return TRUE;
 
-  for (item1 = g_list_first (list1);
-       item1;
-       item1 = g_list_next (item1)) {
-    FsCodecParameter *param1 = item1->data;
-    GList *item2 = NULL;
+  array1 = sorted_params_array (list1, order);
+  array2 = sorted_params_array (list2, order);
 
-    for (item2 = g_list_first (list2);
-         item2;
-         item2 = g_list_next (item2)) {
-      FsCodecParameter *param2 = item2->data;
+  while (i < array1->len && j < array2->len)
+  {
+    gpointer param1 = g_ptr_array_index (array1, i);
+    gpointer param2 = g_ptr_array_index (array2, j);
 
-      if (compare_params (param1, param2))
-        break;
+    if (order (param1, param2))
+    {
+      ret = FALSE;
+      break;
     }
-    if (!item2)
-      return FALSE;
+
+    while (i < array1->len && !order (g_ptr_array_index (array1, i), param1))
+      i++;
+    while (j < array2->len && !order (g_ptr_array_index (array2, j), param2))
+      j++;
   }
 
-  return TRUE;
+  if (i < array1->len || j < array2->len)
+    ret = FALSE;
+
+  g_ptr_array_free (array1, TRUE);
+  g_ptr_array_free (array2, TRUE);
+
+  return ret;
 }
 
 
@@ -642,19 +670,12 @@ fs_codec_are_equal (const FsCodec *codec1, const FsCodec *codec2)
     return FALSE;
 
 
-  /* Is there a smarter way to compare to un-ordered linked lists
-   * to make sure they contain exactly the same elements??
-   */
   if (!compare_lists (codec1->optional_params, codec2->optional_params,
-          compare_optional_params) ||
-      !compare_lists (codec2->optional_params, codec1->optional_params,
-          compare_optional_params))
+          order_optional_params))
     return FALSE;
 
-  if (!compare_lists (codec1->feedback_params,
-          codec2->feedback_params, compare_feedback_params) ||
-      !compare_lists (codec2->feedback_params,
-          codec1->feedback_params, compare_feedback_params))
+  if (!compare_lists (codec1->feedback_params, codec2->feedback_params,
+          order_feedback_params))
     return FALSE;
 
   return TRUE;
@@ -78,6 +78,7 @@ _fs_conference_init_debug (void)
 {
   GST_DEBUG_CATEGORY_INIT (fs_conference_debug, "fsconference", 0,
       "farstream base conference library");
+  _fs_trace_init ();
 }
 
 static void
@@ -107,9 +108,14 @@ fs_conference_error (GObject *signal_src,
     gchar *error_msg,
     FsConference *conf)
 {
+  FsConferenceClass *klass = FS_CONFERENCE_GET_CLASS (conf);
   GstMessage *gst_msg = NULL;
   GstStructure *error_struct = NULL;
 
+  /* The messages that led to the error must come before it */
+  if (klass->flush_messages)
+    klass->flush_messages (conf);
+
   error_struct = gst_structure_new ("farstream-error",
       "src-object", G_TYPE_OBJECT, error_src,
       "error-no", FS_TYPE_ERROR, error_no,
@@ -241,3 +247,72 @@ fs_parse_error (GObject *object,
 
   return TRUE;
 }
+
+/*
+ * fs_parse_batch_for_object:
+ * @object: the #GObject the messages must be about
+ * @field: the name of the field of the messages holding the object
+ * @type: the #GType of that field
+ * @message: a #GstMessage to parse
+ * @messages: (out): the list of messages about @object, to be freed with
+ *  g_list_free(), the messages themselves belong to @message
+ *
+ * Implements fs_session_parse_batch() and fs_stream_parse_batch()
+ *
+ * Returns: %TRUE if @message is a "farstream-batch" message containing
+ * messages about @object
+ */
+gboolean
+fs_parse_batch_for_object (GObject *object,
+    const gchar *field,
+    GType type,
+    GstMessage *message,
+    GList **messages)
+{
+  const GstStructure *s;
+  const GValue *array;
+  GList *list = NULL;
+  guint i;
+
+  if (GST_MESSAGE_TYPE (message) != GST_MESSAGE_ELEMENT)
+    return FALSE;
+
+  s = gst_message_get_structure (message);
+
+  if (!gst_structure_has_name (s, "farstream-batch"))
+    return FALSE;
+
+  array = gst_structure_get_value (s, "messages");
+  if (!array || !GST_VALUE_HOLDS_ARRAY (array))
+    return FALSE;
+
+  for (i = 0; i < gst_value_array_get_size (array); i++)
+  {
+    const GValue *value = gst_value_array_get_value (array, i);
+    const GValue *object_value;
+    GstMessage *submessage;
+
+    if (!G_VALUE_HOLDS (value, GST_TYPE_MESSAGE))
+      continue;
+    submessage = GST_MESSAGE (gst_value_get_mini_object (value));
+
+    if (!submessage || !gst_message_get_structure (submessage))
+      continue;
+
+    object_value = gst_structure_get_value (
+        gst_message_get_structure (submessage), field);
+    if (object_value && G_VALUE_HOLDS (object_value, type) &&
+        g_value_get_object (object_value) == object)
+      list = g_list_prepend (list, submessage);
+  }
+
+  if (!list)
+    return FALSE;
+
+  if (messages)
+    *messages = g_list_reverse (list);
+  else
+    g_list_free (list);
+
+  return TRUE;
+}
@@ -78,6 +78,9 @@ struct _FsConference
  * @parent: parent GstBin class
  * @new_session: virtual method to create a new conference session
  * @new_participant: virtual method to create a new participant
+ * @flush_messages: virtual method to post the messages the conference is
+ *   holding back, called before an error is posted so that it comes after
+ *   them
  *
  * #FsConferenceClass class structure.
  */
@@ -91,8 +94,10 @@ struct _FsConferenceClass {
   FsParticipant *(* new_participant) (FsConference *conference,
       GError **error);
 
+  void (* flush_messages) (FsConference *conference);
+
   /*< private > */
-  gpointer _gst_reserved[GST_PADDING];
+  gpointer _gst_reserved[GST_PADDING - 1];
 };
 
 GType fs_conference_get_type (void);
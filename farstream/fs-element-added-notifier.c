@@ -30,6 +30,10 @@
  * #GstBin or any sub-bin and any element added in the future to the bin or
  * its sub-bins. There is also a utility method to have it used to
  * set the properties of elements based on a GKeyfile.
+ *
+ * Each bin is only subscribed to once, the notifier keeps a set of the bins
+ * it watches so that re-adding or nesting bins does not need to walk the
+ * signal handlers of every element.
  */
 
 #ifdef HAVE_CONFIG_H
@@ -58,18 +62,59 @@ enum
 
 struct _FsElementAddedNotifierPrivate {
   GList *keyfiles;
+
+  /* Set of the watched bins, they are weak references */
+  GHashTable *bins;
+  GMutex *mutex;
 };
 
+/*
+ * A keyfile is compiled lazily into one plan per group and element type, the
+ * plan contains the resolved #GParamSpec and the deserialized values, so
+ * applying it to an element is only a series of g_object_set_property().
+ */
+
+typedef struct {
+  GParamSpec *pspec;
+  GValue value;
+} PropertyPlan;
+
+typedef struct {
+  GType type;
+  GArray *properties;
+} ElementPlan;
+
+typedef struct {
+  GKeyFile *keyfile;
+  /* Checksum of the keyfile's contents, identifies the settings it applies */
+  gchar *checksum;
+  GMutex *mutex;
+  /* group name -> GSList of ElementPlan, one per element type */
+  GHashTable *plans;
+} KeyfilePlans;
+
 static void _element_added_callback (GstBin *parent, GstElement *element,
     gpointer user_data);
 
 static void fs_element_added_notifier_finalize (GObject *object);
 
+static void keyfile_plans_free (KeyfilePlans *kp);
+
 
 G_DEFINE_TYPE(FsElementAddedNotifier, fs_element_added_notifier, G_TYPE_OBJECT);
 
 static guint signals[LAST_SIGNAL] = { 0 };
 
+/* Each watched bin has the list of the notifiers watching it as qdata, so
+ * that the settings applied to the elements added to it can be found */
+static GStaticMutex watchers_mutex = G_STATIC_MUTEX_INIT;
+static GQuark watchers_quark = 0;
+
+/* The keyfiles are applied by handlers connected to this detail, so they run
+ * in the order they were set relative to the other handlers, but can still
+ * be told apart from them */
+static GQuark keyfile_quark = 0;
+
 static void
 fs_element_added_notifier_class_init (FsElementAddedNotifierClass *klass)
 {
@@ -79,6 +124,9 @@ fs_element_added_notifier_class_init (FsElementAddedNotifierClass *klass)
 
   gobject_class->finalize = fs_element_added_notifier_finalize;
 
+  watchers_quark = g_quark_from_static_string ("fs-element-added-notifiers");
+  keyfile_quark = g_quark_from_static_string ("keyfile");
+
    /**
    * FsElementAddedNotifier::element-added:
    * @self: #FsElementAddedNotifier that emitted the signal
@@ -90,10 +138,12 @@ fs_element_added_notifier_class_init (FsElementAddedNotifierClass *klass)
    * Be careful, there is no guarantee that this will be emitted on your
    * main thread, it will be emitted in the thread that added the element.
    * The bin may be %NULL if this is the top-level bin.
+   * It is emitted with the "keyfile" detail, the keyfiles given to this
+   * object are applied by handlers connected to that detail.
    */
   signals[ELEMENT_ADDED] = g_signal_new ("element-added",
       G_TYPE_FROM_CLASS (klass),
-      G_SIGNAL_RUN_LAST,
+      G_SIGNAL_RUN_LAST | G_SIGNAL_DETAILED,
       0,
       NULL,
       NULL,
@@ -108,6 +158,100 @@ static void
 fs_element_added_notifier_init (FsElementAddedNotifier *notifier)
 {
   notifier->priv = FS_ELEMENT_ADDED_NOTIFIER_GET_PRIVATE(notifier);
+
+  notifier->priv->bins = g_hash_table_new (g_direct_hash, g_direct_equal);
+  notifier->priv->mutex = g_mutex_new ();
+}
+
+static void
+bin_add_watcher (GstElement *bin, FsElementAddedNotifier *self)
+{
+  GSList *watchers;
+
+  g_static_mutex_lock (&watchers_mutex);
+  watchers = g_object_steal_qdata (G_OBJECT (bin), watchers_quark);
+  watchers = g_slist_prepend (watchers, self);
+  g_object_set_qdata_full (G_OBJECT (bin), watchers_quark, watchers,
+      (GDestroyNotify) g_slist_free);
+  g_static_mutex_unlock (&watchers_mutex);
+}
+
+static void
+bin_remove_watcher (GObject *bin, FsElementAddedNotifier *self)
+{
+  GSList *watchers;
+
+  g_static_mutex_lock (&watchers_mutex);
+  watchers = g_object_steal_qdata (bin, watchers_quark);
+  watchers = g_slist_remove (watchers, self);
+  if (watchers)
+    g_object_set_qdata_full (bin, watchers_quark, watchers,
+        (GDestroyNotify) g_slist_free);
+  g_static_mutex_unlock (&watchers_mutex);
+}
+
+static void
+_bin_finalized_cb (gpointer user_data, GObject *where_the_object_was)
+{
+  FsElementAddedNotifier *self = user_data;
+
+  g_mutex_lock (self->priv->mutex);
+  g_hash_table_remove (self->priv->bins, where_the_object_was);
+  g_mutex_unlock (self->priv->mutex);
+}
+
+/*
+ * Returns: %TRUE if the bin was not watched before
+ */
+
+static gboolean
+fs_element_added_notifier_watch_bin (FsElementAddedNotifier *self,
+    GstElement *bin)
+{
+  gboolean added = FALSE;
+
+  g_mutex_lock (self->priv->mutex);
+  if (!g_hash_table_lookup (self->priv->bins, bin))
+  {
+    g_hash_table_insert (self->priv->bins, bin, bin);
+    g_object_weak_ref (G_OBJECT (bin), _bin_finalized_cb, self);
+    added = TRUE;
+  }
+  g_mutex_unlock (self->priv->mutex);
+
+  if (added)
+    bin_add_watcher (bin, self);
+
+  return added;
+}
+
+/*
+ * Returns: %TRUE if the bin was being watched
+ */
+
+static gboolean
+fs_element_added_notifier_unwatch_bin (FsElementAddedNotifier *self,
+    GstObject *bin)
+{
+  gboolean removed;
+
+  g_mutex_lock (self->priv->mutex);
+  removed = g_hash_table_remove (self->priv->bins, bin);
+  if (removed)
+    g_object_weak_unref (G_OBJECT (bin), _bin_finalized_cb, self);
+  g_mutex_unlock (self->priv->mutex);
+
+  if (removed)
+    bin_remove_watcher (G_OBJECT (bin), self);
+
+  return removed;
+}
+
+static void
+_unwatch_bin (gpointer key, gpointer value, gpointer user_data)
+{
+  g_object_weak_unref (G_OBJECT (key), _bin_finalized_cb, user_data);
+  bin_remove_watcher (G_OBJECT (key), user_data);
 }
 
 
@@ -117,9 +261,15 @@ fs_element_added_notifier_finalize (GObject *object)
 {
   FsElementAddedNotifier *self = FS_ELEMENT_ADDED_NOTIFIER (object);
 
-  g_list_foreach (self->priv->keyfiles, (GFunc) g_key_file_free, NULL);
+  g_hash_table_foreach (self->priv->bins, _unwatch_bin, self);
+  g_hash_table_destroy (self->priv->bins);
+
+  g_list_foreach (self->priv->keyfiles, (GFunc) keyfile_plans_free, NULL);
   g_list_free (self->priv->keyfiles);
   self->priv->keyfiles = NULL;
+  g_mutex_free (self->priv->mutex);
+
+  G_OBJECT_CLASS (fs_element_added_notifier_parent_class)->finalize (object);
 }
 
 /**
@@ -164,11 +314,15 @@ _bin_unparented_cb (GstObject *object, GstObject *parent, gpointer user_data)
   GstIterator *iter = NULL;
   gboolean done;
 
-  /* Return if there was no handler connected */
-  if (g_signal_handlers_disconnect_by_func (object, _element_added_callback,
-          user_data) == 0)
+  /* Return if the bin was not watched */
+  if (!fs_element_added_notifier_unwatch_bin (user_data, object))
     return;
 
+  g_signal_handlers_disconnect_by_func (object, _element_added_callback,
+      user_data);
+  g_signal_handlers_disconnect_by_func (object, _bin_unparented_cb,
+      user_data);
+
   iter = gst_bin_iterate_elements (GST_BIN (object));
 
   done = FALSE;
@@ -214,21 +368,19 @@ gboolean
 fs_element_added_notifier_remove (FsElementAddedNotifier *notifier,
     GstBin *bin)
 {
+  gboolean watched;
+
   g_return_val_if_fail (FS_IS_ELEMENT_ADDED_NOTIFIER (notifier), FALSE);
   g_return_val_if_fail (GST_IS_BIN (bin), FALSE);
 
-  if (g_signal_handler_find (bin,
-          G_SIGNAL_MATCH_FUNC | G_SIGNAL_MATCH_DATA,
-          0, 0, NULL, /* id, detail, closure */
-          _element_added_callback, notifier) != 0)
-  {
+  g_mutex_lock (notifier->priv->mutex);
+  watched = (g_hash_table_lookup (notifier->priv->bins, bin) != NULL);
+  g_mutex_unlock (notifier->priv->mutex);
+
+  if (watched)
     _bin_unparented_cb (GST_OBJECT (bin), NULL, notifier);
-    return TRUE;
-  }
-  else
-  {
-    return FALSE;
-  }
+
+  return watched;
 }
 
 
@@ -239,75 +391,190 @@ fs_element_added_notifier_remove (FsElementAddedNotifier *notifier,
 #endif
 
 static void
-_bin_added_from_keyfile (FsElementAddedNotifier *notifier, GstBin *bin,
-    GstElement *element, gpointer user_data)
+element_plan_free (ElementPlan *plan)
 {
-  GKeyFile *keyfile = user_data;
-  const gchar *name = NULL;
-  gchar *free_name = NULL;
-  gchar **keys;
-  gint i;
-  GstElementFactory *factory = gst_element_get_factory (element);
+  guint i;
 
-  if (factory)
+  for (i = 0; i < plan->properties->len; i++)
   {
-    name = gst_plugin_feature_get_name (GST_PLUGIN_FEATURE (factory));
-    if (name && !g_key_file_has_group (keyfile, name))
-        name = NULL;
-  }
+    PropertyPlan *prop = &g_array_index (plan->properties, PropertyPlan, i);
 
-  if (!name)
-  {
-    GST_OBJECT_LOCK (element);
-    if (GST_OBJECT_NAME (element) &&
-        g_key_file_has_group (keyfile, GST_OBJECT_NAME (element)))
-      name = free_name = g_strdup (GST_OBJECT_NAME (element));
-    GST_OBJECT_UNLOCK (element);
+    g_param_spec_unref (prop->pspec);
+    g_value_unset (&prop->value);
   }
+  g_array_free (plan->properties, TRUE);
+  g_slice_free (ElementPlan, plan);
+}
 
-  if (!name)
-    return;
+static void
+element_plan_list_free (GSList *list)
+{
+  g_slist_foreach (list, (GFunc) element_plan_free, NULL);
+  g_slist_free (list);
+}
 
-  DEBUG ("Found config for %s", name);
+static KeyfilePlans *
+keyfile_plans_new (GKeyFile *keyfile)
+{
+  KeyfilePlans *kp = g_slice_new (KeyfilePlans);
+  gchar *data;
+  gsize len;
+
+  kp->keyfile = keyfile;
+  kp->mutex = g_mutex_new ();
+
+  data = g_key_file_to_data (keyfile, &len, NULL);
+  kp->checksum = g_compute_checksum_for_string (G_CHECKSUM_SHA1, data, len);
+  g_free (data);
+
+  kp->plans = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+      (GDestroyNotify) element_plan_list_free);
+
+  return kp;
+}
+
+static void
+keyfile_plans_free (KeyfilePlans *kp)
+{
+  g_hash_table_destroy (kp->plans);
+  g_mutex_free (kp->mutex);
+  g_free (kp->checksum);
+  g_key_file_free (kp->keyfile);
+  g_slice_free (KeyfilePlans, kp);
+}
+
+static ElementPlan *
+element_plan_compile (GKeyFile *keyfile, const gchar *name, GType type)
+{
+  ElementPlan *plan = g_slice_new (ElementPlan);
+  GObjectClass *klass = g_type_class_ref (type);
+  gchar **keys;
+  gint i;
+
+  plan->type = type;
+  plan->properties = g_array_new (FALSE, TRUE, sizeof (PropertyPlan));
+
+  DEBUG ("Compiling config for %s", name);
   keys = g_key_file_get_keys (keyfile, name, NULL, NULL);
 
-  for (i = 0; keys[i]; i++)
+  for (i = 0; keys && keys[i]; i++)
   {
-    GParamSpec *param_spec;
-    GValue prop_value = { 0 };
+    PropertyPlan prop = { NULL, { 0 } };
     gchar *str_value;
 
-    DEBUG ("getting %s", keys[i]);
-    param_spec = g_object_class_find_property (G_OBJECT_GET_CLASS(element),
-        keys[i]);
+    prop.pspec = g_object_class_find_property (klass, keys[i]);
 
-    if (!param_spec)
+    if (!prop.pspec)
     {
       DEBUG ("Property %s does not exist in element %s, ignoring",
           keys[i], name);
       continue;
     }
 
-    g_value_init (&prop_value, param_spec->value_type);
+    g_value_init (&prop.value, prop.pspec->value_type);
 
     str_value = g_key_file_get_value (keyfile, name, keys[i], NULL);
-    if (str_value && gst_value_deserialize (&prop_value, str_value))
+    if (str_value && gst_value_deserialize (&prop.value, str_value))
     {
-      DEBUG ("Setting %s to on %s", keys[i], name);
-      g_object_set_property (G_OBJECT (element), keys[i], &prop_value);
+      g_param_spec_ref (prop.pspec);
+      g_array_append_val (plan->properties, prop);
     }
     else
     {
       DEBUG ("Could not read value for property %s", keys[i]);
+      g_value_unset (&prop.value);
     }
     g_free (str_value);
-    g_value_unset (&prop_value);
   }
 
   g_strfreev (keys);
+  g_type_class_unref (klass);
+
+  return plan;
+}
+
+static ElementPlan *
+keyfile_plans_lookup (KeyfilePlans *kp, const gchar *name, GType type)
+{
+  GSList *list, *item;
+  ElementPlan *plan;
+
+  g_mutex_lock (kp->mutex);
+
+  list = g_hash_table_lookup (kp->plans, name);
+  for (item = list; item; item = item->next)
+  {
+    plan = item->data;
+    if (plan->type == type)
+      goto out;
+  }
+
+  plan = element_plan_compile (kp->keyfile, name, type);
+
+  /* Appending to a non-empty list keeps the same head */
+  if (list)
+    g_slist_append (list, plan);
+  else
+    g_hash_table_insert (kp->plans, g_strdup (name),
+        g_slist_append (NULL, plan));
+
+ out:
+  g_mutex_unlock (kp->mutex);
+
+  /* Plans are never modified or freed until the notifier is finalized */
+  return plan;
+}
+
+static void
+keyfile_plans_apply (KeyfilePlans *kp, GstElement *element)
+{
+  const gchar *name = NULL;
+  gchar *free_name = NULL;
+  ElementPlan *plan;
+  guint i;
+  GstElementFactory *factory = gst_element_get_factory (element);
+
+  if (factory)
+  {
+    name = gst_plugin_feature_get_name (GST_PLUGIN_FEATURE (factory));
+    if (name && !g_key_file_has_group (kp->keyfile, name))
+        name = NULL;
+  }
+
+  if (!name)
+  {
+    GST_OBJECT_LOCK (element);
+    if (GST_OBJECT_NAME (element) &&
+        g_key_file_has_group (kp->keyfile, GST_OBJECT_NAME (element)))
+      name = free_name = g_strdup (GST_OBJECT_NAME (element));
+    GST_OBJECT_UNLOCK (element);
+  }
+
+  if (!name)
+    return;
+
+  DEBUG ("Found config for %s", name);
+  plan = keyfile_plans_lookup (kp, name, G_OBJECT_TYPE (element));
+
+  for (i = 0; i < plan->properties->len; i++)
+  {
+    PropertyPlan *prop = &g_array_index (plan->properties, PropertyPlan, i);
+
+    DEBUG ("Setting %s to on %s", prop->pspec->name, name);
+    g_object_set_property (G_OBJECT (element), prop->pspec->name,
+        &prop->value);
+  }
+
   g_free (free_name);
 }
 
+static void
+_bin_added_from_keyfile (FsElementAddedNotifier *notifier, GstBin *bin,
+    GstElement *element, gpointer user_data)
+{
+  keyfile_plans_apply (user_data, element);
+}
+
 
 /**
  * fs_element_added_notifier_set_properties_from_keyfile:
@@ -326,14 +593,20 @@ fs_element_added_notifier_set_properties_from_keyfile (
     FsElementAddedNotifier *notifier,
     GKeyFile *keyfile)
 {
+  KeyfilePlans *kp;
+
   g_return_if_fail (FS_IS_ELEMENT_ADDED_NOTIFIER (notifier));
   g_return_if_fail (keyfile);
 
-  g_signal_connect (notifier, "element-added",
-      G_CALLBACK (_bin_added_from_keyfile), keyfile);
+  kp = keyfile_plans_new (keyfile);
+
+  g_signal_connect (notifier, "element-added::keyfile",
+      G_CALLBACK (_bin_added_from_keyfile), kp);
 
+  g_mutex_lock (notifier->priv->mutex);
   notifier->priv->keyfiles =
-    g_list_prepend (notifier->priv->keyfiles, keyfile);
+    g_list_append (notifier->priv->keyfiles, kp);
+  g_mutex_unlock (notifier->priv->mutex);
 }
 
 
@@ -373,7 +646,19 @@ _element_added_callback (GstBin *parent, GstElement *element,
 {
   FsElementAddedNotifier *notifier = FS_ELEMENT_ADDED_NOTIFIER (user_data);
 
-  if (GST_IS_BIN (element)) {
+  if (GST_IS_BIN (element) &&
+      !fs_element_added_notifier_watch_bin (notifier, element))
+  {
+    /* Already watched, so are its children, but it may have been watched
+     * as a top-level bin, without a parent to be removed from */
+    if (parent && g_signal_handler_find (element,
+            G_SIGNAL_MATCH_FUNC | G_SIGNAL_MATCH_DATA, 0, 0, NULL,
+            _bin_unparented_cb, notifier) == 0)
+      g_signal_connect_object (element, "parent-unset",
+          G_CALLBACK (_bin_unparented_cb), notifier, 0);
+  }
+  else if (GST_IS_BIN (element))
+  {
     GstIterator *iter = NULL;
     gboolean done;
 
@@ -393,12 +678,7 @@ _element_added_callback (GstBin *parent, GstElement *element,
 
       switch (gst_iterator_next (iter, &item)) {
        case GST_ITERATOR_OK:
-         /* We make sure the callback has not already been added */
-         if (g_signal_handler_find (item,
-                 G_SIGNAL_MATCH_FUNC | G_SIGNAL_MATCH_DATA,
-                 0, 0, NULL, /* id, detail, closure */
-                 _element_added_callback, notifier) == 0)
-           _element_added_callback (GST_BIN_CAST (element), item, notifier);
+         _element_added_callback (GST_BIN_CAST (element), item, notifier);
          gst_object_unref (item);
          break;
        case GST_ITERATOR_RESYNC:
@@ -419,7 +699,8 @@ _element_added_callback (GstBin *parent, GstElement *element,
   }
 
   if (parent)
-    g_signal_emit (notifier, signals[ELEMENT_ADDED], 0, parent, element);
+    g_signal_emit (notifier, signals[ELEMENT_ADDED], keyfile_quark, parent,
+        element);
 }
 
 
@@ -447,3 +728,59 @@ fs_element_added_notifier_set_default_properties (
 
   fs_element_added_notifier_set_properties_from_keyfile(notifier, keyfile);
 }
+
+/**
+ * fs_element_added_notifier_get_settings_id:
+ * @element: a #GstElement
+ *
+ * Identifies the properties that the notifiers watching @element will set on
+ * the elements added to it, so that something computed from such elements
+ * can be cached. The id only depends on the contents of the keyfiles given to
+ * these notifiers.
+ *
+ * Returns: a newly allocated string that changes with the keyfiles applied,
+ * the empty string if no notifier sets any property or %NULL if one of them
+ * has #FsElementAddedNotifier::element-added handlers, which could set
+ * anything
+ */
+gchar *
+fs_element_added_notifier_get_settings_id (GstElement *element)
+{
+  GString *id = g_string_new (NULL);
+  GSList *item;
+
+  g_return_val_if_fail (GST_IS_ELEMENT (element), NULL);
+
+  g_static_mutex_lock (&watchers_mutex);
+  for (item = g_object_get_qdata (G_OBJECT (element), watchers_quark);
+       item;
+       item = item->next)
+  {
+    FsElementAddedNotifier *notifier = item->data;
+    GList *kpitem;
+
+    /* Any handler not applying a keyfile */
+    if (g_signal_handler_find (notifier,
+            G_SIGNAL_MATCH_ID | G_SIGNAL_MATCH_DETAIL |
+            G_SIGNAL_MATCH_UNBLOCKED,
+            signals[ELEMENT_ADDED], 0, NULL, NULL, NULL))
+    {
+      g_string_free (id, TRUE);
+      id = NULL;
+      break;
+    }
+
+    g_mutex_lock (notifier->priv->mutex);
+    for (kpitem = notifier->priv->keyfiles; kpitem; kpitem = kpitem->next)
+    {
+      KeyfilePlans *kp = kpitem->data;
+
+      g_string_append (id, kp->checksum);
+      g_string_append_c (id, ';');
+    }
+    g_mutex_unlock (notifier->priv->mutex);
+  }
+  g_static_mutex_unlock (&watchers_mutex);
+
+  return id ? g_string_free (id, FALSE) : NULL;
+}
@@ -100,6 +100,8 @@ void fs_element_added_notifier_set_default_properties (
     FsElementAddedNotifier *notifier,
     GstElement *element);
 
+gchar *fs_element_added_notifier_get_settings_id (GstElement *element);
+
 G_END_DECLS
 
 #endif /* __FS_ELEMENT_ADDED_NOTIFIER_H__ */
@@ -32,6 +32,10 @@
 #include "fs-plugin.h"
 
 #include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <glib/gstdio.h>
 
 #include "fs-conference.h"
 #include "fs-private.h"
@@ -44,6 +48,13 @@
  *
  * This class is a generic class to load GType plugins based on their name.
  * With this simple class, you can only have one type per plugin.
+ *
+ * The location of the plugins that have been found is remembered in an index
+ * stored in the user's cache directory (or in the file pointed to by the
+ * FS_PLUGIN_INDEX environment variable), so that the search path does not
+ * need to be probed again as long as the plugin file is not modified.
+ * Plugins can also be linked statically into the application and registered
+ * with fs_plugin_register_static().
  */
 
 #define FS_PLUGIN_GET_PRIVATE(o)  \
@@ -56,9 +67,21 @@ static GStaticMutex mutex = G_STATIC_MUTEX_INIT;
 static gchar **search_paths = NULL;
 static GList *plugins = NULL;
 
+/* Protected by the mutex */
+static GKeyFile *plugin_index = NULL;
+/* While a scan is in progress, the index is only written once at the end */
+static gboolean plugin_index_scanning = FALSE;
+static gboolean plugin_index_dirty = FALSE;
+/* full name -> FsPluginRegisterFunc, protected by the mutex */
+static GHashTable *static_plugins = NULL;
+
+#define INDEX_GROUP "index"
+
 struct _FsPluginPrivate
 {
   GModule *handle;
+  gchar *type_suffix;
+  FsPluginRegisterFunc register_func;
 };
 
 G_DEFINE_TYPE(FsPlugin, fs_plugin, G_TYPE_TYPE_MODULE);
@@ -90,6 +113,237 @@ fs_plugin_search_path_init (void)
     }
 }
 
+static gchar *
+fs_plugin_index_path (void)
+{
+  const gchar *env = g_getenv ("FS_PLUGIN_INDEX");
+
+  if (env)
+    return g_strdup (env);
+  else
+    return g_build_filename (g_get_user_cache_dir (), "farstream",
+        "plugins." HOST_CPU ".index", NULL);
+}
+
+static void
+fs_plugin_index_load_locked (void)
+{
+  gchar *path;
+  gchar *indexed_paths;
+  gchar *current_paths;
+
+  if (plugin_index)
+    return;
+
+  plugin_index = g_key_file_new ();
+  path = fs_plugin_index_path ();
+
+  if (!g_key_file_load_from_file (plugin_index, path, G_KEY_FILE_NONE, NULL))
+  {
+    GST_DEBUG ("No plugin index at %s", path);
+    g_free (path);
+    return;
+  }
+  g_free (path);
+
+  /* The index is only valid for the search path it was created with */
+  indexed_paths = g_key_file_get_string (plugin_index, INDEX_GROUP,
+      "search-path", NULL);
+  current_paths = g_strjoinv (":", search_paths);
+
+  if (!indexed_paths || strcmp (indexed_paths, current_paths))
+  {
+    GST_DEBUG ("Plugin search path changed, ignoring the plugin index");
+    g_key_file_free (plugin_index);
+    plugin_index = g_key_file_new ();
+  }
+
+  g_free (indexed_paths);
+  g_free (current_paths);
+}
+
+static void
+fs_plugin_index_save_locked (void)
+{
+  gchar *path;
+  gchar *dirname;
+  gchar *data;
+  gchar *current_paths;
+  gsize length;
+  GError *error = NULL;
+
+  current_paths = g_strjoinv (":", search_paths);
+  g_key_file_set_string (plugin_index, INDEX_GROUP, "search-path",
+      current_paths);
+  g_free (current_paths);
+
+  plugin_index_dirty = FALSE;
+
+  path = fs_plugin_index_path ();
+  dirname = g_path_get_dirname (path);
+  g_mkdir_with_parents (dirname, 0755);
+  g_free (dirname);
+
+  data = g_key_file_to_data (plugin_index, &length, NULL);
+  if (!g_file_set_contents (path, data, length, &error))
+  {
+    GST_DEBUG ("Could not write the plugin index to %s: %s", path,
+        error->message);
+    g_clear_error (&error);
+  }
+  g_free (data);
+  g_free (path);
+}
+
+static gboolean
+fs_plugin_get_mtime (const gchar *path, gint64 *mtime)
+{
+  struct stat buf;
+
+  if (g_stat (path, &buf) < 0)
+    return FALSE;
+
+  *mtime = buf.st_mtime;
+  return TRUE;
+}
+
+static void
+fs_plugin_index_remove_locked (const gchar *name)
+{
+  if (!g_key_file_remove_group (plugin_index, name, NULL))
+    return;
+
+  plugin_index_dirty = TRUE;
+  if (!plugin_index_scanning)
+    fs_plugin_index_save_locked ();
+}
+
+/*
+ * Returns: the modification times of the search path directories, -1 for
+ * the ones that do not exist
+ */
+
+static gchar **
+fs_plugin_get_search_path_mtimes (void)
+{
+  guint n = g_strv_length (search_paths);
+  gchar **mtimes = g_new0 (gchar *, n + 1);
+  guint i;
+
+  for (i = 0; i < n; i++)
+  {
+    gint64 mtime;
+
+    if (!fs_plugin_get_mtime (search_paths[i], &mtime))
+      mtime = -1;
+    mtimes[i] = g_strdup_printf ("%" G_GINT64_FORMAT, mtime);
+  }
+
+  return mtimes;
+}
+
+/*
+ * Adding or removing a plugin changes the modification time of its
+ * directory, so the directories must be scanned again for plugins of
+ * @type_suffix if any of them changed since the last scan for that type.
+ */
+
+static gboolean
+fs_plugin_index_search_path_changed_locked (const gchar *type_suffix)
+{
+  gchar *key = g_strdup_printf ("scanned-%s", type_suffix);
+  gchar **indexed;
+  gchar **current;
+  gboolean changed = FALSE;
+  guint i;
+
+  indexed = g_key_file_get_string_list (plugin_index, INDEX_GROUP, key,
+      NULL, NULL);
+  g_free (key);
+  if (!indexed)
+    return TRUE;
+
+  current = fs_plugin_get_search_path_mtimes ();
+
+  if (g_strv_length (indexed) != g_strv_length (current))
+    changed = TRUE;
+  for (i = 0; !changed && current[i]; i++)
+    if (strcmp (indexed[i], current[i]))
+      changed = TRUE;
+
+  g_strfreev (indexed);
+  g_strfreev (current);
+
+  return changed;
+}
+
+/*
+ * @mtimes: the modification times of the search path taken before it was
+ *  scanned, so a plugin added during the scan is found by the next one
+ */
+
+static void
+fs_plugin_index_set_search_path_scanned_locked (const gchar *type_suffix,
+    gchar **mtimes)
+{
+  gchar *key = g_strdup_printf ("scanned-%s", type_suffix);
+
+  g_key_file_set_string_list (plugin_index, INDEX_GROUP, key,
+      (const gchar * const *) mtimes, g_strv_length (mtimes));
+  g_free (key);
+
+  plugin_index_dirty = TRUE;
+}
+
+/*
+ * Returns: the path of the plugin from the index if the file has not been
+ * modified since it was indexed, %NULL otherwise
+ */
+
+static gchar *
+fs_plugin_index_lookup_locked (const gchar *name)
+{
+  gchar *path;
+  gint64 mtime;
+
+  fs_plugin_index_load_locked ();
+
+  path = g_key_file_get_string (plugin_index, name, "path", NULL);
+  if (!path)
+    return NULL;
+
+  if (!fs_plugin_get_mtime (path, &mtime) ||
+      mtime != g_key_file_get_int64 (plugin_index, name, "mtime", NULL))
+  {
+    GST_DEBUG ("Indexed plugin %s at %s is stale", name, path);
+    fs_plugin_index_remove_locked (name);
+    g_free (path);
+    return NULL;
+  }
+
+  return path;
+}
+
+static void
+fs_plugin_index_add_locked (FsPlugin *plugin, const gchar *path)
+{
+  gint64 mtime;
+
+  if (!fs_plugin_get_mtime (path, &mtime))
+    return;
+
+  fs_plugin_index_load_locked ();
+
+  g_key_file_set_string (plugin_index, plugin->name, "path", path);
+  g_key_file_set_string (plugin_index, plugin->name, "type",
+      plugin->priv->type_suffix);
+  g_key_file_set_int64 (plugin_index, plugin->name, "mtime", mtime);
+
+  plugin_index_dirty = TRUE;
+  if (!plugin_index_scanning)
+    fs_plugin_index_save_locked ();
+}
+
 static void
 fs_plugin_class_init (FsPluginClass * klass)
 {
@@ -113,6 +367,29 @@ fs_plugin_init (FsPlugin * plugin)
   plugin->priv->handle = NULL;
 }
 
+static gboolean
+fs_plugin_open_locked (FsPlugin *plugin, const gchar *path,
+    gboolean (**fs_init_plugin) (FsPlugin *))
+{
+  plugin->priv->handle = g_module_open (path, G_MODULE_BIND_LOCAL);
+  GST_INFO ("opening module %s: %s\n", path,
+    (plugin->priv->handle != NULL) ? "succeeded" : g_module_error ());
+
+  if (!plugin->priv->handle)
+    return FALSE;
+
+  if (!g_module_symbol (plugin->priv->handle, "fs_init_plugin",
+          (gpointer) fs_init_plugin))
+  {
+    g_module_close (plugin->priv->handle);
+    plugin->priv->handle = NULL;
+    GST_WARNING ("could not find init function in plugin\n");
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
 static gboolean fs_plugin_load (GTypeModule *module)
 {
   FsPlugin *plugin = FS_PLUGIN(module);
@@ -124,31 +401,28 @@ static gboolean fs_plugin_load (GTypeModule *module)
   g_return_val_if_fail (plugin != NULL, FALSE);
   g_return_val_if_fail (plugin->name != NULL && plugin->name[0] != '\0', FALSE);
 
-  for (search_path = search_paths; *search_path; search_path++) {
-    GST_DEBUG("looking for plugins in %s", *search_path);
-
-    path = g_module_build_path (*search_path, plugin->name);
+  if (plugin->priv->register_func) {
+    plugin->type = plugin->priv->register_func (plugin);
+    return plugin->type != 0;
+  }
 
-    plugin->priv->handle = g_module_open (path, G_MODULE_BIND_LOCAL);
-    GST_INFO ("opening module %s: %s\n", path,
-      (plugin->priv->handle != NULL) ? "succeeded" : g_module_error ());
+  path = fs_plugin_index_lookup_locked (plugin->name);
+  if (path) {
+    if (!fs_plugin_open_locked (plugin, path, &fs_init_plugin))
+      fs_plugin_index_remove_locked (plugin->name);
     g_free (path);
+  }
 
-    if (!plugin->priv->handle) {
-      continue;
-    }
+  for (search_path = search_paths;
+       !plugin->priv->handle && *search_path;
+       search_path++) {
+    GST_DEBUG("looking for plugins in %s", *search_path);
 
-    else if (!g_module_symbol (plugin->priv->handle,
-                          "fs_init_plugin",
-                          (gpointer) & fs_init_plugin)) {
-      g_module_close (plugin->priv->handle);
-      plugin->priv->handle = NULL;
-      GST_WARNING ("could not find init function in plugin\n");
-      continue;
-    }
+    path = g_module_build_path (*search_path, plugin->name);
 
-    else
-      break;
+    if (fs_plugin_open_locked (plugin, path, &fs_init_plugin))
+      fs_plugin_index_add_locked (plugin, path);
+    g_free (path);
   }
 
   if (!plugin->priv->handle) {
@@ -202,6 +476,43 @@ fs_plugin_get_by_name_locked (const gchar * name, const gchar * type_suffix)
 }
 
 
+static FsPlugin *
+fs_plugin_get_or_load_locked (const gchar *name, const gchar *type_suffix,
+    GError **error)
+{
+  FsPlugin *plugin;
+
+  plugin = fs_plugin_get_by_name_locked (name, type_suffix);
+
+  if (plugin)
+    return plugin;
+
+  plugin = g_object_new (FS_TYPE_PLUGIN, NULL);
+  if (!plugin) {
+    g_set_error (error, FS_ERROR, FS_ERROR_CONSTRUCTION,
+      "Could not create a fsplugin object");
+    return NULL;
+  }
+  plugin->name = g_strdup_printf ("%s-%s",name,type_suffix);
+  plugin->priv->type_suffix = g_strdup (type_suffix);
+  if (static_plugins)
+    plugin->priv->register_func = g_hash_table_lookup (static_plugins,
+        plugin->name);
+  g_type_module_set_name (G_TYPE_MODULE (plugin), plugin->name);
+  plugins = g_list_append (plugins, plugin);
+
+  /* We do the use once and then we keep it loaded forever because
+   * the gstreamer libraries can't be unloaded
+   */
+  if (!g_type_module_use (G_TYPE_MODULE (plugin))) {
+    g_set_error (error, FS_ERROR, FS_ERROR_CONSTRUCTION,
+        "Could not load the %s-%s transmitter plugin", name, type_suffix);
+    return NULL;
+  }
+
+  return plugin;
+}
+
 /**
  * fs_plugin_create_valist:
  * @name: The name of the plugin to load
@@ -230,34 +541,12 @@ fs_plugin_create_valist (const gchar *name, const gchar *type_suffix,
   _fs_conference_init_debug ();
 
   g_static_mutex_lock (&mutex);
-
-  plugin = fs_plugin_get_by_name_locked (name, type_suffix);
-
-  if (!plugin) {
-    plugin = g_object_new (FS_TYPE_PLUGIN, NULL);
-    if (!plugin) {
-      g_static_mutex_unlock (&mutex);
-      g_set_error (error, FS_ERROR, FS_ERROR_CONSTRUCTION,
-        "Could not create a fsplugin object");
-      return NULL;
-    }
-    plugin->name = g_strdup_printf ("%s-%s",name,type_suffix);
-    g_type_module_set_name (G_TYPE_MODULE (plugin), plugin->name);
-    plugins = g_list_append (plugins, plugin);
-
-    /* We do the use once and then we keep it loaded forever because
-     * the gstreamer libraries can't be unloaded
-     */
-    if (!g_type_module_use (G_TYPE_MODULE (plugin))) {
-      g_static_mutex_unlock (&mutex);
-      g_set_error (error, FS_ERROR, FS_ERROR_CONSTRUCTION,
-          "Could not load the %s-%s transmitter plugin", name, type_suffix);
-      return NULL;
-    }
-  }
-
+  plugin = fs_plugin_get_or_load_locked (name, type_suffix, error);
   g_static_mutex_unlock (&mutex);
 
+  if (!plugin)
+    return NULL;
+
   object = g_object_new_valist (plugin->type, first_property_name, var_args);
 
   return object;
@@ -373,6 +662,40 @@ fs_plugin_list_available (const gchar *type_suffix)
 
   g_regex_unref (matcher);
 
+  if (static_plugins)
+  {
+    GHashTableIter iter;
+    gpointer key;
+    gchar *suffix = g_strdup_printf ("-%s", type_suffix);
+
+    g_hash_table_iter_init (&iter, static_plugins);
+    while (g_hash_table_iter_next (&iter, &key, NULL))
+    {
+      const gchar *fullname = key;
+      gint i;
+      gboolean found = FALSE;
+      gchar *name;
+
+      if (!g_str_has_suffix (fullname, suffix))
+        continue;
+
+      name = g_strndup (fullname, strlen (fullname) - strlen (suffix));
+      for (i = 0; i < list->len; i++)
+      {
+        if (!strcmp (name, g_ptr_array_index (list, i)))
+        {
+          found = TRUE;
+          break;
+        }
+      }
+      if (found)
+        g_free (name);
+      else
+        g_ptr_array_add (list, name);
+    }
+    g_free (suffix);
+  }
+
   if (list->len)
   {
     g_ptr_array_add (list, NULL);
@@ -388,3 +711,149 @@ fs_plugin_list_available (const gchar *type_suffix)
 
   return retval;
 }
+
+/**
+ * fs_plugin_preload:
+ * @type_suffix: The type of plugins to load (normally "transmitter")
+ * @error: location of a #GError, or NULL if no error occured
+ *
+ * Loads all of the available plugins of a certain type, so that creating
+ * objects from them later does not have to search for them. The plugins
+ * already present in the plugin index are loaded directly, the search path
+ * is only scanned if the index has no plugin of this type or if one of its
+ * directories was modified since the last scan.
+ *
+ * Returns: %TRUE if all the plugins could be loaded, %FALSE otherwise
+ */
+
+gboolean
+fs_plugin_preload (const gchar *type_suffix, GError **error)
+{
+  gchar **names = NULL;
+  gchar **groups;
+  gchar *suffix;
+  gboolean ret = TRUE;
+  gboolean indexed = FALSE;
+  gchar **mtimes = NULL;
+  gboolean scan;
+  gint i;
+
+  g_return_val_if_fail (type_suffix, FALSE);
+
+  _fs_conference_init_debug ();
+
+  suffix = g_strdup_printf ("-%s", type_suffix);
+
+  g_static_mutex_lock (&mutex);
+  fs_plugin_search_path_init ();
+  fs_plugin_index_load_locked ();
+  plugin_index_scanning = TRUE;
+
+  groups = g_key_file_get_groups (plugin_index, NULL);
+  for (i = 0; groups[i]; i++)
+  {
+    gchar *type = g_key_file_get_string (plugin_index, groups[i], "type",
+        NULL);
+
+    if (type && !strcmp (type, type_suffix) &&
+        g_str_has_suffix (groups[i], suffix))
+    {
+      gchar *name = g_strndup (groups[i],
+          strlen (groups[i]) - strlen (suffix));
+
+      indexed = TRUE;
+      if (!fs_plugin_get_or_load_locked (name, type_suffix, NULL))
+        GST_DEBUG ("Could not load indexed plugin %s", groups[i]);
+      g_free (name);
+    }
+    g_free (type);
+  }
+  g_strfreev (groups);
+
+  scan = !indexed || fs_plugin_index_search_path_changed_locked (type_suffix);
+  if (scan)
+    mtimes = fs_plugin_get_search_path_mtimes ();
+
+  g_static_mutex_unlock (&mutex);
+
+  /* Only scan the search path if nothing is indexed yet or if a plugin may
+   * have been added, it also lists the static plugins, otherwise those are
+   * added directly */
+  if (scan)
+    names = fs_plugin_list_available (type_suffix);
+
+  g_static_mutex_lock (&mutex);
+  if (scan)
+    fs_plugin_index_set_search_path_scanned_locked (type_suffix, mtimes);
+  else if (static_plugins)
+  {
+    GHashTableIter iter;
+    gpointer key;
+
+    g_hash_table_iter_init (&iter, static_plugins);
+    while (g_hash_table_iter_next (&iter, &key, NULL))
+    {
+      const gchar *fullname = key;
+      gchar *name;
+
+      if (!g_str_has_suffix (fullname, suffix))
+        continue;
+
+      name = g_strndup (fullname, strlen (fullname) - strlen (suffix));
+      if (!fs_plugin_get_or_load_locked (name, type_suffix, ret ? error : NULL))
+        ret = FALSE;
+      g_free (name);
+    }
+  }
+
+  for (i = 0; names && names[i]; i++)
+  {
+    if (fs_plugin_get_by_name_locked (names[i], type_suffix))
+      continue;
+
+    if (!fs_plugin_get_or_load_locked (names[i], type_suffix,
+            ret ? error : NULL))
+      ret = FALSE;
+  }
+
+  plugin_index_scanning = FALSE;
+  if (plugin_index_dirty)
+    fs_plugin_index_save_locked ();
+  g_static_mutex_unlock (&mutex);
+
+  g_strfreev (names);
+  g_strfreev (mtimes);
+  g_free (suffix);
+
+  return ret;
+}
+
+/**
+ * fs_plugin_register_static:
+ * @name: The name of the plugin
+ * @type_suffix: The type of plugin (normally "transmitter")
+ * @register_func: (scope notified): The function that registers the #GType
+ *   of the plugin
+ *
+ * Registers a plugin that is linked into the application instead of being
+ * loaded from a module. It will be used instead of any module with the same
+ * name found in the search path. This must be called before the plugin is
+ * first used.
+ */
+
+void
+fs_plugin_register_static (const gchar *name, const gchar *type_suffix,
+    FsPluginRegisterFunc register_func)
+{
+  g_return_if_fail (name);
+  g_return_if_fail (type_suffix);
+  g_return_if_fail (register_func);
+
+  g_static_mutex_lock (&mutex);
+  if (!static_plugins)
+    static_plugins = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+        NULL);
+  g_hash_table_insert (static_plugins,
+      g_strdup_printf ("%s-%s", name, type_suffix), register_func);
+  g_static_mutex_unlock (&mutex);
+}
@@ -90,6 +90,18 @@ struct _FsPluginClass
 
 GType fs_plugin_get_type (void);
 
+/**
+ * FsPluginRegisterFunc:
+ * @plugin: The #FsPlugin the type is registered into
+ *
+ * A function that registers the #GType of a statically linked plugin,
+ * as would be passed to FS_INIT_PLUGIN().
+ *
+ * Returns: the registered #GType
+ */
+
+typedef GType (*FsPluginRegisterFunc) (FsPlugin *plugin);
+
 
 GObject *fs_plugin_create_valist (const gchar *name,
                                   const gchar *type_suffix,
@@ -104,6 +116,12 @@ GObject *fs_plugin_create (const gchar *name,
 
 gchar **fs_plugin_list_available (const gchar *type_suffix);
 
+gboolean fs_plugin_preload (const gchar *type_suffix, GError **error);
+
+void fs_plugin_register_static (const gchar *name,
+                                const gchar *type_suffix,
+                                FsPluginRegisterFunc register_func);
+
 /**
  * FS_INIT_PLUGIN:
  * @type_register_func: A function that register a #GType and returns it
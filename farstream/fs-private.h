@@ -32,6 +32,11 @@ G_BEGIN_DECLS
 
 void _fs_conference_init_debug (void);
 
+void _fs_trace_init (void);
+
+gboolean fs_parse_batch_for_object (GObject *object, const gchar *field,
+    GType type, GstMessage *message, GList **messages);
+
 GST_DEBUG_CATEGORY_EXTERN (fs_conference_debug);
 
 G_END_DECLS
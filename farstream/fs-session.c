@@ -940,3 +940,31 @@ fs_session_parse_telephony_event_stopped (FsSession *session,
 
   return TRUE;
 }
+
+
+/**
+ * fs_session_parse_batch:
+ * @session: a #FsSession to match against the message
+ * @message: a #GstMessage to parse
+ * @messages: (out) (transfer container) (element-type GstMessage): Returns
+ *  a #GList of the #GstMessage from the batch that are for @session, in the
+ *  order in which they were posted, if not %NULL. Free the list with
+ *  g_list_free(), the messages are owned by @message.
+ *
+ * Parses a "farstream-batch" message, as posted by conferences that batch
+ * their messages, and finds the messages that are for @session. Each of them
+ * can then be parsed with the other fs_session_parse_* functions.
+ *
+ * Returns: %TRUE if the message is a valid batch containing at least one
+ *  message for @session.
+ */
+gboolean
+fs_session_parse_batch (FsSession *session,
+    GstMessage *message,
+    GList **messages)
+{
+  g_return_val_if_fail (session != NULL, FALSE);
+
+  return fs_parse_batch_for_object (G_OBJECT (session), "session", FS_TYPE_SESSION,
+      message, messages);
+}
@@ -214,6 +214,10 @@ gboolean fs_session_parse_telephony_event_stopped (FsSession *session,
     GstMessage *message,
     FsDTMFMethod *method);
 
+gboolean fs_session_parse_batch (FsSession *session,
+    GstMessage *message,
+    GList **messages);
+
 
 
 G_END_DECLS
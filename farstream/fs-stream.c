@@ -875,3 +875,68 @@ fs_stream_parse_component_state_changed (FsStream *stream,
   return TRUE;
 }
 
+
+/**
+ * fs_stream_parse_stats:
+ * @stream: a #FsStream to match against the message
+ * @message: a #GstMessage to parse
+ * @stats: (out) (transfer none): Returns the #GstStructure with the
+ *  statistics from the #GstMessage if not %NULL
+ *
+ * Parses a "farstream-stream-stats" message and checks if it matches
+ * the @stream parameters. The fields of @stats depend on the conference
+ * that posted the message.
+ *
+ * Returns: %TRUE if the message matches the stream and is valid.
+ */
+gboolean
+fs_stream_parse_stats (FsStream *stream,
+    GstMessage *message,
+    const GstStructure **stats)
+{
+  const GstStructure *s;
+  const GValue *value;
+
+  g_return_val_if_fail (stream != NULL, FALSE);
+
+  if (!check_message (message, stream, "farstream-stream-stats"))
+    return FALSE;
+
+  s = gst_message_get_structure (message);
+
+  value = gst_structure_get_value (s, "stats");
+  if (!value || !G_VALUE_HOLDS (value, GST_TYPE_STRUCTURE))
+    return FALSE;
+  if (stats)
+    *stats = gst_value_get_structure (value);
+
+  return TRUE;
+}
+
+
+/**
+ * fs_stream_parse_batch:
+ * @stream: a #FsStream to match against the message
+ * @message: a #GstMessage to parse
+ * @messages: (out) (transfer container) (element-type GstMessage): Returns
+ *  a #GList of the #GstMessage from the batch that are for @stream, in the
+ *  order in which they were posted, if not %NULL. Free the list with
+ *  g_list_free(), the messages are owned by @message.
+ *
+ * Parses a "farstream-batch" message, as posted by conferences that batch
+ * their messages, and finds the messages that are for @stream. Each of them
+ * can then be parsed with the other fs_stream_parse_* functions.
+ *
+ * Returns: %TRUE if the message is a valid batch containing at least one
+ *  message for @stream.
+ */
+gboolean
+fs_stream_parse_batch (FsStream *stream,
+    GstMessage *message,
+    GList **messages)
+{
+  g_return_val_if_fail (stream != NULL, FALSE);
+
+  return fs_parse_batch_for_object (G_OBJECT (stream), "stream", FS_TYPE_STREAM,
+      message, messages);
+}
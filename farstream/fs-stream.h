@@ -203,6 +203,12 @@ gboolean fs_stream_parse_component_state_changed (FsStream *stream,
     GstMessage *message,
     guint *component,
     FsStreamState *state);
+gboolean fs_stream_parse_stats (FsStream *stream,
+    GstMessage *message,
+    const GstStructure **stats);
+gboolean fs_stream_parse_batch (FsStream *stream,
+    GstMessage *message,
+    GList **messages);
 
 
 G_END_DECLS
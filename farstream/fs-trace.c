@@ -0,0 +1,302 @@
+/*
+ * Farstream - Hot-path tracing
+ *
+ * Copyright 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+/**
+ * SECTION:fs-trace
+ * @short_description: Low overhead tracing of the media path
+ *
+ * When Farstream is configured with --enable-tracing, tracepoints are
+ * compiled in at the places where latency matters: packets going in and out
+ * of the transmitters, the packet modders waiting on the clock, the funnels
+ * pushing buffers, the codec bins being switched and the phases of the codec
+ * negotiation.
+ *
+ * They only cost a single branch until tracing is enabled, either with
+ * fs_trace_set_enabled() or by setting the FS_TRACE environment variable.
+ * Once enabled, each thread writes fixed size records into its own ring
+ * buffer without taking any lock, only the most recent records of each
+ * thread are kept.
+ *
+ * The rings can be written out with fs_trace_dump() in the Chrome trace
+ * event format that chrome://tracing and Perfetto can load.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include "fs-trace.h"
+
+#include "fs-conference.h"
+#include "fs-private.h"
+
+#define FS_TRACE_RING_SIZE 4096
+
+typedef struct {
+  gint64 timestamp;
+  gconstpointer object;
+  gint64 arg;
+  FsTraceEvent event;
+} FsTraceRecord;
+
+typedef struct {
+  guint id;
+  /* Only written by the thread owning the ring */
+  volatile gint head;
+  volatile gint full;
+  FsTraceRecord records[FS_TRACE_RING_SIZE];
+} FsTraceRing;
+
+volatile gint fs_trace_enabled_internal = 0;
+
+#ifdef FS_ENABLE_TRACING
+
+static const struct {
+  const gchar *name;
+  const gchar *category;
+  gchar phase;
+} event_info[FS_TRACE_LAST] = {
+  {"packet-recv", "transmitter", 'i'},
+  {"packet-send", "transmitter", 'i'},
+  {"modder-wait", "modder", 'B'},
+  {"modder-wait", "modder", 'E'},
+  {"funnel-push", "funnel", 'B'},
+  {"funnel-push", "funnel", 'E'},
+  {"send-codec-bin-switch", "codecs", 'i'},
+  {"recv-codec-bin-switch", "codecs", 'i'},
+  {"negotiation", "codecs", 'B'},
+  {"negotiation", "codecs", 'E'},
+  {"distribute", "codecs", 'B'},
+  {"distribute", "codecs", 'E'},
+  {"send-codec", "codecs", 'B'},
+  {"send-codec", "codecs", 'E'}
+};
+
+/* All the rings ever created, the ones of the threads that exited are kept
+ * in free_rings and handed to new threads */
+static GStaticMutex rings_mutex = G_STATIC_MUTEX_INIT;
+static GPtrArray *rings = NULL;
+static GSList *free_rings = NULL;
+
+static GStaticPrivate current_ring = G_STATIC_PRIVATE_INIT;
+
+static void
+fs_trace_ring_release (gpointer data)
+{
+  g_static_mutex_lock (&rings_mutex);
+  free_rings = g_slist_prepend (free_rings, data);
+  g_static_mutex_unlock (&rings_mutex);
+}
+
+static FsTraceRing *
+fs_trace_ring_get (void)
+{
+  FsTraceRing *ring;
+
+  g_static_mutex_lock (&rings_mutex);
+  if (free_rings)
+  {
+    ring = free_rings->data;
+    free_rings = g_slist_delete_link (free_rings, free_rings);
+  }
+  else
+  {
+    if (!rings)
+      rings = g_ptr_array_new ();
+    ring = g_new0 (FsTraceRing, 1);
+    ring->id = rings->len + 1;
+    g_ptr_array_add (rings, ring);
+  }
+  g_static_mutex_unlock (&rings_mutex);
+
+  g_static_private_set (&current_ring, ring, fs_trace_ring_release);
+
+  return ring;
+}
+
+void
+fs_trace_record_internal (FsTraceEvent event, gconstpointer object, gint64 arg)
+{
+  FsTraceRing *ring = g_static_private_get (&current_ring);
+  FsTraceRecord *record;
+  guint head;
+
+  if (G_UNLIKELY (ring == NULL))
+    ring = fs_trace_ring_get ();
+
+  head = ring->head;
+  record = &ring->records[head % FS_TRACE_RING_SIZE];
+  record->timestamp = g_get_monotonic_time ();
+  record->object = object;
+  record->arg = arg;
+  record->event = event;
+
+  if (G_UNLIKELY (head == FS_TRACE_RING_SIZE - 1))
+    g_atomic_int_set (&ring->full, TRUE);
+
+  /* Publishes the record to fs_trace_dump() */
+  g_atomic_int_set (&ring->head, head + 1);
+}
+
+static void
+fs_trace_ring_dump (FsTraceRing *ring, GString *json, gboolean *first)
+{
+  FsTraceRecord *copy;
+  guint head, end, count, dropped, i;
+
+  head = g_atomic_int_get (&ring->head);
+  if (g_atomic_int_get (&ring->full))
+    count = FS_TRACE_RING_SIZE;
+  else
+    count = MIN (head, FS_TRACE_RING_SIZE);
+
+  copy = g_new (FsTraceRecord, count);
+  for (i = 0; i < count; i++)
+    copy[i] = ring->records[(head - count + i) % FS_TRACE_RING_SIZE];
+
+  /* The owning thread may have overwritten the oldest records while they
+   * were being copied (and may be writing the next one), drop those */
+  end = g_atomic_int_get (&ring->head);
+  dropped = end - head + 1;
+  if (dropped > FS_TRACE_RING_SIZE - count)
+    dropped -= FS_TRACE_RING_SIZE - count;
+  else
+    dropped = 0;
+  if (dropped > count)
+    dropped = count;
+
+  for (i = dropped; i < count; i++)
+  {
+    FsTraceRecord *record = &copy[i];
+
+    if (record->event >= FS_TRACE_LAST)
+      continue;
+
+    g_string_append_printf (json, "%s\n{\"name\":\"%s\",\"cat\":\"%s\","
+        "\"ph\":\"%c\",\"ts\":%" G_GINT64_FORMAT ",\"pid\":0,\"tid\":%u,",
+        *first ? "" : ",",
+        event_info[record->event].name,
+        event_info[record->event].category,
+        event_info[record->event].phase,
+        record->timestamp, ring->id);
+    if (event_info[record->event].phase == 'i')
+      g_string_append (json, "\"s\":\"t\",");
+    g_string_append_printf (json, "\"args\":{\"object\":\"%p\","
+        "\"arg\":%" G_GINT64_FORMAT "}}", record->object, record->arg);
+    *first = FALSE;
+  }
+
+  g_free (copy);
+}
+
+#else /* FS_ENABLE_TRACING */
+
+void
+fs_trace_record_internal (FsTraceEvent event, gconstpointer object, gint64 arg)
+{
+}
+
+#endif /* FS_ENABLE_TRACING */
+
+void
+_fs_trace_init (void)
+{
+  static gsize init = 0;
+
+  if (g_once_init_enter (&init))
+  {
+    if (g_getenv ("FS_TRACE"))
+      fs_trace_set_enabled (TRUE);
+    g_once_init_leave (&init, 1);
+  }
+}
+
+/**
+ * fs_trace_set_enabled:
+ * @enabled: %TRUE to start recording the tracepoints, %FALSE to stop
+ *
+ * Starts or stops recording the tracepoints. The records are kept when
+ * tracing is stopped so they can still be dumped with fs_trace_dump().
+ *
+ * This does nothing unless Farstream was configured with --enable-tracing.
+ */
+void
+fs_trace_set_enabled (gboolean enabled)
+{
+#ifdef FS_ENABLE_TRACING
+  g_atomic_int_set (&fs_trace_enabled_internal, enabled ? 1 : 0);
+#endif
+}
+
+/**
+ * fs_trace_get_enabled:
+ *
+ * Tells if the tracepoints are currently being recorded.
+ *
+ * Returns: %TRUE if tracing is enabled
+ */
+gboolean
+fs_trace_get_enabled (void)
+{
+  return g_atomic_int_get (&fs_trace_enabled_internal);
+}
+
+/**
+ * fs_trace_dump:
+ * @filename: The file to write the trace to
+ * @error: location of a #GError, or %NULL if no error occured
+ *
+ * Writes the records currently in the ring buffers of all the threads to
+ * @filename, as a JSON file in the Chrome trace event format that can be
+ * loaded in chrome://tracing or Perfetto. Each ring is shown as a thread.
+ *
+ * Returns: %TRUE on success, %FALSE if the file could not be written or if
+ * Farstream was not configured with --enable-tracing
+ */
+gboolean
+fs_trace_dump (const gchar *filename, GError **error)
+{
+#ifdef FS_ENABLE_TRACING
+  GString *json;
+  gboolean first = TRUE;
+  gboolean ret;
+  guint i;
+
+  g_return_val_if_fail (filename != NULL, FALSE);
+
+  json = g_string_new ("{\"traceEvents\":[");
+
+  g_static_mutex_lock (&rings_mutex);
+  for (i = 0; rings && i < rings->len; i++)
+    fs_trace_ring_dump (g_ptr_array_index (rings, i), json, &first);
+  g_static_mutex_unlock (&rings_mutex);
+
+  g_string_append (json, "\n],\"displayTimeUnit\":\"ms\"}\n");
+
+  ret = g_file_set_contents (filename, json->str, json->len, error);
+  g_string_free (json, TRUE);
+
+  return ret;
+#else
+  g_set_error (error, FS_ERROR, FS_ERROR_NOT_IMPLEMENTED,
+      "Farstream was not configured with --enable-tracing");
+  return FALSE;
+#endif
+}
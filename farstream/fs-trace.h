@@ -0,0 +1,114 @@
+/*
+ * Farstream - Hot-path tracing
+ *
+ * Copyright 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+
+#ifndef __FS_TRACE_H__
+#define __FS_TRACE_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * FsTraceEvent:
+ * @FS_TRACE_TRANSMITTER_RECV: A packet came out of a transmitter,
+ *  the argument is its size
+ * @FS_TRACE_TRANSMITTER_SEND: A packet went into a transmitter,
+ *  the argument is its size
+ * @FS_TRACE_MODDER_WAIT_BEGIN: A packet modder starts waiting on the clock,
+ *  the argument is the running time it waits for
+ * @FS_TRACE_MODDER_WAIT_END: A packet modder is done waiting on the clock,
+ *  the argument is the #GstClockReturn
+ * @FS_TRACE_FUNNEL_PUSH_BEGIN: A funnel starts pushing a buffer,
+ *  the argument is its size
+ * @FS_TRACE_FUNNEL_PUSH_END: A funnel is done pushing a buffer,
+ *  the argument is the #GstFlowReturn
+ * @FS_TRACE_SEND_CODEC_BIN_SWITCH: A new send codec bin has been put in place,
+ *  the argument is its payload type
+ * @FS_TRACE_RECV_CODEC_BIN_SWITCH: A new receive codec bin has been put in
+ *  place, the argument is its payload type
+ * @FS_TRACE_NEGOTIATION_BEGIN: The codecs negotiation starts,
+ *  the argument is the number of remote codecs
+ * @FS_TRACE_NEGOTIATION_END: The codecs negotiation is done,
+ *  the argument is %TRUE if it succeeded
+ * @FS_TRACE_DISTRIBUTE_BEGIN: The negotiated codecs start being given to the
+ *  streams and substreams
+ * @FS_TRACE_DISTRIBUTE_END: The negotiated codecs have been given to the
+ *  streams and substreams
+ * @FS_TRACE_SEND_CODEC_BEGIN: The send codec starts being (re-)selected
+ * @FS_TRACE_SEND_CODEC_END: The send codec has been (re-)selected
+ *
+ * The tracepoints recorded by Farstream, the object of each record is the
+ * element, session or stream that produced it.
+ */
+typedef enum
+{
+  FS_TRACE_TRANSMITTER_RECV,
+  FS_TRACE_TRANSMITTER_SEND,
+  FS_TRACE_MODDER_WAIT_BEGIN,
+  FS_TRACE_MODDER_WAIT_END,
+  FS_TRACE_FUNNEL_PUSH_BEGIN,
+  FS_TRACE_FUNNEL_PUSH_END,
+  FS_TRACE_SEND_CODEC_BIN_SWITCH,
+  FS_TRACE_RECV_CODEC_BIN_SWITCH,
+  FS_TRACE_NEGOTIATION_BEGIN,
+  FS_TRACE_NEGOTIATION_END,
+  FS_TRACE_DISTRIBUTE_BEGIN,
+  FS_TRACE_DISTRIBUTE_END,
+  FS_TRACE_SEND_CODEC_BEGIN,
+  FS_TRACE_SEND_CODEC_END,
+  FS_TRACE_LAST
+} FsTraceEvent;
+
+void fs_trace_set_enabled (gboolean enabled);
+
+gboolean fs_trace_get_enabled (void);
+
+gboolean fs_trace_dump (const gchar *filename, GError **error);
+
+/* Not part of the API, use the FS_TRACE() macro. They have the fs_ prefix
+ * because the library only exports the fs_ symbols. */
+extern volatile gint fs_trace_enabled_internal;
+void fs_trace_record_internal (FsTraceEvent event, gconstpointer object,
+    gint64 arg);
+
+/**
+ * FS_TRACE:
+ * @event: The #FsTraceEvent
+ * @object: The object producing the event
+ * @arg: An event specific 64 bits signed argument
+ *
+ * Records a tracepoint in the calling thread's ring buffer. It compiles to
+ * nothing unless Farstream was configured with --enable-tracing and
+ * is a single branch unless tracing has been enabled with
+ * fs_trace_set_enabled().
+ */
+#ifdef FS_ENABLE_TRACING
+#define FS_TRACE(event, object, arg) G_STMT_START {                     \
+    if (G_UNLIKELY (fs_trace_enabled_internal))                         \
+      fs_trace_record_internal ((event), (object), (arg));              \
+  } G_STMT_END
+#else
+#define FS_TRACE(event, object, arg) G_STMT_START { } G_STMT_END
+#endif
+
+G_END_DECLS
+
+#endif /* __FS_TRACE_H__ */
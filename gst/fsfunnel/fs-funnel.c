@@ -35,6 +35,8 @@
 
 #include "fs-funnel.h"
 
+#include <farstream/fs-trace.h>
+
 GST_DEBUG_CATEGORY_STATIC (fs_funnel_debug);
 #define GST_CAT_DEFAULT fs_funnel_debug
 
@@ -276,7 +278,9 @@ fs_funnel_chain (GstPad * pad, GstBuffer * buffer)
     }
   }
 
+  FS_TRACE (FS_TRACE_FUNNEL_PUSH_BEGIN, funnel, GST_BUFFER_SIZE (buffer));
   res = gst_pad_push (funnel->srcpad, buffer);
+  FS_TRACE (FS_TRACE_FUNNEL_PUSH_END, funnel, res);
 
   GST_LOG_OBJECT (funnel, "handled buffer %s", gst_flow_get_name (res));
 
@@ -29,6 +29,7 @@
 #endif
 
 #include "fs-msn-connection.h"
+#include "fs-msn-framing.h"
 
 #include <arpa/inet.h>
 #include <errno.h>
@@ -86,6 +87,7 @@ struct _FsMsnPollFD {
   gboolean want_read;
   gboolean want_write;
   PollFdCallback callback;
+  FsMsnFramer *framer;
 };
 
 #define FS_MSN_CONNECTION_LOCK(conn)   g_static_rec_mutex_lock(&(conn)->mutex)
@@ -117,6 +119,8 @@ static gboolean fs_msn_open_listening_port_unlock (FsMsnConnection *connection,
 static void successful_connection_cb (FsMsnConnection *self, FsMsnPollFD *fd);
 static void accept_connection_cb (FsMsnConnection *self, FsMsnPollFD *fd);
 static void connection_cb (FsMsnConnection *self, FsMsnPollFD *fd);
+static void set_status_locked (FsMsnConnection *self, FsMsnPollFD *pollfd,
+    FsMsnStatus status);
 
 static gpointer connection_polling_thread (gpointer data);
 static void shutdown_fd (FsMsnConnection *self, FsMsnPollFD *pollfd,
@@ -232,6 +236,7 @@ fs_msn_connection_finalize (GObject *object)
   {
     FsMsnPollFD *p = g_ptr_array_index(self->pollfds, i);
     close (p->pollfd.fd);
+    fs_msn_framer_free (p->framer);
     g_slice_free (FsMsnPollFD, p);
   }
   g_ptr_array_free (self->pollfds, TRUE);
@@ -699,6 +704,9 @@ successful_connection_cb (FsMsnConnection *self, FsMsnPollFD *pollfd)
   }
 
   pollfd->callback = connection_cb;
+  FS_MSN_CONNECTION_LOCK (self);
+  set_status_locked (self, pollfd, FS_MSN_STATUS_AUTH);
+  FS_MSN_CONNECTION_UNLOCK (self);
 
   GST_DEBUG ("connection succeeded on socket %p", pollfd);
   return;
@@ -713,10 +721,58 @@ successful_connection_cb (FsMsnConnection *self, FsMsnPollFD *pollfd)
 }
 
 
+static gboolean
+status_wants_write (FsMsnPollFD *pollfd)
+{
+  switch (pollfd->status)
+  {
+    case FS_MSN_STATUS_AUTH:
+      return !pollfd->server;
+    case FS_MSN_STATUS_CONNECTED:
+      return pollfd->server;
+    case FS_MSN_STATUS_CONNECTED2:
+      return !pollfd->server;
+    default:
+      return FALSE;
+  }
+}
+
+/*
+ * Moves the handshake to the next state, if the new state is one where we
+ * talk, the message is queued right away and the socket is polled for
+ * writing until it has been completely flushed.
+ */
+static void
+set_status_locked (FsMsnConnection *self, FsMsnPollFD *pollfd,
+    FsMsnStatus status)
+{
+  pollfd->status = status;
+
+  if (!status_wants_write (pollfd))
+    return;
+
+  if (status == FS_MSN_STATUS_AUTH)
+  {
+    gchar *str = g_strdup_printf ("recipientid=%s&sessionid=%d\r\n\r\n",
+        self->remote_recipient_id, self->session_id);
+    fs_msn_framer_queue (pollfd->framer, str, strlen (str));
+    g_free (str);
+  }
+  else
+  {
+    fs_msn_framer_queue (pollfd->framer, "connected\r\n\r\n", 13);
+  }
+
+  pollfd->want_write = TRUE;
+  gst_poll_fd_ctl_write (self->poll, &pollfd->pollfd, TRUE);
+}
+
 static void
 connection_cb (FsMsnConnection *self, FsMsnPollFD *pollfd)
 {
   gboolean success = FALSE;
+  FsMsnFramerStatus ret;
+  GError *error = NULL;
 
   GST_DEBUG ("handler called on fd %d. %d %d %d %d", pollfd->pollfd.fd,
       pollfd->server, pollfd->status,
@@ -730,219 +786,119 @@ connection_cb (FsMsnConnection *self, FsMsnPollFD *pollfd)
     goto error;
   }
 
-  if (gst_poll_fd_can_read (self->poll, &pollfd->pollfd))
+  if (status_wants_write (pollfd))
   {
-    switch (pollfd->status)
+    if (!gst_poll_fd_can_write (self->poll, &pollfd->pollfd))
     {
-      case FS_MSN_STATUS_AUTH:
-        if (pollfd->server)
-        {
-          gchar str[35] = {0};
-          gchar check[35] = {0};
+      if (gst_poll_fd_can_read (self->poll, &pollfd->pollfd))
+      {
+        GST_ERROR ("shouldn't receive data when %s on state %d",
+            pollfd->server ? "server" : "client", pollfd->status);
+        goto error;
+      }
+      return;
+    }
 
-          if (recv (pollfd->pollfd.fd, str, 34, 0) == 34)
-          {
-            GST_DEBUG ("Got %s, checking if it's auth", str);
-            FS_MSN_CONNECTION_LOCK(self);
-            snprintf(check, 35, "recipientid=%s&sessionid=%d\r\n\r\n",
-                self->local_recipient_id, self->session_id);
-            FS_MSN_CONNECTION_UNLOCK(self);
-            if (strncmp (str, check, 35) == 0)
-            {
-              GST_DEBUG ("Authentication successful");
-              pollfd->status = FS_MSN_STATUS_CONNECTED;
-              pollfd->want_write = TRUE;
-              gst_poll_fd_ctl_write (self->poll, &pollfd->pollfd, TRUE);
-            }
-            else
-            {
-              GST_WARNING ("Authentication failed check=%s", check);
-              goto error;
-            }
-          }
-          else
-          {
-            gchar error_str[256];
-            strerror_r (errno, error_str, 256);
-            GST_WARNING ("auth: %s", error_str);
-            goto error;
-          }
+    ret = fs_msn_framer_flush (pollfd->framer, &error);
+    if (ret == FS_MSN_FRAMER_AGAIN)
+      return;
+    else if (ret != FS_MSN_FRAMER_OK)
+      goto error;
 
-        } else {
-          GST_ERROR ("shouldn't receive data when client on AUTH state");
-          goto error;
-        }
+    GST_DEBUG ("Sent handshake message for state %d", pollfd->status);
+
+    pollfd->want_write = FALSE;
+    gst_poll_fd_ctl_write (self->poll, &pollfd->pollfd, FALSE);
+
+    FS_MSN_CONNECTION_LOCK (self);
+    switch (pollfd->status)
+    {
+      case FS_MSN_STATUS_AUTH:
+        set_status_locked (self, pollfd, FS_MSN_STATUS_CONNECTED);
         break;
       case FS_MSN_STATUS_CONNECTED:
-        if (!pollfd->server)
+        if (self->producer)
         {
-          gchar str[14] = {0};
-          ssize_t size;
-
-          size = recv (pollfd->pollfd.fd, str, 13, MSG_PEEK);
-          if (size > 0)
-          {
-            GST_DEBUG ("Got %s, checking if it's connected", str);
-            if (size == 13 && strcmp (str, "connected\r\n\r\n") == 0)
-            {
-              GST_DEBUG ("connection successful");
-              recv (pollfd->pollfd.fd, str, 13, 0);
-              pollfd->status = FS_MSN_STATUS_CONNECTED2;
-              pollfd->want_write = TRUE;
-              gst_poll_fd_ctl_write (self->poll, &pollfd->pollfd, TRUE);
-            }
-            else if (!self->producer)
-            {
-              GST_DEBUG ("connection successful");
-              pollfd->status = FS_MSN_STATUS_SEND_RECEIVE;
-              success = TRUE;
-            }
-            else
-            {
-              GST_WARNING ("connected failed");
-              goto error;
-            }
-          }
-          else
-          {
-            gchar error_str[256];
-            strerror_r (errno, error_str, 256);
-            GST_WARNING ("recv: %s", error_str);
-            goto error;
-          }
-        } else {
-          GST_ERROR ("shouldn't receive data when server on CONNECTED state");
-          goto error;
+          pollfd->status = FS_MSN_STATUS_SEND_RECEIVE;
+          success = TRUE;
         }
-        break;
-      case FS_MSN_STATUS_CONNECTED2:
-        if (pollfd->server)
+        else
         {
-          gchar str[14] = {0};
-          ssize_t size;
-
-          size = recv (pollfd->pollfd.fd, str, 13, MSG_PEEK);
-          if (size > 0)
-          {
-            GST_DEBUG ("Got %s, checking if it's connected", str);
-            if (size == 13 && strcmp (str, "connected\r\n\r\n") == 0)
-            {
-              GST_DEBUG ("connection successful");
-              recv (pollfd->pollfd.fd, str, 13, 0);
-              pollfd->status = FS_MSN_STATUS_SEND_RECEIVE;
-              success = TRUE;
-            }
-            else if (!self->producer)
-            {
-              GST_DEBUG ("connection successful");
-              pollfd->status = FS_MSN_STATUS_SEND_RECEIVE;
-              success = TRUE;
-            }
-            else
-            {
-              GST_WARNING ("connected failed");
-              goto error;
-            }
-          }
-          else
-          {
-            gchar error_str[256];
-            strerror_r (errno, error_str, 256);
-            GST_WARNING ("recv: %s", error_str);
-            goto error;
-          }
-
-        } else {
-          GST_ERROR ("shouldn't receive data when client on CONNECTED2 state");
-          goto error;
+          set_status_locked (self, pollfd, FS_MSN_STATUS_CONNECTED2);
         }
         break;
-      default:
-        GST_ERROR ("Invalid status %d", pollfd->status);
-        goto error;
+      case FS_MSN_STATUS_CONNECTED2:
+        pollfd->status = FS_MSN_STATUS_SEND_RECEIVE;
+        success = TRUE;
         break;
-
+      default:
+        g_assert_not_reached ();
     }
+    FS_MSN_CONNECTION_UNLOCK (self);
   }
-  else if (gst_poll_fd_can_write (self->poll, &pollfd->pollfd))
+  else if (gst_poll_fd_can_read (self->poll, &pollfd->pollfd))
   {
-    pollfd->want_write = FALSE;
-    gst_poll_fd_ctl_write (self->poll, &pollfd->pollfd, FALSE);
     switch (pollfd->status)
     {
       case FS_MSN_STATUS_AUTH:
-        if (!pollfd->server)
         {
-          gchar *str;
-          FS_MSN_CONNECTION_LOCK(self);
-          str = g_strdup_printf("recipientid=%s&sessionid=%d\r\n\r\n",
-              self->remote_recipient_id, self->session_id);
-          FS_MSN_CONNECTION_UNLOCK(self);
-          if (send(pollfd->pollfd.fd, str, strlen (str), 0) != -1)
-          {
-            GST_DEBUG ("Sent %s", str);
-            pollfd->status = FS_MSN_STATUS_CONNECTED;
-            g_free (str);
-          }
-          else
-          {
-            gchar error_str[256];
-            strerror_r (errno, error_str, 256);
-            GST_WARNING ("auth send: %s", error_str);
-            g_free (str);
+          gchar *check;
+
+          FS_MSN_CONNECTION_LOCK (self);
+          check = g_strdup_printf ("recipientid=%s&sessionid=%d\r\n\r\n",
+              self->local_recipient_id, self->session_id);
+          FS_MSN_CONNECTION_UNLOCK (self);
+
+          ret = fs_msn_framer_expect (pollfd->framer, check, &error);
+          if (ret == FS_MSN_FRAMER_MISMATCH)
+            GST_WARNING ("Authentication failed check=%s", check);
+          g_free (check);
+
+          if (ret == FS_MSN_FRAMER_AGAIN)
+            return;
+          else if (ret != FS_MSN_FRAMER_OK)
             goto error;
-          }
 
+          GST_DEBUG ("Authentication successful");
+          FS_MSN_CONNECTION_LOCK (self);
+          set_status_locked (self, pollfd, FS_MSN_STATUS_CONNECTED);
+          FS_MSN_CONNECTION_UNLOCK (self);
         }
         break;
       case FS_MSN_STATUS_CONNECTED:
-        if (pollfd->server)
+      case FS_MSN_STATUS_CONNECTED2:
+        ret = fs_msn_framer_expect (pollfd->framer, "connected\r\n\r\n",
+            &error);
+        if (ret == FS_MSN_FRAMER_AGAIN)
         {
-
-          if (send(pollfd->pollfd.fd, "connected\r\n\r\n", 13, 0) != -1)
-          {
-            GST_DEBUG ("sent connected");
-            if (self->producer)
-            {
-              pollfd->status = FS_MSN_STATUS_SEND_RECEIVE;
-              success = TRUE;
-            }
-            else
-            {
-              pollfd->status = FS_MSN_STATUS_CONNECTED2;
-            }
-          }
-          else
-          {
-            gchar error_str[256];
-            strerror_r (errno, error_str, 256);
-            GST_WARNING ("sending connected: %s", error_str);
-            goto error;
-          }
-        } else {
-          GST_DEBUG ("shouldn't receive data when server on CONNECTED state");
-          goto error;
+          return;
         }
-        break;
-      case FS_MSN_STATUS_CONNECTED2:
-        if (!pollfd->server)
+        else if (ret == FS_MSN_FRAMER_OK)
         {
-
-          if (send(pollfd->pollfd.fd, "connected\r\n\r\n", 13, 0) != -1)
+          GST_DEBUG ("connection successful");
+          FS_MSN_CONNECTION_LOCK (self);
+          if (pollfd->status == FS_MSN_STATUS_CONNECTED)
           {
-            GST_DEBUG ("sent connected");
-            pollfd->status = FS_MSN_STATUS_SEND_RECEIVE;
-            success = TRUE;
+            set_status_locked (self, pollfd, FS_MSN_STATUS_CONNECTED2);
           }
           else
           {
-            gchar error_str[256];
-            strerror_r (errno, error_str, 256);
-            GST_WARNING ("sending connected: %s", error_str);
-            goto error;
+            pollfd->status = FS_MSN_STATUS_SEND_RECEIVE;
+            success = TRUE;
           }
-        } else {
-          GST_ERROR ("shouldn't receive data when client on CONNECTED2 state");
+          FS_MSN_CONNECTION_UNLOCK (self);
+        }
+        else if (ret == FS_MSN_FRAMER_MISMATCH && !self->producer)
+        {
+          /* The producer may start sending mimic frames right away, they
+           * stay in the socket for the depayloader */
+          GST_DEBUG ("connection successful");
+          pollfd->status = FS_MSN_STATUS_SEND_RECEIVE;
+          success = TRUE;
+        }
+        else
+        {
+          GST_WARNING ("connected failed");
           goto error;
         }
         break;
@@ -968,6 +924,9 @@ connection_cb (FsMsnConnection *self, FsMsnPollFD *pollfd)
   return;
  error:
   /* Error */
+  if (error)
+    GST_WARNING ("handshake: %s", error->message);
+  g_clear_error (&error);
   GST_WARNING ("Got error from fd %d, closing", pollfd->pollfd.fd);
   shutdown_fd (self, pollfd, TRUE);
 
@@ -1072,6 +1031,7 @@ shutdown_fd_locked (FsMsnConnection *self, FsMsnPollFD *pollfd, gboolean equal)
       if (!gst_poll_remove_fd (self->poll, &p->pollfd))
         GST_WARNING ("Could not remove pollfd %p", p);
       g_ptr_array_remove_index_fast (self->pollfds, i);
+      fs_msn_framer_free (p->framer);
       g_slice_free (FsMsnPollFD, p);
       closed++;
       i--;
@@ -1095,6 +1055,7 @@ add_pollfd_locked (FsMsnConnection *self, int fd, PollFdCallback callback,
   pollfd->want_read = read;
   pollfd->want_write = write;
   pollfd->status = FS_MSN_STATUS_AUTH;
+  pollfd->framer = fs_msn_framer_new (fd);
 
   gst_poll_add_fd (self->poll, &pollfd->pollfd);
 
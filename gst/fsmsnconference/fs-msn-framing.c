@@ -0,0 +1,305 @@
+/*
+ * Farstream - Farstream MSN Framing
+ *
+ * Copyright 2026 agent <agent@local>
+ *
+ * fs-msn-framing.c - Buffered non-blocking framing for the MSN handshake
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+/*
+ * The MSN webcam handshake is a sequence of short ASCII tokens exchanged over
+ * a non-blocking TCP socket. Once the handshake is over, the socket is handed
+ * to the mimic elements, so the framer must never consume a byte that is not
+ * part of the token it is waiting for. Incoming data is therefore peeked and
+ * only the part matching the token is read out of the socket and kept until
+ * the rest arrives, so a partial token does not keep the socket readable.
+ * Outgoing tokens are queued and written out together with writev(),
+ * surviving partial writes.
+ */
+
+/* For POLLRDHUP */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "fs-msn-framing.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include <farstream/fs-conference.h>
+
+/* The longest handshake token is the auth string, with the recipient id */
+#define FS_MSN_FRAMER_MAX_TOKEN 256
+#define FS_MSN_FRAMER_MAX_IOV 16
+
+struct _FsMsnFramer {
+  gint fd;
+
+  /* GByteArrays waiting to be written, out_offset bytes of the head chunk
+   * have already been sent */
+  GQueue out_chunks;
+  gsize out_offset;
+
+  /* The start of the expected token, already read out of the socket */
+  gsize in_len;
+};
+
+static void
+set_errno_error (GError **error, const gchar *what)
+{
+  gchar error_str[256];
+
+  strerror_r (errno, error_str, 256);
+  g_set_error (error, FS_ERROR, FS_ERROR_NETWORK, "%s: %s", what, error_str);
+}
+
+/**
+ * fs_msn_framer_new:
+ * @fd: A non-blocking connected socket
+ *
+ * Creates a new framer for @fd, the framer does not take ownership of the fd
+ *
+ * Returns: a new #FsMsnFramer
+ */
+FsMsnFramer *
+fs_msn_framer_new (gint fd)
+{
+  FsMsnFramer *framer = g_slice_new0 (FsMsnFramer);
+
+  framer->fd = fd;
+  g_queue_init (&framer->out_chunks);
+
+  return framer;
+}
+
+void
+fs_msn_framer_free (FsMsnFramer *framer)
+{
+  GByteArray *chunk;
+
+  while ((chunk = g_queue_pop_head (&framer->out_chunks)))
+    g_byte_array_free (chunk, TRUE);
+
+  g_slice_free (FsMsnFramer, framer);
+}
+
+/**
+ * fs_msn_framer_queue:
+ * @framer: a #FsMsnFramer
+ * @data: the data to send
+ * @len: the length of @data
+ *
+ * Queues data to be sent on the next call to fs_msn_framer_flush()
+ */
+void
+fs_msn_framer_queue (FsMsnFramer *framer, const gchar *data, gsize len)
+{
+  GByteArray *chunk;
+
+  if (len == 0)
+    return;
+
+  chunk = g_byte_array_sized_new (len);
+  g_byte_array_append (chunk, (const guint8 *) data, len);
+  g_queue_push_tail (&framer->out_chunks, chunk);
+}
+
+gboolean
+fs_msn_framer_has_pending_output (FsMsnFramer *framer)
+{
+  return !g_queue_is_empty (&framer->out_chunks);
+}
+
+/**
+ * fs_msn_framer_flush:
+ * @framer: a #FsMsnFramer
+ * @error: location for a #GError or %NULL
+ *
+ * Writes as much of the queued data as the socket accepts without blocking.
+ *
+ * Returns: %FS_MSN_FRAMER_OK if everything was written,
+ *  %FS_MSN_FRAMER_AGAIN if some data is still queued and
+ *  %FS_MSN_FRAMER_ERROR on error
+ */
+FsMsnFramerStatus
+fs_msn_framer_flush (FsMsnFramer *framer, GError **error)
+{
+  while (!g_queue_is_empty (&framer->out_chunks))
+  {
+    struct iovec iov[FS_MSN_FRAMER_MAX_IOV];
+    GList *item;
+    gint n = 0;
+    gssize written;
+
+    for (item = framer->out_chunks.head;
+         item && n < FS_MSN_FRAMER_MAX_IOV;
+         item = item->next, n++)
+    {
+      GByteArray *chunk = item->data;
+      gsize offset = (n == 0) ? framer->out_offset : 0;
+
+      iov[n].iov_base = chunk->data + offset;
+      iov[n].iov_len = chunk->len - offset;
+    }
+
+    do {
+      written = writev (framer->fd, iov, n);
+    } while (written < 0 && errno == EINTR);
+
+    if (written < 0)
+    {
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+        return FS_MSN_FRAMER_AGAIN;
+
+      set_errno_error (error, "Could not write to socket");
+      return FS_MSN_FRAMER_ERROR;
+    }
+
+    /* Drop the chunks that have been completely written */
+    while (written > 0)
+    {
+      GByteArray *chunk = g_queue_peek_head (&framer->out_chunks);
+      gsize remaining = chunk->len - framer->out_offset;
+
+      if ((gsize) written >= remaining)
+      {
+        g_byte_array_free (g_queue_pop_head (&framer->out_chunks), TRUE);
+        framer->out_offset = 0;
+        written -= remaining;
+      }
+      else
+      {
+        framer->out_offset += written;
+        written = 0;
+      }
+    }
+  }
+
+  return FS_MSN_FRAMER_OK;
+}
+
+/*
+ * Once the peer has shut down its side, the rest of a partial token will
+ * never arrive, so it would otherwise be waited for forever.
+ */
+static gboolean
+peer_closed (gint fd)
+{
+#ifdef POLLRDHUP
+  struct pollfd pfd = { fd, POLLRDHUP, 0 };
+
+  return poll (&pfd, 1, 0) > 0 && (pfd.revents & (POLLRDHUP | POLLHUP));
+#else
+  return FALSE;
+#endif
+}
+
+/**
+ * fs_msn_framer_expect:
+ * @framer: a #FsMsnFramer
+ * @token: the NUL terminated token that is expected next on the socket
+ * @error: location for a #GError or %NULL
+ *
+ * Checks if @token is the next thing on the socket and reads out the part of
+ * it that has been received. This function must be called again with the
+ * same @token until it stops returning %FS_MSN_FRAMER_AGAIN. Only bytes
+ * matching @token are read out of the socket, so on a mismatch the incoming
+ * bytes that differ from it are left there.
+ *
+ * Returns: %FS_MSN_FRAMER_OK once the whole token has been read,
+ *  %FS_MSN_FRAMER_AGAIN if only part of it has been received yet,
+ *  %FS_MSN_FRAMER_MISMATCH if the incoming data is something else,
+ *  %FS_MSN_FRAMER_CLOSED or %FS_MSN_FRAMER_ERROR if the socket failed
+ */
+FsMsnFramerStatus
+fs_msn_framer_expect (FsMsnFramer *framer, const gchar *token, GError **error)
+{
+  gsize token_len = strlen (token);
+  gsize missing;
+  gchar *buf;
+  gssize size;
+
+  g_return_val_if_fail (token_len > 0 &&
+      token_len <= FS_MSN_FRAMER_MAX_TOKEN, FS_MSN_FRAMER_ERROR);
+  g_return_val_if_fail (framer->in_len < token_len, FS_MSN_FRAMER_ERROR);
+
+  missing = token_len - framer->in_len;
+  buf = g_alloca (missing);
+
+  do {
+    size = recv (framer->fd, buf, missing, MSG_PEEK);
+  } while (size < 0 && errno == EINTR);
+
+  if (size < 0)
+  {
+    if (errno == EAGAIN || errno == EWOULDBLOCK)
+      return FS_MSN_FRAMER_AGAIN;
+
+    set_errno_error (error, "Could not read from socket");
+    return FS_MSN_FRAMER_ERROR;
+  }
+  else if (size == 0)
+  {
+    g_set_error (error, FS_ERROR, FS_ERROR_NETWORK,
+        "Connection closed by peer");
+    return FS_MSN_FRAMER_CLOSED;
+  }
+
+  if (memcmp (buf, token + framer->in_len, size))
+  {
+    framer->in_len = 0;
+    return FS_MSN_FRAMER_MISMATCH;
+  }
+
+  /* These bytes are part of the token, read them out so the socket only
+   * becomes readable again once more data arrives */
+  do {
+    size = recv (framer->fd, buf, size, 0);
+  } while (size < 0 && errno == EINTR);
+
+  if (size < 0)
+  {
+    set_errno_error (error, "Could not read from socket");
+    return FS_MSN_FRAMER_ERROR;
+  }
+
+  framer->in_len += size;
+
+  if (framer->in_len < token_len)
+  {
+    if (peer_closed (framer->fd))
+    {
+      g_set_error (error, FS_ERROR, FS_ERROR_NETWORK,
+          "Connection closed by peer in the middle of a message");
+      return FS_MSN_FRAMER_CLOSED;
+    }
+    return FS_MSN_FRAMER_AGAIN;
+  }
+
+  framer->in_len = 0;
+
+  return FS_MSN_FRAMER_OK;
+}
@@ -0,0 +1,65 @@
+/*
+ * Farstream - Farstream MSN Framing
+ *
+ * Copyright 2026 agent <agent@local>
+ *
+ * fs-msn-framing.h - Buffered non-blocking framing for the MSN handshake
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef __FS_MSN_FRAMING_H__
+#define __FS_MSN_FRAMING_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * FsMsnFramerStatus:
+ * @FS_MSN_FRAMER_OK: The operation completed
+ * @FS_MSN_FRAMER_AGAIN: The operation would block, retry when the socket
+ *  is readable/writable again
+ * @FS_MSN_FRAMER_MISMATCH: The incoming data does not match what was
+ *  expected, the bytes that differ are left in the socket
+ * @FS_MSN_FRAMER_CLOSED: The peer closed the connection
+ * @FS_MSN_FRAMER_ERROR: A socket error happened
+ */
+typedef enum {
+  FS_MSN_FRAMER_OK,
+  FS_MSN_FRAMER_AGAIN,
+  FS_MSN_FRAMER_MISMATCH,
+  FS_MSN_FRAMER_CLOSED,
+  FS_MSN_FRAMER_ERROR
+} FsMsnFramerStatus;
+
+typedef struct _FsMsnFramer FsMsnFramer;
+
+FsMsnFramer *fs_msn_framer_new (gint fd);
+
+void fs_msn_framer_free (FsMsnFramer *framer);
+
+void fs_msn_framer_queue (FsMsnFramer *framer, const gchar *data, gsize len);
+
+gboolean fs_msn_framer_has_pending_output (FsMsnFramer *framer);
+
+FsMsnFramerStatus fs_msn_framer_flush (FsMsnFramer *framer, GError **error);
+
+FsMsnFramerStatus fs_msn_framer_expect (FsMsnFramer *framer,
+    const gchar *token, GError **error);
+
+G_END_DECLS
+
+#endif /* __FS_MSN_FRAMING_H__ */
@@ -95,6 +95,8 @@ struct _FsRawSessionPrivate
   GstPad *send_tee_pad;
 
   GstElement *transform_bin;
+  /* The tee is linked directly to the capsfilter, protected by conf lock */
+  gboolean passthrough;
   GstElement *fakesink;
 
   GstElement *send_valve;
@@ -111,6 +113,10 @@ struct _FsRawSessionPrivate
 
   GMutex *mutex; /* protects the conference */
 
+  /* Held while the element between the tee and the capsfilter is replaced,
+   * which happens from the streaming thread when the input caps change */
+  GMutex *send_link_mutex;
+
 #ifdef DEBUG_MUTEXES
   guint count;
 #endif
@@ -172,6 +178,8 @@ static GType fs_raw_session_get_stream_transmitter_type (FsSession *session,
 
 
 static GstElement *_create_transform_bin (FsRawSession *self, GError **error);
+static void _send_caps_changed (GstPad *pad, GParamSpec *pspec,
+    FsRawSession *self);
 
 static FsStreamTransmitter *_stream_get_stream_transmitter (FsRawStream *stream,
     const gchar *transmitter_name,
@@ -234,6 +242,7 @@ fs_raw_session_init (FsRawSession *self)
   self->priv->construction_error = NULL;
 
   self->priv->mutex = g_mutex_new ();
+  self->priv->send_link_mutex = g_mutex_new ();
 
   self->priv->media_type = FS_MEDIA_TYPE_LAST + 1;
 }
@@ -292,6 +301,11 @@ fs_raw_session_dispose (GObject *object)
 
   if (send_valve)
   {
+    GstPad *pad = gst_element_get_static_pad (send_valve, "sink");
+
+    g_signal_handlers_disconnect_by_func (pad, _send_caps_changed, self);
+    gst_object_unref (pad);
+
     gst_element_set_locked_state (send_valve, TRUE);
     gst_bin_remove (conferencebin, send_valve);
     gst_element_set_state (send_valve, GST_STATE_NULL);
@@ -405,6 +419,7 @@ fs_raw_session_finalize (GObject *object)
     fs_codec_destroy (self->priv->send_codec);
 
   g_mutex_free (self->priv->mutex);
+  g_mutex_free (self->priv->send_link_mutex);
 
   G_OBJECT_CLASS (fs_raw_session_parent_class)->finalize (object);
 }
@@ -731,6 +746,8 @@ fs_raw_session_constructed (GObject *object)
   }
 
   pad = gst_element_get_static_pad (self->priv->send_valve, "sink");
+  g_signal_connect (pad, "notify::caps", G_CALLBACK (_send_caps_changed),
+      self);
   tmp = g_strdup_printf ("sink_%u", self->id);
   self->priv->media_sink_pad = gst_ghost_pad_new (tmp, pad);
   g_free (tmp);
@@ -778,6 +795,223 @@ _create_transform_bin (FsRawSession *self, GError **error)
   return NULL;
 }
 
+/*
+ * If the data coming in already has the negotiated caps, the tee is linked
+ * directly to the capsfilter in front of the transmitter. The caps of the
+ * data flowing are used if there is any, what upstream can produce otherwise.
+ */
+static gboolean
+_can_passthrough (FsRawSession *self, FsRawConference *conference,
+    GstCaps *caps)
+{
+  GstElement *send_valve = NULL;
+  GstPad *media_sink_pad = NULL;
+  GstCaps *upstream_caps = NULL;
+  gboolean passthrough = FALSE;
+
+  GST_OBJECT_LOCK (conference);
+  if (self->priv->send_valve)
+    send_valve = gst_object_ref (self->priv->send_valve);
+  if (self->priv->media_sink_pad)
+    media_sink_pad = gst_object_ref (self->priv->media_sink_pad);
+  GST_OBJECT_UNLOCK (conference);
+
+  if (send_valve)
+  {
+    GstPad *pad = gst_element_get_static_pad (send_valve, "sink");
+
+    upstream_caps = gst_pad_get_negotiated_caps (pad);
+    gst_object_unref (pad);
+    gst_object_unref (send_valve);
+  }
+
+  if (!upstream_caps && media_sink_pad)
+    upstream_caps = gst_pad_peer_get_caps_reffed (media_sink_pad);
+
+  if (media_sink_pad)
+    gst_object_unref (media_sink_pad);
+
+  if (upstream_caps)
+  {
+    passthrough = !gst_caps_is_empty (upstream_caps) &&
+        gst_caps_is_subset (upstream_caps, caps);
+    gst_caps_unref (upstream_caps);
+  }
+
+  return passthrough;
+}
+
+/*
+ * Links the send tee to the capsfilter, directly in passthrough mode or
+ * through a new transform bin otherwise, replacing the previous one.
+ * Must be called with the send_link_mutex held.
+ */
+static gboolean
+_link_send_path (FsRawSession *self, FsRawConference *conference,
+    gboolean passthrough, GError **error)
+{
+  GstElement *transform;
+  GstPad *transform_pad = NULL;
+  GstPad *old_peer;
+
+  GST_OBJECT_LOCK (conference);
+  transform = self->priv->transform_bin;
+  self->priv->transform_bin = NULL;
+  GST_OBJECT_UNLOCK (conference);
+
+  /* Remove the old transform bin */
+  if (transform != NULL)
+  {
+    gst_element_set_locked_state (transform, TRUE);
+    gst_element_set_state (transform, GST_STATE_NULL);
+    gst_bin_remove (GST_BIN (conference), transform);
+    gst_object_unref (transform);
+    transform = NULL;
+  }
+
+  /* In passthrough mode, the tee was linked directly to the capsfilter */
+  old_peer = gst_pad_get_peer (self->priv->send_tee_pad);
+  if (old_peer)
+  {
+    gst_pad_unlink (self->priv->send_tee_pad, old_peer);
+    gst_object_unref (old_peer);
+  }
+
+  if (passthrough)
+  {
+    GST_DEBUG ("Session %u: caps already match, not using a transform bin",
+        self->id);
+
+    transform_pad = gst_element_get_static_pad (self->priv->send_capsfilter,
+        "sink");
+  }
+  else
+  {
+    transform = _create_transform_bin (self, error);
+
+    if (transform == NULL)
+      return FALSE;
+    gst_object_ref_sink (transform);
+
+    if (!gst_bin_add (GST_BIN (conference), transform))
+    {
+      g_set_error (error, FS_ERROR, FS_ERROR_CONSTRUCTION,
+          "Could not add the transform bin to the conference");
+      gst_object_unref (transform);
+      return FALSE;
+    }
+
+    if (!gst_element_link_pads (transform, "src",
+            self->priv->send_capsfilter, "sink") ||
+        !gst_element_sync_state_with_parent (transform))
+    {
+      g_set_error (error, FS_ERROR, FS_ERROR_CONSTRUCTION,
+          "Could not start the transform bin");
+      goto error;
+    }
+
+    transform_pad = gst_element_get_static_pad (transform, "sink");
+  }
+
+  if (transform_pad == NULL ||
+      GST_PAD_LINK_FAILED (gst_pad_link (self->priv->send_tee_pad,
+              transform_pad)))
+  {
+    g_set_error (error, FS_ERROR, FS_ERROR_CONSTRUCTION,
+        "Could not link the send tee");
+    if (transform_pad)
+      gst_object_unref (transform_pad);
+    goto error;
+  }
+  gst_object_unref (transform_pad);
+
+  GST_OBJECT_LOCK (conference);
+  self->priv->transform_bin = transform;
+  self->priv->passthrough = passthrough;
+  GST_OBJECT_UNLOCK (conference);
+
+  return TRUE;
+
+ error:
+  if (transform)
+  {
+    gst_element_set_locked_state (transform, TRUE);
+    gst_element_set_state (transform, GST_STATE_NULL);
+    gst_bin_remove (GST_BIN (conference), transform);
+    gst_object_unref (transform);
+  }
+
+  return FALSE;
+}
+
+/*
+ * Called from the streaming thread before data with new caps goes through the
+ * valve, the tee is then only fed from this thread, so the path after it can
+ * safely be replaced before the data reaches it.
+ */
+static void
+_send_caps_changed (GstPad *pad, GParamSpec *pspec, FsRawSession *self)
+{
+  FsRawConference *conference;
+  GstElement *capsfilter = NULL;
+  GstCaps *caps = NULL;
+  gboolean passthrough;
+  GError *error = NULL;
+
+  /* The caps are unset when the pad is deactivated */
+  caps = gst_pad_get_negotiated_caps (pad);
+  if (!caps)
+    return;
+  gst_caps_unref (caps);
+  caps = NULL;
+
+  conference = fs_raw_session_get_conference (self, NULL);
+  if (!conference)
+    return;
+
+  g_mutex_lock (self->priv->send_link_mutex);
+
+  GST_OBJECT_LOCK (conference);
+  if (self->priv->send_capsfilter)
+    capsfilter = gst_object_ref (self->priv->send_capsfilter);
+  GST_OBJECT_UNLOCK (conference);
+
+  if (capsfilter)
+  {
+    g_object_get (capsfilter, "caps", &caps, NULL);
+    gst_object_unref (capsfilter);
+  }
+
+  /* Nothing is negotiated yet, the transform bin stays in place */
+  if (!caps || gst_caps_is_any (caps))
+    goto out;
+
+  passthrough = _can_passthrough (self, conference, caps);
+
+  GST_OBJECT_LOCK (conference);
+  if (passthrough == self->priv->passthrough)
+  {
+    GST_OBJECT_UNLOCK (conference);
+    goto out;
+  }
+  GST_OBJECT_UNLOCK (conference);
+
+  GST_DEBUG ("Session %u: the input caps changed, %s the transform bin",
+      self->id, passthrough ? "removing" : "adding");
+
+  if (!_link_send_path (self, conference, passthrough, &error))
+  {
+    fs_session_emit_error (FS_SESSION (self), error->code, error->message);
+    g_clear_error (&error);
+  }
+
+ out:
+  g_mutex_unlock (self->priv->send_link_mutex);
+  if (caps)
+    gst_caps_unref (caps);
+  gst_object_unref (conference);
+}
+
 static void
 _stream_remote_codecs_changed (FsRawStream *stream, GParamSpec *pspec,
     FsRawSession *self)
@@ -785,11 +1019,10 @@ _stream_remote_codecs_changed (FsRawStream *stream, GParamSpec *pspec,
   GList *codecs;
   GstCaps *caps;
   FsCodec *codec = NULL;
-  GstPad *transform_pad;
   GError *error = NULL;
-  GstElement *transform = NULL;
   FsRawConference *conference = fs_raw_session_get_conference (self, &error);
   gboolean changed;
+  gboolean passthrough;
   FsStreamDirection direction;
 
   if (conference == NULL)
@@ -806,52 +1039,33 @@ _stream_remote_codecs_changed (FsRawStream *stream, GParamSpec *pspec,
   else
     codec = codecs->data;
 
-  GST_OBJECT_LOCK (conference);
-  transform = self->priv->transform_bin;
-  self->priv->transform_bin = NULL;
-  GST_OBJECT_UNLOCK (conference);
-
-  /* Replace the transform bin */
-  if (transform != NULL)
+  caps = fs_raw_codec_to_gst_caps (codec);
+  if (caps == NULL)
   {
-    gst_element_set_locked_state (transform, TRUE);
-    gst_element_set_state (transform, GST_STATE_NULL);
-    gst_bin_remove (GST_BIN (conference), transform);
-    g_object_unref (transform);
+    g_set_error (&error, FS_ERROR, FS_ERROR_INVALID_ARGUMENTS,
+        "The codec's encoding name is not valid fixed caps");
+    fs_codec_list_destroy (codecs);
+    goto error;
   }
 
-  transform = _create_transform_bin (self, &error);
-
-  if (transform == NULL)
-    goto error;
-  gst_object_ref_sink (transform);
+  g_mutex_lock (self->priv->send_link_mutex);
 
-  if (!gst_bin_add (GST_BIN (conference), transform))
-    goto error;
+  passthrough = _can_passthrough (self, conference, caps);
 
-  caps = fs_raw_codec_to_gst_caps (codec);
   if (self->priv->send_capsfilter)
     g_object_set (self->priv->send_capsfilter, "caps", caps, NULL);
   gst_caps_unref (caps);
 
-  if (!gst_element_link_pads (transform, "src",
-          self->priv->send_capsfilter, "sink"))
-    goto error;
-
-  if (!gst_element_sync_state_with_parent (transform))
-    goto error;
-
-  transform_pad = gst_element_get_static_pad (transform, "sink");
-  if (transform_pad == NULL)
+  if (!_link_send_path (self, conference, passthrough, &error))
+  {
+    g_mutex_unlock (self->priv->send_link_mutex);
+    fs_codec_list_destroy (codecs);
     goto error;
+  }
 
-  if (GST_PAD_LINK_FAILED (gst_pad_link (self->priv->send_tee_pad,
-      transform_pad)))
-    goto error;
+  g_mutex_unlock (self->priv->send_link_mutex);
 
   GST_OBJECT_LOCK (conference);
-  self->priv->transform_bin = transform;
-  transform = NULL;
 
   if (self->priv->codecs)
     fs_codec_list_destroy (self->priv->codecs);
@@ -910,9 +1124,6 @@ error:
 
   if (conference != NULL)
     gst_object_unref (conference);
-
-  if (transform != NULL)
-    gst_object_unref (transform);
 }
 
 void
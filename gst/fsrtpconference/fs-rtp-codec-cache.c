@@ -38,6 +38,7 @@
 #include <farstream/fs-conference.h>
 
 #include "fs-rtp-conference.h"
+#include "fs-rtp-codec-specific.h"
 
 
 /* Because of annoying CRTs */
@@ -573,3 +574,136 @@ save_codecs_cache (FsMediaType media_type, GList *blueprints)
   GST_DEBUG ("Wrote binary codecs cache");
   return TRUE;
 }
+
+
+/*
+ * In-memory cache of the configuration parameters found by the codec
+ * discovery. It is keyed by the encoder (the send profile or the send
+ * factories from the blueprint), the settings that the element added
+ * notifiers apply to it and the codec without its config parameters
+ * and without its payload type, so that a new session using the same encoder
+ * does not have to run it again.
+ */
+
+static GStaticMutex config_cache_mutex = G_STATIC_MUTEX_INIT;
+static GHashTable *config_cache = NULL;
+
+static gchar *
+codec_config_cache_key (CodecBlueprint *blueprint, const gchar *send_profile,
+    const gchar *settings, FsCodec *codec)
+{
+  GString *key = g_string_new (NULL);
+  FsCodec *filtered = codec_copy_filtered (codec, FS_PARAM_TYPE_CONFIG);
+  GList *item, *item2;
+
+  if (send_profile)
+  {
+    g_string_append (key, send_profile);
+  }
+  else if (blueprint)
+  {
+    for (item = blueprint->send_pipeline_factory; item; item = item->next)
+    {
+      for (item2 = item->data; item2; item2 = item2->next)
+      {
+        g_string_append (key,
+            gst_plugin_feature_get_name (GST_PLUGIN_FEATURE (item2->data)));
+        g_string_append_c (key, ',');
+      }
+      g_string_append_c (key, '!');
+    }
+  }
+
+  g_string_append_printf (key, "|%s|%d|%s|%u|%u", settings,
+      filtered->media_type,
+      filtered->encoding_name, filtered->clock_rate, filtered->channels);
+
+  for (item = filtered->optional_params; item; item = item->next)
+  {
+    FsCodecParameter *param = item->data;
+
+    g_string_append_printf (key, "|%s=%s", param->name, param->value);
+  }
+
+  fs_codec_destroy (filtered);
+
+  return g_string_free (key, FALSE);
+}
+
+/**
+ * codec_config_cache_store:
+ * @blueprint: the #CodecBlueprint used to create the encoder
+ * @send_profile: the send profile used to create the encoder or %NULL
+ * @settings: identifies the properties set on the encoder by the element added
+ *  notifiers, or %NULL if they are not known
+ * @codec: the #FsCodec with its discovered configuration
+ *
+ * Remembers the configuration parameters of @codec, nothing is stored if
+ * the configuration is not complete or if the settings are not known.
+ */
+
+void
+codec_config_cache_store (CodecBlueprint *blueprint, const gchar *send_profile,
+    const gchar *settings, FsCodec *codec)
+{
+  if (!settings || codec_needs_config (codec))
+    return;
+
+  g_static_mutex_lock (&config_cache_mutex);
+  if (!config_cache)
+    config_cache = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+        (GDestroyNotify) fs_codec_destroy);
+  g_hash_table_replace (config_cache,
+      codec_config_cache_key (blueprint, send_profile, settings, codec),
+      fs_codec_copy (codec));
+  g_static_mutex_unlock (&config_cache_mutex);
+}
+
+/**
+ * codec_config_cache_lookup:
+ * @blueprint: the #CodecBlueprint used to create the encoder
+ * @send_profile: the send profile used to create the encoder or %NULL
+ * @settings: identifies the properties set on the encoder by the element added
+ *  notifiers, or %NULL if they are not known
+ * @codec: the #FsCodec to complete
+ *
+ * Adds the previously discovered configuration parameters that are missing
+ * from @codec.
+ *
+ * Returns: %TRUE if there was a configuration in the cache
+ */
+
+gboolean
+codec_config_cache_lookup (CodecBlueprint *blueprint,
+    const gchar *send_profile, const gchar *settings, FsCodec *codec)
+{
+  FsCodec *cached = NULL;
+  gchar *key;
+  GList *item;
+
+  if (!settings)
+    return FALSE;
+
+  key = codec_config_cache_key (blueprint, send_profile, settings, codec);
+
+  g_static_mutex_lock (&config_cache_mutex);
+  if (config_cache)
+    cached = g_hash_table_lookup (config_cache, key);
+
+  if (cached)
+  {
+    for (item = cached->optional_params; item; item = item->next)
+    {
+      FsCodecParameter *param = item->data;
+
+      if (codec_has_config_data_named (codec, param->name) &&
+          !fs_codec_get_optional_parameter (codec, param->name, NULL))
+        fs_codec_add_optional_parameter (codec, param->name, param->value);
+    }
+  }
+  g_static_mutex_unlock (&config_cache_mutex);
+
+  g_free (key);
+
+  return (cached != NULL);
+}
@@ -34,6 +34,11 @@ G_BEGIN_DECLS
 GList *load_codecs_cache (FsMediaType media_type);
 gboolean save_codecs_cache (FsMediaType media_type, GList *codec_blueprints);
 
+void codec_config_cache_store (CodecBlueprint *blueprint,
+    const gchar *send_profile, const gchar *settings, FsCodec *codec);
+gboolean codec_config_cache_lookup (CodecBlueprint *blueprint,
+    const gchar *send_profile, const gchar *settings, FsCodec *codec);
+
 
 G_END_DECLS
 
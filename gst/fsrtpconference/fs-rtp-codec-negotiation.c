@@ -338,9 +338,53 @@ _codec_association_destroy (CodecAssociation *ca)
   fs_codec_destroy (ca->send_codec);
   g_free (ca->send_profile);
   g_free (ca->recv_profile);
+  if (ca->pt_map_caps)
+    gst_caps_unref (ca->pt_map_caps);
   g_slice_free (CodecAssociation, ca);
 }
 
+/**
+ * codec_association_get_pt_map_caps:
+ * @ca: a #CodecAssociation
+ *
+ * Gets the caps for the receive codec without its config parameters, which
+ * is what rtpbin wants when it asks for a payload type. They are only built
+ * the first time, so they must not be modified by the caller.
+ *
+ * Returns: a new reference to the caps
+ */
+
+GstCaps *
+codec_association_get_pt_map_caps (CodecAssociation *ca)
+{
+  if (!ca->pt_map_caps)
+  {
+    FsCodec *tmpcodec = codec_copy_filtered (ca->codec, FS_PARAM_TYPE_CONFIG);
+    ca->pt_map_caps = fs_codec_to_gst_caps (tmpcodec);
+    fs_codec_destroy (tmpcodec);
+  }
+
+  return gst_caps_ref (ca->pt_map_caps);
+}
+
+/**
+ * codec_association_invalidate_caps:
+ * @ca: a #CodecAssociation
+ *
+ * Must be called after modifying the codec of a #CodecAssociation that
+ * may already have been used to get caps.
+ */
+
+void
+codec_association_invalidate_caps (CodecAssociation *ca)
+{
+  if (ca->pt_map_caps)
+  {
+    gst_caps_unref (ca->pt_map_caps);
+    ca->pt_map_caps = NULL;
+  }
+}
+
 
 static CodecBlueprint *
 _find_matching_blueprint (FsCodec *codec, GList *blueprints)
@@ -1206,6 +1250,8 @@ codec_association_copy (CodecAssociation *ca)
   newca->send_codec = fs_codec_copy (ca->send_codec);
   newca->send_profile = g_strdup (ca->send_profile);
   newca->recv_profile = g_strdup (ca->recv_profile);
+  /* The copy is usually modified, let it rebuild its own caps */
+  newca->pt_map_caps = NULL;
 
   return newca;
 }
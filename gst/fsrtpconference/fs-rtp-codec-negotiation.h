@@ -41,6 +41,8 @@ G_BEGIN_DECLS
  * @need_config: means that the config has to be retreived from the codec data
  * @recv_only: means thats its not a real negotiated codec, just a codec that
  * we have offered from which we have to be ready to receive stuff, just in case
+ * @pt_map_caps: the caps returned to rtpbin for this payload type, created
+ *  on first use by codec_association_get_pt_map_caps()
  *
  * The codec association structure represents the link between a #FsCodec and
  * a CodecBlueprint that implements it.
@@ -65,6 +67,7 @@ typedef struct _CodecAssociation {
   gboolean need_config;
   gboolean recv_only;
 
+  GstCaps *pt_map_caps;
 } CodecAssociation;
 
 
@@ -117,6 +120,12 @@ codec_associations_list_are_equal (GList *list1, GList *list2);
 void
 codec_association_list_destroy (GList *list);
 
+GstCaps *
+codec_association_get_pt_map_caps (CodecAssociation *ca);
+
+void
+codec_association_invalidate_caps (CodecAssociation *ca);
+
 typedef gboolean (*CAFindFunc) (CodecAssociation *ca, gpointer user_data);
 
 CodecAssociation *
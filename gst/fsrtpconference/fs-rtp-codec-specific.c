@@ -282,18 +282,87 @@ static const struct SdpNegoFunction sdp_nego_functions[] = {
   {0, NULL, NULL}
 };
 
+/*
+ * The tables above are turned into hash tables the first time they are
+ * used, so that finding the functions for a codec and for each of its
+ * parameters does not scan them with string compares.
+ */
+
+struct SdpNegoLookup {
+  /* encoding name -> struct SdpNegoFunction, one table per media type */
+  GHashTable *functions[FS_MEDIA_TYPE_LAST + 1];
+  /* param name -> struct SdpParam, indexed like sdp_nego_functions */
+  GHashTable *params[G_N_ELEMENTS (sdp_nego_functions)];
+};
+
+static guint
+ascii_strcase_hash (gconstpointer v)
+{
+  const gchar *p;
+  guint32 h = 5381;
+
+  for (p = v; *p; p++)
+    h = (h << 5) + h + g_ascii_tolower (*p);
+
+  return h;
+}
+
+static gboolean
+ascii_strcase_equal (gconstpointer v1, gconstpointer v2)
+{
+  return !g_ascii_strcasecmp (v1, v2);
+}
+
+static gpointer
+build_sdp_nego_lookup (gpointer data)
+{
+  struct SdpNegoLookup *lookup = g_new0 (struct SdpNegoLookup, 1);
+  guint i, j;
+
+  for (i = 0; i <= FS_MEDIA_TYPE_LAST; i++)
+    lookup->functions[i] = g_hash_table_new (ascii_strcase_hash,
+        ascii_strcase_equal);
+
+  for (i = 0; sdp_nego_functions[i].sdp_negotiate_codec; i++)
+  {
+    const struct SdpNegoFunction *nf = &sdp_nego_functions[i];
+
+    g_hash_table_insert (lookup->functions[nf->media_type],
+        (gpointer) nf->encoding_name, (gpointer) nf);
+
+    lookup->params[i] = g_hash_table_new (ascii_strcase_hash,
+        ascii_strcase_equal);
+    for (j = 0; j < MAX_PARAMS && nf->params[j].name; j++)
+      g_hash_table_insert (lookup->params[i], nf->params[j].name,
+          (gpointer) &nf->params[j]);
+  }
+
+  return lookup;
+}
+
+static const struct SdpNegoLookup *
+get_sdp_nego_lookup (void)
+{
+  static GOnce lookup_once = G_ONCE_INIT;
+
+  return g_once (&lookup_once, build_sdp_nego_lookup, NULL);
+}
+
 static const struct SdpNegoFunction *
 get_sdp_nego_function (FsMediaType media_type, const gchar *encoding_name)
 {
-  int i;
+  if (media_type > FS_MEDIA_TYPE_LAST || !encoding_name)
+    return NULL;
 
-  for (i = 0; sdp_nego_functions[i].sdp_negotiate_codec; i++)
-    if (sdp_nego_functions[i].media_type == media_type &&
-        !g_ascii_strcasecmp (sdp_nego_functions[i].encoding_name,
-            encoding_name))
-      return &sdp_nego_functions[i];
+  return g_hash_table_lookup (get_sdp_nego_lookup ()->functions[media_type],
+      encoding_name);
+}
 
-  return NULL;
+static const struct SdpParam *
+lookup_sdp_param (const struct SdpNegoFunction *nf, const gchar *param_name)
+{
+  return g_hash_table_lookup (
+      get_sdp_nego_lookup ()->params[nf - sdp_nego_functions], param_name);
 }
 
 
@@ -334,17 +403,14 @@ static gboolean
 codec_param_check_type (const struct SdpNegoFunction *nf,
     const gchar *param_name, FsParamType paramtypes)
 {
-  gint i;
+  const struct SdpParam *sdp_param;
 
   if (!nf)
     return FALSE;
 
-  for (i = 0; nf->params[i].name; i++)
-    if (nf->params[i].paramtype & paramtypes &&
-        !g_ascii_strcasecmp (nf->params[i].name, param_name))
-      return TRUE;
+  sdp_param = lookup_sdp_param (nf, param_name);
 
-  return FALSE;
+  return sdp_param && (sdp_param->paramtype & paramtypes);
 }
 
 
@@ -469,11 +535,10 @@ get_sdp_param (const struct SdpNegoFunction *nf, const gchar *param_name)
 
   if (nf)
   {
-    gint i;
+    const struct SdpParam *sdp_param = lookup_sdp_param (nf, param_name);
 
-    for (i = 0; nf->params[i].name; i++)
-      if (!g_ascii_strcasecmp (param_name, nf->params[i].name))
-        return &nf->params[i];
+    if (sdp_param)
+      return sdp_param;
 
     if (nf->media_type != FS_MEDIA_TYPE_AUDIO)
       return NULL;
@@ -729,133 +794,176 @@ event_range_cmp (gconstpointer a, gconstpointer b)
   return era->first - erb->first;
 }
 
-static GList *
+/*
+ * Returns a sorted array of struct event_range or %NULL if the string is
+ * not a valid list of events like "0-15,32,36-40"
+ */
+
+static GArray *
 parse_events (const gchar *events)
 {
-  gchar **ranges_strv;
-  GList *ranges = NULL;
-  int i;
+  GArray *ranges = g_array_new (FALSE, FALSE, sizeof (struct event_range));
+  const gchar *p = events;
 
-  ranges_strv = g_strsplit (events, ",", 0);
-
-  for (i = 0; ranges_strv[i]; i++)
+  for (;;)
   {
-    struct event_range *er = g_slice_new (struct event_range);
-    gchar *p = NULL;
+    struct event_range er;
+    gchar *end;
+
+    if (!g_ascii_isdigit (*p))
+      goto invalid;
+    er.first = strtol (p, &end, 10);
+    p = end;
 
-    er->first = atoi (ranges_strv[i]);
-    p = strchr (ranges_strv[i], '-');
-    if (p)
-      er->last = atoi (p + 1);
+    if (*p == '-')
+    {
+      p++;
+      if (!g_ascii_isdigit (*p))
+        goto invalid;
+      er.last = strtol (p, &end, 10);
+      p = end;
+    }
     else
-      er->last = er->first;
+    {
+      er.last = er.first;
+    }
 
-    ranges = g_list_insert_sorted (ranges, er, event_range_cmp);
+    g_array_append_val (ranges, er);
+
+    if (*p == '\0')
+      break;
+    if (*p != ',')
+      goto invalid;
+    p++;
   }
 
-  g_strfreev (ranges_strv);
+  g_array_sort (ranges, event_range_cmp);
 
   return ranges;
+
+ invalid:
+  g_array_free (ranges, TRUE);
+  return NULL;
 }
 
-static void
-event_range_free (gpointer data)
+/*
+ * The same few events strings are negotiated over and over, so keep
+ * them parsed. The cache is small and just emptied when full.
+ */
+
+#define EVENTS_CACHE_SIZE 32
+
+static GStaticMutex events_cache_mutex = G_STATIC_MUTEX_INIT;
+static GHashTable *events_cache = NULL;
+
+static GArray *
+get_parsed_events (const gchar *events)
 {
-  g_slice_free (struct event_range, data);
+  GArray *ranges;
+
+  g_static_mutex_lock (&events_cache_mutex);
+  if (!events_cache)
+    events_cache = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+        (GDestroyNotify) g_array_unref);
+
+  ranges = g_hash_table_lookup (events_cache, events);
+  if (ranges)
+  {
+    g_array_ref (ranges);
+    g_static_mutex_unlock (&events_cache_mutex);
+    return ranges;
+  }
+  g_static_mutex_unlock (&events_cache_mutex);
+
+  ranges = parse_events (events);
+  if (!ranges)
+    return NULL;
+
+  g_static_mutex_lock (&events_cache_mutex);
+  if (g_hash_table_size (events_cache) >= EVENTS_CACHE_SIZE)
+    g_hash_table_remove_all (events_cache);
+  g_hash_table_replace (events_cache, g_strdup (events),
+      g_array_ref (ranges));
+  g_static_mutex_unlock (&events_cache_mutex);
+
+  return ranges;
 }
 
 static gchar *
 event_intersection (const gchar *remote_events, const gchar *local_events)
 {
-  GList *remote_ranges = NULL;
-  GList *local_ranges = NULL;
-  GList *intersected_ranges = NULL;
-  GList *item;
+  GArray *remote_ranges = NULL;
+  GArray *local_ranges = NULL;
+  gboolean *local_done;
   GString *intersection_gstr;
+  guint i, j;
 
-  if (!g_regex_match_simple ("^[0-9]+(-[0-9]+)?(,[0-9]+(-[0-9]+)?)*$",
-          remote_events, 0, 0))
+  remote_ranges = get_parsed_events (remote_events);
+  if (!remote_ranges)
   {
     GST_WARNING ("Invalid remote events (events=%s)", remote_events);
     return NULL;
   }
 
-  if (!g_regex_match_simple ("^[0-9]+(-[0-9]+)?(,[0-9]+(-[0-9]+)?)*$",
-          local_events, 0, 0))
+  local_ranges = get_parsed_events (local_events);
+  if (!local_ranges)
   {
     GST_WARNING ("Invalid local events (events=%s)", local_events);
+    g_array_unref (remote_ranges);
     return NULL;
   }
 
-  remote_ranges = parse_events (remote_events);
-  local_ranges = parse_events (local_events);
+  intersection_gstr = g_string_new ("");
+  local_done = g_new0 (gboolean, local_ranges->len);
 
-  while ((item = remote_ranges) != NULL)
+  for (i = 0; i < remote_ranges->len; i++)
   {
-    struct event_range *er1 = item->data;
-    GList *item2;
+    struct event_range *er1 =
+      &g_array_index (remote_ranges, struct event_range, i);
 
-    item2 = local_ranges;
-    while (item2)
+    for (j = 0; j < local_ranges->len; j++)
     {
-      struct event_range *er2 = item2->data;
+      struct event_range *er2 =
+        &g_array_index (local_ranges, struct event_range, j);
 
-      if (er1->last < er2->first) {
+      if (local_done[j])
+        continue;
+
+      if (er1->last < er2->first)
         break;
-      }
 
       if (er1->first <= er2->last)
       {
-        struct event_range *new_er = g_slice_new (struct event_range);
+        gint first = MAX (er1->first, er2->first);
+        gint last = MIN (er1->last, er2->last);
+
+        if (intersection_gstr->len)
+          g_string_append_c (intersection_gstr, ',');
 
-        new_er->first = MAX (er1->first, er2->first);
-        new_er->last = MIN (er1->last, er2->last);
-        intersected_ranges = g_list_append (intersected_ranges, new_er);
+        if (first == last)
+          g_string_append_printf (intersection_gstr, "%d", first);
+        else
+          g_string_append_printf (intersection_gstr, "%d-%d", first, last);
       }
 
-      item2 = item2->next;
+      /* The next remote ranges can not add anything from this one */
       if (er2->last < er1->last)
-      {
-        local_ranges = g_list_remove (local_ranges, er2);
-        event_range_free (er2);
-      }
+        local_done[j] = TRUE;
     }
-
-    remote_ranges = g_list_delete_link (remote_ranges, item);
-    event_range_free (er1);
   }
 
-  while (local_ranges)
-  {
-    event_range_free (local_ranges->data);
-    local_ranges = g_list_delete_link (local_ranges, local_ranges);
-  }
+  g_free (local_done);
+  g_array_unref (remote_ranges);
+  g_array_unref (local_ranges);
 
-  if (!intersected_ranges)
+  if (!intersection_gstr->len)
   {
     GST_DEBUG ("There is no intersection before the events %s and %s",
         remote_events, local_events);
+    g_string_free (intersection_gstr, TRUE);
     return NULL;
   }
 
-  intersection_gstr = g_string_new ("");
-
-  while ((item = intersected_ranges) != NULL)
-  {
-    struct event_range *er = item->data;
-
-    if (intersection_gstr->len)
-      g_string_append_c (intersection_gstr, ',');
-
-    if (er->first == er->last)
-      g_string_append_printf (intersection_gstr, "%d", er->first);
-    else
-      g_string_append_printf (intersection_gstr, "%d-%d", er->first, er->last);
-
-    intersected_ranges = g_list_delete_link (intersected_ranges, item);
-    event_range_free (er);
-  }
-
   return g_string_free (intersection_gstr, FALSE);
 }
 
@@ -66,6 +66,7 @@ enum
 {
   PROP_0,
   PROP_SDES,
+  PROP_BATCH_MESSAGES
 };
 
 
@@ -101,11 +102,44 @@ struct _FsRtpConferencePrivate
   GList *sessions;
   guint sessions_cookie;
   guint max_session_id;
+  /* Session id -> struct SessionEntry, same sessions as above */
+  GHashTable *sessions_by_id;
 
   GList *participants;
 
   /* Array of all internal threads, as GThreads */
   GPtrArray *threads;
+
+  /* Protected by GST_OBJECT_LOCK */
+  gboolean batch_messages;
+  /* GstMessages waiting for the next farstream-batch message */
+  GPtrArray *batch;
+  guint batch_idle_id;
+  struct BatchIdle *batch_idle;
+};
+
+/*
+ * The idle posting the batch does not hold a reference to the conference,
+ * so a main loop that is not running can't keep it alive. The pointer is
+ * cleared when the conference is disposed, under the batch_idle_mutex.
+ */
+
+struct BatchIdle {
+  FsRtpConference *self;
+};
+
+static GStaticMutex batch_idle_mutex = G_STATIC_MUTEX_INIT;
+
+/*
+ * Given to the weak reference of each session so it can be removed without
+ * searching for it
+ */
+
+struct SessionEntry {
+  FsRtpConference *self;
+  FsRtpSession *session; /* not refed */
+  guint id;
+  GList *link; /* in the sessions list */
 };
 
 static void fs_rtp_conference_do_init (GType type);
@@ -150,6 +184,15 @@ static void _rtpbin_on_ssrc_validated (GstElement *rtpbin,
     guint session_id,
     guint ssrc,
     gpointer user_data);
+static void _rtpbin_on_ssrc_sdes (GstElement *rtpbin,
+    guint session_id,
+    guint ssrc,
+    gpointer user_data);
+
+static gboolean fs_rtp_conference_batch_message (FsRtpConference *self,
+    GstMessage *message);
+static void fs_rtp_conference_flush_batch (FsRtpConference *self);
+static void fs_rtp_conference_flush_messages (FsConference *conf);
 
 static void
 _remove_session (gpointer user_data,
@@ -184,6 +227,8 @@ fs_rtp_conference_dispose (GObject * object)
 {
   FsRtpConference *self = FS_RTP_CONFERENCE (object);
   GList *item;
+  GHashTableIter iter;
+  gpointer value;
 
   if (self->priv->disposed)
     return;
@@ -193,12 +238,17 @@ fs_rtp_conference_dispose (GObject * object)
     self->gstrtpbin = NULL;
   }
 
-  for (item = g_list_first (self->priv->sessions);
-       item;
-       item = g_list_next (item))
-    g_object_weak_unref (G_OBJECT (item->data), _remove_session, self);
+  g_hash_table_iter_init (&iter, self->priv->sessions_by_id);
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+  {
+    struct SessionEntry *entry = value;
+
+    g_object_weak_unref (G_OBJECT (entry->session), _remove_session, entry);
+    g_slice_free (struct SessionEntry, entry);
+  }
   g_list_free (self->priv->sessions);
   self->priv->sessions = NULL;
+  g_hash_table_remove_all (self->priv->sessions_by_id);
   self->priv->sessions_cookie++;
 
   for (item = g_list_first (self->priv->participants);
@@ -208,6 +258,17 @@ fs_rtp_conference_dispose (GObject * object)
   g_list_free (self->priv->participants);
   self->priv->participants = NULL;
 
+  g_static_mutex_lock (&batch_idle_mutex);
+  GST_OBJECT_LOCK (self);
+  if (self->priv->batch_idle)
+    self->priv->batch_idle->self = NULL;
+  self->priv->batch_idle = NULL;
+  GST_OBJECT_UNLOCK (self);
+  g_static_mutex_unlock (&batch_idle_mutex);
+
+  /* There is nowhere left to post the pending messages */
+  fs_rtp_conference_flush_batch (self);
+
   self->priv->disposed = TRUE;
 
   G_OBJECT_CLASS (parent_class)->dispose (object);
@@ -223,6 +284,8 @@ fs_rtp_conference_finalize (GObject * object)
   g_type_class_unref (g_type_class_peek (FS_TYPE_RTP_SUB_STREAM));
 
   g_ptr_array_free (self->priv->threads, TRUE);
+  g_hash_table_destroy (self->priv->sessions_by_id);
+  g_ptr_array_free (self->priv->batch, TRUE);
 
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
@@ -241,6 +304,8 @@ fs_rtp_conference_class_init (FsRtpConferenceClass * klass)
     GST_DEBUG_FUNCPTR (fs_rtp_conference_new_session);
   baseconf_class->new_participant =
     GST_DEBUG_FUNCPTR (fs_rtp_conference_new_participant);
+  baseconf_class->flush_messages =
+    GST_DEBUG_FUNCPTR (fs_rtp_conference_flush_messages);
 
   gstbin_class->handle_message =
     GST_DEBUG_FUNCPTR (fs_rtp_conference_handle_message);
@@ -259,6 +324,26 @@ fs_rtp_conference_class_init (FsRtpConferenceClass * klass)
       g_param_spec_boxed ("sdes", "SDES Items for this conference",
           "SDES items to use for sessions in this conference",
           GST_TYPE_STRUCTURE, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * FsRtpConference:batch-messages:
+   *
+   * If %TRUE, the "farstream-" element messages posted by the conference
+   * and its children are not posted one by one, but collected and posted
+   * from the default #GMainContext once per main loop iteration as a single
+   * "farstream-batch" message. Its "messages" field is a #GST_TYPE_ARRAY
+   * of the original #GstMessage in the order they were posted, use
+   * fs_session_parse_batch() and fs_stream_parse_batch() to get them.
+   *
+   * Errors are never batched. This requires the default #GMainContext to be
+   * running.
+   */
+  g_object_class_install_property (gobject_class, PROP_BATCH_MESSAGES,
+      g_param_spec_boolean ("batch-messages", "Batch messages",
+          "Post the farstream messages as one farstream-batch message per"
+          " main loop iteration",
+          FALSE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 }
 
 static void
@@ -286,6 +371,9 @@ fs_rtp_conference_init (FsRtpConference *conf,
   conf->priv->max_session_id = 1;
 
   conf->priv->threads = g_ptr_array_new ();
+  conf->priv->sessions_by_id = g_hash_table_new (g_direct_hash,
+      g_direct_equal);
+  conf->priv->batch = g_ptr_array_new ();
 
   conf->gstrtpbin = gst_element_factory_make ("gstrtpbin", "rtpbin");
 
@@ -311,6 +399,8 @@ fs_rtp_conference_init (FsRtpConference *conf,
                     G_CALLBACK (_rtpbin_on_bye_ssrc), conf);
   g_signal_connect (conf->gstrtpbin, "on-ssrc-validated",
                     G_CALLBACK (_rtpbin_on_ssrc_validated), conf);
+  g_signal_connect (conf->gstrtpbin, "on-ssrc-sdes",
+                    G_CALLBACK (_rtpbin_on_ssrc_sdes), conf);
 
   /* We have to ref the class here because the class initialization
    * in GLib is not thread safe
@@ -328,13 +418,16 @@ fs_rtp_conference_get_property (GObject *object,
 {
   FsRtpConference *self = FS_RTP_CONFERENCE (object);
 
-  if (!self->gstrtpbin)
-    return;
-
   switch (prop_id)
   {
     case PROP_SDES:
-      g_object_get_property (G_OBJECT (self->gstrtpbin), "sdes", value);
+      if (self->gstrtpbin)
+        g_object_get_property (G_OBJECT (self->gstrtpbin), "sdes", value);
+      break;
+    case PROP_BATCH_MESSAGES:
+      GST_OBJECT_LOCK (self);
+      g_value_set_boolean (value, self->priv->batch_messages);
+      GST_OBJECT_UNLOCK (self);
       break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
@@ -350,13 +443,16 @@ fs_rtp_conference_set_property (GObject *object,
 {
   FsRtpConference *self = FS_RTP_CONFERENCE (object);
 
-  if (!self->gstrtpbin)
-    return;
-
   switch (prop_id)
   {
     case PROP_SDES:
-      g_object_set_property (G_OBJECT (self->gstrtpbin), "sdes", value);
+      if (self->gstrtpbin)
+        g_object_set_property (G_OBJECT (self->gstrtpbin), "sdes", value);
+      break;
+    case PROP_BATCH_MESSAGES:
+      GST_OBJECT_LOCK (self);
+      self->priv->batch_messages = g_value_get_boolean (value);
+      GST_OBJECT_UNLOCK (self);
       break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
@@ -451,21 +547,13 @@ static FsRtpSession *
 fs_rtp_conference_get_session_by_id_locked (FsRtpConference *self,
                                             guint session_id)
 {
-  GList *item = NULL;
+  struct SessionEntry *entry;
 
-  for (item = g_list_first (self->priv->sessions);
-       item;
-       item = g_list_next (item)) {
-    FsRtpSession *session = item->data;
+  entry = g_hash_table_lookup (self->priv->sessions_by_id,
+      GUINT_TO_POINTER (session_id));
 
-    if (session->id == session_id) {
-      g_object_ref (session);
-      break;
-    }
-  }
-
-  if (item)
-    return FS_RTP_SESSION (item->data);
+  if (entry)
+    return g_object_ref (entry->session);
   else
     return NULL;
 }
@@ -495,13 +583,18 @@ static void
 _remove_session (gpointer user_data,
                  GObject *where_the_object_was)
 {
-  FsRtpConference *self = FS_RTP_CONFERENCE (user_data);
+  struct SessionEntry *entry = user_data;
+  FsRtpConference *self = entry->self;
 
   GST_OBJECT_LOCK (self);
   self->priv->sessions =
-    g_list_remove_all (self->priv->sessions, where_the_object_was);
+    g_list_delete_link (self->priv->sessions, entry->link);
+  g_hash_table_remove (self->priv->sessions_by_id,
+      GUINT_TO_POINTER (entry->id));
   self->priv->sessions_cookie++;
   GST_OBJECT_UNLOCK (self);
+
+  g_slice_free (struct SessionEntry, entry);
 }
 
 static void
@@ -524,6 +617,7 @@ fs_rtp_conference_new_session (FsConference *conf,
 {
   FsRtpConference *self = FS_RTP_CONFERENCE (conf);
   FsSession *new_session = NULL;
+  struct SessionEntry *entry;
   guint id;
 
   if (!self->gstrtpbin)
@@ -536,7 +630,8 @@ fs_rtp_conference_new_session (FsConference *conf,
   GST_OBJECT_LOCK (self);
   do {
     id = self->priv->max_session_id++;
-  } while (fs_rtp_conference_get_session_by_id_locked (self, id));
+  } while (g_hash_table_lookup (self->priv->sessions_by_id,
+          GUINT_TO_POINTER (id)));
   GST_OBJECT_UNLOCK (self);
 
   new_session = FS_SESSION_CAST (fs_rtp_session_new (media_type, self, id,
@@ -546,12 +641,21 @@ fs_rtp_conference_new_session (FsConference *conf,
     return NULL;
   }
 
+  entry = g_slice_new (struct SessionEntry);
+  entry->self = self;
+  entry->session = FS_RTP_SESSION (new_session);
+  entry->id = id;
+
   GST_OBJECT_LOCK (self);
-  self->priv->sessions = g_list_append (self->priv->sessions, new_session);
+  /* The order does not matter, don't walk the list with many sessions */
+  self->priv->sessions = g_list_prepend (self->priv->sessions, new_session);
+  entry->link = self->priv->sessions;
+  g_hash_table_insert (self->priv->sessions_by_id, GUINT_TO_POINTER (id),
+      entry);
   self->priv->sessions_cookie++;
   GST_OBJECT_UNLOCK (self);
 
-  g_object_weak_ref (G_OBJECT (new_session), _remove_session, self);
+  g_object_weak_ref (G_OBJECT (new_session), _remove_session, entry);
 
   return new_session;
 }
@@ -575,7 +679,7 @@ fs_rtp_conference_new_participant (FsConference *conf,
 
 
   GST_OBJECT_LOCK (self);
-  self->priv->participants = g_list_append (self->priv->participants,
+  self->priv->participants = g_list_prepend (self->priv->participants,
       new_participant);
   GST_OBJECT_UNLOCK (self);
 
@@ -599,46 +703,9 @@ fs_rtp_conference_handle_message (
     {
       const GstStructure *s = gst_message_get_structure (message);
 
-      /* we change the structure name and add the session ID to it */
-      if (gst_structure_has_name (s, "application/x-rtp-source-sdes") &&
-          gst_structure_has_field_typed (s, "session", G_TYPE_UINT) &&
-          gst_structure_has_field_typed (s, "ssrc", G_TYPE_UINT) &&
-          gst_structure_has_field_typed (s, "cname", G_TYPE_STRING))
-      {
-        guint session_id;
-        guint ssrc;
-        const GValue *val;
-        FsRtpSession *session;
-        const gchar *cname;
-
-        val = gst_structure_get_value (s, "session");
-        session_id = g_value_get_uint (val);
-
-        val = gst_structure_get_value (s, "ssrc");
-        ssrc = g_value_get_uint (val);
-
-        cname = gst_structure_get_string (s, "cname");
-
-        if (!ssrc || !cname)
-        {
-          GST_WARNING_OBJECT (self,
-              "Got GstRTPBinSDES without a ssrc or a cname (ssrc:%u cname:%p)",
-              ssrc, cname);
-          break;
-        }
-
-        session = fs_rtp_conference_get_session_by_id (self, session_id);
-
-        if (session) {
-          fs_rtp_session_associate_ssrc_cname (session, ssrc, cname);
-          g_object_unref (session);
-        } else {
-          GST_WARNING_OBJECT (self,"Our GstRtpBin announced a new association"
-              "for non-existent session %u for ssrc: %u and cname %s",
-              session_id, ssrc, cname);
-        }
-      }
-      else if (gst_structure_has_name (s, "dtmf-event-processed") ||
+      /* The SDES messages from the rtpbin are handled through the
+       * "on-ssrc-sdes" signal, they are just forwarded */
+      if (gst_structure_has_name (s, "dtmf-event-processed") ||
           gst_structure_has_name (s, "dtmf-event-dropped"))
       {
         GList *item;
@@ -664,6 +731,11 @@ fs_rtp_conference_handle_message (
         GST_OBJECT_UNLOCK (self);
 
       }
+      else if (fs_rtp_conference_batch_message (self, message))
+      {
+        message = NULL;
+        goto out;
+      }
     }
     break;
     case GST_MESSAGE_STREAM_STATUS:
@@ -711,6 +783,165 @@ fs_rtp_conference_handle_message (
     GST_BIN_CLASS (parent_class)->handle_message (bin, message);
 }
 
+static void
+fs_rtp_conference_post_pending_batch (FsRtpConference *self)
+{
+  GstStructure *s;
+  GValue array = {0};
+  guint i;
+
+  g_value_init (&array, GST_TYPE_ARRAY);
+
+  GST_OBJECT_LOCK (self);
+  for (i = 0; i < self->priv->batch->len; i++)
+  {
+    GValue value = {0};
+
+    g_value_init (&value, GST_TYPE_MESSAGE);
+    gst_value_take_mini_object (&value,
+        g_ptr_array_index (self->priv->batch, i));
+    gst_value_array_append_value (&array, &value);
+    g_value_unset (&value);
+  }
+  g_ptr_array_set_size (self->priv->batch, 0);
+  GST_OBJECT_UNLOCK (self);
+
+  if (gst_value_array_get_size (&array))
+  {
+    s = gst_structure_new ("farstream-batch", NULL);
+    gst_structure_take_value (s, "messages", &array);
+
+    gst_element_post_message (GST_ELEMENT (self),
+        gst_message_new_element (GST_OBJECT (self), s));
+  }
+  else
+  {
+    g_value_unset (&array);
+  }
+}
+
+static gboolean
+fs_rtp_conference_post_batch (gpointer user_data)
+{
+  struct BatchIdle *idle = user_data;
+  FsRtpConference *self;
+
+  g_static_mutex_lock (&batch_idle_mutex);
+  self = idle->self;
+  if (self)
+    gst_object_ref (self);
+  g_static_mutex_unlock (&batch_idle_mutex);
+
+  if (!self)
+    return FALSE;
+
+  GST_OBJECT_LOCK (self);
+  if (self->priv->batch_idle == idle)
+  {
+    self->priv->batch_idle = NULL;
+    self->priv->batch_idle_id = 0;
+  }
+  GST_OBJECT_UNLOCK (self);
+
+  fs_rtp_conference_post_pending_batch (self);
+
+  gst_object_unref (self);
+
+  return FALSE;
+}
+
+static void
+batch_idle_free (gpointer data)
+{
+  g_slice_free (struct BatchIdle, data);
+}
+
+/*
+ * Posts the pending messages right away, used before an error is posted and
+ * when the conference goes to the NULL state, when the main loop may not run
+ * anymore.
+ */
+
+static void
+fs_rtp_conference_flush_batch (FsRtpConference *self)
+{
+  guint idle_id;
+
+  GST_OBJECT_LOCK (self);
+  idle_id = self->priv->batch_idle_id;
+  self->priv->batch_idle_id = 0;
+  self->priv->batch_idle = NULL;
+  GST_OBJECT_UNLOCK (self);
+
+  if (idle_id)
+    g_source_remove (idle_id);
+
+  fs_rtp_conference_post_pending_batch (self);
+}
+
+static void
+fs_rtp_conference_flush_messages (FsConference *conf)
+{
+  fs_rtp_conference_flush_batch (FS_RTP_CONFERENCE (conf));
+}
+
+/*
+ * Returns: %TRUE if the message has been added to the next batch and the
+ * caller must not use it anymore
+ */
+
+static gboolean
+fs_rtp_conference_batch_message (FsRtpConference *self, GstMessage *message)
+{
+  const GstStructure *s;
+
+  if (GST_MESSAGE_TYPE (message) != GST_MESSAGE_ELEMENT)
+    return FALSE;
+
+  s = gst_message_get_structure (message);
+  if (!g_str_has_prefix (gst_structure_get_name (s), "farstream-") ||
+      gst_structure_has_name (s, "farstream-error") ||
+      gst_structure_has_name (s, "farstream-batch"))
+    return FALSE;
+
+  GST_OBJECT_LOCK (self);
+  if (!self->priv->batch_messages || self->priv->disposed)
+  {
+    GST_OBJECT_UNLOCK (self);
+    return FALSE;
+  }
+
+  g_ptr_array_add (self->priv->batch, message);
+  if (!self->priv->batch_idle_id)
+  {
+    self->priv->batch_idle = g_slice_new (struct BatchIdle);
+    self->priv->batch_idle->self = self;
+    self->priv->batch_idle_id = g_idle_add_full (G_PRIORITY_DEFAULT,
+        fs_rtp_conference_post_batch, self->priv->batch_idle,
+        batch_idle_free);
+  }
+  GST_OBJECT_UNLOCK (self);
+
+  return TRUE;
+}
+
+/**
+ * fs_rtp_conference_post_message:
+ * @self: a #FsRtpConference
+ * @message: (transfer full): a #GstMessage from the conference
+ *
+ * Posts a message from the conference, or adds it to the next
+ * "farstream-batch" message if the #FsRtpConference:batch-messages property
+ * is set.
+ */
+
+void
+fs_rtp_conference_post_message (FsRtpConference *self, GstMessage *message)
+{
+  if (!fs_rtp_conference_batch_message (self, message))
+    gst_element_post_message (GST_ELEMENT (self), message);
+}
+
 static GstStateChangeReturn
 fs_rtp_conference_change_state (GstElement *element, GstStateChange transition)
 {
@@ -735,6 +966,14 @@ fs_rtp_conference_change_state (GstElement *element, GstStateChange transition)
               transition)) == GST_STATE_CHANGE_FAILURE)
     goto failure;
 
+  switch (transition) {
+    case GST_STATE_CHANGE_READY_TO_NULL:
+      fs_rtp_conference_flush_batch (self);
+      break;
+    default:
+      break;
+  }
+
   return result;
 
  failure:
@@ -857,6 +1096,24 @@ _rtpbin_on_ssrc_validated (GstElement *rtpbin,
   }
 }
 
+static void
+_rtpbin_on_ssrc_sdes (GstElement *rtpbin,
+    guint session_id,
+    guint ssrc,
+    gpointer user_data)
+{
+  FsRtpConference *self = FS_RTP_CONFERENCE (user_data);
+  FsRtpSession *session =
+    fs_rtp_conference_get_session_by_id (self, session_id);
+
+  if (session)
+  {
+    fs_rtp_session_ssrc_sdes (session, ssrc);
+
+    g_object_unref (session);
+  }
+}
+
 gboolean
 fs_rtp_conference_is_internal_thread (FsRtpConference *self)
 {
@@ -79,6 +79,9 @@ GstCaps *fs_codec_to_gst_caps_with_ptime (const FsCodec *codec);
 
 gboolean fs_rtp_conference_is_internal_thread (FsRtpConference *self);
 
+void fs_rtp_conference_post_message (FsRtpConference *self,
+    GstMessage *message);
+
 G_END_DECLS
 
 #endif /* __FS_RTP_CONFERENCE_H__ */
@@ -29,6 +29,8 @@
 
 #include "fs-rtp-packet-modder.h"
 
+#include <farstream/fs-trace.h>
+
 GST_DEBUG_CATEGORY_STATIC (fs_rtp_packet_modder_debug);
 #define GST_CAT_DEFAULT fs_rtp_packet_modder_debug
 
@@ -163,7 +165,9 @@ fs_rtp_packet_modder_sync_to_clock (FsRtpPacketModder *self,
     self->unscheduled = FALSE;
     GST_OBJECT_UNLOCK (self);
 
+    FS_TRACE (FS_TRACE_MODDER_WAIT_BEGIN, self, running_time);
     clockret = gst_clock_id_wait (id, NULL);
+    FS_TRACE (FS_TRACE_MODDER_WAIT_END, self, clockret);
 
     GST_OBJECT_LOCK (self);
     gst_clock_id_unref (id);
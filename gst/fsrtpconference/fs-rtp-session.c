@@ -67,6 +67,8 @@
 
 #include <farstream/fs-transmitter.h>
 #include "farstream/fs-utils.h"
+#include "farstream/fs-trace.h"
+#include <farstream/fs-element-added-notifier.h>
 #include <farstream/fs-rtp.h>
 
 #include "fs-rtp-bitrate-adapter.h"
@@ -77,6 +79,7 @@
 #include "fs-rtp-substream.h"
 #include "fs-rtp-special-source.h"
 #include "fs-rtp-codec-specific.h"
+#include "fs-rtp-codec-cache.h"
 #include "fs-rtp-tfrc.h"
 
 #define GST_CAT_DEFAULT fsrtpconference_debug
@@ -109,6 +112,49 @@ enum
 
 #define DEFAULT_NO_RTCP_TIMEOUT (7000)
 
+/* Maximum time the codec config discovery can take, after that we stop it
+ * and only get the config from the real send pipeline */
+#define DISCOVERY_TIMEOUT (10 * GST_SECOND)
+
+/*
+ * The discovery timeout does not hold a reference to the session, it only
+ * points to it until it is unscheduled, under the discovery_timeout_mutex.
+ */
+
+struct DiscoveryTimeout {
+  FsRtpSession *session;
+};
+
+static GStaticMutex discovery_timeout_mutex = G_STATIC_MUTEX_INIT;
+
+/*
+ * Locking:
+ *
+ * The session state is split in a few independently locked domains:
+ *  - The session mutex (FS_RTP_SESSION_LOCK) protects the codecs and their
+ *    negotiation, the list of streams, the cname index and the free
+ *    substreams. It is shared with the streams and substreams.
+ *  - The ssrc mutex protects the SSRC to stream maps, so that the per packet
+ *    association path never waits behind codec negotiation.
+ *  - The transmitters mutex protects the table of transmitters.
+ *  - The send and discovery pad blocked mutexes serialise changes to the
+ *    send and discovery pipelines.
+ *
+ * The ssrc and transmitters mutexes are leaf locks: they may be taken while
+ * holding the session mutex, but nothing else may be taken while holding
+ * them, in particular not the session mutex.
+ */
+
+#define FS_RTP_SESSION_SSRC_LOCK(session) \
+  g_mutex_lock ((session)->priv->ssrc_mutex)
+#define FS_RTP_SESSION_SSRC_UNLOCK(session) \
+  g_mutex_unlock ((session)->priv->ssrc_mutex)
+
+#define FS_RTP_SESSION_TRANSMITTERS_LOCK(session) \
+  g_mutex_lock ((session)->priv->transmitters_mutex)
+#define FS_RTP_SESSION_TRANSMITTERS_UNLOCK(session) \
+  g_mutex_unlock ((session)->priv->transmitters_mutex)
+
 struct _FsRtpSessionPrivate
 {
   FsMediaType media_type;
@@ -116,7 +162,9 @@ struct _FsRtpSessionPrivate
   /* We hold a ref to this, needs the lock to access it */
   FsRtpConference *conference;
 
+  /* Protected by the transmitters mutex */
   GHashTable *transmitters;
+  GMutex *transmitters_mutex;
 
   /* We keep references to these elements
    */
@@ -155,6 +203,9 @@ struct _FsRtpSessionPrivate
   GstElement *discovery_codecbin;
   /* This one is protected by the session lock */
   FsCodec *discovery_codec;
+  /* Protected by the session mutex */
+  GstClockID discovery_timeout_id;
+  struct DiscoveryTimeout *discovery_timeout;
 
   /* Request pad to release on dispose */
   GstPad *rtpbin_send_rtp_sink;
@@ -172,12 +223,23 @@ struct _FsRtpSessionPrivate
   GstElement *send_codecbin;
   GList *extra_send_capsfilters;
 
-  /* These lists are protected by the session mutex */
+  /* These are protected by the session mutex */
   GList *streams;
   guint streams_cookie;
-  GList *free_substreams;
   guint streams_sending;
 
+  /* ht of cname -> GQueue of the streams with that cname, in the order of
+   * the streams list, the first one wins. stream_cnames is the reverse
+   * mapping, so that the cname of a stream that is gone can be found.
+   * They are protected by the session mutex */
+  GHashTable *cname_streams;
+  GHashTable *stream_cnames;
+
+  /* ht of ssrc -> GList of substreams not yet associated with a stream,
+   * the list holds a reference to each substream
+   * It is protected by the session mutex */
+  GHashTable *free_substreams;
+
   /* The static list of all the blueprints */
   GList *blueprints;
 
@@ -199,9 +261,10 @@ struct _FsRtpSessionPrivate
   GList *extra_sources;
 
   /* This is a ht of ssrc->streams
-   * It is protected by the session mutex */
+   * It is protected by the ssrc mutex */
   GHashTable *ssrc_streams;
   GHashTable *ssrc_streams_manual;
+  GMutex *ssrc_mutex;
 
   GError *construction_error;
 
@@ -309,6 +372,15 @@ fs_rtp_session_stop_codec_param_gathering_unlock (FsRtpSession *session);
 static void
 fs_rtp_session_associate_free_substreams (FsRtpSession *session,
     FsRtpStream *stream, guint32 ssrc);
+static void
+fs_rtp_session_free_substreams_foreach_locked (FsRtpSession *session,
+    GFunc func, gpointer user_data);
+static void
+fs_rtp_session_add_free_substream_locked (FsRtpSession *session,
+    FsRtpSubStream *substream);
+static gboolean
+fs_rtp_session_remove_free_substream_locked (FsRtpSession *session,
+    FsRtpSubStream *substream);
 
 static void
 _send_caps_changed (GstPad *pad, GParamSpec *pspec, FsRtpSession *session);
@@ -429,6 +501,8 @@ fs_rtp_session_init (FsRtpSession *self)
     g_free, g_object_unref);
 
   self->mutex = g_mutex_new ();
+  self->priv->ssrc_mutex = g_mutex_new ();
+  self->priv->transmitters_mutex = g_mutex_new ();
 
   self->priv->send_pad_blocked_mutex = g_mutex_new ();
   self->priv->discovery_pad_blocked_mutex = g_mutex_new ();
@@ -441,6 +515,12 @@ fs_rtp_session_init (FsRtpSession *self)
   self->priv->ssrc_streams = g_hash_table_new (g_direct_hash, g_direct_equal);
   self->priv->ssrc_streams_manual = g_hash_table_new (g_direct_hash,
       g_direct_equal);
+  self->priv->cname_streams = g_hash_table_new_full (g_str_hash, g_str_equal,
+      g_free, (GDestroyNotify) g_queue_free);
+  self->priv->stream_cnames = g_hash_table_new_full (g_direct_hash,
+      g_direct_equal, NULL, g_free);
+  self->priv->free_substreams = g_hash_table_new_full (g_direct_hash,
+      g_direct_equal, NULL, (GDestroyNotify) g_list_free);
 
   g_queue_init (&self->priv->telephony_events);
 }
@@ -643,9 +723,8 @@ fs_rtp_session_dispose (GObject *obj)
 
 
   /* Now the recv pipeline */
-  if (self->priv->free_substreams)
-    g_list_foreach (self->priv->free_substreams, (GFunc) fs_rtp_sub_stream_stop,
-      NULL);
+  fs_rtp_session_free_substreams_foreach_locked (self,
+      (GFunc) fs_rtp_sub_stream_stop, NULL);
   if (self->priv->rtpbin_recv_rtp_sink)
     gst_pad_set_active (self->priv->rtpbin_recv_rtp_sink, FALSE);
   if (self->priv->rtpbin_recv_rtcp_sink)
@@ -718,12 +797,9 @@ fs_rtp_session_dispose (GObject *obj)
       self);
   }
 
-  if (self->priv->free_substreams)
-  {
-    g_list_foreach (self->priv->free_substreams, (GFunc) g_object_unref, NULL);
-    g_list_free (self->priv->free_substreams);
-    self->priv->free_substreams = NULL;
-  }
+  fs_rtp_session_free_substreams_foreach_locked (self,
+      (GFunc) g_object_unref, NULL);
+  g_hash_table_remove_all (self->priv->free_substreams);
 
 
   if (self->priv->conference)
@@ -742,8 +818,12 @@ fs_rtp_session_dispose (GObject *obj)
   g_list_free (self->priv->streams);
   self->priv->streams = NULL;
   self->priv->streams_cookie++;
+  g_hash_table_remove_all (self->priv->cname_streams);
+  g_hash_table_remove_all (self->priv->stream_cnames);
+  FS_RTP_SESSION_SSRC_LOCK (self);
   g_hash_table_remove_all (self->priv->ssrc_streams);
   g_hash_table_remove_all (self->priv->ssrc_streams_manual);
+  FS_RTP_SESSION_SSRC_UNLOCK (self);
 
   if (self->priv->transmitters)
   {
@@ -761,6 +841,8 @@ fs_rtp_session_finalize (GObject *object)
 
   g_mutex_free (self->mutex);
   self->mutex = NULL;
+  g_mutex_free (self->priv->ssrc_mutex);
+  g_mutex_free (self->priv->transmitters_mutex);
 
   if (self->priv->blueprints)
   {
@@ -784,6 +866,12 @@ fs_rtp_session_finalize (GObject *object)
     g_hash_table_destroy (self->priv->ssrc_streams);
   if (self->priv->ssrc_streams_manual)
     g_hash_table_destroy (self->priv->ssrc_streams_manual);
+  if (self->priv->cname_streams)
+    g_hash_table_destroy (self->priv->cname_streams);
+  if (self->priv->stream_cnames)
+    g_hash_table_destroy (self->priv->stream_cnames);
+  if (self->priv->free_substreams)
+    g_hash_table_destroy (self->priv->free_substreams);
 
   g_mutex_free (self->priv->send_pad_blocked_mutex);
   g_mutex_free (self->priv->discovery_pad_blocked_mutex);
@@ -964,8 +1052,10 @@ fs_rtp_session_set_property (GObject *object,
     case PROP_TOS:
       FS_RTP_SESSION_LOCK (self);
       self->priv->tos = g_value_get_uint (value);
+      FS_RTP_SESSION_TRANSMITTERS_LOCK (self);
       g_hash_table_foreach (self->priv->transmitters, set_tos,
           GUINT_TO_POINTER (self->priv->tos));
+      FS_RTP_SESSION_TRANSMITTERS_UNLOCK (self);
       FS_RTP_SESSION_UNLOCK (self);
       break;
     case PROP_SEND_BITRATE:
@@ -1009,7 +1099,7 @@ static void
 _rtp_bitrate_adapter_renegotiate (GstElement *bitrate_adapter,
     FsRtpSession *self)
 {
-  gst_element_post_message (GST_ELEMENT (self->priv->conference),
+  fs_rtp_conference_post_message (self->priv->conference,
       gst_message_new_element (GST_OBJECT (self->priv->conference),
           gst_structure_new ("farstream-renegotiate",
               "session", FS_TYPE_SESSION, self,
@@ -1597,7 +1687,7 @@ _stream_known_source_packet_received (FsRtpStream *stream, guint component,
 
  ok:
 
-  FS_RTP_SESSION_LOCK (self);
+  FS_RTP_SESSION_SSRC_LOCK (self);
 
   if (!g_hash_table_lookup (self->priv->ssrc_streams,  GUINT_TO_POINTER (ssrc)))
   {
@@ -1605,16 +1695,155 @@ _stream_known_source_packet_received (FsRtpStream *stream, guint component,
     g_hash_table_insert (self->priv->ssrc_streams, GUINT_TO_POINTER (ssrc),
         stream);
 
-    FS_RTP_SESSION_UNLOCK (self);
+    FS_RTP_SESSION_SSRC_UNLOCK (self);
 
     fs_rtp_session_associate_free_substreams (self, stream, ssrc);
   }
   else
   {
-    FS_RTP_SESSION_UNLOCK (self);
+    FS_RTP_SESSION_SSRC_UNLOCK (self);
+  }
+
+  fs_rtp_session_has_disposed_exit (self);
+}
+
+struct StreamSsrcs {
+  FsRtpStream *stream;
+  GArray *ssrcs;
+};
+
+static void
+_add_ssrc_of_stream (gpointer key, gpointer value, gpointer user_data)
+{
+  struct StreamSsrcs *data = user_data;
+  guint32 ssrc = GPOINTER_TO_UINT (key);
+
+  if (value == data->stream)
+    g_array_append_val (data->ssrcs, ssrc);
+}
+
+static GstStructure *
+_get_source_stats (GObject *source)
+{
+  GstStructure *stats = NULL;
+
+  if (source)
+  {
+    g_object_get (source, "stats", &stats, NULL);
+    g_object_unref (source);
   }
 
+  return stats;
+}
+
+/**
+ * fs_rtp_session_get_stream_stats:
+ * @self: a #FsRtpSession
+ * @stream: a #FsRtpStream of this session
+ *
+ * Collects the statistics kept by the rtpbin for the SSRCs associated with
+ * @stream and for our own SSRC. Nothing is counted on the media path, this
+ * only reads counters that are updated anyway.
+ *
+ * Returns: a new "stream-stats" #GstStructure or %NULL if the
+ *  session has been disposed
+ */
+GstStructure *
+fs_rtp_session_get_stream_stats (FsRtpSession *self, FsRtpStream *stream)
+{
+  GObject *internal_session;
+  GObject *source = NULL;
+  GstStructure *stats, *source_stats;
+  struct StreamSsrcs data;
+  guint64 packets_received = 0, bytes_received = 0, bitrate_received = 0;
+  guint64 packets_sent = 0, bytes_sent = 0, bitrate_sent = 0;
+  gint64 packets_lost = 0, remote_packets_lost = 0;
+  GstClockTime jitter = 0, round_trip = 0;
+  guint i;
+
+  if (fs_rtp_session_has_disposed_enter (self, NULL))
+    return NULL;
+
+  internal_session = g_object_ref (self->priv->rtpbin_internal_session);
+
+  data.stream = stream;
+  data.ssrcs = g_array_new (FALSE, FALSE, sizeof (guint32));
+  FS_RTP_SESSION_SSRC_LOCK (self);
+  g_hash_table_foreach (self->priv->ssrc_streams, _add_ssrc_of_stream, &data);
+  FS_RTP_SESSION_SSRC_UNLOCK (self);
+
   fs_rtp_session_has_disposed_exit (self);
+
+  for (i = 0; i < data.ssrcs->len; i++)
+  {
+    guint32 ssrc = g_array_index (data.ssrcs, guint32, i);
+    guint64 val64;
+    guint val;
+    gint vali;
+    gint clock_rate;
+
+    source = NULL;
+    g_signal_emit_by_name (internal_session, "get-source-by-ssrc", ssrc,
+        &source);
+    source_stats = _get_source_stats (source);
+    if (!source_stats)
+      continue;
+
+    if (gst_structure_get_uint64 (source_stats, "packets-received", &val64))
+      packets_received += val64;
+    if (gst_structure_get_uint64 (source_stats, "octets-received", &val64))
+      bytes_received += val64;
+    if (gst_structure_get_uint64 (source_stats, "bitrate", &val64))
+      bitrate_received += val64;
+
+    /* What we reported about them */
+    if (gst_structure_get_int (source_stats, "sent-rb-packetslost", &vali))
+      packets_lost += vali;
+    if (gst_structure_get_uint (source_stats, "jitter", &val) &&
+        gst_structure_get_int (source_stats, "clock-rate", &clock_rate) &&
+        clock_rate > 0)
+      jitter = MAX (jitter,
+          gst_util_uint64_scale_int (val, GST_SECOND, clock_rate));
+
+    /* What they reported about us */
+    if (gst_structure_get_int (source_stats, "rb-packetslost", &vali))
+      remote_packets_lost = MAX (remote_packets_lost, vali);
+    if (gst_structure_get_uint (source_stats, "rb-round-trip", &val))
+      round_trip = MAX (round_trip,
+          gst_util_uint64_scale_int (val, GST_SECOND, 65536));
+
+    gst_structure_free (source_stats);
+  }
+
+  g_array_free (data.ssrcs, TRUE);
+
+  source = NULL;
+  g_object_get (internal_session, "internal-source", &source, NULL);
+  source_stats = _get_source_stats (source);
+  if (source_stats)
+  {
+    gst_structure_get_uint64 (source_stats, "packets-sent", &packets_sent);
+    gst_structure_get_uint64 (source_stats, "octets-sent", &bytes_sent);
+    gst_structure_get_uint64 (source_stats, "bitrate", &bitrate_sent);
+    gst_structure_free (source_stats);
+  }
+
+  g_object_unref (internal_session);
+
+  stats = gst_structure_new ("stream-stats",
+      "packets-received", G_TYPE_UINT64, packets_received,
+      "bytes-received", G_TYPE_UINT64, bytes_received,
+      "bitrate-received", G_TYPE_UINT64, bitrate_received,
+      "packets-lost", G_TYPE_INT64, packets_lost,
+      "jitter", G_TYPE_UINT64, jitter,
+      "packets-sent", G_TYPE_UINT64, packets_sent,
+      "bytes-sent", G_TYPE_UINT64, bytes_sent,
+      "bitrate-sent", G_TYPE_UINT64, bitrate_sent,
+      "remote-packets-lost", G_TYPE_INT64, remote_packets_lost,
+      "round-trip", G_TYPE_UINT64, round_trip,
+      NULL);
+
+  return stats;
 }
 
 static void
@@ -1651,12 +1880,12 @@ _stream_ssrc_added_cb (FsRtpStream *stream, guint32 ssrc, gpointer user_data)
   if (fs_rtp_session_has_disposed_enter (self, NULL))
     return;
 
-  FS_RTP_SESSION_LOCK (self);
+  FS_RTP_SESSION_SSRC_LOCK (self);
   g_hash_table_insert (self->priv->ssrc_streams, GUINT_TO_POINTER (ssrc),
       stream);
   g_hash_table_insert (self->priv->ssrc_streams_manual, GUINT_TO_POINTER (ssrc),
       stream);
-  FS_RTP_SESSION_UNLOCK (self);
+  FS_RTP_SESSION_SSRC_UNLOCK (self);
 
   fs_rtp_session_associate_free_substreams (self, stream, ssrc);
 
@@ -1670,6 +1899,84 @@ _remove_stream_from_ht (gpointer key, gpointer value, gpointer user_data)
   return (value == user_data);
 }
 
+/*
+ * Streams are indexed in the order they are added, so the first stream in
+ * the list keeps precedence like it always had.
+ */
+
+static void
+fs_rtp_session_index_stream_cname_locked (FsRtpSession *self,
+    FsRtpStream *stream)
+{
+  gchar *cname = NULL;
+  GQueue *queue;
+
+  g_object_get (stream->participant, "cname", &cname, NULL);
+
+  if (!cname)
+    return;
+
+  queue = g_hash_table_lookup (self->priv->cname_streams, cname);
+  if (!queue)
+  {
+    queue = g_queue_new ();
+    g_hash_table_insert (self->priv->cname_streams, g_strdup (cname), queue);
+  }
+  g_queue_push_tail (queue, stream);
+
+  g_hash_table_insert (self->priv->stream_cnames, stream, cname);
+}
+
+static void
+fs_rtp_session_unindex_stream_cname_locked (FsRtpSession *self,
+    gpointer stream)
+{
+  const gchar *cname;
+  GQueue *queue;
+
+  cname = g_hash_table_lookup (self->priv->stream_cnames, stream);
+  if (!cname)
+    return;
+
+  queue = g_hash_table_lookup (self->priv->cname_streams, cname);
+  g_queue_remove (queue, stream);
+  if (g_queue_is_empty (queue))
+    g_hash_table_remove (self->priv->cname_streams, cname);
+
+  g_hash_table_remove (self->priv->stream_cnames, stream);
+}
+
+/*
+ * Rebuilds the cname index from the list of streams, this is only needed
+ * when a cname changes.
+ */
+
+static void
+fs_rtp_session_rebuild_cname_index_locked (FsRtpSession *self)
+{
+  GList *item;
+
+  g_hash_table_remove_all (self->priv->cname_streams);
+  g_hash_table_remove_all (self->priv->stream_cnames);
+
+  for (item = self->priv->streams; item; item = item->next)
+    fs_rtp_session_index_stream_cname_locked (self, item->data);
+}
+
+static void
+_participant_cname_changed (FsRtpParticipant *participant, GParamSpec *pspec,
+    FsRtpSession *self)
+{
+  if (fs_rtp_session_has_disposed_enter (self, NULL))
+    return;
+
+  FS_RTP_SESSION_LOCK (self);
+  fs_rtp_session_rebuild_cname_index_locked (self);
+  FS_RTP_SESSION_UNLOCK (self);
+
+  fs_rtp_session_has_disposed_exit (self);
+}
+
 static void
 _remove_stream (gpointer user_data,
     GObject *where_the_object_was)
@@ -1683,11 +1990,16 @@ _remove_stream (gpointer user_data,
   self->priv->streams =
     g_list_remove_all (self->priv->streams, where_the_object_was);
   self->priv->streams_cookie++;
+  fs_rtp_session_unindex_stream_cname_locked (self, where_the_object_was);
 
+  /* Still under the session lock, so that fs_rtp_session_associate_ssrc_cname()
+   * can not map a SSRC to the stream between the two */
+  FS_RTP_SESSION_SSRC_LOCK (self);
   g_hash_table_foreach_remove (self->priv->ssrc_streams, _remove_stream_from_ht,
       where_the_object_was);
   g_hash_table_foreach_remove (self->priv->ssrc_streams_manual,
       _remove_stream_from_ht, where_the_object_was);
+  FS_RTP_SESSION_SSRC_UNLOCK (self);
   FS_RTP_SESSION_UNLOCK (self);
 
   fs_rtp_session_has_disposed_exit (self);
@@ -1750,6 +2062,14 @@ fs_rtp_session_new_stream (FsSession *session,
 
     self->priv->streams = g_list_append (self->priv->streams, new_stream);
     self->priv->streams_cookie++;
+
+    fs_rtp_session_index_stream_cname_locked (self,
+        FS_RTP_STREAM (new_stream));
+    if (!g_signal_handler_find (rtpparticipant,
+            G_SIGNAL_MATCH_FUNC | G_SIGNAL_MATCH_DATA, 0, 0, NULL,
+            _participant_cname_changed, self))
+      g_signal_connect_object (rtpparticipant, "notify::cname",
+          G_CALLBACK (_participant_cname_changed), self, 0);
     FS_RTP_SESSION_UNLOCK (self);
   }
 
@@ -2111,11 +2431,7 @@ fs_rtp_session_request_pt_map (FsRtpSession *session, guint pt)
       session->priv->codec_associations, pt);
 
   if (ca)
-  {
-    FsCodec *tmpcodec = codec_copy_filtered (ca->codec, FS_PARAM_TYPE_CONFIG);
-    caps = fs_codec_to_gst_caps (tmpcodec);
-    fs_codec_destroy (tmpcodec);
-  }
+    caps = codec_association_get_pt_map_caps (ca);
 
   FS_RTP_SESSION_UNLOCK (session);
 
@@ -2195,6 +2511,48 @@ _get_recvonly_filter (FsTransmitter *transmitter, guint component,
     return NULL;
 }
 
+#ifdef FS_ENABLE_TRACING
+
+static gboolean
+_transmitter_trace_probe (GstPad *pad, GstBuffer *buffer, gpointer user_data)
+{
+  FS_TRACE (GPOINTER_TO_INT (user_data), pad, GST_BUFFER_SIZE (buffer));
+
+  return TRUE;
+}
+
+/*
+ * The packets going in and out of the transmitters are only traced if tracing
+ * was enabled when the transmitter was created, so that the buffer probes
+ * are not installed otherwise.
+ */
+
+static void
+_add_transmitter_trace_probes (GstElement *element, const gchar *padformat,
+    FsTraceEvent event)
+{
+  guint c;
+
+  if (!fs_trace_get_enabled ())
+    return;
+
+  for (c = 1; c <= 2; c++)
+  {
+    gchar *padname = g_strdup_printf (padformat, c);
+    GstPad *pad = gst_element_get_static_pad (element, padname);
+
+    if (pad)
+    {
+      gst_pad_add_buffer_probe (pad, G_CALLBACK (_transmitter_trace_probe),
+          GINT_TO_POINTER (event));
+      gst_object_unref (pad);
+    }
+    g_free (padname);
+  }
+}
+
+#endif
+
 static gboolean
 fs_rtp_session_add_transmitter_gst_sink (FsRtpSession *self,
     FsTransmitter *transmitter,
@@ -2222,6 +2580,10 @@ fs_rtp_session_add_transmitter_gst_sink (FsRtpSession *self,
       "rtcp tee", sink, "sink2", GST_PAD_SINK, error))
     goto error;
 
+#ifdef FS_ENABLE_TRACING
+  _add_transmitter_trace_probes (sink, "sink%u", FS_TRACE_TRANSMITTER_SEND);
+#endif
+
   gst_object_unref (sink);
 
   return TRUE;
@@ -2253,16 +2615,19 @@ fs_rtp_session_get_transmitter (FsRtpSession *self,
   GstElement *src = NULL;
   guint tos;
 
-  FS_RTP_SESSION_LOCK (self);
+  FS_RTP_SESSION_TRANSMITTERS_LOCK (self);
   transmitter = g_hash_table_lookup (self->priv->transmitters,
     transmitter_name);
 
   if (transmitter)
   {
     g_object_ref (transmitter);
-    FS_RTP_SESSION_UNLOCK (self);
+    FS_RTP_SESSION_TRANSMITTERS_UNLOCK (self);
     return transmitter;
   }
+  FS_RTP_SESSION_TRANSMITTERS_UNLOCK (self);
+
+  FS_RTP_SESSION_LOCK (self);
   tos = self->priv->tos;
   FS_RTP_SESSION_UNLOCK (self);
 
@@ -2296,13 +2661,17 @@ fs_rtp_session_get_transmitter (FsRtpSession *self,
       "rtcp funnel", src, "src2", GST_PAD_SRC, error))
     goto error;
 
+#ifdef FS_ENABLE_TRACING
+  _add_transmitter_trace_probes (src, "src%u", FS_TRACE_TRANSMITTER_RECV);
+#endif
+
   gst_element_sync_state_with_parent (src);
 
-  FS_RTP_SESSION_LOCK (self);
+  FS_RTP_SESSION_TRANSMITTERS_LOCK (self);
   /* Check if two were added at the same time */
   if (g_hash_table_lookup (self->priv->transmitters, transmitter_name))
   {
-    FS_RTP_SESSION_UNLOCK (self);
+    FS_RTP_SESSION_TRANSMITTERS_UNLOCK (self);
 
     gst_element_set_locked_state (src, TRUE);
     gst_element_set_state (src, GST_STATE_NULL);
@@ -2313,7 +2682,7 @@ fs_rtp_session_get_transmitter (FsRtpSession *self,
 
   g_hash_table_insert (self->priv->transmitters, g_strdup (transmitter_name),
       transmitter);
-  FS_RTP_SESSION_UNLOCK (self);
+  FS_RTP_SESSION_TRANSMITTERS_UNLOCK (self);
 
   gst_object_unref (src);
 
@@ -2384,11 +2753,13 @@ fs_rtp_session_get_stream_by_ssrc_locked (FsRtpSession *self,
 {
   FsRtpStream *stream = NULL;
 
+  FS_RTP_SESSION_SSRC_LOCK (self);
   stream = g_hash_table_lookup (self->priv->ssrc_streams,
       GUINT_TO_POINTER (ssrc));
 
   if (stream)
     g_object_ref (stream);
+  FS_RTP_SESSION_SSRC_UNLOCK (self);
 
   return stream;
 }
@@ -2397,20 +2768,21 @@ fs_rtp_session_get_stream_by_ssrc_locked (FsRtpSession *self,
 /**
  * fs_rtp_session_verify_recv_codecs_locked
  * @session: A #FsRtpSession
+ * @only_stream: If not %NULL, only verify the substreams of this #FsRtpStream
  *
  * Verifies that the various substreams still have the right codec, otherwise
  * re-sets it.
  */
 
 static void
-fs_rtp_session_verify_recv_codecs_locked (FsRtpSession *session)
+fs_rtp_session_verify_recv_codecs_locked (FsRtpSession *session,
+    FsRtpStream *only_stream)
 {
   GList *item, *item2;
 
-  for (item = g_list_first (session->priv->free_substreams);
-       item;
-       item = g_list_next (item))
-    fs_rtp_sub_stream_verify_codec_locked (item->data);
+  if (!only_stream)
+    fs_rtp_session_free_substreams_foreach_locked (session,
+        (GFunc) fs_rtp_sub_stream_verify_codec_locked, NULL);
 
   for (item = g_list_first (session->priv->streams);
        item;
@@ -2418,6 +2790,9 @@ fs_rtp_session_verify_recv_codecs_locked (FsRtpSession *session)
   {
     FsRtpStream *stream = item->data;
 
+    if (only_stream && stream != only_stream)
+      continue;
+
     for (item2 = g_list_first (stream->substreams);
          item2;
          item2 = g_list_next (item2))
@@ -2431,19 +2806,23 @@ fs_rtp_session_verify_recv_codecs_locked (FsRtpSession *session)
  * @session: a #FsRtpSession
  * @force_stream: The #FsRtpStream to which the new remote codecs belong
  * @forced_remote_codecs: The #GList of remote codecs to use for that stream
+ * @only_force_stream: If %TRUE, only update @force_stream
  *
  * This function distributes the codecs to the streams including their
  * own config data.
  *
  * If a stream is specified, it will use the specified remote codecs
- * instead of the ones currently in the stream.
+ * instead of the ones currently in the stream. If the codec associations
+ * have not changed, the other streams already have the right codecs and
+ * @only_force_stream can be set to skip them.
  */
 
 
 static void
 fs_rtp_session_distribute_recv_codecs_locked (FsRtpSession *session,
     FsRtpStream *force_stream,
-    GList *forced_remote_codecs)
+    GList *forced_remote_codecs,
+    gboolean only_force_stream)
 {
   GList *item = NULL;
   guint cookie;
@@ -2461,6 +2840,8 @@ fs_rtp_session_distribute_recv_codecs_locked (FsRtpSession *session,
 
     if (stream == force_stream)
       remote_codecs = forced_remote_codecs;
+    else if (only_force_stream)
+      continue;
     else
       remote_codecs = stream->remote_codecs;
 
@@ -2562,6 +2943,7 @@ fs_rtp_session_negotiate_codecs_locked (FsRtpSession *session,
   GList *item;
   guint8 hdrext_used_ids[8];
   GList *new_hdrexts = NULL;
+  gchar *settings;
 
   *has_remotes = FALSE;
 
@@ -2650,6 +3032,25 @@ fs_rtp_session_negotiate_codecs_locked (FsRtpSession *session,
   fs_rtp_tfrc_filter_codecs (&new_negotiated_codec_associations,
       &new_hdrexts);
 
+  /* Re-use the config found by an earlier discovery of the same encoder
+   * with the same settings */
+  settings = fs_element_added_notifier_get_settings_id (
+      GST_ELEMENT (session->priv->conference));
+  for (item = new_negotiated_codec_associations; item; item = item->next)
+  {
+    CodecAssociation *ca = item->data;
+
+    if (ca->need_config &&
+        codec_config_cache_lookup (ca->blueprint, ca->send_profile, settings,
+            ca->codec))
+    {
+      ca->need_config = codec_needs_config (ca->codec);
+      GST_DEBUG ("Got config for %d/%s from the cache", ca->codec->id,
+          ca->codec->encoding_name);
+    }
+  }
+  g_free (settings);
+
   if (session->priv->codec_associations)
     *is_new = ! codec_associations_list_are_equal (
       session->priv->codec_associations, new_negotiated_codec_associations);
@@ -2684,6 +3085,10 @@ fs_rtp_session_negotiate_codecs_locked (FsRtpSession *session,
  * If a stream is specified, it will use the specified remote codecs
  * instead of the ones currently in the stream
  *
+ * If the resulting codec associations are the same as the previous ones,
+ * only the streams whose remote codecs changed are updated, the other streams
+ * and the send codec are left alone.
+ *
  * MT safe
  *
  * Returns: TRUE if the negotiation succeeds, FALSE otherwise
@@ -2697,24 +3102,69 @@ fs_rtp_session_update_codecs (FsRtpSession *session,
 {
   gboolean is_new = TRUE;
   gboolean has_remotes = FALSE;
+  gboolean had_remotes = FALSE;
+  gboolean had_send_codec;
+  GList *item;
 
   FS_RTP_SESSION_LOCK (session);
 
+  /* Re-offering the same codecs can not change the result of the
+   * negotiation */
+  if (stream && stream->remote_codecs && remote_codecs &&
+      fs_codec_list_are_equal (stream->remote_codecs, remote_codecs))
+  {
+    GST_DEBUG ("Stream %p re-offered the same codecs, nothing to renegotiate",
+        stream);
+    FS_RTP_SESSION_UNLOCK (session);
+    return TRUE;
+  }
+
+  for (item = session->priv->streams; item; item = item->next)
+  {
+    FsRtpStream *mystream = item->data;
+
+    if (mystream->remote_codecs)
+    {
+      had_remotes = TRUE;
+      break;
+    }
+  }
+  had_send_codec = (session->priv->current_send_codec != NULL);
+
+  FS_TRACE (FS_TRACE_NEGOTIATION_BEGIN, session,
+      g_list_length (remote_codecs));
   if (!fs_rtp_session_negotiate_codecs_locked (
         session, stream, remote_codecs, &has_remotes, &is_new, error))
   {
+    FS_TRACE (FS_TRACE_NEGOTIATION_END, session, FALSE);
     FS_RTP_SESSION_UNLOCK (session);
     return FALSE;
   }
+  FS_TRACE (FS_TRACE_NEGOTIATION_END, session, TRUE);
 
   if (session->priv->rtp_tfrc)
     fs_rtp_tfrc_codecs_updated (session->priv->rtp_tfrc,
         session->priv->codec_associations,
         session->priv->hdrext_negotiated);
 
-  fs_rtp_session_distribute_recv_codecs_locked (session, stream, remote_codecs);
-
-  fs_rtp_session_verify_recv_codecs_locked (session);
+  FS_TRACE (FS_TRACE_DISTRIBUTE_BEGIN, session, 0);
+  if (!is_new && stream)
+  {
+    /* The codec associations did not change, so only the stream that got
+     * new remote codecs (and its substreams) needs to be updated */
+    GST_DEBUG ("Codec associations unchanged, only updating stream %p",
+        stream);
+    fs_rtp_session_distribute_recv_codecs_locked (session, stream,
+        remote_codecs, TRUE);
+    fs_rtp_session_verify_recv_codecs_locked (session, stream);
+  }
+  else
+  {
+    fs_rtp_session_distribute_recv_codecs_locked (session, stream,
+        remote_codecs, FALSE);
+    fs_rtp_session_verify_recv_codecs_locked (session, NULL);
+  }
+  FS_TRACE (FS_TRACE_DISTRIBUTE_END, session, 0);
 
   if (is_new)
     g_signal_emit_by_name (session->priv->conference->gstrtpbin,
@@ -2724,7 +3174,9 @@ fs_rtp_session_update_codecs (FsRtpSession *session,
 
   FS_RTP_SESSION_UNLOCK (session);
 
-  if (has_remotes)
+  /* The send codec is only selected from the codec associations, so it can
+   * only change if they did */
+  if (has_remotes && (is_new || !had_remotes || !had_send_codec))
   {
     fs_rtp_session_verify_send_codec_bin (session);
   }
@@ -2734,7 +3186,7 @@ fs_rtp_session_update_codecs (FsRtpSession *session,
     g_object_notify (G_OBJECT (session), "codecs");
     g_object_notify (G_OBJECT (session), "codecs-without-config");
 
-    gst_element_post_message (GST_ELEMENT (session->priv->conference),
+    fs_rtp_conference_post_message (session->priv->conference,
         gst_message_new_element (GST_OBJECT (session->priv->conference),
             gst_structure_new ("farstream-codecs-changed",
                 "session", FS_TYPE_SESSION, session,
@@ -2779,6 +3231,8 @@ fs_rtp_session_update_minimum_rtcp_interval (FsRtpSession *self,
 {
   guint min_interval = 5000;
   GList *item, *item2;
+  GHashTableIter iter;
+  gpointer value;
 
   FS_RTP_SESSION_LOCK (self);
 
@@ -2786,16 +3240,20 @@ fs_rtp_session_update_minimum_rtcp_interval (FsRtpSession *self,
     min_interval = MIN (min_interval,
         self->priv->current_send_codec->minimum_reporting_interval);
 
-  for (item = self->priv->free_substreams; item; item = item->next)
+  g_hash_table_iter_init (&iter, self->priv->free_substreams);
+  while (g_hash_table_iter_next (&iter, NULL, &value))
   {
-    FsRtpSubStream *substream = item->data;
+    for (item = value; item; item = item->next)
+    {
+      FsRtpSubStream *substream = item->data;
 
-    if (substream == skip_substream)
-      continue;
+      if (substream == skip_substream)
+        continue;
 
-    if (substream->codec)
-      min_interval = MIN (min_interval,
-          substream->codec->minimum_reporting_interval);
+      if (substream->codec)
+        min_interval = MIN (min_interval,
+            substream->codec->minimum_reporting_interval);
+    }
   }
 
   for (item2 = self->priv->streams; item2; item2 = item2->next)
@@ -2834,10 +3292,8 @@ _substream_unlinked (FsRtpSubStream *substream, gpointer user_data)
 
   FS_RTP_SESSION_LOCK (self);
 
-  if (g_list_find (self->priv->free_substreams, substream))
+  if (fs_rtp_session_remove_free_substream_locked (self, substream))
   {
-    self->priv->free_substreams = g_list_remove (self->priv->free_substreams,
-        substream);
     FS_RTP_SESSION_UNLOCK (self);
 
     fs_rtp_sub_stream_stop (substream);
@@ -2938,8 +3394,7 @@ fs_rtp_session_new_recv_pad (FsRtpSession *session, GstPad *new_pad,
     }
     else
     {
-      session->priv->free_substreams =
-        g_list_prepend (session->priv->free_substreams, substream);
+      fs_rtp_session_add_free_substream_locked (session, substream);
 
       g_signal_connect_object (substream, "error",
           G_CALLBACK (_substream_error), session, 0);
@@ -3747,6 +4202,7 @@ fs_rtp_session_add_send_codec_bin_unlock (FsRtpSession *session,
   }
 
   session->priv->send_codecbin = codecbin;
+  FS_TRACE (FS_TRACE_SEND_CODEC_BIN_SWITCH, session, ca->send_codec->id);
 
   session->priv->current_send_codec = codec_copy;
   FS_RTP_SESSION_UNLOCK (session);
@@ -3796,6 +4252,7 @@ _send_src_pad_blocked_callback (GstPad *pad, gboolean blocked,
   }
 
   g_mutex_lock (self->priv->send_pad_blocked_mutex);
+  FS_TRACE (FS_TRACE_SEND_CODEC_BEGIN, self, 0);
 
   FS_RTP_SESSION_LOCK (self);
   ca = fs_rtp_session_select_send_codec_locked (self, &error);
@@ -3889,7 +4346,7 @@ _send_src_pad_blocked_callback (GstPad *pad, gboolean blocked,
     secondary_codecs = g_list_concat (secondary_codecs, other_codecs);
 
     g_object_notify (G_OBJECT (self), "current-send-codec");
-    gst_element_post_message (GST_ELEMENT (self->priv->conference),
+    fs_rtp_conference_post_message (self->priv->conference,
         gst_message_new_element (GST_OBJECT (self->priv->conference),
             gst_structure_new ("farstream-send-codec-changed",
                 "session", FS_TYPE_SESSION, self,
@@ -3914,6 +4371,7 @@ _send_src_pad_blocked_callback (GstPad *pad, gboolean blocked,
 
   gst_pad_set_blocked_async (pad, FALSE, pad_block_do_nothing, NULL);
 
+  FS_TRACE (FS_TRACE_SEND_CODEC_END, self, changed);
   g_mutex_unlock (self->priv->send_pad_blocked_mutex);
   fs_rtp_session_has_disposed_exit (self);
   return;
@@ -3983,6 +4441,71 @@ _substream_get_codec_bin (FsRtpSubStream *substream,
   return codecbin;
 }
 
+static void
+fs_rtp_session_free_substreams_foreach_locked (FsRtpSession *session,
+    GFunc func, gpointer user_data)
+{
+  GHashTableIter iter;
+  gpointer value;
+
+  g_hash_table_iter_init (&iter, session->priv->free_substreams);
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    g_list_foreach (value, func, user_data);
+}
+
+static void
+fs_rtp_session_add_free_substream_locked (FsRtpSession *session,
+    FsRtpSubStream *substream)
+{
+  gpointer key = GUINT_TO_POINTER (substream->ssrc);
+  GList *list = g_hash_table_lookup (session->priv->free_substreams, key);
+
+  /* Appending to a non-empty list keeps the same head */
+  if (list)
+    g_list_append (list, substream);
+  else
+    g_hash_table_insert (session->priv->free_substreams, key,
+        g_list_append (NULL, substream));
+}
+
+static gboolean
+fs_rtp_session_remove_free_substream_locked (FsRtpSession *session,
+    FsRtpSubStream *substream)
+{
+  gpointer key = GUINT_TO_POINTER (substream->ssrc);
+  GList *list = g_hash_table_lookup (session->priv->free_substreams, key);
+  GList *link = g_list_find (list, substream);
+
+  if (!link)
+    return FALSE;
+
+  g_hash_table_steal (session->priv->free_substreams, key);
+  list = g_list_delete_link (list, link);
+  if (list)
+    g_hash_table_insert (session->priv->free_substreams, key, list);
+
+  return TRUE;
+}
+
+static FsRtpSubStream *
+fs_rtp_session_pop_free_substream_locked (FsRtpSession *session, guint32 ssrc)
+{
+  gpointer key = GUINT_TO_POINTER (ssrc);
+  GList *list = g_hash_table_lookup (session->priv->free_substreams, key);
+  FsRtpSubStream *substream;
+
+  if (!list)
+    return NULL;
+
+  substream = list->data;
+  g_hash_table_steal (session->priv->free_substreams, key);
+  list = g_list_delete_link (list, list);
+  if (list)
+    g_hash_table_insert (session->priv->free_substreams, key, list);
+
+  return substream;
+}
+
 static void
 fs_rtp_session_associate_free_substreams (FsRtpSession *session,
     FsRtpStream *stream, guint32 ssrc)
@@ -3994,25 +4517,9 @@ fs_rtp_session_associate_free_substreams (FsRtpSession *session,
   for (;;)
   {
     FsRtpSubStream *substream = NULL;
-    GList *item = NULL;
     GError *error = NULL;
 
-    for (item = g_list_first (session->priv->free_substreams);
-         item;
-         item = g_list_next (item))
-    {
-      FsRtpSubStream *localsubstream = item->data;
-
-      GST_LOG ("Have substream with ssrc %x, looking for %x",
-          localsubstream->ssrc, ssrc);
-      if (ssrc == localsubstream->ssrc)
-      {
-        substream = localsubstream;
-        session->priv->free_substreams = g_list_delete_link (
-            session->priv->free_substreams, item);
-        break;
-      }
-    }
+    substream = fs_rtp_session_pop_free_substream_locked (session, ssrc);
 
     if (!substream)
       break;
@@ -4054,61 +4561,97 @@ fs_rtp_session_associate_ssrc_cname (FsRtpSession *session,
     const gchar *cname)
 {
   FsRtpStream *stream = NULL;
-  GList *item = NULL;
+  gboolean has_free_substreams;
+  GQueue *queue;
 
   if (fs_rtp_session_has_disposed_enter (session, NULL))
     return;
 
   FS_RTP_SESSION_LOCK (session);
 
-  if (!session->priv->free_substreams)
-  {
-    FS_RTP_SESSION_UNLOCK (session);
-    fs_rtp_session_has_disposed_exit (session);
-    return;
-  }
-
-  for (item = g_list_first (session->priv->streams);
-       item;
-       item = g_list_next (item))
-  {
-    FsRtpStream *localstream = item->data;
-    gchar *localcname = NULL;
-
-    g_object_get (localstream->participant, "cname", &localcname, NULL);
-
-    if (localcname && !strcmp (localcname, cname))
-    {
-      stream = localstream;
-      g_free (localcname);
-      break;
-    }
-    g_free (localcname);
-  }
+  queue = g_hash_table_lookup (session->priv->cname_streams, cname);
+  if (queue)
+    stream = g_queue_peek_head (queue);
 
   if (!stream)
   {
-    GST_LOG ("There is no participant with cname %s, but"
-        " we have streams of unknown origin", cname);
+    GST_LOG ("There is no participant with cname %s", cname);
     FS_RTP_SESSION_UNLOCK (session);
     fs_rtp_session_has_disposed_exit (session);
     return;
   }
 
+  /* Remember the association even if there are no substreams waiting yet,
+   * so that substreams created later are given to the stream directly */
+  FS_RTP_SESSION_SSRC_LOCK (session);
   if (!g_hash_table_lookup (session->priv->ssrc_streams,
           GUINT_TO_POINTER (ssrc)))
     g_hash_table_insert (session->priv->ssrc_streams, GUINT_TO_POINTER (ssrc),
         stream);
+  FS_RTP_SESSION_SSRC_UNLOCK (session);
+
+  has_free_substreams = (g_hash_table_lookup (session->priv->free_substreams,
+          GUINT_TO_POINTER (ssrc)) != NULL);
 
   g_object_ref (stream);
   FS_RTP_SESSION_UNLOCK (session);
 
-  fs_rtp_session_associate_free_substreams (session, stream, ssrc);
+  if (has_free_substreams)
+    fs_rtp_session_associate_free_substreams (session, stream, ssrc);
   g_object_unref (stream);
 
   fs_rtp_session_has_disposed_exit (session);
 }
 
+/**
+ * fs_rtp_session_ssrc_sdes:
+ * @session: a #FsRtpSession
+ * @ssrc: The ssrc
+ *
+ * This function is called every time SDES is received for @ssrc, it gets
+ * the CNAME from the rtpbin's source and associates the SSRC with the stream
+ * of the participant with that CNAME. Once a SSRC is associated, the
+ * following SDES packets are ignored.
+ */
+void
+fs_rtp_session_ssrc_sdes (FsRtpSession *session,
+    guint32 ssrc)
+{
+  GObject *source = NULL;
+  GstStructure *sdes = NULL;
+  gboolean associated;
+  const gchar *cname;
+
+  if (fs_rtp_session_has_disposed_enter (session, NULL))
+    return;
+
+  FS_RTP_SESSION_SSRC_LOCK (session);
+  associated = (g_hash_table_lookup (session->priv->ssrc_streams,
+          GUINT_TO_POINTER (ssrc)) != NULL);
+  FS_RTP_SESSION_SSRC_UNLOCK (session);
+
+  if (!associated)
+    g_signal_emit_by_name (session->priv->rtpbin_internal_session,
+        "get-source-by-ssrc", ssrc, &source);
+
+  fs_rtp_session_has_disposed_exit (session);
+
+  if (!source)
+    return;
+
+  g_object_get (source, "sdes", &sdes, NULL);
+  g_object_unref (source);
+
+  if (!sdes)
+    return;
+
+  cname = gst_structure_get_string (sdes, "cname");
+  if (cname)
+    fs_rtp_session_associate_ssrc_cname (session, ssrc, cname);
+
+  gst_structure_free (sdes);
+}
+
 static void
 _substream_no_rtcp_timedout_cb (FsRtpSubStream *substream,
     FsRtpSession *session)
@@ -4132,7 +4675,7 @@ _substream_no_rtcp_timedout_cb (FsRtpSubStream *substream,
     return;
   }
 
-  if (!g_list_find (session->priv->free_substreams, substream))
+  if (!fs_rtp_session_remove_free_substream_locked (session, substream))
   {
     GST_WARNING ("Could not find substream %p in the list of free substreams",
         substream);
@@ -4141,10 +4684,6 @@ _substream_no_rtcp_timedout_cb (FsRtpSubStream *substream,
     return;
   }
 
-  session->priv->free_substreams =
-    g_list_remove (session->priv->free_substreams,
-        substream);
-
   while (
       g_signal_handlers_disconnect_by_func (substream, "error", session) > 0);
   while (
@@ -4183,11 +4722,11 @@ fs_rtp_session_bye_ssrc (FsRtpSession *session,
 
   /* First remove it from the known SSRCs */
 
-  FS_RTP_SESSION_LOCK (session);
+  FS_RTP_SESSION_SSRC_LOCK (session);
   if (!g_hash_table_lookup (session->priv->ssrc_streams_manual,
           GUINT_TO_POINTER (ssrc)))
     g_hash_table_remove (session->priv->ssrc_streams, GUINT_TO_POINTER (ssrc));
-  FS_RTP_SESSION_UNLOCK (session);
+  FS_RTP_SESSION_SSRC_UNLOCK (session);
 
   /*
    * TODO:
@@ -4200,12 +4739,18 @@ fs_rtp_session_bye_ssrc (FsRtpSession *session,
 }
 
 
+/*
+ * Returns: %TRUE if the codec needed its config or if the config changed
+ */
+
 static gboolean
-gather_caps_parameters (CodecAssociation *ca, GstCaps *caps)
+gather_caps_parameters (FsRtpSession *session, CodecAssociation *ca,
+    GstCaps *caps)
 {
   GstStructure *s = NULL;
   int i;
   gboolean old_need_config = FALSE;
+  gboolean changed = FALSE;
 
   s = gst_caps_get_structure (caps, 0);
 
@@ -4236,6 +4781,7 @@ gather_caps_parameters (CodecAssociation *ca, GstCaps *caps)
               /* replace the value if its different */
               fs_codec_remove_optional_parameter (ca->codec, param);
               fs_codec_add_optional_parameter (ca->codec, name, value);
+              changed = TRUE;
               break;
             }
           }
@@ -4247,16 +4793,30 @@ gather_caps_parameters (CodecAssociation *ca, GstCaps *caps)
                 ca->codec->id, ca->codec->encoding_name, name, value);
 
             fs_codec_add_optional_parameter (ca->codec, name, value);
+            changed = TRUE;
           }
         }
       }
     }
   }
 
+  if (changed)
+    codec_association_invalidate_caps (ca);
+
   old_need_config = ca->need_config;
   ca->need_config = FALSE;
 
-  return old_need_config;
+  if (old_need_config || changed)
+  {
+    gchar *settings = fs_element_added_notifier_get_settings_id (
+        GST_ELEMENT (session->priv->conference));
+
+    codec_config_cache_store (ca->blueprint, ca->send_profile, settings,
+        ca->codec);
+    g_free (settings);
+  }
+
+  return old_need_config || changed;
 }
 
 static void
@@ -4291,9 +4851,10 @@ _send_caps_changed (GstPad *pad, GParamSpec *pspec, FsRtpSession *session)
 
   /*
    * Emit farstream-codecs-changed if the sending thread finds the config
-   * for the last codec that needed it
+   * for the last codec that needed it or if the config from the cache
+   * turns out to be different
    */
-  if (gather_caps_parameters (ca, caps))
+  if (gather_caps_parameters (session, ca, caps))
   {
     GList *item = NULL;
 
@@ -4309,7 +4870,7 @@ _send_caps_changed (GstPad *pad, GParamSpec *pspec, FsRtpSession *session)
     {
       FS_RTP_SESSION_UNLOCK (session);
       g_object_notify (G_OBJECT (session), "codecs");
-      gst_element_post_message (GST_ELEMENT (session->priv->conference),
+      fs_rtp_conference_post_message (session->priv->conference,
           gst_message_new_element (GST_OBJECT (session->priv->conference),
               gst_structure_new ("farstream-codecs-changed",
                   "session", FS_TYPE_SESSION, session,
@@ -4366,7 +4927,7 @@ _discovery_caps_changed (GstPad *pad, GParamSpec *pspec, FsRtpSession *session)
 
   if (ca && ca->need_config)
   {
-    gather_caps_parameters (ca, caps);
+    gather_caps_parameters (session, ca, caps);
     fs_codec_destroy (session->priv->discovery_codec);
     session->priv->discovery_codec = fs_codec_copy (ca->codec);
     block = !ca->need_config;
@@ -4634,6 +5195,10 @@ _discovery_pad_blocked_callback (GstPad *pad, gboolean blocked,
 
   FS_RTP_SESSION_LOCK (session);
 
+  /* The discovery was stopped while the pad was being blocked */
+  if (!session->priv->discovery_timeout_id)
+    goto out_locked;
+
   /* Find out if there is a codec that needs the config to be fetched */
   for (item = g_list_first (session->priv->codec_associations);
        item;
@@ -4648,7 +5213,7 @@ _discovery_pad_blocked_callback (GstPad *pad, gboolean blocked,
     fs_rtp_session_stop_codec_param_gathering_unlock (session);
 
     g_object_notify (G_OBJECT (session), "codecs");
-    gst_element_post_message (GST_ELEMENT (session->priv->conference),
+    fs_rtp_conference_post_message (session->priv->conference,
         gst_message_new_element (GST_OBJECT (session->priv->conference),
             gst_structure_new ("farstream-codecs-changed",
                 "session", FS_TYPE_SESSION, session,
@@ -4683,6 +5248,56 @@ _discovery_pad_blocked_callback (GstPad *pad, gboolean blocked,
   goto out_unlocked;
 }
 
+static gboolean
+_discovery_timeout_cb (GstClock *clock, GstClockTime time, GstClockID id,
+    gpointer user_data)
+{
+  struct DiscoveryTimeout *timeout = user_data;
+  FsRtpSession *session;
+
+  g_static_mutex_lock (&discovery_timeout_mutex);
+  session = timeout->session;
+  if (session)
+    g_object_ref (session);
+  g_static_mutex_unlock (&discovery_timeout_mutex);
+
+  if (!session)
+    return FALSE;
+
+  if (fs_rtp_session_has_disposed_enter (session, NULL))
+  {
+    g_object_unref (session);
+    return FALSE;
+  }
+
+  g_mutex_lock (session->priv->discovery_pad_blocked_mutex);
+  FS_RTP_SESSION_LOCK (session);
+
+  if (session->priv->discovery_timeout_id != id)
+  {
+    FS_RTP_SESSION_UNLOCK (session);
+    goto out;
+  }
+
+  GST_WARNING ("Codec Param discovery for session %d timed out, the config"
+      " will come from the send pipeline", session->id);
+
+  fs_rtp_session_stop_codec_param_gathering_unlock (session);
+
+ out:
+  g_mutex_unlock (session->priv->discovery_pad_blocked_mutex);
+  fs_rtp_session_has_disposed_exit (session);
+  g_object_unref (session);
+
+  return FALSE;
+}
+
+static void
+discovery_timeout_free (gpointer data)
+{
+  g_slice_free (struct DiscoveryTimeout, data);
+}
+
 /**
  * fs_rtp_session_start_codec_param_gathering_locked
  * @session: a #FsRtpSession
@@ -4711,6 +5326,20 @@ fs_rtp_session_start_codec_param_gathering_locked (FsRtpSession *session)
 
   GST_DEBUG ("Starting Codec Param discovery for session %d", session->id);
 
+  if (!session->priv->discovery_timeout_id)
+  {
+    GstClock *sysclock = gst_system_clock_obtain ();
+
+    session->priv->discovery_timeout = g_slice_new (struct DiscoveryTimeout);
+    session->priv->discovery_timeout->session = session;
+    session->priv->discovery_timeout_id = gst_clock_new_single_shot_id (
+        sysclock, gst_clock_get_time (sysclock) + DISCOVERY_TIMEOUT);
+    gst_clock_id_wait_async_full (session->priv->discovery_timeout_id,
+        _discovery_timeout_cb, session->priv->discovery_timeout,
+        discovery_timeout_free);
+    gst_object_unref (sysclock);
+  }
+
   gst_pad_set_blocked_async (session->priv->send_tee_discovery_pad, TRUE,
       _discovery_pad_blocked_callback, session);
 }
@@ -4735,6 +5364,18 @@ fs_rtp_session_stop_codec_param_gathering_unlock (FsRtpSession *session)
     session->priv->discovery_codec = NULL;
   }
 
+  if (session->priv->discovery_timeout_id)
+  {
+    g_static_mutex_lock (&discovery_timeout_mutex);
+    session->priv->discovery_timeout->session = NULL;
+    g_static_mutex_unlock (&discovery_timeout_mutex);
+    session->priv->discovery_timeout = NULL;
+
+    gst_clock_id_unschedule (session->priv->discovery_timeout_id);
+    gst_clock_id_unref (session->priv->discovery_timeout_id);
+    session->priv->discovery_timeout_id = NULL;
+  }
+
   FS_RTP_SESSION_UNLOCK (session);
 
   if (session->priv->discovery_fakesink)
@@ -5038,7 +5679,7 @@ invalid:
   FS_RTP_SESSION_UNLOCK (self);
 
   if (post_message)
-    gst_element_post_message (GST_ELEMENT (self->priv->conference),
+    fs_rtp_conference_post_message (self->priv->conference,
         post_message);
 
   fs_rtp_session_try_sending_dtmf_event (self);
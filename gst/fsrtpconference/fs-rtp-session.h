@@ -121,6 +121,12 @@ void fs_rtp_session_associate_ssrc_cname (FsRtpSession *session,
     guint32 ssrc,
     const gchar *cname);
 
+void fs_rtp_session_ssrc_sdes (FsRtpSession *session,
+    guint32 ssrc);
+
+GstStructure *fs_rtp_session_get_stream_stats (FsRtpSession *self,
+    struct _FsRtpStream *stream);
+
 void fs_rtp_session_bye_ssrc (FsRtpSession *session,
     guint32 ssrc);
 
@@ -63,7 +63,9 @@ enum
   PROP_DIRECTION,
   PROP_PARTICIPANT,
   PROP_SESSION,
-  PROP_RTP_HEADER_EXTENSIONS
+  PROP_RTP_HEADER_EXTENSIONS,
+  PROP_STATS,
+  PROP_STATS_INTERVAL
 };
 
 struct _FsRtpStreamPrivate
@@ -88,8 +90,17 @@ struct _FsRtpStreamPrivate
   gulong state_changed_handler_id;
 
   GMutex *mutex;
+
+  /* Protected by stats_mutex */
+  guint stats_interval;
+  GstClockID stats_clock_id;
 };
 
+/* Streams with a stats timer -> their GstClockID, the clock callbacks use it
+ * to know if the stream is still alive */
+static GStaticMutex stats_mutex = G_STATIC_MUTEX_INIT;
+static GHashTable *stats_streams = NULL;
+
 
 G_DEFINE_TYPE(FsRtpStream, fs_rtp_stream, FS_TYPE_STREAM);
 
@@ -206,6 +217,44 @@ fs_rtp_stream_class_init (FsRtpStreamClass *klass)
           " would like to use",
           FS_TYPE_RTP_HEADER_EXTENSION_LIST,
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * FsRtpStream:stats:
+   *
+   * A "stream-stats" #GstStructure with the statistics of this stream:
+   * the "packets-received", "bytes-received" and "bitrate-received" (in bits
+   * per second) from the SSRCs of this stream, the "packets-lost" and
+   * "jitter" (a #GstClockTime) we measured on them, the "packets-sent",
+   * "bytes-sent" and "bitrate-sent" of our own SSRC, and the
+   * "remote-packets-lost" and "round-trip" (a #GstClockTime) reported by the
+   * remote side in its RTCP receiver reports.
+   *
+   * These are read from the counters that the rtpbin already keeps, so
+   * nothing is added on the media path.
+   */
+  g_object_class_install_property (gobject_class,
+      PROP_STATS,
+      g_param_spec_boxed ("stats",
+          "Statistics of the stream",
+          "A GstStructure with the RTP statistics of this stream",
+          GST_TYPE_STRUCTURE,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * FsRtpStream:stats-interval:
+   *
+   * If not 0, a "farstream-stream-stats" message is posted on the bus every
+   * stats-interval milliseconds. It contains the "stream" and the
+   * #FsRtpStream:stats as "stats", use fs_stream_parse_stats() to parse it.
+   */
+  g_object_class_install_property (gobject_class,
+      PROP_STATS_INTERVAL,
+      g_param_spec_uint ("stats-interval",
+          "Statistics interval",
+          "Interval in milliseconds between farstream-stream-stats messages"
+          " (0 to disable)",
+          0, G_MAXUINT, 0,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 }
 
 static void
@@ -265,14 +314,96 @@ fs_rtp_stream_get_stream_transmitter (FsRtpStream *self, GError **error)
   return st;
 }
 
+static gboolean
+_stats_timeout (GstClock *clock, GstClockTime time, GstClockID id,
+    gpointer user_data)
+{
+  FsRtpStream *self = user_data;
+  FsRtpSession *session;
+  FsRtpConference *conf;
+  GstStructure *stats;
+
+  g_static_mutex_lock (&stats_mutex);
+  if (!stats_streams || g_hash_table_lookup (stats_streams, self) != id)
+  {
+    g_static_mutex_unlock (&stats_mutex);
+    return FALSE;
+  }
+  g_object_ref (self);
+  g_static_mutex_unlock (&stats_mutex);
+
+  session = fs_rtp_stream_get_session (self, NULL);
+  if (!session)
+    goto out;
+
+  stats = fs_rtp_session_get_stream_stats (session, self);
+  conf = fs_rtp_session_get_conference (session);
+
+  if (stats && conf)
+    fs_rtp_conference_post_message (conf,
+        gst_message_new_element (GST_OBJECT (conf),
+            gst_structure_new ("farstream-stream-stats",
+                "stream", FS_TYPE_STREAM, self,
+                "stats", GST_TYPE_STRUCTURE, stats,
+                NULL)));
+
+  if (stats)
+    gst_structure_free (stats);
+  if (conf)
+    gst_object_unref (conf);
+  g_object_unref (session);
+
+ out:
+  g_object_unref (self);
+  return TRUE;
+}
+
+static void
+fs_rtp_stream_set_stats_interval (FsRtpStream *self, guint interval)
+{
+  g_static_mutex_lock (&stats_mutex);
+
+  if (self->priv->stats_clock_id)
+  {
+    g_hash_table_remove (stats_streams, self);
+    gst_clock_id_unschedule (self->priv->stats_clock_id);
+    gst_clock_id_unref (self->priv->stats_clock_id);
+    self->priv->stats_clock_id = NULL;
+  }
+
+  self->priv->stats_interval = interval;
+
+  if (interval)
+  {
+    GstClock *clock = gst_system_clock_obtain ();
+    GstClockTime period = interval * GST_MSECOND;
+
+    self->priv->stats_clock_id = gst_clock_new_periodic_id (clock,
+        gst_clock_get_time (clock) + period, period);
+    gst_object_unref (clock);
+
+    if (!stats_streams)
+      stats_streams = g_hash_table_new (g_direct_hash, g_direct_equal);
+    g_hash_table_insert (stats_streams, self, self->priv->stats_clock_id);
+
+    gst_clock_id_wait_async (self->priv->stats_clock_id, _stats_timeout,
+        self);
+  }
+
+  g_static_mutex_unlock (&stats_mutex);
+}
+
 static void
 fs_rtp_stream_dispose (GObject *object)
 {
   FsRtpStream *self = FS_RTP_STREAM (object);
   FsStreamTransmitter *st;
   FsRtpParticipant *participant;
-  FsRtpSession *session = fs_rtp_stream_get_session (self, NULL);
+  FsRtpSession *session;
 
+  fs_rtp_stream_set_stats_interval (self, 0);
+
+  session = fs_rtp_stream_get_session (self, NULL);
   if (!session)
     return;
 
@@ -365,12 +496,25 @@ fs_rtp_stream_get_property (GObject *object,
                             GParamSpec *pspec)
 {
   FsRtpStream *self = FS_RTP_STREAM (object);
-  FsRtpSession *session = fs_rtp_stream_get_session (self, NULL);
+  FsRtpSession *session;
 
+  if (prop_id == PROP_STATS_INTERVAL)
+  {
+    g_static_mutex_lock (&stats_mutex);
+    g_value_set_uint (value, self->priv->stats_interval);
+    g_static_mutex_unlock (&stats_mutex);
+    return;
+  }
+
+  session = fs_rtp_stream_get_session (self, NULL);
   if (!session)
     return;
 
   switch (prop_id) {
+    case PROP_STATS:
+      g_value_take_boxed (value,
+          fs_rtp_session_get_stream_stats (session, self));
+      break;
     case PROP_REMOTE_CODECS:
       FS_RTP_SESSION_LOCK (session);
       g_value_set_boxed (value, self->remote_codecs);
@@ -508,6 +652,9 @@ fs_rtp_stream_set_property (GObject *object,
         }
       }
       break;
+    case PROP_STATS_INTERVAL:
+      fs_rtp_stream_set_stats_interval (self, g_value_get_uint (value));
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -721,7 +868,7 @@ _local_candidates_prepared (FsStreamTransmitter *stream_transmitter,
 
   g_object_get (session, "conference", &conf, NULL);
 
-  gst_element_post_message (conf,
+  fs_rtp_conference_post_message (FS_RTP_CONFERENCE (conf),
       gst_message_new_element (GST_OBJECT (conf),
           gst_structure_new ("farstream-local-candidates-prepared",
               "stream", FS_TYPE_STREAM, self,
@@ -748,7 +895,7 @@ _new_active_candidate_pair (
 
   g_object_get (session, "conference", &conf, NULL);
 
-  gst_element_post_message (conf,
+  fs_rtp_conference_post_message (FS_RTP_CONFERENCE (conf),
       gst_message_new_element (GST_OBJECT (conf),
           gst_structure_new ("farstream-new-active-candidate-pair",
               "stream", FS_TYPE_STREAM, self,
@@ -776,7 +923,7 @@ _new_local_candidate (
 
   g_object_get (session, "conference", &conf, NULL);
 
-  gst_element_post_message (conf,
+  fs_rtp_conference_post_message (FS_RTP_CONFERENCE (conf),
       gst_message_new_element (GST_OBJECT (conf),
           gst_structure_new ("farstream-new-local-candidate",
               "stream", FS_TYPE_STREAM, self,
@@ -824,7 +971,7 @@ _state_changed (FsStreamTransmitter *stream_transmitter,
 
   g_object_get (session, "conference", &conf, NULL);
 
-  gst_element_post_message (conf,
+  fs_rtp_conference_post_message (FS_RTP_CONFERENCE (conf),
       gst_message_new_element (GST_OBJECT (conf),
           gst_structure_new ("farstream-component-state-changed",
               "stream", FS_TYPE_STREAM, self,
@@ -997,7 +1144,7 @@ _substream_codec_changed (FsRtpSubStream *substream,
 
     g_object_get (session, "conference", &conf, NULL);
 
-    gst_element_post_message (conf,
+    fs_rtp_conference_post_message (FS_RTP_CONFERENCE (conf),
         gst_message_new_element (GST_OBJECT (conf),
             gst_structure_new ("farstream-recv-codecs-changed",
                 "stream", FS_TYPE_STREAM, stream,
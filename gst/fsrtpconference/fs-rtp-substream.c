@@ -31,6 +31,7 @@
 
 #include <farstream/fs-stream.h>
 #include <farstream/fs-session.h>
+#include <farstream/fs-trace.h>
 
 #include "fs-rtp-stream.h"
 #include "fs-rtp-marshal.h"
@@ -984,6 +985,7 @@ fs_rtp_sub_stream_set_codecbin (FsRtpSubStream *substream,
   substream->priv->codecbin = codecbin;
   substream->priv->builder_hash = builder_hash;
   codec = NULL;
+  FS_TRACE (FS_TRACE_RECV_CODEC_BIN_SWITCH, substream, substream->pt);
 
   if (substream->priv->stream && !substream->priv->output_ghostpad)
   {
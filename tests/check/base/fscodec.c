@@ -211,6 +211,52 @@ GST_START_TEST (test_fscodec_are_equal_feedback_params)
 GST_END_TEST;
 
 
+GST_START_TEST (test_fscodec_are_equal_unordered)
+{
+  FsCodec *codec1;
+  FsCodec *codec2;
+
+  codec1 = fs_codec_new (96, "H264", FS_MEDIA_TYPE_VIDEO, 90000);
+  fs_codec_add_optional_parameter (codec1, "profile-level-id", "42e01f");
+  fs_codec_add_optional_parameter (codec1, "packetization-mode", "1");
+  fs_codec_add_optional_parameter (codec1, "sprop-parameter-sets", "Z0IAH");
+  fs_codec_add_feedback_parameter (codec1, "nack", "", "");
+  fs_codec_add_feedback_parameter (codec1, "nack", "pli", "");
+  fs_codec_add_feedback_parameter (codec1, "ccm", "fir", "");
+
+  codec2 = fs_codec_new (96, "H264", FS_MEDIA_TYPE_VIDEO, 90000);
+  fs_codec_add_optional_parameter (codec2, "SPROP-parameter-sets", "Z0IAH");
+  fs_codec_add_optional_parameter (codec2, "profile-level-id", "42e01f");
+  fs_codec_add_optional_parameter (codec2, "Packetization-Mode", "1");
+  fs_codec_add_feedback_parameter (codec2, "CCM", "FIR", "");
+  fs_codec_add_feedback_parameter (codec2, "nack", "pli", "");
+  fs_codec_add_feedback_parameter (codec2, "nack", "", "");
+
+  fail_unless (fs_codec_are_equal (codec1, codec2) == TRUE,
+      "Codecs with reordered params and different case not recognized");
+
+  /* Duplicated parameters are ignored */
+  fs_codec_add_optional_parameter (codec2, "profile-level-id", "42e01f");
+  fs_codec_add_feedback_parameter (codec2, "nack", "pli", "");
+
+  fail_unless (fs_codec_are_equal (codec1, codec2) == TRUE,
+      "Duplicated params made the codecs different");
+  fail_unless (fs_codec_are_equal (codec2, codec1) == TRUE,
+      "Duplicated params made the codecs different");
+
+  /* Values are case sensitive */
+  fs_codec_add_optional_parameter (codec1, "sprop-parameter-sets", "z0iah");
+
+  fail_unless (fs_codec_are_equal (codec1, codec2) == FALSE,
+      "Parameter with a different value not detected");
+  fail_unless (fs_codec_are_equal (codec2, codec1) == FALSE,
+      "Parameter with a different value not detected");
+
+  fs_codec_destroy (codec1);
+  fs_codec_destroy (codec2);
+}
+GST_END_TEST;
+
 GST_START_TEST (test_fscodec_copy)
 {
   FsCodec *codec1 = init_codec_with_three_params ();
@@ -403,6 +449,7 @@ fscodec_suite (void)
   tcase_add_test (tc_chain, test_fscodec_are_equal);
   tcase_add_test (tc_chain, test_fscodec_are_equal_opt_params);
   tcase_add_test (tc_chain, test_fscodec_are_equal_feedback_params);
+  tcase_add_test (tc_chain, test_fscodec_are_equal_unordered);
   tcase_add_test (tc_chain, test_fscodec_copy);
   tcase_add_test (tc_chain, test_fscodec_null);
   tcase_add_test (tc_chain, test_fscodec_keyfile);
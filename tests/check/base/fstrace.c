@@ -0,0 +1,191 @@
+/* Farstream unit tests for the tracepoints
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <unistd.h>
+
+#include <glib/gstdio.h>
+
+#include <gst/check/gstcheck.h>
+#include "farstream/fs-conference.h"
+#include "farstream/fs-trace.h"
+
+#ifdef FS_ENABLE_TRACING
+
+static gchar *
+dump_trace (void)
+{
+  GError *error = NULL;
+  gchar *filename = NULL;
+  gchar *contents = NULL;
+  gint fd;
+
+  fd = g_file_open_tmp ("fstrace-XXXXXX.json", &filename, &error);
+  fail_if (fd < 0, "Could not open temporary file: %s",
+      error ? error->message : "");
+  close (fd);
+
+  fail_unless (fs_trace_dump (filename, &error), "Could not dump: %s",
+      error ? error->message : "");
+  fail_unless (error == NULL);
+
+  fail_unless (g_file_get_contents (filename, &contents, NULL, NULL));
+  g_unlink (filename);
+  g_free (filename);
+
+  return contents;
+}
+
+static guint
+count_events (const gchar *json, const gchar *name)
+{
+  gchar *needle = g_strdup_printf ("\"name\":\"%s\"", name);
+  const gchar *p = json;
+  guint count = 0;
+
+  while ((p = strstr (p, needle)))
+  {
+    count++;
+    p++;
+  }
+
+  g_free (needle);
+
+  return count;
+}
+
+static gpointer
+trace_thread (gpointer data)
+{
+  FS_TRACE (FS_TRACE_NEGOTIATION_BEGIN, data, 3);
+  FS_TRACE (FS_TRACE_NEGOTIATION_END, data, TRUE);
+
+  return NULL;
+}
+
+GST_START_TEST (test_fstrace_dump)
+{
+  GThread *thread;
+  gchar *json;
+  gchar *object;
+
+  FS_TRACE (FS_TRACE_RECV_CODEC_BIN_SWITCH, NULL, 0);
+
+  fs_trace_set_enabled (TRUE);
+  fail_unless (fs_trace_get_enabled ());
+
+  FS_TRACE (FS_TRACE_FUNNEL_PUSH_BEGIN, &json, 160);
+  FS_TRACE (FS_TRACE_FUNNEL_PUSH_END, &json, 0);
+  FS_TRACE (FS_TRACE_SEND_CODEC_BIN_SWITCH, &json, 96);
+
+  thread = g_thread_create (trace_thread, &thread, TRUE, NULL);
+  fail_if (thread == NULL);
+  g_thread_join (thread);
+
+  fs_trace_set_enabled (FALSE);
+  fail_if (fs_trace_get_enabled ());
+
+  FS_TRACE (FS_TRACE_RECV_CODEC_BIN_SWITCH, NULL, 0);
+
+  json = dump_trace ();
+
+  fail_unless (g_str_has_prefix (json, "{\"traceEvents\":["));
+  fail_unless (count_events (json, "funnel-push") == 2);
+  fail_unless (count_events (json, "send-codec-bin-switch") == 1);
+  fail_unless (count_events (json, "negotiation") == 2);
+  fail_unless (count_events (json, "recv-codec-bin-switch") == 0,
+      "Tracepoints were recorded while tracing was disabled");
+  fail_unless (strstr (json, "\"ph\":\"B\"") != NULL);
+  fail_unless (strstr (json, "\"ph\":\"E\"") != NULL);
+  fail_unless (strstr (json, "\"arg\":96") != NULL);
+
+  object = g_strdup_printf ("\"object\":\"%p\"", &json);
+  fail_unless (strstr (json, object) != NULL);
+  g_free (object);
+
+  g_free (json);
+}
+GST_END_TEST;
+
+GST_START_TEST (test_fstrace_ring_wraps)
+{
+  gchar *json;
+  guint count;
+  guint i;
+
+  fs_trace_set_enabled (TRUE);
+  for (i = 0; i < 10000; i++)
+    FS_TRACE (FS_TRACE_TRANSMITTER_RECV, NULL, i);
+  fs_trace_set_enabled (FALSE);
+
+  json = dump_trace ();
+
+  /* Only the most recent records are kept */
+  count = count_events (json, "packet-recv");
+  fail_unless (count > 0 && count < 10000, "Got %u records", count);
+  fail_unless (strstr (json, "\"arg\":9999}") != NULL);
+  fail_unless (strstr (json, "\"arg\":0}") == NULL);
+
+  g_free (json);
+}
+GST_END_TEST;
+
+#else
+
+GST_START_TEST (test_fstrace_disabled)
+{
+  GError *error = NULL;
+
+  fs_trace_set_enabled (TRUE);
+  fail_if (fs_trace_get_enabled ());
+
+  fail_if (fs_trace_dump ("fstrace.json", &error));
+  fail_unless (error && error->domain == FS_ERROR &&
+      error->code == FS_ERROR_NOT_IMPLEMENTED);
+  g_clear_error (&error);
+
+  fail_if (g_file_test ("fstrace.json", G_FILE_TEST_EXISTS));
+}
+GST_END_TEST;
+
+#endif
+
+static Suite *
+fstrace_suite (void)
+{
+  Suite *s = suite_create ("fstrace");
+  TCase *tc_chain = tcase_create ("fstrace");
+
+  suite_add_tcase (s, tc_chain);
+
+#ifdef FS_ENABLE_TRACING
+  tcase_add_test (tc_chain, test_fstrace_dump);
+  tcase_add_test (tc_chain, test_fstrace_ring_wraps);
+#else
+  tcase_add_test (tc_chain, test_fstrace_disabled);
+#endif
+
+  return s;
+}
+
+
+GST_CHECK_MAIN (fstrace);
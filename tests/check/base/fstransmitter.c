@@ -24,8 +24,11 @@
 #endif
 
 #include <gst/check/gstcheck.h>
+
+#include <string.h>
 #include <farstream/fs-transmitter.h>
 #include <farstream/fs-conference.h>
+#include <farstream/fs-plugin.h>
 
 
 GST_START_TEST (test_fstransmitter_new_fail)
@@ -44,6 +47,85 @@ GST_START_TEST (test_fstransmitter_new_fail)
 }
 GST_END_TEST;
 
+GST_START_TEST (test_fstransmitter_preload)
+{
+  GError *error = NULL;
+  FsTransmitter *transmitter = NULL;
+  const gchar *index_path = g_getenv ("FS_PLUGIN_INDEX");
+
+  fail_unless (fs_plugin_preload ("transmitter", &error),
+      "Could not preload transmitters: %s", error ? error->message : "");
+  fail_unless (error == NULL);
+
+  /* The plugins are loaded and indexed before any transmitter is made */
+  fail_if (g_type_from_name ("FsRawUdpTransmitter") == 0,
+      "The rawudp transmitter was not preloaded");
+  if (index_path)
+    fail_unless (g_file_test (index_path, G_FILE_TEST_IS_REGULAR),
+        "The plugin index was not written to %s", index_path);
+
+  transmitter = fs_transmitter_new ("rawudp", 1,  0, &error);
+  fail_unless (transmitter != NULL, "Could not create rawudp transmitter: %s",
+      error ? error->message : "");
+  g_object_unref (transmitter);
+
+  transmitter = fs_transmitter_new ("rawudp", 1,  0, &error);
+  fail_unless (transmitter != NULL);
+  g_object_unref (transmitter);
+}
+GST_END_TEST;
+
+typedef FsTransmitter FsStaticTransmitter;
+typedef FsTransmitterClass FsStaticTransmitterClass;
+
+static GType
+fs_static_transmitter_register_type (FsPlugin *module)
+{
+  static const GTypeInfo info = {
+    sizeof (FsStaticTransmitterClass),
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    sizeof (FsStaticTransmitter),
+    0,
+    NULL
+  };
+
+  return g_type_module_register_type (G_TYPE_MODULE (module),
+      FS_TYPE_TRANSMITTER, "FsStaticTransmitter", &info, 0);
+}
+
+GST_START_TEST (test_fstransmitter_static)
+{
+  GError *error = NULL;
+  FsTransmitter *transmitter = NULL;
+  gchar **available;
+  gboolean found = FALSE;
+  gint i;
+
+  fs_plugin_register_static ("static", "transmitter",
+      fs_static_transmitter_register_type);
+
+  available = fs_transmitter_list_available ();
+  for (i = 0; available && available[i]; i++)
+    if (!strcmp (available[i], "static"))
+      found = TRUE;
+  g_strfreev (available);
+  fail_unless (found, "Static transmitter is not listed");
+
+  transmitter = fs_transmitter_new ("static", 1,  0, &error);
+  fail_unless (transmitter != NULL, "Could not create static transmitter: %s",
+      error ? error->message : "");
+  fail_unless (error == NULL);
+  fail_unless (!strcmp (G_OBJECT_TYPE_NAME (transmitter),
+          "FsStaticTransmitter"));
+
+  g_object_unref (transmitter);
+}
+GST_END_TEST;
+
 
 static Suite *
 fstransmitter_suite (void)
@@ -54,6 +136,8 @@ fstransmitter_suite (void)
   suite_add_tcase (s, tc_chain);
 
   tcase_add_test (tc_chain, test_fstransmitter_new_fail);
+  tcase_add_test (tc_chain, test_fstransmitter_preload);
+  tcase_add_test (tc_chain, test_fstransmitter_static);
 
   return s;
 }
@@ -0,0 +1,262 @@
+/* Farstream unit tests for the MSN handshake framing
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+*/
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <gst/check/gstcheck.h>
+#include <farstream/fs-conference.h>
+
+#include "fs-msn-framing.h"
+
+#define AUTH_TOKEN "recipientid=123&sessionid=4567\r\n\r\n"
+#define CONNECTED_TOKEN "connected\r\n\r\n"
+
+static gint fds[2];
+
+static void
+setup_socketpair (void)
+{
+  fail_unless (socketpair (AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+  fcntl (fds[0], F_SETFL, fcntl (fds[0], F_GETFL) | O_NONBLOCK);
+  fcntl (fds[1], F_SETFL, fcntl (fds[1], F_GETFL) | O_NONBLOCK);
+}
+
+static void
+teardown_socketpair (void)
+{
+  if (fds[0] >= 0)
+    close (fds[0]);
+  if (fds[1] >= 0)
+    close (fds[1]);
+  fds[0] = fds[1] = -1;
+}
+
+GST_START_TEST (test_msnframing_partial_read)
+{
+  FsMsnFramer *framer;
+  const gchar *token = AUTH_TOKEN;
+  gsize i;
+
+  setup_socketpair ();
+  framer = fs_msn_framer_new (fds[0]);
+
+  fail_unless (fs_msn_framer_expect (framer, token, NULL) ==
+      FS_MSN_FRAMER_AGAIN);
+
+  for (i = 0; i < strlen (token) - 1; i++)
+  {
+    fail_unless (write (fds[1], token + i, 1) == 1);
+    fail_unless (fs_msn_framer_expect (framer, token, NULL) ==
+        FS_MSN_FRAMER_AGAIN);
+  }
+
+  fail_unless (write (fds[1], token + i, 1) == 1);
+  fail_unless (fs_msn_framer_expect (framer, token, NULL) == FS_MSN_FRAMER_OK);
+
+  fs_msn_framer_free (framer);
+  teardown_socketpair ();
+}
+GST_END_TEST;
+
+GST_START_TEST (test_msnframing_random_splits)
+{
+  FsMsnFramer *framer;
+  const gchar *token = AUTH_TOKEN;
+  gsize token_len = strlen (token);
+  gint round;
+
+  setup_socketpair ();
+  framer = fs_msn_framer_new (fds[0]);
+
+  for (round = 0; round < 1000; round++)
+  {
+    gsize sent = 0;
+    FsMsnFramerStatus ret = FS_MSN_FRAMER_AGAIN;
+
+    while (sent < token_len)
+    {
+      gsize chunk = g_random_int_range (1, token_len - sent + 1);
+
+      fail_unless (ret == FS_MSN_FRAMER_AGAIN);
+      fail_unless (write (fds[1], token + sent, chunk) == chunk);
+      sent += chunk;
+
+      /* Sometimes read after every chunk, sometimes let them pile up */
+      if (sent == token_len || g_random_boolean ())
+        ret = fs_msn_framer_expect (framer, token, NULL);
+    }
+
+    fail_unless (ret == FS_MSN_FRAMER_OK, "Round %d failed with %d", round,
+        ret);
+  }
+
+  fs_msn_framer_free (framer);
+  teardown_socketpair ();
+}
+GST_END_TEST;
+
+GST_START_TEST (test_msnframing_mismatch)
+{
+  FsMsnFramer *framer;
+  gchar buf[32] = {0};
+  /* Looks like the start of the token, then diverges */
+  const gchar *data = "connecXYZ";
+
+  setup_socketpair ();
+  framer = fs_msn_framer_new (fds[0]);
+
+  fail_unless (write (fds[1], data, 4) == 4);
+  fail_unless (fs_msn_framer_expect (framer, CONNECTED_TOKEN, NULL) ==
+      FS_MSN_FRAMER_AGAIN);
+
+  fail_unless (write (fds[1], data + 4, strlen (data) - 4) ==
+      strlen (data) - 4);
+  fail_unless (fs_msn_framer_expect (framer, CONNECTED_TOKEN, NULL) ==
+      FS_MSN_FRAMER_MISMATCH);
+
+  /* Only the matching prefix may have been consumed */
+  fail_unless (read (fds[0], buf, sizeof (buf)) == strlen (data) - 4);
+  fail_unless (strcmp (buf, data + 4) == 0);
+
+  /* Data that is not a token at all must stay in the socket */
+  fail_unless (write (fds[1], "\x18\0\0\0", 4) == 4);
+  fail_unless (fs_msn_framer_expect (framer, CONNECTED_TOKEN, NULL) ==
+      FS_MSN_FRAMER_MISMATCH);
+  fail_unless (read (fds[0], buf, sizeof (buf)) == 4);
+
+  fs_msn_framer_free (framer);
+  teardown_socketpair ();
+}
+GST_END_TEST;
+
+GST_START_TEST (test_msnframing_closed)
+{
+  FsMsnFramer *framer;
+  GError *error = NULL;
+
+  setup_socketpair ();
+  framer = fs_msn_framer_new (fds[0]);
+
+  fail_unless (write (fds[1], "conn", 4) == 4);
+  fail_unless (fs_msn_framer_expect (framer, CONNECTED_TOKEN, NULL) ==
+      FS_MSN_FRAMER_AGAIN);
+
+  /* The start of the token has been received, but will never be
+   * completed */
+  close (fds[1]);
+  fds[1] = -1;
+
+  fail_unless (fs_msn_framer_expect (framer, CONNECTED_TOKEN, &error) ==
+      FS_MSN_FRAMER_CLOSED);
+  fail_unless (error && error->domain == FS_ERROR &&
+      error->code == FS_ERROR_NETWORK);
+  g_clear_error (&error);
+
+  fs_msn_framer_free (framer);
+  teardown_socketpair ();
+}
+GST_END_TEST;
+
+GST_START_TEST (test_msnframing_partial_write)
+{
+  FsMsnFramer *framer;
+  GString *expected = g_string_new (NULL);
+  GString *received = g_string_new (NULL);
+  gint sndbuf = 1024;
+  gint i;
+
+  setup_socketpair ();
+  setsockopt (fds[0], SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof (sndbuf));
+  framer = fs_msn_framer_new (fds[0]);
+
+  /* Queue much more than the socket buffer can take in one go */
+  for (i = 0; i < 2000; i++)
+  {
+    const gchar *msg = (i % 2) ? AUTH_TOKEN : CONNECTED_TOKEN;
+
+    fs_msn_framer_queue (framer, msg, strlen (msg));
+    g_string_append (expected, msg);
+  }
+
+  fail_unless (fs_msn_framer_has_pending_output (framer));
+
+  for (;;)
+  {
+    gchar buf[333];
+    gssize size;
+    FsMsnFramerStatus ret = fs_msn_framer_flush (framer, NULL);
+
+    fail_if (ret == FS_MSN_FRAMER_ERROR);
+
+    while ((size = read (fds[1], buf, sizeof (buf))) > 0)
+      g_string_append_len (received, buf, size);
+
+    if (ret == FS_MSN_FRAMER_OK)
+      break;
+  }
+
+  fail_if (fs_msn_framer_has_pending_output (framer));
+  fail_unless (received->len == expected->len);
+  fail_unless (memcmp (received->str, expected->str, expected->len) == 0);
+
+  g_string_free (expected, TRUE);
+  g_string_free (received, TRUE);
+  fs_msn_framer_free (framer);
+  teardown_socketpair ();
+}
+GST_END_TEST;
+
+static Suite *
+fsmsnframing_suite (void)
+{
+  Suite *s = suite_create ("fsmsnframing");
+  TCase *tc_chain;
+
+  tc_chain = tcase_create ("fsmsnframing_partial_read");
+  tcase_add_test (tc_chain, test_msnframing_partial_read);
+  suite_add_tcase (s, tc_chain);
+
+  tc_chain = tcase_create ("fsmsnframing_random_splits");
+  tcase_add_test (tc_chain, test_msnframing_random_splits);
+  suite_add_tcase (s, tc_chain);
+
+  tc_chain = tcase_create ("fsmsnframing_mismatch");
+  tcase_add_test (tc_chain, test_msnframing_mismatch);
+  suite_add_tcase (s, tc_chain);
+
+  tc_chain = tcase_create ("fsmsnframing_closed");
+  tcase_add_test (tc_chain, test_msnframing_closed);
+  suite_add_tcase (s, tc_chain);
+
+  tc_chain = tcase_create ("fsmsnframing_partial_write");
+  tcase_add_test (tc_chain, test_msnframing_partial_write);
+  suite_add_tcase (s, tc_chain);
+
+  return s;
+}
+
+GST_CHECK_MAIN (fsmsnframing);
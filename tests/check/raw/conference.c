@@ -94,6 +94,14 @@ GStaticMutex testlock = G_STATIC_MUTEX_INIT;
 gboolean select_last_codec = FALSE;
 gboolean reset_to_last_codec = FALSE;
 
+/* Make the source produce exactly the codec caps */
+gboolean passthrough_src = FALSE;
+
+#define RAW_CODEC_CAPS "audio/x-raw-int,"                   \
+  "endianness=(int)1234, signed=(bool)true, "               \
+  "width=(int)16, depth=(int)16, "                          \
+  "rate=(int)44100"
+
 static GstBusSyncReply
 default_sync_handler (GstBus *bus, GstMessage *message, gpointer data)
 {
@@ -254,11 +262,27 @@ setup_fakesrc (struct SimpleTestConference *dat)
 
   g_object_set (dat->fakesrc,
       "blocksize", 10,
-      "is-live", TRUE,
+      "is-live", !passthrough_src,
       "volume", 0.3,
       NULL);
 
-  srcpad = gst_element_get_static_pad (dat->fakesrc, "src");
+  if (passthrough_src)
+  {
+    GstElement *capsfilter = gst_element_factory_make ("capsfilter", NULL);
+    GstCaps *caps = gst_caps_from_string (RAW_CODEC_CAPS);
+
+    fail_if (capsfilter == NULL, "Could not make capsfilter");
+    g_object_set (capsfilter, "caps", caps, NULL);
+    gst_caps_unref (caps);
+    gst_bin_add (GST_BIN (dat->pipeline), capsfilter);
+    fail_unless (gst_element_link (dat->fakesrc, capsfilter));
+
+    srcpad = gst_element_get_static_pad (capsfilter, "src");
+  }
+  else
+  {
+    srcpad = gst_element_get_static_pad (dat->fakesrc, "src");
+  }
 
   fail_unless (gst_pad_link (srcpad, sinkpad) == GST_PAD_LINK_OK,
       "Could not link the capsfilter and the fsrawconference");
@@ -1005,10 +1029,7 @@ set_initial_codecs (
 
   ts_fail_unless (codecs == NULL, "Shouldn't generate codecs codecs");
 
-  codec = fs_codec_new (0, "audio/x-raw-int,"
-      "endianness=(int)1234, signed=(bool)true, "
-      "width=(int)16, depth=(int)16, "
-      "rate=(int)44100", FS_MEDIA_TYPE_AUDIO, 0);
+  codec = fs_codec_new (0, RAW_CODEC_CAPS, FS_MEDIA_TYPE_AUDIO, 0);
   codecs = g_list_append (codecs, codec);
 
   filtered_codecs = g_list_append (filtered_codecs, codecs->data);
@@ -1311,6 +1332,71 @@ GST_START_TEST (test_rawconference_change_to_send_only)
 GST_END_TEST;
 
 
+static gint
+_compare_factory_name (GstElement *element, const gchar *factory_name)
+{
+  GstElementFactory *factory = gst_element_get_factory (element);
+  gint ret = 1;
+
+  if (factory &&
+      !strcmp (GST_PLUGIN_FEATURE_NAME (factory), factory_name))
+    ret = 0;
+
+  if (ret != 0)
+    gst_object_unref (element);
+  return ret;
+}
+
+static void
+_passthrough_handoff_handler (GstElement *element, GstBuffer *buffer,
+    GstPad *pad, gpointer user_data)
+{
+  struct SimpleTestStream *st = user_data;
+  const gchar *converters[] = {"audioconvert", "audioresample", NULL};
+  gint i;
+
+  st->buffer_count++;
+
+  if (st->buffer_count == 1)
+  {
+    ts_fail_unless (GST_BUFFER_SIZE (buffer) > 0, "Received an empty buffer");
+
+    for (i = 0; converters[i]; i++)
+    {
+      GstIterator *iter;
+      GstElement *converter;
+
+      iter = gst_bin_iterate_recurse (GST_BIN (st->dat->conference));
+      converter = gst_iterator_find_custom (iter,
+          (GCompareFunc) _compare_factory_name, (gpointer) converters[i]);
+      gst_iterator_free (iter);
+
+      if (converter)
+        gst_object_unref (converter);
+      ts_fail_unless (converter == NULL,
+          "There is a %s in the passthrough send path", converters[i]);
+    }
+  }
+
+  if (st->buffer_count == 100)
+    g_main_loop_quit (loop);
+}
+
+static void
+_passthrough_init (struct SimpleTestStream *st, guint confid, guint streamid)
+{
+  st->handoff_handler = G_CALLBACK (_passthrough_handoff_handler);
+}
+
+GST_START_TEST (test_rawconference_passthrough)
+{
+  passthrough_src = TRUE;
+  nway_test (2, NULL, _passthrough_init, "shm", 0, NULL);
+  passthrough_src = FALSE;
+}
+GST_END_TEST;
+
+
 GST_START_TEST (test_rawconference_dispose)
 {
   FsConference *conf;
@@ -1529,6 +1615,10 @@ fsrawconference_suite (void)
   tcase_add_test (tc_chain, test_rawconference_change_to_send_only);
   suite_add_tcase (s, tc_chain);
 
+  tc_chain = tcase_create ("fsrawconference_passthrough");
+  tcase_add_test (tc_chain, test_rawconference_passthrough);
+  suite_add_tcase (s, tc_chain);
+
   tc_chain = tcase_create ("fsrawconference_dispose");
   tcase_add_test (tc_chain, test_rawconference_dispose);
   suite_add_tcase (s, tc_chain);
@@ -25,6 +25,7 @@
 #include <gst/check/gstcheck.h>
 #include <farstream/fs-conference.h>
 #include <farstream/fs-rtp.h>
+#include <farstream/fs-element-added-notifier.h>
 
 #include "generic.h"
 
@@ -433,6 +434,144 @@ GST_START_TEST (test_rtpcodecs_invalid_remote_codecs)
 GST_END_TEST;
 
 
+static void
+_codecs_notify (GObject *object, GParamSpec *param, gpointer user_data)
+{
+  guint *count = user_data;
+
+  (*count)++;
+}
+
+/* Counts, for each stream, the changes of its negotiated codecs and the
+ * farstream-recv-codecs-changed messages posted for it */
+
+struct StreamUpdates {
+  FsStream *streams[3];
+  guint negotiated[3];
+  guint recv_changed[3];
+};
+
+static void
+_negotiated_codecs_notify (GObject *object, GParamSpec *param,
+    gpointer user_data)
+{
+  struct StreamUpdates *su = user_data;
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (su->streams); i++)
+    if (object == G_OBJECT (su->streams[i]))
+      su->negotiated[i]++;
+}
+
+static void
+_count_recv_codecs_changed (GstElement *pipeline, struct StreamUpdates *su)
+{
+  GstBus *bus = gst_pipeline_get_bus (GST_PIPELINE (pipeline));
+  GstMessage *message;
+
+  while ((message = gst_bus_pop_filtered (bus, GST_MESSAGE_ELEMENT)))
+  {
+    const GstStructure *s = gst_message_get_structure (message);
+
+    if (gst_structure_has_name (s, "farstream-recv-codecs-changed"))
+    {
+      const GValue *value = gst_structure_get_value (s, "stream");
+      FsStream *stream = g_value_get_object (value);
+      guint i;
+
+      for (i = 0; i < G_N_ELEMENTS (su->streams); i++)
+        if (stream == su->streams[i])
+          su->recv_changed[i]++;
+    }
+
+    gst_message_unref (message);
+  }
+
+  gst_object_unref (bus);
+}
+
+GST_START_TEST (test_rtpcodecs_reoffer_same_codecs)
+{
+  struct SimpleTestConference *dat = NULL;
+  struct SimpleTestStream *st = NULL, *st2 = NULL, *st3 = NULL;
+  GList *codecs = NULL, *negotiated = NULL, *stream_codecs = NULL;
+  GError *error = NULL;
+  guint notifies = 0;
+  struct StreamUpdates su;
+  guint i;
+
+  dat = setup_simple_conference (1, "fsrtpconference", "bob@127.0.0.1");
+  st = simple_conference_add_stream (dat, dat, "rawudp", 0, NULL);
+  st2 = simple_conference_add_stream (dat, dat, "rawudp", 0, NULL);
+  st3 = simple_conference_add_stream (dat, dat, "rawudp", 0, NULL);
+
+  g_object_get (dat->session, "codecs-without-config", &codecs, NULL);
+
+  fail_unless (fs_stream_set_remote_codecs (st->stream, codecs, &error),
+      "Could not set remote codecs on the first stream");
+  fail_unless (fs_stream_set_remote_codecs (st2->stream, codecs, &error),
+      "Could not set remote codecs on the second stream");
+
+  g_object_get (dat->session, "codecs-without-config", &negotiated, NULL);
+
+  g_signal_connect (dat->session, "notify::codecs",
+      G_CALLBACK (_codecs_notify), &notifies);
+
+  memset (&su, 0, sizeof (su));
+  su.streams[0] = st->stream;
+  su.streams[1] = st2->stream;
+  su.streams[2] = st3->stream;
+  for (i = 0; i < G_N_ELEMENTS (su.streams); i++)
+    g_signal_connect (su.streams[i], "notify::negotiated-codecs",
+        G_CALLBACK (_negotiated_codecs_notify), &su);
+  _count_recv_codecs_changed (dat->pipeline, &su);
+  memset (su.recv_changed, 0, sizeof (su.recv_changed));
+
+  fail_unless (fs_stream_set_remote_codecs (st->stream, codecs, &error),
+      "Could not re-offer the same codecs");
+  fail_unless (notifies == 0, "Re-offering the same codecs changed them");
+
+  _count_recv_codecs_changed (dat->pipeline, &su);
+  for (i = 0; i < G_N_ELEMENTS (su.streams); i++)
+    fail_unless (su.negotiated[i] == 0 && su.recv_changed[i] == 0,
+        "Re-offering the same codecs updated stream %u", i);
+
+  /* Another stream with the same codecs does not change the result of the
+   * negotiation, but must still get its negotiated codecs */
+  fail_unless (fs_stream_set_remote_codecs (st3->stream, codecs, &error),
+      "Could not set remote codecs on the third stream");
+  fail_unless (notifies == 0, "The same codecs changed the negotiation");
+
+  _count_recv_codecs_changed (dat->pipeline, &su);
+  for (i = 0; i < 2; i++)
+    fail_unless (su.negotiated[i] == 0 && su.recv_changed[i] == 0,
+        "Stream %u was updated for the third stream's codecs", i);
+  fail_unless (su.negotiated[2] == 1,
+      "The third stream's negotiated codecs changed %u times",
+      su.negotiated[2]);
+
+  for (i = 0; i < G_N_ELEMENTS (su.streams); i++)
+    g_signal_handlers_disconnect_by_func (su.streams[i],
+        _negotiated_codecs_notify, &su);
+
+  g_object_get (st3->stream, "negotiated-codecs", &stream_codecs, NULL);
+  fail_unless (stream_codecs != NULL,
+      "The third stream did not get its negotiated codecs");
+  fs_codec_list_destroy (stream_codecs);
+
+  fs_codec_list_destroy (codecs);
+  g_object_get (dat->session, "codecs-without-config", &codecs, NULL);
+  fail_unless (fs_codec_list_are_equal (codecs, negotiated),
+      "The negotiated codecs changed");
+
+  fs_codec_list_destroy (codecs);
+  fs_codec_list_destroy (negotiated);
+
+  cleanup_simple_conference (dat);
+}
+GST_END_TEST;
+
+
 GST_START_TEST (test_rtpcodecs_reserved_pt)
 {
   struct SimpleTestConference *dat = NULL;
@@ -933,6 +1072,163 @@ GST_START_TEST (test_rtpcodecs_preset_config_data)
 GST_END_TEST;
 
 
+static void
+_codecs_ready_bus_message (GstBus *bus, GstMessage *message,
+    struct SimpleTestConference *dat)
+{
+  const GstStructure *s = gst_message_get_structure (message);
+  GList *codecs = NULL;
+
+  if (!gst_structure_has_name (s, "farstream-codecs-changed"))
+    return;
+
+  g_object_get (dat->session, "codecs", &codecs, NULL);
+  if (codecs)
+    g_main_loop_quit (loop);
+  fs_codec_list_destroy (codecs);
+}
+
+static gboolean
+_codecs_ready_timeout (gpointer user_data)
+{
+  g_main_loop_quit (loop);
+  return TRUE;
+}
+
+/*
+ * Waits until the codecs are ready, @ready_at_once is set if they were
+ * ready without any discovery. Returns FALSE if the codec is not available.
+ * If there is a keyfile, it is applied to the pipeline with a
+ * #FsElementAddedNotifier
+ */
+
+static gboolean
+wait_for_codecs_ready (const gchar *encoding_name, GKeyFile *keyfile,
+    gboolean *ready_at_once)
+{
+  FsElementAddedNotifier *notifier = NULL;
+  struct SimpleTestConference *dat = NULL;
+  GList *codecs = NULL, *item;
+  GstElement *src;
+  GstPad *srcpad, *sinkpad;
+  GstBus *bus;
+  gboolean available = FALSE;
+  guint timeout_id;
+
+  loop = g_main_loop_new (NULL, FALSE);
+
+  dat = setup_simple_conference_full (1, "fsrtpconference", "bob@127.0.0.1",
+      FS_MEDIA_TYPE_VIDEO);
+
+  if (keyfile)
+  {
+    notifier = fs_element_added_notifier_new ();
+    fs_element_added_notifier_set_properties_from_keyfile (notifier, keyfile);
+    fs_element_added_notifier_add (notifier, GST_BIN (dat->pipeline));
+  }
+
+  codecs = g_list_prepend (NULL, fs_codec_new (FS_CODEC_ID_ANY, encoding_name,
+          FS_MEDIA_TYPE_VIDEO, 90000));
+  fail_unless (fs_session_set_codec_preferences (dat->session, codecs, NULL),
+      "Unable to set codec preferences");
+  fs_codec_list_destroy (codecs);
+
+  g_object_get (dat->session, "codecs-without-config", &codecs, NULL);
+  for (item = codecs; item; item = g_list_next (item))
+    if (!g_ascii_strcasecmp (encoding_name,
+            ((FsCodec *) item->data)->encoding_name))
+      break;
+  fs_codec_list_destroy (codecs);
+
+  if (!item)
+  {
+    GST_WARNING ("Could not find %s elements, skipping", encoding_name);
+    goto out;
+  }
+  available = TRUE;
+
+  g_object_get (dat->session, "codecs", &codecs, NULL);
+  *ready_at_once = (codecs != NULL);
+  fs_codec_list_destroy (codecs);
+
+  if (*ready_at_once)
+    goto out;
+
+  src = gst_element_factory_make ("videotestsrc", NULL);
+  fail_if (src == NULL, "Could not make videotestsrc");
+  g_object_set (src, "is-live", TRUE, NULL);
+  gst_bin_add (GST_BIN (dat->pipeline), src);
+
+  g_object_get (dat->session, "sink-pad", &sinkpad, NULL);
+  srcpad = gst_element_get_static_pad (src, "src");
+  fail_unless (gst_pad_link (srcpad, sinkpad) == GST_PAD_LINK_OK,
+      "Could not link the videotestsrc to the session");
+  gst_object_unref (srcpad);
+  gst_object_unref (sinkpad);
+
+  bus = gst_pipeline_get_bus (GST_PIPELINE (dat->pipeline));
+  gst_bus_add_signal_watch (bus);
+  g_signal_connect (bus, "message::element",
+      G_CALLBACK (_codecs_ready_bus_message), dat);
+
+  fail_if (gst_element_set_state (dat->pipeline, GST_STATE_PLAYING) ==
+      GST_STATE_CHANGE_FAILURE, "Could not set the pipeline to playing");
+
+  timeout_id = g_timeout_add_seconds (30, _codecs_ready_timeout, NULL);
+  g_main_loop_run (loop);
+  g_source_remove (timeout_id);
+
+  gst_bus_remove_signal_watch (bus);
+  gst_object_unref (bus);
+
+  g_object_get (dat->session, "codecs", &codecs, NULL);
+  fail_if (codecs == NULL, "%s codecs never became ready", encoding_name);
+  fs_codec_list_destroy (codecs);
+
+  fail_if (gst_element_set_state (dat->pipeline, GST_STATE_NULL) ==
+      GST_STATE_CHANGE_FAILURE, "Could not set the pipeline to null");
+
+ out:
+  g_main_loop_unref (loop);
+  cleanup_simple_conference (dat);
+  if (notifier)
+    g_object_unref (notifier);
+
+  return available;
+}
+
+static void
+check_config_cache (const gchar *encoding_name)
+{
+  gboolean ready_at_once = FALSE;
+  GKeyFile *keyfile;
+
+  if (!wait_for_codecs_ready (encoding_name, NULL, &ready_at_once))
+    return;
+  fail_if (ready_at_once, "%s codecs ready before any discovery",
+      encoding_name);
+
+  wait_for_codecs_ready (encoding_name, NULL, &ready_at_once);
+  fail_unless (ready_at_once, "%s codec config was not cached",
+      encoding_name);
+
+  /* Encoder settings from a keyfile may change the config */
+  keyfile = g_key_file_new ();
+  g_key_file_set_integer (keyfile, "x264enc", "threads", 1);
+  g_key_file_set_integer (keyfile, "theoraenc", "speed-level", 2);
+  wait_for_codecs_ready (encoding_name, keyfile, &ready_at_once);
+  fail_if (ready_at_once, "%s config cached for other encoder settings",
+      encoding_name);
+}
+
+GST_START_TEST (test_rtpcodecs_config_cache)
+{
+  check_config_cache ("H264");
+  check_config_cache ("THEORA");
+}
+GST_END_TEST;
+
+
 static void
 profile_test (const gchar *send_profile, const gchar *recv_profile,
     gboolean is_valid)
@@ -2413,6 +2709,10 @@ fsrtpcodecs_suite (void)
   tcase_add_test (tc_chain, test_rtpcodecs_invalid_remote_codecs);
   suite_add_tcase (s, tc_chain);
 
+  tc_chain = tcase_create ("fsrtpcodecs_reoffer_same_codecs");
+  tcase_add_test (tc_chain, test_rtpcodecs_reoffer_same_codecs);
+  suite_add_tcase (s, tc_chain);
+
   tc_chain = tcase_create ("fsrtpcodecs_reserved_pt");
   tcase_add_test (tc_chain, test_rtpcodecs_reserved_pt);
   suite_add_tcase (s, tc_chain);
@@ -2425,6 +2725,10 @@ fsrtpcodecs_suite (void)
   tcase_add_test (tc_chain, test_rtpcodecs_preset_config_data);
   suite_add_tcase (s, tc_chain);
 
+  tc_chain = tcase_create ("fsrtpcodecs_config_cache");
+  tcase_add_test (tc_chain, test_rtpcodecs_config_cache);
+  suite_add_tcase (s, tc_chain);
+
   tc_chain = tcase_create ("fsrtpcodecs_test_codec_profile");
   tcase_add_test (tc_chain, test_rtpcodecs_profile);
   suite_add_tcase (s, tc_chain);
@@ -25,6 +25,7 @@
 #include <gst/check/gstcheck.h>
 #include <farstream/fs-conference.h>
 #include <farstream/fs-stream-transmitter.h>
+#include <farstream/fs-element-added-notifier.h>
 
 #include "check-threadsafe.h"
 
@@ -955,6 +956,165 @@ GST_START_TEST (test_rtpconference_errors)
 GST_END_TEST;
 
 
+GST_START_TEST (test_rtpconference_batch_messages)
+{
+  struct SimpleTestConference *dat = NULL;
+  struct SimpleTestStream *st = NULL, *st2 = NULL;
+  GList *codecs = NULL, *messages = NULL, *item;
+  GstBus *bus;
+  GstMessage *message;
+  GError *error = NULL;
+  guint batches = 0, codecs_changed = 0;
+
+  dat = setup_simple_conference (1, "fsrtpconference", "bob@127.0.0.1");
+  g_object_set (dat->conference, "batch-messages", TRUE, NULL);
+
+  st = simple_conference_add_stream (dat, dat, "rawudp", 0, NULL);
+  st2 = simple_conference_add_stream (dat, dat, "rawudp", 0, NULL);
+
+  bus = gst_pipeline_get_bus (GST_PIPELINE (dat->pipeline));
+  while ((message = gst_bus_pop (bus)))
+    gst_message_unref (message);
+
+  g_object_get (dat->session, "codecs-without-config", &codecs, NULL);
+  fail_unless (fs_stream_set_remote_codecs (st->stream, codecs, &error));
+  fail_unless (fs_stream_set_remote_codecs (st2->stream, codecs, &error));
+  fs_codec_list_destroy (codecs);
+
+  /* Nothing is posted until the main loop runs */
+  while ((message = gst_bus_pop (bus)))
+  {
+    fail_if (fs_session_parse_codecs_changed (dat->session, message),
+        "A farstream-codecs-changed message was not batched");
+    gst_message_unref (message);
+  }
+
+  while (g_main_context_iteration (NULL, FALSE));
+
+  while ((message = gst_bus_pop (bus)))
+  {
+    if (fs_session_parse_batch (dat->session, message, &messages))
+    {
+      batches++;
+      for (item = messages; item; item = item->next)
+        if (fs_session_parse_codecs_changed (dat->session, item->data))
+          codecs_changed++;
+      g_list_free (messages);
+      messages = NULL;
+    }
+    gst_message_unref (message);
+  }
+
+  ts_fail_unless (batches == 1, "Got %u batches instead of one", batches);
+  ts_fail_unless (codecs_changed > 0, "The batch has no codecs-changed");
+
+  gst_object_unref (bus);
+
+  cleanup_simple_conference (dat);
+}
+GST_END_TEST;
+
+
+GST_START_TEST (test_rtpconference_batch_before_error)
+{
+  struct SimpleTestConference *dat = NULL;
+  struct SimpleTestStream *st = NULL;
+  GList *codecs = NULL;
+  GstBus *bus;
+  GstMessage *message;
+  GError *error = NULL;
+  gboolean got_batch = FALSE, got_error = FALSE;
+
+  dat = setup_simple_conference (1, "fsrtpconference", "bob@127.0.0.1");
+  g_object_set (dat->conference, "batch-messages", TRUE, NULL);
+
+  st = simple_conference_add_stream (dat, dat, "rawudp", 0, NULL);
+
+  bus = gst_pipeline_get_bus (GST_PIPELINE (dat->pipeline));
+  while ((message = gst_bus_pop (bus)))
+    gst_message_unref (message);
+
+  g_object_get (dat->session, "codecs-without-config", &codecs, NULL);
+  fail_unless (fs_stream_set_remote_codecs (st->stream, codecs, &error));
+  fs_codec_list_destroy (codecs);
+
+  /* The main loop has not run, so the batch is still pending */
+  fs_session_emit_error (dat->session, FS_ERROR_INTERNAL, "Test error");
+
+  while ((message = gst_bus_pop (bus)))
+  {
+    const GstStructure *s = gst_message_get_structure (message);
+
+    if (s && gst_structure_has_name (s, "farstream-batch"))
+    {
+      ts_fail_if (got_error, "The batch was posted after the error");
+      got_batch = TRUE;
+    }
+    else if (s && gst_structure_has_name (s, "farstream-error"))
+    {
+      got_error = TRUE;
+    }
+    gst_message_unref (message);
+  }
+
+  ts_fail_unless (got_batch, "The pending batch was not posted");
+  ts_fail_unless (got_error, "The error was not posted");
+
+  gst_object_unref (bus);
+
+  cleanup_simple_conference (dat);
+}
+GST_END_TEST;
+
+
+GST_START_TEST (test_rtpconference_stream_stats)
+{
+  struct SimpleTestConference *dat = NULL;
+  struct SimpleTestStream *st = NULL;
+  GstStructure *stats = NULL;
+  const GstStructure *message_stats = NULL;
+  GstBus *bus;
+  GstMessage *message;
+  guint64 packets;
+  gboolean got_stats = FALSE;
+
+  dat = setup_simple_conference (1, "fsrtpconference", "bob@127.0.0.1");
+  st = simple_conference_add_stream (dat, dat, "rawudp", 0, NULL);
+
+  g_object_get (st->stream, "stats", &stats, NULL);
+  ts_fail_unless (stats != NULL, "Could not get the stream stats");
+  ts_fail_unless (gst_structure_get_uint64 (stats, "packets-received",
+          &packets) && packets == 0);
+  ts_fail_unless (gst_structure_has_field_typed (stats, "round-trip",
+          G_TYPE_UINT64));
+  gst_structure_free (stats);
+
+  bus = gst_pipeline_get_bus (GST_PIPELINE (dat->pipeline));
+
+  g_object_set (st->stream, "stats-interval", 10, NULL);
+
+  while (!got_stats &&
+      (message = gst_bus_timed_pop_filtered (bus, GST_SECOND,
+          GST_MESSAGE_ELEMENT)))
+  {
+    if (fs_stream_parse_stats (st->stream, message, &message_stats))
+    {
+      ts_fail_unless (gst_structure_has_field (message_stats, "bytes-sent"));
+      got_stats = TRUE;
+    }
+    gst_message_unref (message);
+  }
+  ts_fail_unless (got_stats, "No farstream-stream-stats message was posted");
+
+  g_object_set (st->stream, "stats-interval", 0, NULL);
+
+  gst_object_unref (bus);
+
+  cleanup_simple_conference (dat);
+}
+GST_END_TEST;
+
+
 GST_START_TEST (test_rtpconference_select_send_codec)
 {
   select_last_codec = TRUE;
@@ -1386,6 +1546,123 @@ GST_START_TEST (test_rtpconference_multicast_three_way_ssrc_assoc)
 }
 GST_END_TEST;
 
+static void
+_many_streams_element_added (FsElementAddedNotifier *notifier, GstBin *bin,
+    GstElement *element, gpointer user_data)
+{
+  guint *count = user_data;
+
+  ts_fail_if (g_object_get_data (G_OBJECT (element), "notified") != NULL,
+      "Element %s was notified twice", GST_OBJECT_NAME (element));
+  g_object_set_data (G_OBJECT (element), "notified", GINT_TO_POINTER (1));
+
+  (*count)++;
+}
+
+GST_START_TEST (test_rtpconference_many_streams_notifier)
+{
+  struct SimpleTestConference *dat = NULL;
+  FsElementAddedNotifier *notifier;
+  guint count = 0;
+  guint i;
+
+  dat = setup_simple_conference (1, "fsrtpconference", "bob@127.0.0.1");
+
+  notifier = fs_element_added_notifier_new ();
+  fs_element_added_notifier_set_default_properties (notifier,
+      dat->conference);
+  g_signal_connect (notifier, "element-added",
+      G_CALLBACK (_many_streams_element_added), &count);
+  fs_element_added_notifier_add (notifier, GST_BIN (dat->pipeline));
+
+  /* Every element already in the pipeline is notified once */
+  fail_unless (count > 0, "The existing elements were not notified");
+
+  /* Each new element must only be notified once, however many bins are
+   * already watched */
+  for (i = 0; i < 100; i++)
+    simple_conference_add_stream (dat, dat, "shm", 0, NULL);
+
+  fail_unless (fs_element_added_notifier_remove (notifier,
+          GST_BIN (dat->pipeline)));
+  g_object_unref (notifier);
+
+  cleanup_simple_conference (dat);
+}
+GST_END_TEST;
+
+struct ContentionData {
+  FsStream *stream;
+  volatile gint stop;
+  volatile gint rounds;
+};
+
+static gpointer
+_renegotiate_thread (gpointer user_data)
+{
+  struct ContentionData *cd = user_data;
+  GList *codecs[2] = {NULL, NULL};
+
+  codecs[0] = g_list_append (codecs[0],
+      fs_codec_new (0, "PCMU", FS_MEDIA_TYPE_AUDIO, 8000));
+  codecs[0] = g_list_append (codecs[0],
+      fs_codec_new (8, "PCMA", FS_MEDIA_TYPE_AUDIO, 8000));
+  codecs[1] = g_list_append (codecs[1],
+      fs_codec_new (8, "PCMA", FS_MEDIA_TYPE_AUDIO, 8000));
+  codecs[1] = g_list_append (codecs[1],
+      fs_codec_new (0, "PCMU", FS_MEDIA_TYPE_AUDIO, 8000));
+
+  while (!g_atomic_int_get (&cd->stop))
+  {
+    GError *error = NULL;
+
+    fs_stream_set_remote_codecs (cd->stream, codecs[cd->rounds % 2], &error);
+    g_clear_error (&error);
+    g_atomic_int_inc (&cd->rounds);
+  }
+
+  fs_codec_list_destroy (codecs[0]);
+  fs_codec_list_destroy (codecs[1]);
+
+  return NULL;
+}
+
+GST_START_TEST (test_rtpconference_lock_contention)
+{
+  struct SimpleTestConference *dat = NULL;
+  struct SimpleTestStream *st = NULL;
+  struct ContentionData cd = {NULL, 0, 0};
+  GThread *thread;
+  guint i;
+
+  dat = setup_simple_conference (1, "fsrtpconference", "bob@127.0.0.1");
+
+  st = simple_conference_add_stream (dat, dat, "shm", 0, NULL);
+  cd.stream = st->stream;
+
+  thread = g_thread_create (_renegotiate_thread, &cd, TRUE, NULL);
+  fail_if (thread == NULL);
+
+  for (i = 0; i < 50; i++)
+  {
+    struct SimpleTestStream *new_st;
+
+    new_st = simple_conference_add_stream (dat, dat, "shm", 0, NULL);
+    fail_unless (new_st->stream != NULL,
+        "Could not add stream %u during the renegotiations", i);
+  }
+
+  /* The renegotiations must not have been blocked by the new streams */
+  while (g_atomic_int_get (&cd.rounds) < 2)
+    g_thread_yield ();
+
+  g_atomic_int_set (&cd.stop, 1);
+  g_thread_join (thread);
+
+  cleanup_simple_conference (dat);
+}
+GST_END_TEST;
+
 #if 0
 static void
 min_timeout (TCase *tc_chain, guint min)
@@ -1526,10 +1803,27 @@ fsrtpconference_suite (void)
   tcase_add_test (tc_chain, test_rtpconference_ten_way);
   suite_add_tcase (s, tc_chain);
 
+  tc_chain = tcase_create ("fsrtpconference_many_streams_notifier");
+  tcase_add_test (tc_chain, test_rtpconference_many_streams_notifier);
+  suite_add_tcase (s, tc_chain);
+
+  tc_chain = tcase_create ("fsrtpconference_lock_contention");
+  tcase_add_test (tc_chain, test_rtpconference_lock_contention);
+  suite_add_tcase (s, tc_chain);
+
   tc_chain = tcase_create ("fsrtpconference_errors");
   tcase_add_test (tc_chain, test_rtpconference_errors);
   suite_add_tcase (s, tc_chain);
 
+  tc_chain = tcase_create ("fsrtpconference_batch_messages");
+  tcase_add_test (tc_chain, test_rtpconference_batch_messages);
+  tcase_add_test (tc_chain, test_rtpconference_batch_before_error);
+  suite_add_tcase (s, tc_chain);
+
+  tc_chain = tcase_create ("fsrtpconference_stream_stats");
+  tcase_add_test (tc_chain, test_rtpconference_stream_stats);
+  suite_add_tcase (s, tc_chain);
+
   tc_chain = tcase_create ("fsrtpconference_select_send_codec");
   tcase_add_test (tc_chain, test_rtpconference_select_send_codec);
   suite_add_tcase (s, tc_chain);
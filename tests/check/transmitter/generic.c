@@ -138,6 +138,24 @@ setup_pipeline (FsTransmitter *trans, GCallback cb)
   return pipeline;
 }
 
+/* Returns the number of threads in the process, or 0 if it is unknown */
+
+guint
+count_threads (void)
+{
+  GDir *dir = g_dir_open ("/proc/self/task", 0, NULL);
+  guint count = 0;
+
+  if (!dir)
+    return 0;
+
+  while (g_dir_read_name (dir))
+    count++;
+  g_dir_close (dir);
+
+  return count;
+}
+
 
 gboolean
 bus_error_callback (GstBus *bus, GstMessage *message, gpointer user_data)
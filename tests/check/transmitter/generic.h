@@ -38,6 +38,8 @@ gboolean bus_error_callback (GstBus *bus, GstMessage *message,
 
 void test_transmitter_creation (gchar *transmitter_name);
 
+guint count_threads (void);
+
 extern GPid stund_pid;
 
 void setup_stund (void);
@@ -23,6 +23,13 @@
 #endif
 
 #include <gst/check/gstcheck.h>
+
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <errno.h>
 #include <farstream/fs-transmitter.h>
 #include <farstream/fs-conference.h>
 
@@ -277,6 +284,253 @@ GST_START_TEST (test_multicasttransmitter_sending_half)
 GST_END_TEST;
 
 
+static FsStreamTransmitter *
+_join_group (FsTransmitter *trans, const gchar *group, guint8 ttl)
+{
+  GError *error = NULL;
+  FsStreamTransmitter *st;
+  FsCandidate *cand;
+  GList *candidates;
+
+  st = fs_transmitter_new_stream_transmitter (trans, NULL, 0, NULL, &error);
+  fail_if (st == NULL, "Could not create stream transmitter: %s",
+      error ? error->message : "");
+
+  cand = fs_candidate_new ("L1", FS_COMPONENT_RTP,
+      FS_CANDIDATE_TYPE_MULTICAST, FS_NETWORK_PROTOCOL_UDP, group, 4322);
+  cand->ttl = ttl;
+  candidates = g_list_prepend (NULL, cand);
+
+  fail_unless (fs_stream_transmitter_force_remote_candidates (st, candidates,
+          &error), "Could not join %s: %s", group,
+      error ? error->message : "");
+  fs_candidate_list_destroy (candidates);
+
+  return st;
+}
+
+/* Returns: the number of open file descriptors, or -1 if unknown */
+
+static gint
+_count_fds (void)
+{
+  GDir *dir = g_dir_open ("/proc/self/fd", 0, NULL);
+  gint fds = 0;
+
+  if (!dir)
+    return -1;
+
+  while (g_dir_read_name (dir))
+    fds++;
+  g_dir_close (dir);
+
+  return fds;
+}
+
+GST_START_TEST (test_multicasttransmitter_many_groups)
+{
+  GError *error = NULL;
+  FsTransmitter *trans;
+  FsStreamTransmitter **sts;
+  FsStreamTransmitter *extra_st;
+  struct rlimit limit;
+  guint groups = 1000;
+  guint i;
+  gint fds_before, fds_joined, fds;
+
+  /* Every group uses a socket, leave some room for the rest */
+  if (getrlimit (RLIMIT_NOFILE, &limit) == 0 &&
+      limit.rlim_cur != RLIM_INFINITY && limit.rlim_cur < groups + 64)
+    groups = limit.rlim_cur > 128 ? limit.rlim_cur - 64 : 64;
+
+  trans = fs_transmitter_new ("multicast", 1, 0, &error);
+  fail_if (trans == NULL, "Could not create transmitter: %s",
+      error ? error->message : "");
+
+  sts = g_new0 (FsStreamTransmitter *, groups);
+  fds_before = _count_fds ();
+
+  for (i = 0; i < groups; i++)
+  {
+    gchar *group = g_strdup_printf ("239.255.%u.%u", i / 250, i % 250 + 1);
+    sts[i] = _join_group (trans, group, (i % 3) + 1);
+    g_free (group);
+  }
+  fds_joined = _count_fds ();
+
+  /* Joining an existing group reuses its socket */
+  extra_st = _join_group (trans, "239.255.0.1", 4);
+  fds = _count_fds ();
+  fail_unless (fds == fds_joined,
+      "Joining an existing group opened %d file descriptors",
+      fds - fds_joined);
+  g_object_unref (extra_st);
+
+  for (i = 0; i < groups; i++)
+    g_object_unref (sts[i]);
+
+  /* Leaving every group closes all the sockets that were opened for them */
+  fds = _count_fds ();
+  fail_unless (fds <= fds_before,
+      "%d file descriptors are still open after leaving all the groups",
+      fds - fds_before);
+
+  g_free (sts);
+  g_object_unref (trans);
+}
+GST_END_TEST;
+
+/* 239.255.100.0 */
+#define SHARED_GROUP_BASE 0xEFFF6400
+
+static volatile gint shared_received = 0;
+static gint shared_expected = 0;
+/* Packets received per group, the group index is the payload */
+static volatile gint *shared_group_received = NULL;
+static guint shared_groups = 0;
+
+static void
+_shared_handoff_handler (GstElement *element, GstBuffer *buffer, GstPad *pad,
+  gpointer user_data)
+{
+  guint32 index;
+
+  ts_fail_unless (GST_BUFFER_SIZE (buffer) >= sizeof (index),
+      "Got a %u bytes packet", GST_BUFFER_SIZE (buffer));
+  memcpy (&index, GST_BUFFER_DATA (buffer), sizeof (index));
+  index = ntohl (index);
+  ts_fail_unless (index < shared_groups, "Got a packet for group %u", index);
+
+  g_atomic_int_inc (&shared_group_received[index]);
+
+  if (g_atomic_int_add (&shared_received, 1) + 1 ==
+      shared_expected)
+    g_main_loop_quit (loop);
+}
+
+static gboolean
+_shared_timeout (gpointer user_data)
+{
+  g_main_loop_quit (loop);
+  return FALSE;
+}
+
+/*
+ * Returns: the number of streaming threads used to receive the groups
+ */
+
+static guint
+run_many_groups_receive (gboolean shared_receive, guint groups,
+    guint packets_per_group)
+{
+  GError *error = NULL;
+  FsTransmitter *trans;
+  FsStreamTransmitter **sts;
+  GstBus *bus;
+  guint threads_before, threads;
+  gint sock;
+  guchar ttl = 1;
+  guint i, j;
+  guint timeout_id;
+
+  loop = g_main_loop_new (NULL, FALSE);
+  shared_received = 0;
+  shared_expected = groups * packets_per_group;
+  shared_groups = groups;
+  shared_group_received = g_new0 (gint, groups);
+
+  trans = fs_transmitter_new ("multicast", 2, 0, &error);
+  fail_if (trans == NULL, "Could not create transmitter: %s",
+      error ? error->message : "");
+  g_object_set (trans, "shared-receive", shared_receive, NULL);
+
+  pipeline = setup_pipeline (trans, G_CALLBACK (_shared_handoff_handler));
+  bus = gst_element_get_bus (pipeline);
+  gst_bus_add_watch (bus, bus_error_callback, NULL);
+  gst_object_unref (bus);
+
+  threads_before = count_threads ();
+
+  sts = g_new0 (FsStreamTransmitter *, groups);
+  for (i = 0; i < groups; i++)
+  {
+    struct in_addr group;
+
+    group.s_addr = htonl (SHARED_GROUP_BASE + i + 1);
+    sts[i] = _join_group (trans, inet_ntoa (group), 1);
+    g_object_set (sts[i], "sending", FALSE, NULL);
+  }
+
+  fail_if (gst_element_set_state (pipeline, GST_STATE_PLAYING) ==
+      GST_STATE_CHANGE_FAILURE, "Could not set the pipeline to playing");
+  gst_element_get_state (pipeline, NULL, NULL, GST_CLOCK_TIME_NONE);
+  threads = count_threads ();
+
+  sock = socket (AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  fail_if (sock < 0);
+  setsockopt (sock, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof (ttl));
+
+  for (j = 0; j < packets_per_group; j++)
+  {
+    for (i = 0; i < groups; i++)
+    {
+      struct sockaddr_in addr;
+      guint32 buf[3] = { htonl (i), 0, 0 };
+
+      memset (&addr, 0, sizeof (addr));
+      addr.sin_family = AF_INET;
+      addr.sin_port = htons (4322);
+      addr.sin_addr.s_addr = htonl (SHARED_GROUP_BASE + i + 1);
+      fail_if (sendto (sock, buf, sizeof (buf), 0, (struct sockaddr *) &addr,
+              sizeof (addr)) < 0, "Could not send: %s", g_strerror (errno));
+    }
+    /* Don't overflow the socket buffers */
+    g_usleep (G_USEC_PER_SEC / 100);
+  }
+
+  timeout_id = g_timeout_add_seconds (10, _shared_timeout, NULL);
+  if (g_atomic_int_get (&shared_received) < shared_expected)
+    g_main_loop_run (loop);
+  g_source_remove (timeout_id);
+
+  close (sock);
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+
+  /* Some packets may be dropped, but every group must have been received */
+  for (i = 0; i < groups; i++)
+    fail_unless (g_atomic_int_get (&shared_group_received[i]) > 0,
+        "%s: nothing received from group %u of %u",
+        shared_receive ? "Shared socket" : "Socket per group", i, groups);
+
+  for (i = 0; i < groups; i++)
+    g_object_unref (sts[i]);
+  g_free (sts);
+  g_object_unref (trans);
+  gst_object_unref (pipeline);
+  g_main_loop_unref (loop);
+  g_free ((gint *) shared_group_received);
+  shared_group_received = NULL;
+
+  return threads - threads_before;
+}
+
+GST_START_TEST (test_multicasttransmitter_shared_receive)
+{
+  guint per_group_threads;
+  guint shared_threads;
+
+  /* More groups than one socket can join on Linux (20), so the shared mode
+   * needs more than one socket */
+  per_group_threads = run_many_groups_receive (FALSE, 256, 10);
+  shared_threads = run_many_groups_receive (TRUE, 256, 10);
+
+  fail_unless (shared_threads < per_group_threads,
+      "The shared sockets used %u streaming threads, %u without sharing",
+      shared_threads, per_group_threads);
+}
+GST_END_TEST;
+
 
 static Suite *
 multicasttransmitter_suite (void)
@@ -314,6 +568,14 @@ multicasttransmitter_suite (void)
   tcase_add_test (tc_chain, test_multicasttransmitter_sending_half);
   suite_add_tcase (s, tc_chain);
 
+  tc_chain = tcase_create ("multicast_transmitter_many_groups");
+  tcase_add_test (tc_chain, test_multicasttransmitter_many_groups);
+  suite_add_tcase (s, tc_chain);
+
+  tc_chain = tcase_create ("multicast_transmitter_shared_receive");
+  tcase_add_test (tc_chain, test_multicasttransmitter_shared_receive);
+  suite_add_tcase (s, tc_chain);
+
   return s;
 }
 
@@ -49,6 +49,8 @@ volatile gint running = TRUE;
 gboolean associate_on_source = TRUE;
 gboolean is_address_local = FALSE;
 gboolean force_candidates = FALSE;
+volatile gint agent_events = 0;
+volatile gint stats_messages = 0;
 
 GStaticMutex count_mutex = G_STATIC_MUTEX_INIT;
 
@@ -65,6 +67,8 @@ _new_local_candidate (FsStreamTransmitter *st, FsCandidate *candidate,
   GST_DEBUG ("Has local candidate %s:%u of type %d",
     candidate->ip, candidate->port, candidate->type);
 
+  g_atomic_int_inc (&agent_events);
+
   ts_fail_if (candidate == NULL, "Passed NULL candidate");
   ts_fail_unless (candidate->ip != NULL, "Null IP in candidate");
   ts_fail_if (candidate->port == 0, "Candidate has port 0");
@@ -168,6 +172,8 @@ _local_candidates_prepared (FsStreamTransmitter *st, gpointer user_data)
 
   g_object_set_data (G_OBJECT (st), "candidates", NULL);
 
+  g_atomic_int_inc (&agent_events);
+
   ts_fail_if (g_list_length (candidates) < 2,
       "We don't have at least 2 candidates");
 
@@ -190,6 +196,8 @@ _new_active_candidate_pair (FsStreamTransmitter *st, FsCandidate *local,
     "Local and remote candidates dont have the same component id");
 
   GST_DEBUG ("New active candidate pair");
+
+  g_atomic_int_inc (&agent_events);
 }
 
 static void
@@ -294,6 +302,8 @@ _stream_state_changed (FsStreamTransmitter *st, guint component,
   gchar *prop = NULL;
   FsStreamState oldstate = 0;
 
+  g_atomic_int_inc (&agent_events);
+
   enumclass = g_type_class_ref (FS_TYPE_STREAM_STATE);
   enumvalue = g_enum_get_value (enumclass, state);
 
@@ -348,6 +358,43 @@ check_running (gpointer data)
   return FALSE;
 }
 
+static GstBusSyncReply
+_stats_sync_handler (GstBus *bus, GstMessage *message, gpointer user_data)
+{
+  const GstStructure *s;
+  guint component;
+  guint64 packets, bytes;
+
+  if (GST_MESSAGE_TYPE (message) != GST_MESSAGE_ELEMENT)
+    return GST_BUS_PASS;
+
+  s = gst_message_get_structure (message);
+  if (!gst_structure_has_name (s, "farstream-component-stats"))
+    return GST_BUS_PASS;
+
+  g_atomic_int_inc (&stats_messages);
+
+  ts_fail_unless (gst_structure_get_uint (s, "component", &component));
+
+  /* The fakesrc sends buffers of component * 10 bytes */
+  ts_fail_unless (gst_structure_get_uint64 (s, "packets-sent", &packets));
+  ts_fail_unless (gst_structure_get_uint64 (s, "bytes-sent", &bytes));
+  ts_fail_unless (bytes == packets * component * 10,
+      "Sent %" G_GUINT64_FORMAT " bytes in %" G_GUINT64_FORMAT " packets"
+      " on component %u", bytes, packets, component);
+
+  ts_fail_unless (gst_structure_get_uint64 (s, "packets-received", &packets));
+  ts_fail_unless (gst_structure_get_uint64 (s, "bytes-received", &bytes));
+  ts_fail_unless (bytes == packets * component * 10,
+      "Received %" G_GUINT64_FORMAT " bytes in %" G_GUINT64_FORMAT
+      " packets on component %u", bytes, packets, component);
+
+  ts_fail_unless (gst_structure_has_field_typed (s, "media-idle-time",
+          G_TYPE_UINT64));
+
+  return GST_BUS_PASS;
+}
+
 typedef FsParticipant FsNiceTestParticipant;
 typedef FsParticipantClass FsNiceTestParticipantClass;
 
@@ -392,6 +439,8 @@ run_nice_transmitter_test (gint n_parameters, GParameter *params,
   associate_on_source = !(flags & FLAG_NO_SOURCE);
   is_address_local = (flags & FLAG_IS_LOCAL);
   force_candidates = (flags & FLAG_FORCE_CANDIDATES);
+  agent_events = 0;
+  stats_messages = 0;
 
   if (flags & FLAG_RECVONLY_FILTER)
     ts_fail_unless (fs_fake_filter_register ());
@@ -436,10 +485,12 @@ run_nice_transmitter_test (gint n_parameters, GParameter *params,
 
   bus = gst_element_get_bus (pipeline);
   gst_bus_add_watch (bus, bus_error_callback, NULL);
+  gst_bus_set_sync_handler (bus, _stats_sync_handler, NULL);
   gst_object_unref (bus);
 
   bus = gst_element_get_bus (pipeline2);
   gst_bus_add_watch (bus, bus_error_callback, NULL);
+  gst_bus_set_sync_handler (bus, _stats_sync_handler, NULL);
   gst_object_unref (bus);
 
   /*
@@ -539,6 +590,23 @@ run_nice_transmitter_test (gint n_parameters, GParameter *params,
   fs_stream_transmitter_stop (st);
   fs_stream_transmitter_stop (st2);
 
+  {
+    guint dispatches1, dispatches2;
+
+    g_object_get (st, "event-dispatches", &dispatches1, NULL);
+    g_object_get (st2, "event-dispatches", &dispatches2, NULL);
+
+    GST_DEBUG ("%u agent events in %u dispatches",
+        g_atomic_int_get (&agent_events), dispatches1 + dispatches2);
+
+    ts_fail_if (dispatches1 == 0 || dispatches2 == 0,
+        "The agent events were never dispatched");
+    ts_fail_unless (dispatches1 + dispatches2 <=
+        g_atomic_int_get (&agent_events),
+        "More dispatches (%u) than agent events (%d)",
+        dispatches1 + dispatches2, g_atomic_int_get (&agent_events));
+  }
+
   gst_element_set_state (pipeline, GST_STATE_NULL);
   gst_element_get_state (pipeline, NULL, NULL, GST_CLOCK_TIME_NONE);
 
@@ -580,6 +648,21 @@ GST_START_TEST (test_nicetransmitter_no_associate_on_source)
 }
 GST_END_TEST;
 
+GST_START_TEST (test_nicetransmitter_component_stats)
+{
+  GParameter param = {NULL, {0}};
+
+  param.name = "stats-interval";
+  g_value_init (&param.value, G_TYPE_UINT);
+  g_value_set_uint (&param.value, 10);
+
+  run_nice_transmitter_test (1, &param, 0);
+
+  ts_fail_if (g_atomic_int_get (&stats_messages) == 0,
+      "No component stats were posted");
+}
+GST_END_TEST;
+
 GST_START_TEST (test_nicetransmitter_preferred_candidates)
 {
   GParameter param = {NULL, {0}};
@@ -870,6 +953,161 @@ GST_START_TEST (test_nicetransmitter_sending_half)
 }
 GST_END_TEST;
 
+#define POOL_THREADS 4
+#define POOL_AGENTS 500
+
+GST_START_TEST (test_nicetransmitter_agent_thread_pool)
+{
+  FsTransmitter *trans;
+  FsStreamTransmitter **sts;
+  FsNiceTestParticipant **ps;
+  GValueArray *loads;
+  GError *error = NULL;
+  guint threads_before, threads_after;
+  guint total = 0;
+  guint i;
+
+  trans = fs_transmitter_new ("nice", 2, 0, &error);
+  ts_fail_if (trans == NULL);
+  ts_fail_unless (error == NULL);
+
+  g_object_set (trans, "agent-threads", POOL_THREADS, NULL);
+
+  sts = g_new0 (FsStreamTransmitter *, POOL_AGENTS);
+  ps = g_new0 (FsNiceTestParticipant *, POOL_AGENTS);
+
+  threads_before = count_threads ();
+
+  /* Every participant gets its own agent */
+  for (i = 0; i < POOL_AGENTS; i++)
+  {
+    ps[i] = g_object_new (fs_nice_test_participant_get_type (), NULL);
+    sts[i] = fs_transmitter_new_stream_transmitter (trans,
+        FS_PARTICIPANT (ps[i]), 0, NULL, &error);
+    ts_fail_unless (sts[i] != NULL, "Could not create stream transmitter: %s",
+        error ? error->message : "");
+  }
+
+  threads_after = count_threads ();
+
+  g_object_get (trans, "agent-thread-loads", &loads, NULL);
+  ts_fail_unless (loads->n_values == POOL_THREADS);
+  for (i = 0; i < loads->n_values; i++)
+  {
+    guint load = g_value_get_uint (g_value_array_get_nth (loads, i));
+
+    ts_fail_unless (load == POOL_AGENTS / POOL_THREADS,
+        "Agent thread %u runs %u agents", i, load);
+    total += load;
+  }
+  ts_fail_unless (total == POOL_AGENTS);
+
+  /* The pool threads may have been started by an earlier test */
+  if (threads_before)
+    ts_fail_unless (threads_after - threads_before <= POOL_THREADS,
+        "%u agents created %u threads", POOL_AGENTS,
+        threads_after - threads_before);
+  g_value_array_free (loads);
+
+  for (i = 0; i < POOL_AGENTS; i++)
+  {
+    fs_stream_transmitter_stop (sts[i]);
+    g_object_unref (sts[i]);
+    g_object_unref (ps[i]);
+  }
+
+  g_object_get (trans, "agent-thread-loads", &loads, NULL);
+  for (i = 0; i < loads->n_values; i++)
+    ts_fail_unless (g_value_get_uint (g_value_array_get_nth (loads, i)) == 0);
+  g_value_array_free (loads);
+
+  g_free (sts);
+  g_free (ps);
+  g_object_unref (trans);
+}
+GST_END_TEST;
+
+
+#define TOGGLES 200
+
+static void
+_sink_element_added (GstBin *bin, GstElement *element, gpointer user_data)
+{
+  guint *added = user_data;
+
+  (*added)++;
+}
+
+static void
+run_sending_toggles (gboolean permanent, guint *elements_added)
+{
+  FsTransmitter *trans;
+  FsStreamTransmitter *st;
+  FsNiceTestParticipant *p;
+  GstElement *pipeline;
+  GstElement *gst_sink;
+  GError *error = NULL;
+  guint i;
+
+  trans = fs_transmitter_new ("nice", 2, 0, &error);
+  ts_fail_if (trans == NULL);
+  ts_fail_unless (error == NULL);
+
+  g_object_set (trans,
+      "permanent-sinks", permanent,
+      "keyunit-suppress-window", 1000,
+      NULL);
+
+  pipeline = setup_pipeline (trans, NULL);
+
+  ts_fail_if (gst_element_set_state (pipeline, GST_STATE_PLAYING) ==
+      GST_STATE_CHANGE_FAILURE, "Could not set the pipeline to playing");
+
+  p = g_object_new (fs_nice_test_participant_get_type (), NULL);
+  st = fs_transmitter_new_stream_transmitter (trans, FS_PARTICIPANT (p), 0,
+      NULL, &error);
+  ts_fail_unless (st != NULL, "Could not create stream transmitter: %s",
+      error ? error->message : "");
+
+  g_object_get (trans, "gst-sink", &gst_sink, NULL);
+  *elements_added = 0;
+  g_signal_connect (gst_sink, "element-added",
+      G_CALLBACK (_sink_element_added), elements_added);
+
+  for (i = 0; i < TOGGLES; i++)
+  {
+    g_object_set (st, "sending", FALSE, NULL);
+    g_object_set (st, "sending", TRUE, NULL);
+  }
+
+  g_signal_handlers_disconnect_by_func (gst_sink, _sink_element_added,
+      elements_added);
+  gst_object_unref (gst_sink);
+
+  fs_stream_transmitter_stop (st);
+  g_object_unref (st);
+  g_object_unref (p);
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_element_get_state (pipeline, NULL, NULL, GST_CLOCK_TIME_NONE);
+  gst_object_unref (pipeline);
+  g_object_unref (trans);
+}
+
+GST_START_TEST (test_nicetransmitter_sending_toggle)
+{
+  guint added_relink, added_permanent;
+
+  run_sending_toggles (FALSE, &added_relink);
+  run_sending_toggles (TRUE, &added_permanent);
+
+  ts_fail_unless (added_relink >= TOGGLES,
+      "The sinks were only re-added %u times for %u toggles", added_relink,
+      TOGGLES);
+  ts_fail_unless (added_permanent == 0,
+      "%u elements were added with permanent sinks", added_permanent);
+}
+GST_END_TEST;
 
 static Suite *
 nicetransmitter_suite (void)
@@ -894,6 +1132,10 @@ nicetransmitter_suite (void)
   tcase_add_test (tc_chain, test_nicetransmitter_no_associate_on_source);
   suite_add_tcase (s, tc_chain);
 
+  tc_chain = tcase_create ("nicetransmitter-component-stats");
+  tcase_add_test (tc_chain, test_nicetransmitter_component_stats);
+  suite_add_tcase (s, tc_chain);
+
   tc_chain = tcase_create ("nicetransmitter-preferred-candidates");
   tcase_add_test (tc_chain, test_nicetransmitter_preferred_candidates);
   suite_add_tcase (s, tc_chain);
@@ -922,6 +1164,14 @@ nicetransmitter_suite (void)
   tcase_add_test (tc_chain, test_nicetransmitter_sending_half);
   suite_add_tcase (s, tc_chain);
 
+  tc_chain = tcase_create ("nicetransmitter-sending-toggle");
+  tcase_add_test (tc_chain, test_nicetransmitter_sending_toggle);
+  suite_add_tcase (s, tc_chain);
+
+  tc_chain = tcase_create ("nicetransmitter-agent-thread-pool");
+  tcase_add_test (tc_chain, test_nicetransmitter_agent_thread_pool);
+  suite_add_tcase (s, tc_chain);
+
   return s;
 }
 
@@ -876,6 +876,188 @@ GST_START_TEST (test_rawudptransmitter_run_stun_altern_to_nowhere)
 }
 GST_END_TEST;
 
+/*
+ * The first server does not exist, the reply from the second one (which
+ * redirects to stund) must be used without waiting for the first to time out
+ */
+
+GST_START_TEST (test_rawudptransmitter_run_parallel_stun)
+{
+  GParameter params[5];
+  GValueArray *servers;
+  GValue val = {0};
+
+  if (stund_pid <= 0 || stun_alternd_data == NULL)
+    return;
+
+  memset (params, 0, sizeof (GParameter) * 5);
+
+  params[0].name = "stun-ip";
+  g_value_init (&params[0].value, G_TYPE_STRING);
+  g_value_set_static_string (&params[0].value, "127.0.0.1");
+
+  params[1].name = "stun-port";
+  g_value_init (&params[1].value, G_TYPE_UINT);
+  g_value_set_uint (&params[1].value, 7777);
+
+  servers = g_value_array_new (1);
+  g_value_init (&val, GST_TYPE_STRUCTURE);
+  gst_value_take_structure (&val, gst_structure_new ("stun-server",
+          "ip", G_TYPE_STRING, "127.0.0.1",
+          "port", G_TYPE_UINT, 3480,
+          NULL));
+  g_value_array_append (servers, &val);
+  g_value_unset (&val);
+
+  params[2].name = "stun-servers";
+  g_value_init (&params[2].value, G_TYPE_VALUE_ARRAY);
+  g_value_take_boxed (&params[2].value, servers);
+
+  params[3].name = "stun-timeout";
+  g_value_init (&params[3].value, G_TYPE_UINT);
+  g_value_set_uint (&params[3].value, 10);
+
+  params[4].name = "upnp-discovery";
+  g_value_init (&params[4].value, G_TYPE_BOOLEAN);
+  g_value_set_boolean (&params[4].value, FALSE);
+
+  run_rawudp_transmitter_test (5, params, FLAG_HAS_STUN);
+
+  g_value_unset (&params[2].value);
+}
+GST_END_TEST;
+
+static void
+_count_srflx_candidate (FsStreamTransmitter *st, FsCandidate *candidate,
+    gpointer user_data)
+{
+  gint *count = user_data;
+
+  GST_DEBUG ("Has local candidate %s:%u of type %d",
+      candidate->ip, candidate->port, candidate->type);
+
+  ts_fail_unless (candidate->type == FS_CANDIDATE_TYPE_SRFLX,
+      "Candidate %s:%u on component %u is not server reflexive",
+      candidate->ip, candidate->port, candidate->component_id);
+
+  g_atomic_int_inc (count);
+}
+
+static FsStreamTransmitter *
+_new_cached_stun_stream (FsTransmitter *trans, gint *count)
+{
+  GError *error = NULL;
+  FsStreamTransmitter *st;
+  GParameter params[5];
+  GList *candidates = NULL;
+
+  memset (params, 0, sizeof (GParameter) * 5);
+
+  params[0].name = "stun-ip";
+  g_value_init (&params[0].value, G_TYPE_STRING);
+  g_value_set_static_string (&params[0].value, "127.0.0.1");
+
+  params[1].name = "stun-port";
+  g_value_init (&params[1].value, G_TYPE_UINT);
+  g_value_set_uint (&params[1].value, 3478);
+
+  params[2].name = "stun-timeout";
+  g_value_init (&params[2].value, G_TYPE_UINT);
+  g_value_set_uint (&params[2].value, 5);
+
+  params[3].name = "upnp-discovery";
+  g_value_init (&params[3].value, G_TYPE_BOOLEAN);
+  g_value_set_boolean (&params[3].value, FALSE);
+
+  candidates = g_list_prepend (candidates, fs_candidate_new ("L1",
+          FS_COMPONENT_RTCP, FS_CANDIDATE_TYPE_HOST, FS_NETWORK_PROTOCOL_UDP,
+          NULL, RTCP_PORT));
+  candidates = g_list_prepend (candidates, fs_candidate_new ("L1",
+          FS_COMPONENT_RTP, FS_CANDIDATE_TYPE_HOST, FS_NETWORK_PROTOCOL_UDP,
+          NULL, RTP_PORT));
+
+  params[4].name = "preferred-local-candidates";
+  g_value_init (&params[4].value, FS_TYPE_CANDIDATE_LIST);
+  g_value_take_boxed (&params[4].value, candidates);
+
+  st = fs_transmitter_new_stream_transmitter (trans, NULL, 5, params, &error);
+
+  g_value_unset (&params[4].value);
+
+  if (error)
+    ts_fail ("Error creating stream transmitter: (%s:%d) %s",
+        g_quark_to_string (error->domain), error->code, error->message);
+
+  ts_fail_unless (g_signal_connect (st, "new-local-candidate",
+          G_CALLBACK (_count_srflx_candidate), count),
+      "Could not connect new-local-candidate signal");
+  ts_fail_unless (g_signal_connect (st, "error",
+          G_CALLBACK (stream_transmitter_error), NULL),
+      "Could not connect error signal");
+
+  if (!fs_stream_transmitter_gather_local_candidates (st, &error))
+    ts_fail ("Could not start gathering local candidates: %s",
+        error ? error->message : "(no error)");
+
+  return st;
+}
+
+static void
+_wait_for_count (volatile gint *count, gint value)
+{
+  gint i;
+
+  for (i = 0; i < 400 && g_atomic_int_get (count) < value; i++)
+    g_usleep (10 * 1000);
+}
+
+/*
+ * The second stream re-uses the ports of the first one after the STUN
+ * server has gone away, it must get the address from the cache
+ */
+
+GST_START_TEST (test_rawudptransmitter_stun_cache)
+{
+  GError *error = NULL;
+  FsTransmitter *trans;
+  FsStreamTransmitter *st1, *st2;
+  volatile gint count1 = 0, count2 = 0;
+
+  if (stund_pid <= 0)
+    return;
+
+  trans = fs_transmitter_new ("rawudp", 2, 0, &error);
+  if (error)
+    ts_fail ("Error creating transmitter: (%s:%d) %s",
+        g_quark_to_string (error->domain), error->code, error->message);
+
+  pipeline = setup_pipeline (trans, G_CALLBACK (_handoff_handler_empty));
+  ts_fail_if (gst_element_set_state (pipeline, GST_STATE_PLAYING) ==
+      GST_STATE_CHANGE_FAILURE, "Could not set the pipeline to playing");
+
+  st1 = _new_cached_stun_stream (trans, (gint *) &count1);
+  _wait_for_count (&count1, 2);
+  ts_fail_unless (g_atomic_int_get (&count1) == 2,
+      "Did not get the candidates from the STUN server");
+
+  teardown_stund ();
+
+  st2 = _new_cached_stun_stream (trans, (gint *) &count2);
+  _wait_for_count (&count2, 2);
+  ts_fail_unless (g_atomic_int_get (&count2) == 2,
+      "Did not get the cached STUN candidates");
+
+  fs_stream_transmitter_stop (st2);
+  g_object_unref (st2);
+  fs_stream_transmitter_stop (st1);
+  g_object_unref (st1);
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (pipeline);
+  g_object_unref (trans);
+}
+GST_END_TEST;
+
 GST_START_TEST (test_rawudptransmitter_strange_arguments)
 {
   FsTransmitter *trans = NULL;
@@ -1056,6 +1238,19 @@ rawudptransmitter_suite (void)
   tcase_add_test (tc_chain, test_rawudptransmitter_run_stun_altern_to_nowhere);
   suite_add_tcase (s, tc_chain);
 
+  tc_chain = tcase_create ("rawudptransmitter-parallel-stun");
+  tcase_set_timeout (tc_chain, 5);
+  tcase_add_checked_fixture (tc_chain, setup_stund_stunalternd,
+      teardown_stund_stunalternd);
+  tcase_add_test (tc_chain, test_rawudptransmitter_run_parallel_stun);
+  suite_add_tcase (s, tc_chain);
+
+  tc_chain = tcase_create ("rawudptransmitter-stun-cache");
+  tcase_set_timeout (tc_chain, 15);
+  tcase_add_checked_fixture (tc_chain, setup_stund, teardown_stund);
+  tcase_add_test (tc_chain, test_rawudptransmitter_stun_cache);
+  suite_add_tcase (s, tc_chain);
+
   tc_chain = tcase_create ("rawudptransmitter-strange-arguments");
   tcase_add_test (tc_chain, test_rawudptransmitter_strange_arguments);
   suite_add_tcase (s, tc_chain);
@@ -186,6 +186,64 @@ GST_START_TEST (test_bin_added_recursive)
 }
 GST_END_TEST;
 
+GST_START_TEST (test_bin_added_watched_bin)
+{
+  GstElement *pipeline = NULL;
+  GstElement *bin = NULL;
+  GstElement *identity = NULL;
+  FsElementAddedNotifier *notifier = NULL;
+
+  pipeline = gst_pipeline_new (NULL);
+
+  bin = gst_bin_new (NULL);
+  gst_object_ref (bin);
+
+  identity = gst_element_factory_make ("identity", NULL);
+  gst_object_ref (identity);
+
+  notifier = fs_element_added_notifier_new ();
+
+  g_signal_connect (notifier, "element-added",
+      G_CALLBACK (_added_cb), &last_added);
+
+  /* The bin is watched on its own first, then inside the pipeline */
+  fs_element_added_notifier_add (notifier, GST_BIN (bin));
+  fs_element_added_notifier_add (notifier, GST_BIN (pipeline));
+
+  called = FALSE;
+  last_added = last_bin = NULL;
+
+  fail_unless (gst_bin_add (GST_BIN (pipeline), bin),
+      "Could not add bin to pipeline");
+
+  fail_if (called == FALSE, "AddedCallback not called for a watched bin");
+  fail_unless (last_added == bin,
+      "The element passed to the callback was wrong"
+      " (it was %p, should have been %p",
+      last_added, bin);
+  fail_unless (last_bin == pipeline,
+      "The bin passed to the callback was wrong"
+      " (it was %p, should have been %p",
+      last_bin, pipeline);
+
+  gst_bin_remove (GST_BIN (pipeline), bin);
+
+  called = FALSE;
+  last_added = last_bin = NULL;
+
+  fail_unless (gst_bin_add (GST_BIN (bin), identity),
+      "Could not add identity to bin");
+
+  fail_if (called == TRUE, "The bin was removed from the pipeline,"
+      " but the callback was still called");
+
+  g_object_unref (notifier);
+  gst_object_unref (identity);
+  gst_object_unref (bin);
+  gst_object_unref (pipeline);
+}
+GST_END_TEST;
+
 static void
 test_keyfile (FsElementAddedNotifier *notifier)
 {
@@ -278,6 +336,75 @@ GST_START_TEST (test_bin_file)
 }
 GST_END_TEST;
 
+GST_START_TEST (test_bin_keyfile_many_elements)
+{
+  GKeyFile *keyfile = g_key_file_new ();
+  FsElementAddedNotifier *notifier = NULL;
+  GstElement *pipeline;
+  GstElement *bin;
+  GstIterator *iter;
+  gpointer item;
+  gboolean done = FALSE;
+  guint count = 0;
+  guint i;
+
+  g_key_file_set_boolean (keyfile, "identity", "sync", TRUE);
+  g_key_file_set_boolean (keyfile, "identity", "silent", TRUE);
+  g_key_file_set_integer (keyfile, "identity", "sleep-time", 0);
+  g_key_file_set_integer (keyfile, "identity", "error-after", -1);
+  g_key_file_set_boolean (keyfile, "identity", "invalid-property", TRUE);
+
+  notifier = fs_element_added_notifier_new ();
+  fs_element_added_notifier_set_properties_from_keyfile (notifier, keyfile);
+
+  pipeline = gst_pipeline_new (NULL);
+  bin = gst_bin_new (NULL);
+  gst_bin_add (GST_BIN (pipeline), bin);
+  fs_element_added_notifier_add (notifier, GST_BIN (pipeline));
+
+  for (i = 0; i < 1000; i++)
+  {
+    GstElement *identity = gst_element_factory_make ("identity", NULL);
+
+    fail_unless (gst_bin_add (GST_BIN (bin), identity),
+        "Could not add identity to bin");
+  }
+
+  /* The same plan must have been applied to every one of them */
+  iter = gst_bin_iterate_elements (GST_BIN (bin));
+  while (!done)
+  {
+    switch (gst_iterator_next (iter, &item))
+    {
+      case GST_ITERATOR_OK:
+        {
+          gboolean sync, silent;
+
+          g_object_get (item, "sync", &sync, "silent", &silent, NULL);
+          fail_unless (sync && silent, "Properties not set on %s",
+              GST_OBJECT_NAME (item));
+          gst_object_unref (item);
+          count++;
+        }
+        break;
+      case GST_ITERATOR_RESYNC:
+        gst_iterator_resync (iter);
+        count = 0;
+        break;
+      default:
+        done = TRUE;
+        break;
+    }
+  }
+  gst_iterator_free (iter);
+
+  fail_unless (count == 1000, "Only found %u of the 1000 elements", count);
+
+  g_object_unref (notifier);
+  gst_object_unref (pipeline);
+}
+GST_END_TEST;
+
 GST_START_TEST (test_bin_errors)
 {
   FsElementAddedNotifier *notifier = NULL;
@@ -311,8 +438,10 @@ binadded_suite (void)
   suite_add_tcase (s, tc_chain);
   tcase_add_test (tc_chain, test_bin_added_simple);
   tcase_add_test (tc_chain, test_bin_added_recursive);
+  tcase_add_test (tc_chain, test_bin_added_watched_bin);
   tcase_add_test (tc_chain, test_bin_keyfile);
   tcase_add_test (tc_chain, test_bin_file);
+  tcase_add_test (tc_chain, test_bin_keyfile_many_elements);
   tcase_add_test (tc_chain, test_bin_errors);
 
   return s;
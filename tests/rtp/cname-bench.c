@@ -0,0 +1,121 @@
+/* Farstream ad-hoc benchmark for associating SSRCs with participants
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <stdlib.h>
+
+#include <gst/gst.h>
+
+#include <farstream/fs-conference.h>
+
+#include "fs-rtp-conference.h"
+#include "fs-rtp-session.h"
+
+#define DEFAULT_SSRCS 10000
+
+/*
+ * Associates new SSRCs with the participants of a session from their
+ * CNAME, as is done when the first SDES of a SSRC is received. The cost
+ * per SSRC should not depend on the number of participants.
+ */
+
+static void
+time_association (guint participants, guint ssrcs)
+{
+  GstElement *conf;
+  GstBus *bus;
+  FsSession *session;
+  GPtrArray *participant_list, *streams;
+  GError *error = NULL;
+  gint64 start, time;
+  guint i;
+
+  conf = g_object_new (FS_TYPE_RTP_CONFERENCE, NULL);
+  gst_object_ref_sink (conf);
+
+  /* Nobody reads the messages */
+  bus = gst_element_get_bus (conf);
+  gst_bus_set_flushing (bus, TRUE);
+  gst_object_unref (bus);
+
+  session = fs_conference_new_session (FS_CONFERENCE (conf),
+      FS_MEDIA_TYPE_AUDIO, &error);
+  if (!session)
+    g_error ("Could not create session: %s", error->message);
+
+  participant_list = g_ptr_array_new_with_free_func (g_object_unref);
+  streams = g_ptr_array_new_with_free_func (g_object_unref);
+
+  for (i = 0; i < participants; i++)
+  {
+    FsParticipant *participant;
+    FsStream *stream;
+    gchar *cname = g_strdup_printf ("user%u@127.0.0.1", i);
+
+    participant = fs_conference_new_participant (FS_CONFERENCE (conf),
+        &error);
+    if (!participant)
+      g_error ("Could not create participant: %s", error->message);
+    g_object_set (participant, "cname", cname, NULL);
+    g_ptr_array_add (participant_list, participant);
+    g_free (cname);
+
+    stream = fs_session_new_stream (session, participant, FS_DIRECTION_BOTH,
+        &error);
+    if (!stream)
+      g_error ("Could not create stream: %s", error->message);
+    g_ptr_array_add (streams, stream);
+  }
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < ssrcs; i++)
+  {
+    /* The last participants are the slowest to find in a list */
+    gchar *cname = g_strdup_printf ("user%u@127.0.0.1",
+        (participants - 1) - (i % participants));
+
+    fs_rtp_session_associate_ssrc_cname (FS_RTP_SESSION (session), i + 1,
+        cname);
+    g_free (cname);
+  }
+  time = g_get_monotonic_time () - start;
+
+  g_message ("%u participants: %" G_GINT64_FORMAT " us total,"
+      " %.3f us per SSRC", participants, time, (gdouble) time / ssrcs);
+
+  g_ptr_array_unref (streams);
+  g_ptr_array_unref (participant_list);
+  g_object_unref (session);
+  gst_object_unref (conf);
+}
+
+int main (int argc, char **argv)
+{
+  guint ssrcs = DEFAULT_SSRCS;
+
+  gst_init (&argc, &argv);
+
+  if (argc > 1)
+    ssrcs = atoi (argv[1]);
+
+  time_association (10, ssrcs);
+  time_association (100, ssrcs);
+  time_association (1000, ssrcs);
+
+  return 0;
+}
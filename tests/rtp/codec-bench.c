@@ -0,0 +1,145 @@
+/* Farstream ad-hoc benchmark for copying and comparing codec lists
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <stdlib.h>
+
+#include <glib.h>
+
+#include <farstream/fs-codec.h>
+
+#define DEFAULT_ITERATIONS 100000
+
+static GList *
+build_codecs (gboolean reversed)
+{
+  GList *codecs = NULL;
+  FsCodec *codec;
+
+  codec = fs_codec_new (111, "OPUS", FS_MEDIA_TYPE_AUDIO, 48000);
+  codec->channels = 2;
+  if (!reversed)
+  {
+    fs_codec_add_optional_parameter (codec, "minptime", "10");
+    fs_codec_add_optional_parameter (codec, "useinbandfec", "1");
+    fs_codec_add_optional_parameter (codec, "stereo", "1");
+    fs_codec_add_optional_parameter (codec, "sprop-stereo", "1");
+    fs_codec_add_optional_parameter (codec, "maxaveragebitrate", "64000");
+  }
+  else
+  {
+    fs_codec_add_optional_parameter (codec, "maxaveragebitrate", "64000");
+    fs_codec_add_optional_parameter (codec, "sprop-stereo", "1");
+    fs_codec_add_optional_parameter (codec, "stereo", "1");
+    fs_codec_add_optional_parameter (codec, "useinbandfec", "1");
+    fs_codec_add_optional_parameter (codec, "minptime", "10");
+  }
+  codecs = g_list_append (codecs, codec);
+
+  codec = fs_codec_new (96, "H264", FS_MEDIA_TYPE_VIDEO, 90000);
+  if (!reversed)
+  {
+    fs_codec_add_optional_parameter (codec, "profile-level-id", "42e01f");
+    fs_codec_add_optional_parameter (codec, "packetization-mode", "1");
+    fs_codec_add_optional_parameter (codec, "level-asymmetry-allowed", "1");
+    fs_codec_add_optional_parameter (codec, "sprop-parameter-sets",
+        "Z0LAH9kAoD2wEQAAAwABAAADADIPGDKA,aMuMsg==");
+    fs_codec_add_optional_parameter (codec, "max-mbps", "108000");
+    fs_codec_add_optional_parameter (codec, "max-fs", "3600");
+    fs_codec_add_feedback_parameter (codec, "nack", "", "");
+    fs_codec_add_feedback_parameter (codec, "nack", "pli", "");
+    fs_codec_add_feedback_parameter (codec, "ccm", "fir", "");
+    fs_codec_add_feedback_parameter (codec, "goog-remb", "", "");
+  }
+  else
+  {
+    fs_codec_add_optional_parameter (codec, "max-fs", "3600");
+    fs_codec_add_optional_parameter (codec, "max-mbps", "108000");
+    fs_codec_add_optional_parameter (codec, "sprop-parameter-sets",
+        "Z0LAH9kAoD2wEQAAAwABAAADADIPGDKA,aMuMsg==");
+    fs_codec_add_optional_parameter (codec, "level-asymmetry-allowed", "1");
+    fs_codec_add_optional_parameter (codec, "packetization-mode", "1");
+    fs_codec_add_optional_parameter (codec, "profile-level-id", "42e01f");
+    fs_codec_add_feedback_parameter (codec, "goog-remb", "", "");
+    fs_codec_add_feedback_parameter (codec, "ccm", "fir", "");
+    fs_codec_add_feedback_parameter (codec, "nack", "pli", "");
+    fs_codec_add_feedback_parameter (codec, "nack", "", "");
+  }
+  codecs = g_list_append (codecs, codec);
+
+  return codecs;
+}
+
+static void
+report (const gchar *name, gint64 time, guint iterations)
+{
+  g_message ("%s: %" G_GINT64_FORMAT " us total, %.3f us per iteration",
+      name, time, (gdouble) time / iterations);
+}
+
+int main (int argc, char **argv)
+{
+  GList *codecs, *same, *reversed;
+  guint iterations = DEFAULT_ITERATIONS;
+  guint i;
+  gint64 start;
+
+  if (argc > 1)
+    iterations = atoi (argv[1]);
+
+  codecs = build_codecs (FALSE);
+  same = build_codecs (FALSE);
+  reversed = build_codecs (TRUE);
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < iterations; i++)
+    fs_codec_list_destroy (fs_codec_list_copy (codecs));
+  report ("fs_codec_list_copy", g_get_monotonic_time () - start, iterations);
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < iterations; i++)
+  {
+    GList *copy = fs_codec_list_copy (codecs);
+
+    if (!fs_codec_list_are_equal (codecs, copy))
+      g_error ("Copy is not equal");
+    fs_codec_list_destroy (copy);
+  }
+  report ("fs_codec_list_copy + are_equal", g_get_monotonic_time () - start,
+      iterations);
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < iterations; i++)
+    if (!fs_codec_list_are_equal (codecs, same))
+      g_error ("Identical lists are not equal");
+  report ("fs_codec_list_are_equal (same order)",
+      g_get_monotonic_time () - start, iterations);
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < iterations; i++)
+    if (!fs_codec_list_are_equal (codecs, reversed))
+      g_error ("Reordered parameters are not equal");
+  report ("fs_codec_list_are_equal (reordered params)",
+      g_get_monotonic_time () - start, iterations);
+
+  fs_codec_list_destroy (codecs);
+  fs_codec_list_destroy (same);
+  fs_codec_list_destroy (reversed);
+
+  return 0;
+}
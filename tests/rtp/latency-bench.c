@@ -0,0 +1,607 @@
+/* Farstream ad-hoc end-to-end latency benchmark for the RTP conference
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+#include <gst/gst.h>
+
+#include <farstream/fs-conference.h>
+
+#include "fs-rtp-conference.h"
+
+#define DEFAULT_CALLS 1
+#define DEFAULT_SECONDS 10
+
+/* Both in 20ms buffers */
+#define BURST_PERIOD 50
+#define SAMPLES_PER_BUFFER 160
+
+#define BURST_AMPLITUDE 16000
+#define BURST_THRESHOLD 4000
+
+#define SETUP_TIMEOUT 30
+
+/*
+ * Sets up N calls, each made of two conferences in the same pipeline talking
+ * to each other with PCMU over the rawudp transmitter on the loopback.
+ *
+ * Each side sends silence from a live source with a loud burst every
+ * BURST_PERIOD buffers. The mouth-to-ear latency is the time between the
+ * burst leaving the source and it being rendered by a synchronized sink on
+ * the other side. This assumes the latency is shorter than the burst period.
+ *
+ * The call setup time is from the start of the creation of the call until
+ * media has been rendered on both sides. The memory and CPU usage are taken
+ * once all calls are set up, over the measurement period.
+ *
+ * The results are printed as JSON on stdout.
+ *
+ * The farstream plugins and transmitters must be found, so run it with
+ * GST_PLUGIN_PATH=$(top_builddir)/gst and
+ * FS_PLUGIN_PATH=$(top_builddir)/transmitters/rawudp/.libs when uninstalled.
+ */
+
+typedef struct _Call Call;
+
+typedef struct {
+  Call *call;
+  guint idx;
+
+  GstElement *conf;
+  FsParticipant *participant;
+  FsSession *session;
+  FsStream *stream;
+
+  /* Protected by the mutex */
+  guint buffers;
+  gint64 last_burst;
+  guint bursts_sent;
+  guint bursts_received;
+  gboolean in_burst;
+  gint64 first_media;
+} CallSide;
+
+struct _Call {
+  guint id;
+  gint64 start;
+  CallSide sides[2];
+};
+
+static GMutex *mutex = NULL;
+static GArray *latencies = NULL;
+static GArray *setup_times = NULL;
+static gboolean measuring = FALSE;
+static guint calls_established = 0;
+
+static GMainLoop *loop = NULL;
+static GstElement *pipeline = NULL;
+static Call *calls = NULL;
+static guint n_calls = DEFAULT_CALLS;
+static guint seconds = DEFAULT_SECONDS;
+
+static gint64 measure_start;
+static struct rusage rusage_start;
+static glong rss_before = -1;
+static glong rss_established = -1;
+static gboolean failed = FALSE;
+
+static glong
+get_rss (void)
+{
+  gchar *contents = NULL;
+  glong size, resident;
+
+  if (!g_file_get_contents ("/proc/self/statm", &contents, NULL, NULL))
+    return -1;
+
+  if (sscanf (contents, "%ld %ld", &size, &resident) != 2)
+    resident = -1;
+  else
+    resident *= sysconf (_SC_PAGESIZE);
+
+  g_free (contents);
+
+  return resident;
+}
+
+static gint64
+rusage_cpu_us (struct rusage *ru)
+{
+  return (gint64) ru->ru_utime.tv_sec * G_USEC_PER_SEC + ru->ru_utime.tv_usec +
+    (gint64) ru->ru_stime.tv_sec * G_USEC_PER_SEC + ru->ru_stime.tv_usec;
+}
+
+static gint
+compare_int64 (gconstpointer a, gconstpointer b)
+{
+  gint64 va = *(const gint64 *) a;
+  gint64 vb = *(const gint64 *) b;
+
+  return (va > vb) - (va < vb);
+}
+
+static gint64
+percentile (GArray *array, guint pct)
+{
+  if (array->len == 0)
+    return -1;
+
+  return g_array_index (array, gint64,
+      MIN (array->len - 1, array->len * pct / 100));
+}
+
+static gboolean
+src_buffer_probe (GstPad *pad, GstBuffer *buffer, gpointer user_data)
+{
+  CallSide *side = user_data;
+  gboolean burst;
+
+  g_mutex_lock (mutex);
+  burst = (side->buffers++ % BURST_PERIOD == BURST_PERIOD - 1);
+  g_mutex_unlock (mutex);
+
+  if (burst && gst_buffer_is_writable (buffer))
+  {
+    gint16 *samples = (gint16 *) GST_BUFFER_DATA (buffer);
+    guint i;
+
+    for (i = 0; i < GST_BUFFER_SIZE (buffer) / 2; i++)
+      samples[i] = (i & 1) ? BURST_AMPLITUDE : -BURST_AMPLITUDE;
+
+    g_mutex_lock (mutex);
+    side->last_burst = g_get_monotonic_time ();
+    if (measuring)
+      side->bursts_sent++;
+    g_mutex_unlock (mutex);
+  }
+
+  return TRUE;
+}
+
+static void
+sink_handoff (GstElement *fakesink, GstBuffer *buffer, GstPad *pad,
+    gpointer user_data)
+{
+  CallSide *side = user_data;
+  CallSide *peer = &side->call->sides[1 - side->idx];
+  gint16 *samples = (gint16 *) GST_BUFFER_DATA (buffer);
+  gint64 now = g_get_monotonic_time ();
+  gint max = 0;
+  guint i;
+
+  for (i = 0; i < GST_BUFFER_SIZE (buffer) / 2; i++)
+    max = MAX (max, ABS (samples[i]));
+
+  g_mutex_lock (mutex);
+
+  if (side->first_media == 0)
+  {
+    side->first_media = now;
+
+    if (peer->first_media)
+    {
+      gint64 setup = MAX (side->first_media, peer->first_media) -
+        side->call->start;
+
+      g_array_append_val (setup_times, setup);
+      calls_established++;
+    }
+  }
+
+  if (max > BURST_THRESHOLD)
+  {
+    if (!side->in_burst && peer->last_burst)
+    {
+      gint64 latency = now - peer->last_burst;
+
+      if (measuring)
+      {
+        g_array_append_val (latencies, latency);
+        side->bursts_received++;
+      }
+      peer->last_burst = 0;
+    }
+    side->in_burst = TRUE;
+  }
+  else
+  {
+    side->in_burst = FALSE;
+  }
+
+  g_mutex_unlock (mutex);
+}
+
+static void
+src_pad_added_cb (FsStream *stream, GstPad *pad, FsCodec *codec,
+    gpointer user_data)
+{
+  CallSide *side = user_data;
+  GstElement *sink;
+  GstPad *sinkpad;
+
+  sink = gst_element_factory_make ("fakesink", NULL);
+  g_object_set (sink, "sync", TRUE, "async", FALSE, "signal-handoffs", TRUE,
+      NULL);
+  g_signal_connect (sink, "handoff", G_CALLBACK (sink_handoff), side);
+
+  if (!gst_bin_add (GST_BIN (pipeline), sink))
+    g_error ("Could not add the sink");
+
+  sinkpad = gst_element_get_static_pad (sink, "sink");
+  if (GST_PAD_LINK_FAILED (gst_pad_link (pad, sinkpad)))
+    g_error ("Could not link the sink");
+  gst_object_unref (sinkpad);
+
+  gst_element_sync_state_with_parent (sink);
+}
+
+static void
+setup_side (Call *call, guint idx)
+{
+  CallSide *side = &call->sides[idx];
+  GError *error = NULL;
+  GstElement *src;
+  GstPad *pad, *sinkpad;
+  GList *codecs;
+  GList *candidates = NULL;
+  GParameter params[3];
+  guint i;
+
+  memset (params, 0, sizeof (params));
+
+  side->call = call;
+  side->idx = idx;
+
+  side->conf = g_object_new (FS_TYPE_RTP_CONFERENCE, NULL);
+  if (!gst_bin_add (GST_BIN (pipeline), side->conf))
+    g_error ("Could not add the conference");
+
+  side->session = fs_conference_new_session (FS_CONFERENCE (side->conf),
+      FS_MEDIA_TYPE_AUDIO, &error);
+  if (!side->session)
+    g_error ("Could not create session: %s", error->message);
+
+  codecs = g_list_prepend (NULL,
+      fs_codec_new (FS_CODEC_ID_ANY, "PCMU", FS_MEDIA_TYPE_AUDIO, 8000));
+  if (!fs_session_set_codec_preferences (side->session, codecs, &error))
+    g_error ("Could not set the codec preferences: %s", error->message);
+  fs_codec_list_destroy (codecs);
+
+  side->participant = fs_conference_new_participant (
+      FS_CONFERENCE (side->conf), &error);
+  if (!side->participant)
+    g_error ("Could not create participant: %s", error->message);
+
+  side->stream = fs_session_new_stream (side->session, side->participant,
+      FS_DIRECTION_BOTH, &error);
+  if (!side->stream)
+    g_error ("Could not create stream: %s", error->message);
+  g_object_set_data (G_OBJECT (side->stream), "call-side", side);
+  g_signal_connect (side->stream, "src-pad-added",
+      G_CALLBACK (src_pad_added_cb), side);
+
+  candidates = g_list_prepend (candidates, fs_candidate_new ("L1",
+          FS_COMPONENT_RTCP, FS_CANDIDATE_TYPE_HOST, FS_NETWORK_PROTOCOL_UDP,
+          "127.0.0.1", 0));
+  candidates = g_list_prepend (candidates, fs_candidate_new ("L1",
+          FS_COMPONENT_RTP, FS_CANDIDATE_TYPE_HOST, FS_NETWORK_PROTOCOL_UDP,
+          "127.0.0.1", 0));
+
+  params[0].name = "preferred-local-candidates";
+  g_value_init (&params[0].value, FS_TYPE_CANDIDATE_LIST);
+  g_value_take_boxed (&params[0].value, candidates);
+
+  params[1].name = "upnp-discovery";
+  g_value_init (&params[1].value, G_TYPE_BOOLEAN);
+  g_value_set_boolean (&params[1].value, FALSE);
+
+  params[2].name = "upnp-mapping";
+  g_value_init (&params[2].value, G_TYPE_BOOLEAN);
+  g_value_set_boolean (&params[2].value, FALSE);
+
+  if (!fs_stream_set_transmitter (side->stream, "rawudp", params, 3, &error))
+    g_error ("Could not set the rawudp transmitter: %s", error->message);
+
+  for (i = 0; i < 3; i++)
+    g_value_unset (&params[i].value);
+
+  g_object_get (side->session, "codecs-without-config", &codecs, NULL);
+  if (!codecs)
+    g_error ("PCMU is not available");
+  if (!fs_stream_set_remote_codecs (side->stream, codecs, &error))
+    g_error ("Could not set the remote codecs: %s", error->message);
+  fs_codec_list_destroy (codecs);
+
+  src = gst_parse_bin_from_description ("audiotestsrc is-live=1 wave=silence"
+      " samplesperbuffer=" G_STRINGIFY (SAMPLES_PER_BUFFER) " !"
+      " audio/x-raw-int, rate=8000, channels=1, width=16, depth=16",
+      TRUE, &error);
+  if (!src)
+    g_error ("Could not build the source: %s", error->message);
+  if (!gst_bin_add (GST_BIN (pipeline), src))
+    g_error ("Could not add the source");
+
+  pad = gst_element_get_static_pad (src, "src");
+  gst_pad_add_buffer_probe (pad, G_CALLBACK (src_buffer_probe), side);
+  g_object_get (side->session, "sink-pad", &sinkpad, NULL);
+  if (GST_PAD_LINK_FAILED (gst_pad_link (pad, sinkpad)))
+    g_error ("Could not link the source to the session");
+  gst_object_unref (sinkpad);
+  gst_object_unref (pad);
+
+  gst_element_sync_state_with_parent (side->conf);
+  gst_element_sync_state_with_parent (src);
+}
+
+static void
+new_local_candidate (GstMessage *message)
+{
+  const GstStructure *s = gst_message_get_structure (message);
+  const GValue *value;
+  FsStream *stream;
+  FsCandidate *candidate;
+  CallSide *side, *peer;
+  GList *candidates;
+  GError *error = NULL;
+  gboolean ret;
+
+  value = gst_structure_get_value (s, "stream");
+  stream = g_value_get_object (value);
+  value = gst_structure_get_value (s, "candidate");
+  candidate = g_value_get_boxed (value);
+
+  side = g_object_get_data (G_OBJECT (stream), "call-side");
+  if (!side)
+    return;
+  peer = &side->call->sides[1 - side->idx];
+
+  candidates = g_list_prepend (NULL, candidate);
+  ret = fs_stream_add_remote_candidates (peer->stream, candidates, &error);
+  if (!ret && error &&
+      error->domain == FS_ERROR && error->code == FS_ERROR_NOT_IMPLEMENTED)
+  {
+    g_clear_error (&error);
+    ret = fs_stream_force_remote_candidates (peer->stream, candidates,
+        &error);
+  }
+  g_list_free (candidates);
+
+  if (!ret)
+    g_error ("Could not add remote candidate: %s",
+        error ? error->message : "");
+}
+
+static gboolean
+bus_watch (GstBus *bus, GstMessage *message, gpointer user_data)
+{
+  switch (GST_MESSAGE_TYPE (message))
+  {
+    case GST_MESSAGE_ERROR:
+      {
+        GError *error = NULL;
+        gchar *debug = NULL;
+
+        gst_message_parse_error (message, &error, &debug);
+        g_error ("Got an error from %s: %s (%s)",
+            GST_OBJECT_NAME (GST_MESSAGE_SRC (message)), error->message,
+            debug);
+      }
+      break;
+    case GST_MESSAGE_ELEMENT:
+      {
+        const GstStructure *s = gst_message_get_structure (message);
+
+        if (gst_structure_has_name (s, "farstream-new-local-candidate"))
+        {
+          new_local_candidate (message);
+        }
+        else if (gst_structure_has_name (s, "farstream-error"))
+        {
+          g_error ("Farstream error: %s",
+              gst_structure_get_string (s, "error-msg"));
+        }
+      }
+      break;
+    default:
+      break;
+  }
+
+  return TRUE;
+}
+
+static gboolean
+finish_measurement (gpointer user_data)
+{
+  struct rusage rusage_end;
+  gint64 duration, cpu;
+  guint bursts_sent = 0, bursts_received = 0;
+  guint i;
+
+  getrusage (RUSAGE_SELF, &rusage_end);
+  duration = g_get_monotonic_time () - measure_start;
+  cpu = rusage_cpu_us (&rusage_end) - rusage_cpu_us (&rusage_start);
+
+  g_mutex_lock (mutex);
+  measuring = FALSE;
+  for (i = 0; i < n_calls; i++)
+  {
+    bursts_sent += calls[i].sides[0].bursts_sent +
+      calls[i].sides[1].bursts_sent;
+    bursts_received += calls[i].sides[0].bursts_received +
+      calls[i].sides[1].bursts_received;
+  }
+  g_mutex_unlock (mutex);
+
+  g_array_sort (latencies, compare_int64);
+  g_array_sort (setup_times, compare_int64);
+
+  g_print ("{\n"
+      "  \"transmitter\": \"rawudp\",\n"
+      "  \"calls\": %u,\n"
+      "  \"duration_us\": %" G_GINT64_FORMAT ",\n"
+      "  \"bursts_sent\": %u,\n"
+      "  \"bursts_received\": %u,\n"
+      "  \"latency_us\": {\"samples\": %u, \"p50\": %" G_GINT64_FORMAT
+      ", \"p99\": %" G_GINT64_FORMAT ", \"max\": %" G_GINT64_FORMAT "},\n"
+      "  \"setup_us\": {\"p50\": %" G_GINT64_FORMAT ", \"p99\": %"
+      G_GINT64_FORMAT ", \"max\": %" G_GINT64_FORMAT "},\n"
+      "  \"rss_bytes_per_call\": %ld,\n"
+      "  \"cpu_us_per_call_per_second\": %.1f\n"
+      "}\n",
+      n_calls, duration, bursts_sent, bursts_received,
+      latencies->len, percentile (latencies, 50), percentile (latencies, 99),
+      percentile (latencies, 100),
+      percentile (setup_times, 50), percentile (setup_times, 99),
+      percentile (setup_times, 100),
+      (rss_before >= 0 && rss_established >= 0) ?
+      (rss_established - rss_before) / (glong) n_calls : -1,
+      (gdouble) cpu / n_calls / ((gdouble) duration / G_USEC_PER_SEC));
+
+  g_main_loop_quit (loop);
+
+  return FALSE;
+}
+
+static gboolean
+check_established (gpointer user_data)
+{
+  guint established;
+
+  g_mutex_lock (mutex);
+  established = calls_established;
+  g_mutex_unlock (mutex);
+
+  if (established < n_calls)
+  {
+    if (g_get_monotonic_time () - calls[0].start >
+        SETUP_TIMEOUT * G_USEC_PER_SEC)
+    {
+      g_message ("Only %u of %u calls were set up after %d seconds",
+          established, n_calls, SETUP_TIMEOUT);
+      failed = TRUE;
+      g_main_loop_quit (loop);
+      return FALSE;
+    }
+    return TRUE;
+  }
+
+  rss_established = get_rss ();
+
+  g_mutex_lock (mutex);
+  measuring = TRUE;
+  g_mutex_unlock (mutex);
+
+  getrusage (RUSAGE_SELF, &rusage_start);
+  measure_start = g_get_monotonic_time ();
+
+  g_timeout_add_seconds (seconds, finish_measurement, NULL);
+
+  return FALSE;
+}
+
+static gboolean
+start_calls (gpointer user_data)
+{
+  guint i;
+
+  rss_before = get_rss ();
+
+  for (i = 0; i < n_calls; i++)
+  {
+    calls[i].id = i;
+    calls[i].start = g_get_monotonic_time ();
+    setup_side (&calls[i], 0);
+    setup_side (&calls[i], 1);
+  }
+
+  g_timeout_add (100, check_established, NULL);
+
+  return FALSE;
+}
+
+int main (int argc, char **argv)
+{
+  GstBus *bus;
+  guint i, j;
+
+  gst_init (&argc, &argv);
+
+  if (argc > 1)
+    n_calls = atoi (argv[1]);
+  if (argc > 2)
+    seconds = atoi (argv[2]);
+
+  if (n_calls == 0 || seconds == 0)
+  {
+    g_message ("Usage: %s [calls] [seconds]", argv[0]);
+    return 1;
+  }
+
+  mutex = g_mutex_new ();
+  latencies = g_array_new (FALSE, FALSE, sizeof (gint64));
+  setup_times = g_array_new (FALSE, FALSE, sizeof (gint64));
+  calls = g_new0 (Call, n_calls);
+
+  loop = g_main_loop_new (NULL, FALSE);
+  pipeline = gst_pipeline_new (NULL);
+
+  bus = gst_pipeline_get_bus (GST_PIPELINE (pipeline));
+  gst_bus_add_watch (bus, bus_watch, NULL);
+  gst_object_unref (bus);
+
+  if (gst_element_set_state (pipeline, GST_STATE_PLAYING) ==
+      GST_STATE_CHANGE_FAILURE)
+    g_error ("Could not start the pipeline");
+
+  g_idle_add (start_calls, NULL);
+  g_main_loop_run (loop);
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+
+  for (i = 0; i < n_calls; i++)
+  {
+    for (j = 0; j < 2; j++)
+    {
+      CallSide *side = &calls[i].sides[j];
+
+      if (side->stream)
+      {
+        fs_stream_destroy (side->stream);
+        g_object_unref (side->stream);
+      }
+      if (side->session)
+        g_object_unref (side->session);
+      if (side->participant)
+        g_object_unref (side->participant);
+    }
+  }
+
+  gst_object_unref (pipeline);
+  g_main_loop_unref (loop);
+  g_free (calls);
+  g_array_free (latencies, TRUE);
+  g_array_free (setup_times, TRUE);
+  g_mutex_free (mutex);
+
+  return failed ? 1 : 0;
+}
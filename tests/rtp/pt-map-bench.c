@@ -0,0 +1,117 @@
+/* Farstream ad-hoc benchmark for the rtpbin pt-map requests
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <stdlib.h>
+
+#include <gst/gst.h>
+
+#include <farstream/fs-conference.h>
+
+#include "fs-rtp-conference.h"
+#include "fs-rtp-codec-specific.h"
+
+#define DEFAULT_REQUESTS 10000
+
+/*
+ * Emits "request-pt-map" on the rtpbin like it does for every new SSRC and
+ * compares it with building the caps from the codec every time.
+ */
+
+int main (int argc, char **argv)
+{
+  GstElement *conf;
+  FsSession *session;
+  GList *codecs = NULL;
+  FsCodec *codec;
+  GError *error = NULL;
+  guint session_id;
+  guint requests = DEFAULT_REQUESTS;
+  guint i;
+  gint64 start, cached_time, uncached_time;
+
+  gst_init (&argc, &argv);
+
+  if (argc > 1)
+    requests = atoi (argv[1]);
+
+  conf = g_object_new (FS_TYPE_RTP_CONFERENCE, NULL);
+  gst_object_ref_sink (conf);
+
+  session = fs_conference_new_session (FS_CONFERENCE (conf),
+      FS_MEDIA_TYPE_AUDIO, &error);
+  if (!session)
+  {
+    g_message ("Could not create session: %s", error->message);
+    g_clear_error (&error);
+    gst_object_unref (conf);
+    return 1;
+  }
+
+  g_object_get (session, "id", &session_id,
+      "codecs-without-config", &codecs, NULL);
+
+  if (!codecs)
+  {
+    g_message ("No audio codecs found, can not run the benchmark");
+    g_object_unref (session);
+    gst_object_unref (conf);
+    return 1;
+  }
+
+  codec = codecs->data;
+
+  g_message ("Requesting caps for %d/%s %u times", codec->id,
+      codec->encoding_name, requests);
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < requests; i++)
+  {
+    GstCaps *caps = NULL;
+
+    g_signal_emit_by_name (FS_RTP_CONFERENCE (conf)->gstrtpbin,
+        "request-pt-map", session_id, codec->id, &caps);
+    if (!caps)
+      g_error ("No caps for payload type %d", codec->id);
+    gst_caps_unref (caps);
+  }
+  cached_time = g_get_monotonic_time () - start;
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < requests; i++)
+  {
+    FsCodec *tmpcodec = codec_copy_filtered (codec, FS_PARAM_TYPE_CONFIG);
+    GstCaps *caps = fs_codec_to_gst_caps (tmpcodec);
+
+    fs_codec_destroy (tmpcodec);
+    gst_caps_unref (caps);
+  }
+  uncached_time = g_get_monotonic_time () - start;
+
+  g_message ("request-pt-map: %" G_GINT64_FORMAT " us total,"
+      " %.3f us per request", cached_time, (gdouble) cached_time / requests);
+  g_message ("building caps: %" G_GINT64_FORMAT " us total,"
+      " %.3f us per request", uncached_time,
+      (gdouble) uncached_time / requests);
+
+  fs_codec_list_destroy (codecs);
+  g_object_unref (session);
+  gst_object_unref (conf);
+
+  return 0;
+}
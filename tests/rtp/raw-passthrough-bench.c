@@ -0,0 +1,343 @@
+/* Farstream ad-hoc benchmark for the raw conference passthrough send path
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib/gstdio.h>
+#include <gst/gst.h>
+
+#include <farstream/fs-conference.h>
+
+#define DEFAULT_BUFFERS 10000
+
+#define READY_TIMEOUT 10
+
+#define RAW_CODEC_CAPS "audio/x-raw-int,"                   \
+  "endianness=(int)1234, signed=(bool)true, "               \
+  "width=(int)16, depth=(int)16, "                          \
+  "rate=(int)44100"
+
+/*
+ * Sends small buffers that already have the codec caps from one raw
+ * conference to another over the shm transmitter, so the send path should
+ * not contain any converter. It reports the number of buffers received per
+ * second and whether a converter was found in the sending conference.
+ *
+ * The farstream plugins and transmitters must be found, so run it with
+ * GST_PLUGIN_PATH=$(top_builddir)/gst and
+ * FS_PLUGIN_PATH=$(top_builddir)/transmitters/shm/.libs when uninstalled.
+ */
+
+typedef struct {
+  GstElement *conference;
+  FsParticipant *participant;
+  FsSession *session;
+  FsStream *stream;
+  gchar *path;
+} Side;
+
+static GMainLoop *loop = NULL;
+static guint candidates_ready = 0;
+static guint n_buffers = DEFAULT_BUFFERS;
+static guint buffer_count = 0;
+static GTimer *timer = NULL;
+
+static gboolean
+bus_watch (GstBus *bus, GstMessage *message, gpointer user_data)
+{
+  switch (GST_MESSAGE_TYPE (message))
+  {
+    case GST_MESSAGE_ERROR:
+      {
+        GError *error = NULL;
+        gchar *debug = NULL;
+
+        gst_message_parse_error (message, &error, &debug);
+        g_error ("Got an error from %s: %s (%s)",
+            GST_OBJECT_NAME (GST_MESSAGE_SRC (message)), error->message,
+            debug);
+      }
+      break;
+    case GST_MESSAGE_ELEMENT:
+      {
+        const GstStructure *s = gst_message_get_structure (message);
+
+        if (gst_structure_has_name (s, "farstream-new-local-candidate"))
+        {
+          candidates_ready++;
+          if (candidates_ready == 2)
+            g_main_loop_quit (loop);
+        }
+        else if (gst_structure_has_name (s, "farstream-error"))
+        {
+          g_error ("Farstream error: %s",
+              gst_structure_get_string (s, "error-msg"));
+        }
+      }
+      break;
+    default:
+      break;
+  }
+
+  return TRUE;
+}
+
+static gboolean
+ready_timeout (gpointer user_data)
+{
+  g_error ("Only %u of the 2 send sockets were ready after %d seconds",
+      candidates_ready, READY_TIMEOUT);
+
+  return FALSE;
+}
+
+static void
+handoff (GstElement *element, GstBuffer *buffer, GstPad *pad,
+    gpointer user_data)
+{
+  buffer_count++;
+
+  if (buffer_count == 1)
+    g_timer_start (timer);
+  else if (buffer_count == n_buffers)
+    g_main_loop_quit (loop);
+}
+
+static void
+src_pad_added (FsStream *stream, GstPad *pad, FsCodec *codec,
+    GstElement *pipeline)
+{
+  GstElement *fakesink = gst_element_factory_make ("fakesink", NULL);
+  GstPad *sinkpad;
+
+  g_object_set (fakesink,
+      "signal-handoffs", TRUE,
+      "sync", FALSE,
+      "async", FALSE,
+      NULL);
+  g_signal_connect (fakesink, "handoff", G_CALLBACK (handoff), NULL);
+
+  gst_bin_add (GST_BIN (pipeline), fakesink);
+
+  sinkpad = gst_element_get_static_pad (fakesink, "sink");
+  if (GST_PAD_LINK_FAILED (gst_pad_link (pad, sinkpad)))
+    g_error ("Could not link the fakesink");
+  gst_object_unref (sinkpad);
+
+  gst_element_sync_state_with_parent (fakesink);
+}
+
+static void
+create_side (GstElement *pipeline, Side *side, const gchar *dir,
+    const gchar *name)
+{
+  GError *error = NULL;
+  GParameter param = {0};
+
+  side->conference = gst_element_factory_make ("fsrawconference", NULL);
+  if (!side->conference)
+    g_error ("Could not create the fsrawconference, is GST_PLUGIN_PATH set?");
+  if (!gst_bin_add (GST_BIN (pipeline), side->conference))
+    g_error ("Could not add the conference");
+
+  side->session = fs_conference_new_session (
+      FS_CONFERENCE (side->conference), FS_MEDIA_TYPE_AUDIO, &error);
+  if (!side->session)
+    g_error ("Could not create session: %s", error->message);
+
+  side->participant = fs_conference_new_participant (
+      FS_CONFERENCE (side->conference), &error);
+  if (!side->participant)
+    g_error ("Could not create participant: %s", error->message);
+
+  side->stream = fs_session_new_stream (side->session, side->participant,
+      FS_DIRECTION_BOTH, &error);
+  if (!side->stream)
+    g_error ("Could not create stream: %s", error->message);
+
+  side->path = g_build_filename (dir, name, NULL);
+  param.name = "preferred-local-candidates";
+  g_value_init (&param.value, FS_TYPE_CANDIDATE_LIST);
+  g_value_take_boxed (&param.value, g_list_prepend (NULL,
+          fs_candidate_new ("", FS_COMPONENT_RTP, FS_CANDIDATE_TYPE_HOST,
+              FS_NETWORK_PROTOCOL_UDP, side->path, 0)));
+
+  if (!fs_stream_set_transmitter (side->stream, "shm", &param, 1, &error))
+    g_error ("Could not set the shm transmitter: %s", error->message);
+  g_value_unset (&param.value);
+}
+
+static void
+connect_side (Side *side, Side *peer)
+{
+  GError *error = NULL;
+  FsCandidate *candidate;
+  GList *list;
+
+  candidate = fs_candidate_new ("", FS_COMPONENT_RTP,
+      FS_CANDIDATE_TYPE_HOST, FS_NETWORK_PROTOCOL_UDP, NULL, 0);
+  candidate->username = g_strdup (peer->path);
+  list = g_list_prepend (NULL, candidate);
+  if (!fs_stream_force_remote_candidates (side->stream, list, &error))
+    g_error ("Could not set the remote candidate: %s", error->message);
+  fs_candidate_list_destroy (list);
+
+  list = g_list_prepend (NULL,
+      fs_codec_new (0, RAW_CODEC_CAPS, FS_MEDIA_TYPE_AUDIO, 0));
+  if (!fs_stream_set_remote_codecs (side->stream, list, &error))
+    g_error ("Could not set the remote codecs: %s", error->message);
+  fs_codec_list_destroy (list);
+}
+
+static void
+destroy_side (Side *side)
+{
+  fs_stream_destroy (side->stream);
+  g_object_unref (side->stream);
+  g_object_unref (side->participant);
+  fs_session_destroy (side->session);
+  g_object_unref (side->session);
+  g_unlink (side->path);
+  g_free (side->path);
+}
+
+static gint
+compare_factory_name (GstElement *element, const gchar *factory_name)
+{
+  GstElementFactory *factory = gst_element_get_factory (element);
+  gint ret = 1;
+
+  if (factory && !strcmp (GST_PLUGIN_FEATURE_NAME (factory), factory_name))
+    ret = 0;
+
+  if (ret != 0)
+    gst_object_unref (element);
+
+  return ret;
+}
+
+static gboolean
+has_element (GstElement *bin, const gchar *factory_name)
+{
+  GstIterator *iter = gst_bin_iterate_recurse (GST_BIN (bin));
+  GstElement *element;
+
+  element = gst_iterator_find_custom (iter,
+      (GCompareFunc) compare_factory_name, (gpointer) factory_name);
+  gst_iterator_free (iter);
+
+  if (element)
+    gst_object_unref (element);
+
+  return element != NULL;
+}
+
+int main (int argc, char **argv)
+{
+  GstElement *pipeline, *src, *capsfilter;
+  GstCaps *caps;
+  GstPad *srcpad, *sinkpad;
+  GstBus *bus;
+  GError *error = NULL;
+  Side sender, receiver;
+  gchar *dir;
+  guint timeout_id;
+  gdouble elapsed;
+
+  gst_init (&argc, &argv);
+
+  if (argc > 1)
+    n_buffers = MAX (2, atoi (argv[1]));
+
+  dir = g_dir_make_tmp ("fs-raw-passthrough-bench-XXXXXX", &error);
+  if (!dir)
+    g_error ("Could not create the socket directory: %s", error->message);
+
+  loop = g_main_loop_new (NULL, FALSE);
+  timer = g_timer_new ();
+
+  pipeline = gst_pipeline_new (NULL);
+
+  bus = gst_pipeline_get_bus (GST_PIPELINE (pipeline));
+  gst_bus_add_watch (bus, bus_watch, NULL);
+  gst_object_unref (bus);
+
+  create_side (pipeline, &sender, dir, "sender");
+  create_side (pipeline, &receiver, dir, "receiver");
+
+  g_signal_connect (receiver.stream, "src-pad-added",
+      G_CALLBACK (src_pad_added), pipeline);
+
+  src = gst_element_factory_make ("audiotestsrc", NULL);
+  capsfilter = gst_element_factory_make ("capsfilter", NULL);
+  if (!src || !capsfilter)
+    g_error ("Could not create the source elements");
+  g_object_set (src,
+      "blocksize", 10,
+      "is-live", FALSE,
+      "volume", 0.3,
+      NULL);
+  caps = gst_caps_from_string (RAW_CODEC_CAPS);
+  g_object_set (capsfilter, "caps", caps, NULL);
+  gst_caps_unref (caps);
+  gst_bin_add_many (GST_BIN (pipeline), src, capsfilter, NULL);
+  if (!gst_element_link (src, capsfilter))
+    g_error ("Could not link the source to the capsfilter");
+
+  srcpad = gst_element_get_static_pad (capsfilter, "src");
+  g_object_get (sender.session, "sink-pad", &sinkpad, NULL);
+  if (gst_pad_link (srcpad, sinkpad) != GST_PAD_LINK_OK)
+    g_error ("Could not link the capsfilter and the fsrawconference");
+  gst_object_unref (srcpad);
+  gst_object_unref (sinkpad);
+
+  if (gst_element_set_state (pipeline, GST_STATE_PLAYING) ==
+      GST_STATE_CHANGE_FAILURE)
+    g_error ("Could not start the pipeline");
+
+  timeout_id = g_timeout_add_seconds (READY_TIMEOUT, ready_timeout, NULL);
+  g_main_loop_run (loop);
+  g_source_remove (timeout_id);
+
+  connect_side (&sender, &receiver);
+  connect_side (&receiver, &sender);
+
+  g_main_loop_run (loop);
+
+  elapsed = g_timer_elapsed (timer, NULL);
+  g_message ("Received %u buffers in %.3fs (%.0f buffers/s)", buffer_count,
+      elapsed, (buffer_count - 1) / elapsed);
+  g_message ("Send path: %s",
+      has_element (sender.conference, "audioconvert") ||
+      has_element (sender.conference, "audioresample") ?
+      "converted" : "passthrough");
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  destroy_side (&sender);
+  destroy_side (&receiver);
+  gst_object_unref (pipeline);
+
+  g_timer_destroy (timer);
+  g_main_loop_unref (loop);
+  g_rmdir (dir);
+  g_free (dir);
+
+  return 0;
+}
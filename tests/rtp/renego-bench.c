@@ -0,0 +1,126 @@
+/* Farstream ad-hoc benchmark for renegotiating codecs with many streams
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <stdlib.h>
+
+#include <gst/gst.h>
+
+#include <farstream/fs-conference.h>
+
+#include "fs-rtp-conference.h"
+
+#define DEFAULT_STREAMS 100
+
+/*
+ * Creates many streams in one session and gives them all the same remote
+ * codecs, after the first two this does not change the negotiated codecs.
+ * Then has every one of them re-offer the same codecs.
+ */
+
+static void
+reoffer_all (GPtrArray *streams, GList *codecs, const gchar *name)
+{
+  GError *error = NULL;
+  gint64 start;
+  guint i;
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < streams->len; i++)
+    if (!fs_stream_set_remote_codecs (g_ptr_array_index (streams, i), codecs,
+            &error))
+      g_error ("Could not set the remote codecs: %s", error->message);
+
+  start = g_get_monotonic_time () - start;
+  g_message ("%s: %" G_GINT64_FORMAT " us total, %.3f us per stream",
+      name, start, (gdouble) start / streams->len);
+}
+
+int main (int argc, char **argv)
+{
+  GstElement *conf;
+  FsSession *session;
+  GPtrArray *participants, *streams;
+  GList *codecs = NULL;
+  GError *error = NULL;
+  guint n_streams = DEFAULT_STREAMS;
+  guint i;
+
+  gst_init (&argc, &argv);
+
+  if (argc > 1)
+    n_streams = atoi (argv[1]);
+
+  conf = g_object_new (FS_TYPE_RTP_CONFERENCE, NULL);
+  gst_object_ref_sink (conf);
+
+  session = fs_conference_new_session (FS_CONFERENCE (conf),
+      FS_MEDIA_TYPE_AUDIO, &error);
+  if (!session)
+  {
+    g_message ("Could not create session: %s", error->message);
+    g_clear_error (&error);
+    gst_object_unref (conf);
+    return 1;
+  }
+
+  g_object_get (session, "codecs-without-config", &codecs, NULL);
+
+  if (!codecs)
+  {
+    g_message ("No audio codecs found, can not run the benchmark");
+    g_object_unref (session);
+    gst_object_unref (conf);
+    return 1;
+  }
+
+  participants = g_ptr_array_new_with_free_func (g_object_unref);
+  streams = g_ptr_array_new_with_free_func (g_object_unref);
+
+  for (i = 0; i < n_streams; i++)
+  {
+    FsParticipant *participant;
+    FsStream *stream;
+
+    participant = fs_conference_new_participant (FS_CONFERENCE (conf),
+        &error);
+    if (!participant)
+      g_error ("Could not create participant: %s", error->message);
+    g_ptr_array_add (participants, participant);
+
+    stream = fs_session_new_stream (session, participant, FS_DIRECTION_BOTH,
+        &error);
+    if (!stream)
+      g_error ("Could not create stream: %s", error->message);
+    g_ptr_array_add (streams, stream);
+  }
+
+  g_message ("Offering %u codecs on %u streams", g_list_length (codecs),
+      n_streams);
+
+  reoffer_all (streams, codecs, "initial offer");
+  reoffer_all (streams, codecs, "re-offer");
+
+  g_ptr_array_unref (streams);
+  g_ptr_array_unref (participants);
+  fs_codec_list_destroy (codecs);
+  g_object_unref (session);
+  gst_object_unref (conf);
+
+  return 0;
+}
@@ -0,0 +1,328 @@
+/* Farstream ad-hoc benchmark for conferences with many sessions
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <glib/gstdio.h>
+#include <gst/gst.h>
+
+#include <farstream/fs-conference.h>
+
+#include "fs-rtp-conference.h"
+
+#define DEFAULT_SESSIONS 1000
+
+#define READY_TIMEOUT 60
+
+/*
+ * Creates many sessions in a single playing conference, each with 2 to 4
+ * streams using the shm transmitter. Every stream sends on its own socket and
+ * is connected to receive from the next stream of the same session. Then
+ * tears everything down.
+ *
+ * It reports the time taken by each phase and the number of threads, file
+ * descriptors and the resident memory after each of them.
+ *
+ * The farstream plugins and transmitters must be found, so run it with
+ * GST_PLUGIN_PATH=$(top_builddir)/gst and
+ * FS_PLUGIN_PATH=$(top_builddir)/transmitters/shm/.libs when uninstalled.
+ */
+
+typedef struct {
+  FsSession *session;
+  GPtrArray *participants;
+  GPtrArray *streams;
+} Session;
+
+static guint candidates_ready = 0;
+
+static void
+report_resources (const gchar *phase)
+{
+  gchar *contents = NULL;
+  glong threads = -1, resident = -1, size;
+  guint fds = 0;
+  GDir *dir;
+
+  if (g_file_get_contents ("/proc/self/status", &contents, NULL, NULL))
+  {
+    gchar *line = strstr (contents, "\nThreads:");
+
+    if (line)
+      threads = atol (line + strlen ("\nThreads:"));
+    g_free (contents);
+  }
+
+  if (g_file_get_contents ("/proc/self/statm", &contents, NULL, NULL))
+  {
+    if (sscanf (contents, "%ld %ld", &size, &resident) == 2)
+      resident = resident * sysconf (_SC_PAGESIZE) / 1024;
+    g_free (contents);
+  }
+
+  dir = g_dir_open ("/proc/self/fd", 0, NULL);
+  if (dir)
+  {
+    while (g_dir_read_name (dir))
+      fds++;
+    g_dir_close (dir);
+  }
+
+  g_message ("%s: %ld threads, %u fds, %ld kB resident", phase, threads,
+      fds, resident);
+}
+
+static void
+report_time (const gchar *phase, gint64 time, guint count, const gchar *what)
+{
+  g_message ("%s: %" G_GINT64_FORMAT " us total, %.3f us per %s",
+      phase, time, (gdouble) time / count, what);
+}
+
+static gboolean
+bus_watch (GstBus *bus, GstMessage *message, gpointer user_data)
+{
+  switch (GST_MESSAGE_TYPE (message))
+  {
+    case GST_MESSAGE_ERROR:
+      {
+        GError *error = NULL;
+        gchar *debug = NULL;
+
+        gst_message_parse_error (message, &error, &debug);
+        g_error ("Got an error from %s: %s (%s)",
+            GST_OBJECT_NAME (GST_MESSAGE_SRC (message)), error->message,
+            debug);
+      }
+      break;
+    case GST_MESSAGE_ELEMENT:
+      {
+        const GstStructure *s = gst_message_get_structure (message);
+
+        if (gst_structure_has_name (s, "farstream-new-local-candidate"))
+          candidates_ready++;
+        else if (gst_structure_has_name (s, "farstream-error"))
+          g_error ("Farstream error: %s",
+              gst_structure_get_string (s, "error-msg"));
+      }
+      break;
+    default:
+      break;
+  }
+
+  return TRUE;
+}
+
+static gboolean
+wakeup (gpointer user_data)
+{
+  return TRUE;
+}
+
+static gchar *
+socket_path (const gchar *dir, guint session, guint stream)
+{
+  gchar *name = g_strdup_printf ("s%u-%u", session, stream);
+  gchar *path = g_build_filename (dir, name, NULL);
+
+  g_free (name);
+
+  return path;
+}
+
+static void
+create_session (GstElement *conf, Session *ses, guint n_streams,
+    const gchar *dir)
+{
+  GError *error = NULL;
+  guint session_id;
+  guint i;
+
+  ses->session = fs_conference_new_session (FS_CONFERENCE (conf),
+      FS_MEDIA_TYPE_AUDIO, &error);
+  if (!ses->session)
+    g_error ("Could not create session: %s", error->message);
+
+  g_object_get (ses->session, "id", &session_id, NULL);
+
+  ses->participants = g_ptr_array_new_with_free_func (g_object_unref);
+  ses->streams = g_ptr_array_new_with_free_func (g_object_unref);
+
+  for (i = 0; i < n_streams; i++)
+  {
+    FsParticipant *participant;
+    FsStream *stream;
+    GParameter param = {0};
+    gchar *path;
+
+    participant = fs_conference_new_participant (FS_CONFERENCE (conf),
+        &error);
+    if (!participant)
+      g_error ("Could not create participant: %s", error->message);
+    g_ptr_array_add (ses->participants, participant);
+
+    stream = fs_session_new_stream (ses->session, participant,
+        FS_DIRECTION_BOTH, &error);
+    if (!stream)
+      g_error ("Could not create stream: %s", error->message);
+    g_ptr_array_add (ses->streams, stream);
+
+    path = socket_path (dir, session_id, i);
+    param.name = "preferred-local-candidates";
+    g_value_init (&param.value, FS_TYPE_CANDIDATE_LIST);
+    g_value_take_boxed (&param.value, g_list_prepend (NULL,
+            fs_candidate_new ("", FS_COMPONENT_RTP, FS_CANDIDATE_TYPE_HOST,
+                FS_NETWORK_PROTOCOL_UDP, path, 0)));
+    g_free (path);
+
+    if (!fs_stream_set_transmitter (stream, "shm", &param, 1, &error))
+      g_error ("Could not set the shm transmitter: %s", error->message);
+    g_value_unset (&param.value);
+  }
+}
+
+static void
+connect_session (Session *ses, const gchar *dir)
+{
+  GError *error = NULL;
+  guint session_id;
+  guint i;
+
+  g_object_get (ses->session, "id", &session_id, NULL);
+
+  for (i = 0; i < ses->streams->len; i++)
+  {
+    FsCandidate *candidate;
+    GList *candidates;
+
+    candidate = fs_candidate_new ("", FS_COMPONENT_RTP,
+        FS_CANDIDATE_TYPE_HOST, FS_NETWORK_PROTOCOL_UDP, NULL, 0);
+    candidate->username = socket_path (dir, session_id,
+        (i + 1) % ses->streams->len);
+    candidates = g_list_prepend (NULL, candidate);
+
+    if (!fs_stream_force_remote_candidates (
+            g_ptr_array_index (ses->streams, i), candidates, &error))
+      g_error ("Could not connect stream %u of session %u: %s", i,
+          session_id, error->message);
+
+    fs_candidate_list_destroy (candidates);
+  }
+}
+
+static void
+destroy_session (Session *ses)
+{
+  guint i;
+
+  for (i = 0; i < ses->streams->len; i++)
+    fs_stream_destroy (g_ptr_array_index (ses->streams, i));
+  g_ptr_array_unref (ses->streams);
+  g_ptr_array_unref (ses->participants);
+  fs_session_destroy (ses->session);
+  g_object_unref (ses->session);
+}
+
+int main (int argc, char **argv)
+{
+  GstElement *pipeline, *conf;
+  GstBus *bus;
+  GError *error = NULL;
+  Session *sessions;
+  gchar *dir;
+  guint n_sessions = DEFAULT_SESSIONS;
+  guint n_streams = 0;
+  guint wakeup_id;
+  guint i;
+  gint64 start, deadline;
+
+  gst_init (&argc, &argv);
+
+  if (argc > 1)
+    n_sessions = atoi (argv[1]);
+
+  dir = g_dir_make_tmp ("fs-scale-bench-XXXXXX", &error);
+  if (!dir)
+    g_error ("Could not create the socket directory: %s", error->message);
+
+  pipeline = gst_pipeline_new (NULL);
+  conf = g_object_new (FS_TYPE_RTP_CONFERENCE, NULL);
+  if (!gst_bin_add (GST_BIN (pipeline), conf))
+    g_error ("Could not add the conference");
+
+  bus = gst_pipeline_get_bus (GST_PIPELINE (pipeline));
+  gst_bus_add_watch (bus, bus_watch, NULL);
+  gst_object_unref (bus);
+
+  if (gst_element_set_state (pipeline, GST_STATE_PLAYING) ==
+      GST_STATE_CHANGE_FAILURE)
+    g_error ("Could not start the pipeline");
+
+  report_resources ("start");
+
+  sessions = g_new0 (Session, n_sessions);
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < n_sessions; i++)
+  {
+    create_session (conf, &sessions[i], 2 + i % 3, dir);
+    n_streams += 2 + i % 3;
+  }
+  report_time ("create", g_get_monotonic_time () - start, n_sessions,
+      "session");
+  g_message ("Created %u sessions with %u streams", n_sessions, n_streams);
+  report_resources ("created");
+
+  wakeup_id = g_timeout_add (100, wakeup, NULL);
+  start = g_get_monotonic_time ();
+  deadline = start + READY_TIMEOUT * G_USEC_PER_SEC;
+  while (candidates_ready < n_streams && g_get_monotonic_time () < deadline)
+    g_main_context_iteration (NULL, TRUE);
+  g_source_remove (wakeup_id);
+  if (candidates_ready < n_streams)
+    g_error ("Only %u of the %u send sockets were ready after %d seconds",
+        candidates_ready, n_streams, READY_TIMEOUT);
+  report_time ("sockets ready", g_get_monotonic_time () - start, n_streams,
+      "stream");
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < n_sessions; i++)
+    connect_session (&sessions[i], dir);
+  report_time ("connect", g_get_monotonic_time () - start, n_streams,
+      "stream");
+  report_resources ("connected");
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < n_sessions; i++)
+    destroy_session (&sessions[i]);
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (pipeline);
+  report_time ("teardown", g_get_monotonic_time () - start, n_sessions,
+      "session");
+  report_resources ("torn down");
+
+  g_free (sessions);
+  g_rmdir (dir);
+  g_free (dir);
+
+  return 0;
+}
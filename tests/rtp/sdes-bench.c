@@ -0,0 +1,139 @@
+/* Farstream ad-hoc benchmark for the handling of repeated RTCP SDES
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <stdlib.h>
+
+#include <gst/gst.h>
+
+#include <farstream/fs-conference.h>
+
+#include "fs-rtp-conference.h"
+#include "fs-rtp-session.h"
+
+#define DEFAULT_MESSAGES 100000
+#define PARTICIPANTS 100
+
+/*
+ * Every SSRC sends SDES with every RTCP packet, compares the cost of
+ * going through "on-ssrc-sdes" for SSRCs that are already associated
+ * with the cost of only pushing the SDES bus messages through the
+ * conference.
+ */
+
+static void
+report (const gchar *name, gint64 time, guint messages)
+{
+  g_message ("%s: %" G_GINT64_FORMAT " us total, %.3f us per message",
+      name, time, (gdouble) time / messages);
+}
+
+int main (int argc, char **argv)
+{
+  GstElement *conf;
+  GstBus *bus;
+  FsSession *session;
+  GPtrArray *participants, *streams;
+  GError *error = NULL;
+  guint session_id;
+  guint messages = DEFAULT_MESSAGES;
+  guint i;
+  gint64 start;
+
+  gst_init (&argc, &argv);
+
+  if (argc > 1)
+    messages = atoi (argv[1]);
+
+  conf = g_object_new (FS_TYPE_RTP_CONFERENCE, NULL);
+  gst_object_ref_sink (conf);
+
+  /* Nobody reads the messages */
+  bus = gst_element_get_bus (conf);
+  gst_bus_set_flushing (bus, TRUE);
+  gst_object_unref (bus);
+
+  session = fs_conference_new_session (FS_CONFERENCE (conf),
+      FS_MEDIA_TYPE_AUDIO, &error);
+  if (!session)
+  {
+    g_message ("Could not create session: %s", error->message);
+    g_clear_error (&error);
+    gst_object_unref (conf);
+    return 1;
+  }
+  g_object_get (session, "id", &session_id, NULL);
+
+  participants = g_ptr_array_new_with_free_func (g_object_unref);
+  streams = g_ptr_array_new_with_free_func (g_object_unref);
+
+  for (i = 0; i < PARTICIPANTS; i++)
+  {
+    FsParticipant *participant;
+    FsStream *stream;
+    gchar *cname = g_strdup_printf ("user%u@127.0.0.1", i);
+
+    participant = fs_conference_new_participant (FS_CONFERENCE (conf),
+        &error);
+    if (!participant)
+      g_error ("Could not create participant: %s", error->message);
+    g_object_set (participant, "cname", cname, NULL);
+    g_ptr_array_add (participants, participant);
+
+    stream = fs_session_new_stream (session, participant, FS_DIRECTION_BOTH,
+        &error);
+    if (!stream)
+      g_error ("Could not create stream: %s", error->message);
+    g_ptr_array_add (streams, stream);
+
+    fs_rtp_session_associate_ssrc_cname (FS_RTP_SESSION (session), i + 1,
+        cname);
+    g_free (cname);
+  }
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < messages; i++)
+    g_signal_emit_by_name (FS_RTP_CONFERENCE (conf)->gstrtpbin,
+        "on-ssrc-sdes", session_id, (i % PARTICIPANTS) + 1);
+  report ("on-ssrc-sdes (associated)", g_get_monotonic_time () - start,
+      messages);
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < messages; i++)
+  {
+    gchar *cname = g_strdup_printf ("user%u@127.0.0.1", i % PARTICIPANTS);
+    GstElement *rtpbin = FS_RTP_CONFERENCE (conf)->gstrtpbin;
+
+    gst_element_post_message (rtpbin,
+        gst_message_new_element (GST_OBJECT (rtpbin),
+            gst_structure_new ("application/x-rtp-source-sdes",
+                "session", G_TYPE_UINT, session_id,
+                "ssrc", G_TYPE_UINT, (i % PARTICIPANTS) + 1,
+                "cname", G_TYPE_STRING, cname,
+                NULL)));
+    g_free (cname);
+  }
+  report ("SDES bus messages", g_get_monotonic_time () - start, messages);
+
+  g_ptr_array_unref (streams);
+  g_ptr_array_unref (participants);
+  g_object_unref (session);
+  gst_object_unref (conf);
+
+  return 0;
+}
@@ -0,0 +1,126 @@
+/* Farstream ad-hoc benchmark for the SDP codec negotiation
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <stdlib.h>
+
+#include <gst/gst.h>
+
+#include <farstream/fs-codec.h>
+
+#include "fs-rtp-conference.h"
+#include "fs-rtp-codec-specific.h"
+
+#define DEFAULT_ROUNDS 1000
+
+/*
+ * Runs offer/answer rounds between two sets of codecs like the ones
+ * exchanged in a typical audio+video call.
+ */
+
+static GList *
+build_offer (gboolean answerer)
+{
+  GList *codecs = NULL;
+  FsCodec *codec;
+
+  codec = fs_codec_new (0, "PCMU", FS_MEDIA_TYPE_AUDIO, 8000);
+  codecs = g_list_append (codecs, codec);
+
+  codec = fs_codec_new (97, "iLBC", FS_MEDIA_TYPE_AUDIO, 8000);
+  fs_codec_add_optional_parameter (codec, "mode", answerer ? "20" : "30");
+  codecs = g_list_append (codecs, codec);
+
+  codec = fs_codec_new (18, "G729", FS_MEDIA_TYPE_AUDIO, 8000);
+  fs_codec_add_optional_parameter (codec, "annexb", "no");
+  codecs = g_list_append (codecs, codec);
+
+  codec = fs_codec_new (101, "telephone-event", FS_MEDIA_TYPE_AUDIO, 8000);
+  fs_codec_add_optional_parameter (codec, "events",
+      answerer ? "0-11,32-41" : "0-15,36");
+  codecs = g_list_append (codecs, codec);
+
+  codec = fs_codec_new (96, "H264", FS_MEDIA_TYPE_VIDEO, 90000);
+  fs_codec_add_optional_parameter (codec, "profile-level-id",
+      answerer ? "42e015" : "42e01f");
+  fs_codec_add_optional_parameter (codec, "packetization-mode", "1");
+  fs_codec_add_optional_parameter (codec, "max-mbps", "108000");
+  fs_codec_add_optional_parameter (codec, "sprop-parameter-sets",
+      "Z0LAH9kAoD2wEQAAAwABAAADADIPGDKA,aMuMsg==");
+  codecs = g_list_append (codecs, codec);
+
+  codec = fs_codec_new (98, "H263-1998", FS_MEDIA_TYPE_VIDEO, 90000);
+  fs_codec_add_optional_parameter (codec, "qcif", "1");
+  fs_codec_add_optional_parameter (codec, "cif", answerer ? "2" : "1");
+  fs_codec_add_optional_parameter (codec, "f", "1");
+  fs_codec_add_optional_parameter (codec, "custom", "800,600,2");
+  codecs = g_list_append (codecs, codec);
+
+  return codecs;
+}
+
+int main (int argc, char **argv)
+{
+  GList *offer, *answer;
+  guint rounds = DEFAULT_ROUNDS;
+  guint negotiated = 0;
+  guint i;
+  gint64 start, elapsed;
+
+  gst_init (&argc, &argv);
+
+  GST_DEBUG_CATEGORY_INIT (fsrtpconference_nego, "fsrtpconference_nego",
+      0, "Farstream RTP Codec Negotiation");
+
+  if (argc > 1)
+    rounds = atoi (argv[1]);
+
+  offer = build_offer (FALSE);
+  answer = build_offer (TRUE);
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < rounds; i++)
+  {
+    GList *item, *item2;
+
+    for (item = offer; item; item = item->next)
+    {
+      for (item2 = answer; item2; item2 = item2->next)
+      {
+        FsCodec *nego = sdp_negotiate_codec (item->data, FS_PARAM_TYPE_ALL,
+            item2->data, FS_PARAM_TYPE_ALL);
+
+        if (nego)
+        {
+          negotiated++;
+          fs_codec_destroy (nego);
+        }
+      }
+    }
+  }
+  elapsed = g_get_monotonic_time () - start;
+
+  g_message ("%u offer/answer rounds, %u codecs negotiated per round:"
+      " %" G_GINT64_FORMAT " us total, %.3f us per round", rounds,
+      rounds ? negotiated / rounds : 0, elapsed, (gdouble) elapsed / rounds);
+
+  fs_codec_list_destroy (offer);
+  fs_codec_list_destroy (answer);
+
+  return 0;
+}
@@ -0,0 +1,373 @@
+/*
+ * Farstream - Farstream Multicast UDP Transmitter
+ *
+ * Copyright 2026 agent <agent@local>
+ *
+ * fs-multicast-src.c - A source reading many multicast groups from one socket
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "fs-multicast-src.h"
+
+#ifdef HAVE_MULTICAST_SRC
+
+#include <errno.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+
+GST_DEBUG_CATEGORY_EXTERN (fs_multicast_transmitter_debug);
+#define GST_CAT_DEFAULT fs_multicast_transmitter_debug
+
+static GstStaticPadTemplate src_template = GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS_ANY);
+
+static GstPushSrcClass *parent_class = NULL;
+
+static GType type = 0;
+
+static void fs_multicast_src_base_init (gpointer g_class);
+static void fs_multicast_src_class_init (FsMulticastSrcClass *klass);
+static void fs_multicast_src_init (FsMulticastSrc *self);
+static void fs_multicast_src_finalize (GObject *object);
+
+static gboolean fs_multicast_src_start (GstBaseSrc *basesrc);
+static gboolean fs_multicast_src_stop (GstBaseSrc *basesrc);
+static gboolean fs_multicast_src_unlock (GstBaseSrc *basesrc);
+static gboolean fs_multicast_src_unlock_stop (GstBaseSrc *basesrc);
+static GstFlowReturn fs_multicast_src_create (GstPushSrc *psrc,
+    GstBuffer **buf);
+
+GType
+fs_multicast_src_get_type (void)
+{
+  g_assert (type);
+  return type;
+}
+
+GType
+fs_multicast_src_register_type (FsPlugin *module)
+{
+  static const GTypeInfo info = {
+    sizeof (FsMulticastSrcClass),
+    (GBaseInitFunc) fs_multicast_src_base_init,
+    NULL,
+    (GClassInitFunc) fs_multicast_src_class_init,
+    NULL,
+    NULL,
+    sizeof (FsMulticastSrc),
+    0,
+    (GInstanceInitFunc) fs_multicast_src_init
+  };
+
+  type = g_type_module_register_type (G_TYPE_MODULE (module),
+    GST_TYPE_PUSH_SRC, "FsMulticastSrc", &info, 0);
+
+  return type;
+}
+
+static void
+fs_multicast_src_base_init (gpointer g_class)
+{
+  GstElementClass *element_class = GST_ELEMENT_CLASS (g_class);
+
+  gst_element_class_add_pad_template (element_class,
+      gst_static_pad_template_get (&src_template));
+
+  gst_element_class_set_details_simple (element_class,
+      "Farstream multicast source",
+      "Source/Network",
+      "Receives many multicast groups from one socket",
+      "agent <agent@local>");
+}
+
+static void
+fs_multicast_src_class_init (FsMulticastSrcClass *klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  GstBaseSrcClass *basesrc_class = GST_BASE_SRC_CLASS (klass);
+  GstPushSrcClass *pushsrc_class = GST_PUSH_SRC_CLASS (klass);
+
+  parent_class = g_type_class_peek_parent (klass);
+
+  gobject_class->finalize = fs_multicast_src_finalize;
+
+  basesrc_class->start = fs_multicast_src_start;
+  basesrc_class->stop = fs_multicast_src_stop;
+  basesrc_class->unlock = fs_multicast_src_unlock;
+  basesrc_class->unlock_stop = fs_multicast_src_unlock_stop;
+
+  pushsrc_class->create = fs_multicast_src_create;
+}
+
+static void
+fs_multicast_src_init (FsMulticastSrc *self)
+{
+  self->fd = -1;
+  self->groups = g_hash_table_new (NULL, NULL);
+
+  gst_base_src_set_live (GST_BASE_SRC (self), TRUE);
+  gst_base_src_set_format (GST_BASE_SRC (self), GST_FORMAT_TIME);
+  gst_base_src_set_do_timestamp (GST_BASE_SRC (self), TRUE);
+}
+
+static void
+fs_multicast_src_finalize (GObject *object)
+{
+  FsMulticastSrc *self = FS_MULTICAST_SRC (object);
+
+  g_hash_table_destroy (self->groups);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+/*
+ * The socket is not owned by the element, the caller must close it after
+ * the element has been set to the NULL state.
+ */
+
+GstElement *
+fs_multicast_src_new (gint fd)
+{
+  FsMulticastSrc *self = g_object_new (FS_TYPE_MULTICAST_SRC, NULL);
+
+  self->fd = fd;
+
+  return GST_ELEMENT (self);
+}
+
+/*
+ * Returns: %TRUE if this is the first user of this group
+ */
+
+gboolean
+fs_multicast_src_add_group (FsMulticastSrc *self, const struct in_addr *group)
+{
+  gpointer key = GUINT_TO_POINTER (group->s_addr);
+  guint count;
+
+  GST_OBJECT_LOCK (self);
+  count = GPOINTER_TO_UINT (g_hash_table_lookup (self->groups, key));
+  g_hash_table_insert (self->groups, key, GUINT_TO_POINTER (count + 1));
+  GST_OBJECT_UNLOCK (self);
+
+  return count == 0;
+}
+
+/*
+ * Returns: %TRUE if this was the last user of this group
+ */
+
+gboolean
+fs_multicast_src_remove_group (FsMulticastSrc *self,
+    const struct in_addr *group)
+{
+  gpointer key = GUINT_TO_POINTER (group->s_addr);
+  guint count;
+
+  GST_OBJECT_LOCK (self);
+  count = GPOINTER_TO_UINT (g_hash_table_lookup (self->groups, key));
+  if (count > 1)
+    g_hash_table_insert (self->groups, key, GUINT_TO_POINTER (count - 1));
+  else
+    g_hash_table_remove (self->groups, key);
+  GST_OBJECT_UNLOCK (self);
+
+  return count == 1;
+}
+
+gboolean
+fs_multicast_src_has_group (FsMulticastSrc *self, const struct in_addr *group)
+{
+  gboolean ret;
+
+  GST_OBJECT_LOCK (self);
+  ret = g_hash_table_lookup (self->groups,
+      GUINT_TO_POINTER (group->s_addr)) != NULL;
+  GST_OBJECT_UNLOCK (self);
+
+  return ret;
+}
+
+static gboolean
+fs_multicast_src_start (GstBaseSrc *basesrc)
+{
+  FsMulticastSrc *self = FS_MULTICAST_SRC (basesrc);
+
+  if (self->fd < 0)
+  {
+    GST_ELEMENT_ERROR (self, RESOURCE, OPEN_READ, (NULL),
+        ("No socket to read from"));
+    return FALSE;
+  }
+
+  self->poll = gst_poll_new (TRUE);
+  if (!self->poll)
+  {
+    GST_ELEMENT_ERROR (self, RESOURCE, OPEN_READ, (NULL),
+        ("Could not create the poll set: %s", g_strerror (errno)));
+    return FALSE;
+  }
+
+  gst_poll_fd_init (&self->pollfd);
+  self->pollfd.fd = self->fd;
+  gst_poll_add_fd (self->poll, &self->pollfd);
+  gst_poll_fd_ctl_read (self->poll, &self->pollfd, TRUE);
+
+  return TRUE;
+}
+
+static gboolean
+fs_multicast_src_stop (GstBaseSrc *basesrc)
+{
+  FsMulticastSrc *self = FS_MULTICAST_SRC (basesrc);
+
+  if (self->poll)
+  {
+    gst_poll_free (self->poll);
+    self->poll = NULL;
+  }
+
+  return TRUE;
+}
+
+static gboolean
+fs_multicast_src_unlock (GstBaseSrc *basesrc)
+{
+  FsMulticastSrc *self = FS_MULTICAST_SRC (basesrc);
+
+  if (self->poll)
+    gst_poll_set_flushing (self->poll, TRUE);
+
+  return TRUE;
+}
+
+static gboolean
+fs_multicast_src_unlock_stop (GstBaseSrc *basesrc)
+{
+  FsMulticastSrc *self = FS_MULTICAST_SRC (basesrc);
+
+  if (self->poll)
+    gst_poll_set_flushing (self->poll, FALSE);
+
+  return TRUE;
+}
+
+static gboolean
+fs_multicast_src_accept (FsMulticastSrc *self, struct msghdr *msg)
+{
+  struct cmsghdr *cmsg;
+  gboolean accept = FALSE;
+
+  for (cmsg = CMSG_FIRSTHDR (msg); cmsg; cmsg = CMSG_NXTHDR (msg, cmsg))
+  {
+    if (cmsg->cmsg_level == IPPROTO_IP && cmsg->cmsg_type == IP_PKTINFO)
+    {
+      struct in_pktinfo *pktinfo = (struct in_pktinfo *) CMSG_DATA (cmsg);
+
+      GST_OBJECT_LOCK (self);
+      accept = g_hash_table_lookup (self->groups,
+          GUINT_TO_POINTER (pktinfo->ipi_addr.s_addr)) != NULL;
+      GST_OBJECT_UNLOCK (self);
+      break;
+    }
+  }
+
+  return accept;
+}
+
+static GstFlowReturn
+fs_multicast_src_create (GstPushSrc *psrc, GstBuffer **buf)
+{
+  FsMulticastSrc *self = FS_MULTICAST_SRC (psrc);
+  GstBuffer *outbuf;
+  struct msghdr msg;
+  struct iovec iov;
+  struct sockaddr_in from;
+  gchar control[CMSG_SPACE (sizeof (struct in_pktinfo))];
+  int readsize;
+  gssize ret;
+
+ retry:
+
+  if (gst_poll_wait (self->poll, GST_CLOCK_TIME_NONE) < 0)
+  {
+    if (errno == EBUSY)
+      return GST_FLOW_WRONG_STATE;
+    if (errno == EAGAIN || errno == EINTR)
+      goto retry;
+
+    GST_ELEMENT_ERROR (self, RESOURCE, READ, (NULL),
+        ("Could not wait for packets: %s", g_strerror (errno)));
+    return GST_FLOW_ERROR;
+  }
+
+  if (ioctl (self->fd, FIONREAD, &readsize) < 0)
+  {
+    GST_ELEMENT_ERROR (self, RESOURCE, READ, (NULL),
+        ("Could not get the size of the packet: %s", g_strerror (errno)));
+    return GST_FLOW_ERROR;
+  }
+
+  outbuf = gst_buffer_new_and_alloc (readsize);
+
+  iov.iov_base = GST_BUFFER_DATA (outbuf);
+  iov.iov_len = readsize;
+
+  memset (&msg, 0, sizeof (msg));
+  msg.msg_name = &from;
+  msg.msg_namelen = sizeof (from);
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof (control);
+
+  ret = recvmsg (self->fd, &msg, 0);
+  if (ret < 0)
+  {
+    gst_buffer_unref (outbuf);
+
+    if (errno == EAGAIN || errno == EINTR || errno == ECONNREFUSED)
+      goto retry;
+
+    GST_ELEMENT_ERROR (self, RESOURCE, READ, (NULL),
+        ("Could not receive packet: %s", g_strerror (errno)));
+    return GST_FLOW_ERROR;
+  }
+
+  /* The socket also gets the packets sent to its port for groups that
+   * another socket has joined, or to a unicast address */
+  if (!fs_multicast_src_accept (self, &msg))
+  {
+    GST_LOG_OBJECT (self, "Dropping packet sent to a group we did not join");
+    gst_buffer_unref (outbuf);
+    goto retry;
+  }
+
+  GST_BUFFER_SIZE (outbuf) = ret;
+  *buf = outbuf;
+
+  return GST_FLOW_OK;
+}
+
+#endif /* HAVE_MULTICAST_SRC */
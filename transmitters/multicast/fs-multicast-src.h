@@ -0,0 +1,100 @@
+/*
+ * Farstream - Farstream Multicast UDP Transmitter
+ *
+ * Copyright 2026 agent <agent@local>
+ *
+ * fs-multicast-src.h - A source reading many multicast groups from one socket
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef __FS_MULTICAST_SRC_H__
+#define __FS_MULTICAST_SRC_H__
+
+#include <gst/gst.h>
+#include <gst/base/gstpushsrc.h>
+
+#include <farstream/fs-plugin.h>
+
+#ifndef G_OS_WIN32
+# include <netinet/in.h>
+#endif
+
+G_BEGIN_DECLS
+
+/* Receiving many groups on one socket requires knowing the destination
+ * address of every packet */
+#if defined (IP_PKTINFO) && !defined (G_OS_WIN32)
+# define HAVE_MULTICAST_SRC 1
+#endif
+
+#ifdef HAVE_MULTICAST_SRC
+
+#define FS_TYPE_MULTICAST_SRC \
+  (fs_multicast_src_get_type ())
+#define FS_MULTICAST_SRC(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj), FS_TYPE_MULTICAST_SRC, FsMulticastSrc))
+#define FS_IS_MULTICAST_SRC(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE((obj), FS_TYPE_MULTICAST_SRC))
+
+typedef struct _FsMulticastSrc FsMulticastSrc;
+typedef struct _FsMulticastSrcClass FsMulticastSrcClass;
+
+/*
+ * FsMulticastSrc:
+ *
+ * Reads packets from a socket that has joined many multicast groups and
+ * only lets through the packets sent to one of the groups it has been told
+ * about with fs_multicast_src_add_group(). This replaces one socket and one
+ * udpsrc per group when many groups are received on the same port.
+ */
+
+struct _FsMulticastSrc
+{
+  GstPushSrc parent;
+
+  /*< private >*/
+
+  gint fd;
+  GstPoll *poll;
+  GstPollFD pollfd;
+
+  /* in_addr_t -> number of users, protected by the object lock */
+  GHashTable *groups;
+};
+
+struct _FsMulticastSrcClass
+{
+  GstPushSrcClass parent_class;
+};
+
+GType fs_multicast_src_get_type (void);
+
+GType fs_multicast_src_register_type (FsPlugin *module);
+
+GstElement *fs_multicast_src_new (gint fd);
+
+gboolean fs_multicast_src_add_group (FsMulticastSrc *self,
+    const struct in_addr *group);
+gboolean fs_multicast_src_remove_group (FsMulticastSrc *self,
+    const struct in_addr *group);
+gboolean fs_multicast_src_has_group (FsMulticastSrc *self,
+    const struct in_addr *group);
+
+#endif /* HAVE_MULTICAST_SRC */
+
+G_END_DECLS
+
+#endif /* __FS_MULTICAST_SRC_H__ */
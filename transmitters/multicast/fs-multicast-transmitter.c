@@ -36,10 +36,12 @@
 
 #include "fs-multicast-transmitter.h"
 #include "fs-multicast-stream-transmitter.h"
+#include "fs-multicast-src.h"
 
 #include <farstream/fs-conference.h>
 #include <farstream/fs-plugin.h>
 
+#include <errno.h>
 #include <string.h>
 #include <sys/types.h>
 
@@ -55,6 +57,9 @@
 # include <sys/socket.h>
 # include <netinet/ip.h>
 # include <arpa/inet.h>
+# ifdef HAVE_GETIFADDRS
+#  include <ifaddrs.h>
+# endif
 #endif /*G_OS_WIN32*/
 
 GST_DEBUG_CATEGORY (fs_multicast_transmitter_debug);
@@ -74,7 +79,8 @@ enum
   PROP_GST_SRC,
   PROP_COMPONENTS,
   PROP_TYPE_OF_SERVICE,
-  PROP_DO_TIMESTAMP
+  PROP_DO_TIMESTAMP,
+  PROP_SHARED_RECEIVE
 };
 
 struct _FsMulticastTransmitterPrivate
@@ -89,10 +95,21 @@ struct _FsMulticastTransmitterPrivate
   GstElement **udpsrc_funnels;
   GstElement **udpsink_tees;
 
+  /* Protects the type_of_service, taken before the udpsocks_mutexes */
   GMutex *mutex;
-  GList **udpsocks;
+
+  /* One table of UdpSock per component, indexed by
+   * local_ip:multicast_ip:port, each protected by its own mutex */
+  GHashTable **udpsocks;
+  GMutex **udpsocks_mutexes;
+
+  /* One table of RecvSock chains per component, indexed by local_ip:port,
+   * protected by the same mutex as the udpsocks */
+  GHashTable **recvsocks;
 
   gint type_of_service;
+  /* Protected by the mutex */
+  gboolean shared_receive;
   gboolean do_timestamp;
 
   gboolean disposed;
@@ -109,6 +126,11 @@ static void fs_multicast_transmitter_constructed (GObject *object);
 static void fs_multicast_transmitter_dispose (GObject *object);
 static void fs_multicast_transmitter_finalize (GObject *object);
 
+static guint udpsock_hash (gconstpointer v);
+static gboolean udpsock_equal (gconstpointer v1, gconstpointer v2);
+static guint recvsock_hash (gconstpointer v);
+static gboolean recvsock_equal (gconstpointer v1, gconstpointer v2);
+
 static void fs_multicast_transmitter_get_property (GObject *object,
                                                 guint prop_id,
                                                 GValue *value,
@@ -166,6 +188,9 @@ fs_multicast_transmitter_register_type (FsPlugin *module)
       "Farstream multicast UDP transmitter");
 
   fs_multicast_stream_transmitter_register_type (module);
+#ifdef HAVE_MULTICAST_SRC
+  fs_multicast_src_register_type (module);
+#endif
 
   type = g_type_module_register_type (G_TYPE_MODULE (module),
     FS_TYPE_TRANSMITTER, "FsMulticastTransmitter", &info, 0);
@@ -197,6 +222,24 @@ fs_multicast_transmitter_class_init (FsMulticastTransmitterClass *klass)
   g_object_class_override_property (gobject_class, PROP_DO_TIMESTAMP,
     "do-timestamp");
 
+  /**
+   * FsMulticastTransmitter:shared-receive:
+   *
+   * Receive all the multicast groups that use the same port on a single
+   * socket, which joins every group and only lets through the packets
+   * addressed to one of them. This uses one receiving thread per port
+   * instead of one per group. It only affects streams created after it is
+   * set and is ignored on platforms that can not get the destination
+   * address of received packets.
+   */
+  g_object_class_install_property (gobject_class,
+      PROP_SHARED_RECEIVE,
+      g_param_spec_boolean ("shared-receive",
+          "Receive many groups on one socket",
+          "Receive all the groups that use the same port on one socket",
+          FALSE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   transmitter_class->new_stream_transmitter =
     fs_multicast_transmitter_new_stream_transmitter;
   transmitter_class->get_stream_transmitter_type =
@@ -236,7 +279,16 @@ fs_multicast_transmitter_constructed (GObject *object)
   /* We waste one space in order to have the index be the component_id */
   self->priv->udpsrc_funnels = g_new0 (GstElement *, self->components+1);
   self->priv->udpsink_tees = g_new0 (GstElement *, self->components+1);
-  self->priv->udpsocks = g_new0 (GList *, self->components+1);
+  self->priv->udpsocks = g_new0 (GHashTable *, self->components+1);
+  self->priv->udpsocks_mutexes = g_new0 (GMutex *, self->components+1);
+  self->priv->recvsocks = g_new0 (GHashTable *, self->components+1);
+  for (c = 1; c <= self->components; c++)
+  {
+    self->priv->udpsocks[c] = g_hash_table_new (udpsock_hash, udpsock_equal);
+    self->priv->recvsocks[c] = g_hash_table_new (recvsock_hash,
+        recvsock_equal);
+    self->priv->udpsocks_mutexes[c] = g_mutex_new ();
+  }
 
   /* First we need the src elemnet */
 
@@ -411,8 +463,20 @@ fs_multicast_transmitter_finalize (GObject *object)
   }
 
   if (self->priv->udpsocks) {
+    int c;
+
+    for (c = 1; c <= self->components; c++)
+    {
+      g_hash_table_destroy (self->priv->udpsocks[c]);
+      g_hash_table_destroy (self->priv->recvsocks[c]);
+      g_mutex_free (self->priv->udpsocks_mutexes[c]);
+    }
     g_free (self->priv->udpsocks);
     self->priv->udpsocks = NULL;
+    g_free (self->priv->udpsocks_mutexes);
+    self->priv->udpsocks_mutexes = NULL;
+    g_free (self->priv->recvsocks);
+    self->priv->recvsocks = NULL;
   }
 
   g_mutex_free (self->priv->mutex);
@@ -446,6 +510,11 @@ fs_multicast_transmitter_get_property (GObject *object,
     case PROP_DO_TIMESTAMP:
       g_value_set_boolean (value, self->priv->do_timestamp);
       break;
+    case PROP_SHARED_RECEIVE:
+      g_mutex_lock (self->priv->mutex);
+      g_value_set_boolean (value, self->priv->shared_receive);
+      g_mutex_unlock (self->priv->mutex);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -471,6 +540,11 @@ fs_multicast_transmitter_set_property (GObject *object,
     case PROP_DO_TIMESTAMP:
       self->priv->do_timestamp = g_value_get_boolean (value);
       break;
+    case PROP_SHARED_RECEIVE:
+      g_mutex_lock (self->priv->mutex);
+      self->priv->shared_receive = g_value_get_boolean (value);
+      g_mutex_unlock (self->priv->mutex);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -502,11 +576,44 @@ fs_multicast_transmitter_new_stream_transmitter (FsTransmitter *transmitter,
 }
 
 
+/*
+ * The RecvSock structure represents the socket used to receive every group
+ * on one local_ip:port when the shared-receive property is set. The UdpSocks
+ * then only send and each of them adds its group to the RecvSock.
+ * The kernel limits the number of groups one socket can join, so once a
+ * RecvSock is full another one is created for the same local_ip:port and
+ * chained to it, the recvsocks table only contains the head of each chain.
+ */
+
+typedef struct _RecvSock RecvSock;
+
+struct _RecvSock {
+  GstElement *src;
+  GstPad *src_requested_pad;
+
+  gchar *local_ip;
+  guint16 port;
+
+  gint fd;
+
+  /* This is just a convenience pointer to our parent transmitter */
+  GstElement *funnel;
+
+  guint component_id;
+
+  /* Protected by the component's udpsocks mutex */
+  guint refcount;
+  gboolean full;
+  RecvSock *next;
+};
+
 /*
  * The UdpSock structure is a ref-counted pseudo-object use to represent
  * one local_ip:port:multicast_ip trio on which we listen and send,
  * so it includes a udpsrc and a multiudpsink. It represents one BSD socket.
- * The TTL used is the max TTL requested by any stream.
+ * The TTL used is the max TTL requested by any stream, the requested TTLs
+ * are kept as a count per TTL value so the new max can be found without
+ * going through every stream.
  */
 
 struct _UdpSock {
@@ -514,6 +621,9 @@ struct _UdpSock {
   GstElement *udpsrc;
   GstPad *udpsrc_requested_pad;
 
+  /* Used instead of the udpsrc in shared-receive mode */
+  RecvSock *recvsock;
+
   GstElement *udpsink;
   GstElement *udpsink_recvonly_filter;
   GstPad *udpsink_requested_pad;
@@ -521,13 +631,14 @@ struct _UdpSock {
   gchar *local_ip;
   gchar *multicast_ip;
   guint16 port;
-  /* Protected by the transmitter mutex */
+  /* Protected by the component's udpsocks mutex */
   guint8 current_ttl;
 
   gint fd;
 
-  /* Protected by the transmitter mutex */
-  GByteArray *ttls;
+  /* Protected by the component's udpsocks mutex */
+  guint ttl_counts[256];
+  guint ttl_refcount;
 
   /* These are just convenience pointers to our parent transmitter */
   GstElement *funnel;
@@ -562,33 +673,22 @@ _ip_string_into_sockaddr_in (const gchar *ip_as_string,
   return TRUE;
 }
 
-static gint
-_bind_port (
+static gboolean
+_set_membership (gint sock,
     const gchar *local_ip,
     const gchar *multicast_ip,
-    guint16 port,
-    guchar ttl,
-    int type_of_service,
+    gboolean join,
     GError **error)
 {
-  int sock = -1;
   struct sockaddr_in address;
-  int retval;
-  guchar loop = 1;
-  int reuseaddr = 1;
 #ifdef HAVE_IP_MREQN
   struct ip_mreqn mreq;
 #else
   struct ip_mreq mreq;
 #endif
 
-  address.sin_family = AF_INET;
-  address.sin_addr.s_addr = INADDR_ANY;
-
-  g_assert (multicast_ip);
-
   if (!_ip_string_into_sockaddr_in (multicast_ip, &address, error))
-    goto error;
+    return FALSE;
   memcpy (&mreq.imr_multiaddr, &address.sin_addr,
       sizeof (mreq.imr_multiaddr));
 
@@ -596,7 +696,7 @@ _bind_port (
   {
     struct sockaddr_in tmpaddr;
     if (!_ip_string_into_sockaddr_in (local_ip, &tmpaddr, error))
-      goto error;
+      return FALSE;
 #ifdef HAVE_IP_MREQN
     memcpy (&mreq.imr_address, &tmpaddr.sin_addr, sizeof (mreq.imr_address));
 #else
@@ -616,6 +716,80 @@ _bind_port (
   mreq.imr_ifindex = 0;
 #endif
 
+  if (setsockopt (sock, IPPROTO_IP,
+          join ? IP_ADD_MEMBERSHIP : IP_DROP_MEMBERSHIP,
+          (const void *)&mreq, sizeof (mreq)) < 0)
+  {
+    gint errsv = errno;
+
+    g_set_error (error, FS_ERROR, FS_ERROR_INVALID_ARGUMENTS,
+        "Could not %s the socket %s the multicast group: %s",
+        join ? "join" : "remove", join ? "to" : "from",
+        g_strerror (errsv));
+    /* Lets the caller tell when the socket can't join any more groups */
+    errno = errsv;
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+static gboolean
+_set_reuse (gint sock, GError **error)
+{
+  int reuseaddr = 1;
+
+  if (setsockopt (sock, SOL_SOCKET, SO_REUSEADDR, (const void *)&reuseaddr,
+          sizeof (reuseaddr)) < 0)
+  {
+    g_set_error (error, FS_ERROR, FS_ERROR_INVALID_ARGUMENTS,
+        "Error setting reuseaddr to TRUE: %s",
+        g_strerror (errno));
+    return FALSE;
+  }
+
+#ifdef SO_REUSEPORT
+  if (setsockopt (sock, SOL_SOCKET, SO_REUSEPORT, (const void *)&reuseaddr,
+          sizeof (reuseaddr)) < 0)
+  {
+    g_set_error (error, FS_ERROR, FS_ERROR_INVALID_ARGUMENTS,
+        "Error setting reuseaddr to TRUE: %s",
+        g_strerror (errno));
+    return FALSE;
+  }
+#endif
+
+  return TRUE;
+}
+
+/*
+ * If @join is %FALSE, the socket is only used to send, the packets to the
+ * group are received by the shared RecvSock instead.
+ */
+
+static gint
+_bind_port (
+    const gchar *local_ip,
+    const gchar *multicast_ip,
+    guint16 port,
+    guchar ttl,
+    int type_of_service,
+    gboolean join,
+    GError **error)
+{
+  int sock = -1;
+  struct sockaddr_in address;
+  int retval;
+  guchar loop = 1;
+
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = INADDR_ANY;
+
+  g_assert (multicast_ip);
+
+  if (!_ip_string_into_sockaddr_in (multicast_ip, &address, error))
+    goto error;
+
   if ((sock = socket (AF_INET, SOCK_DGRAM, IPPROTO_UDP)) <= 0) {
     g_set_error (error, FS_ERROR, FS_ERROR_NETWORK,
       "Error creating socket: %s", g_strerror (errno));
@@ -640,33 +814,24 @@ _bind_port (
     goto error;
   }
 
-  if (setsockopt (sock, SOL_SOCKET, SO_REUSEADDR, (const void *)&reuseaddr,
-          sizeof (reuseaddr)) < 0)
-  {
-    g_set_error (error, FS_ERROR, FS_ERROR_INVALID_ARGUMENTS,
-        "Error setting reuseaddr to TRUE: %s",
-        g_strerror (errno));
+  if (!_set_reuse (sock, error))
     goto error;
-  }
 
-#ifdef SO_REUSEPORT
-  if (setsockopt (sock, SOL_SOCKET, SO_REUSEPORT, (const void *)&reuseaddr,
-          sizeof (reuseaddr)) < 0)
+  if (join)
   {
-    g_set_error (error, FS_ERROR, FS_ERROR_INVALID_ARGUMENTS,
-        "Error setting reuseaddr to TRUE: %s",
-        g_strerror (errno));
-    goto error;
+    if (!_set_membership (sock, local_ip, multicast_ip, TRUE, error))
+      goto error;
   }
-#endif
-
-  if (setsockopt (sock, IPPROTO_IP, IP_ADD_MEMBERSHIP,
-          (const void *)&mreq, sizeof (mreq)) < 0)
+  else
   {
-    g_set_error (error, FS_ERROR, FS_ERROR_INVALID_ARGUMENTS,
-        "Could not join the socket to the multicast group: %s",
-        g_strerror (errno));
-    goto error;
+#ifdef IP_MULTICAST_ALL
+    /* Don't get the packets for the groups joined by the RecvSock */
+    int mcast_all = 0;
+
+    if (setsockopt (sock, IPPROTO_IP, IP_MULTICAST_ALL,
+            (const void *)&mcast_all, sizeof (mcast_all)) < 0)
+      GST_WARNING ("could not unset IP_MULTICAST_ALL: %s", g_strerror (errno));
+#endif
   }
 
   if (setsockopt (sock, IPPROTO_IP, IP_TOS,
@@ -696,31 +861,125 @@ _bind_port (
   return -1;
 }
 
+#ifdef HAVE_MULTICAST_SRC
+
+/*
+ * The shared socket can't be bound to local_ip like the udpsrc sockets are
+ * bound to their group, or it would not get the multicast packets at all.
+ * So it is bound to the interface that has local_ip instead.
+ */
+
+static void
+_bind_to_local_ip_device (gint sock, const gchar *local_ip)
+{
+#if defined (SO_BINDTODEVICE) && defined (HAVE_GETIFADDRS)
+  struct sockaddr_in address;
+  struct ifaddrs *ifaddrs, *ifa;
+
+  if (!_ip_string_into_sockaddr_in (local_ip, &address, NULL))
+    return;
+
+  if (getifaddrs (&ifaddrs) < 0)
+  {
+    GST_WARNING ("could not list the interfaces: %s", g_strerror (errno));
+    return;
+  }
+
+  for (ifa = ifaddrs; ifa; ifa = ifa->ifa_next)
+  {
+    if (ifa->ifa_addr == NULL || ifa->ifa_addr->sa_family != AF_INET ||
+        ((struct sockaddr_in *) ifa->ifa_addr)->sin_addr.s_addr !=
+        address.sin_addr.s_addr)
+      continue;
+
+    if (setsockopt (sock, SOL_SOCKET, SO_BINDTODEVICE, ifa->ifa_name,
+            strlen (ifa->ifa_name) + 1) < 0)
+      GST_WARNING ("could not bind the socket to %s (%s): %s", ifa->ifa_name,
+          local_ip, g_strerror (errno));
+    break;
+  }
+
+  if (ifa == NULL)
+    GST_WARNING ("no interface has the address %s", local_ip);
+
+  freeifaddrs (ifaddrs);
+#else
+  GST_WARNING ("can not bind the shared socket to the interface of %s, it"
+      " will also get the groups joined on the other interfaces", local_ip);
+#endif
+}
+
+static gint
+_bind_shared_port (const gchar *local_ip, guint16 port, GError **error)
+{
+  int sock = -1;
+  struct sockaddr_in address;
+  int pktinfo = 1;
+#ifdef IP_MULTICAST_ALL
+  int mcast_all = 0;
+#endif
+
+  memset (&address, 0, sizeof (address));
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = INADDR_ANY;
+  address.sin_port = htons (port);
+
+  if ((sock = socket (AF_INET, SOCK_DGRAM, IPPROTO_UDP)) <= 0) {
+    g_set_error (error, FS_ERROR, FS_ERROR_NETWORK,
+      "Error creating socket: %s", g_strerror (errno));
+    goto error;
+  }
+
+  if (!_set_reuse (sock, error))
+    goto error;
+
+  if (setsockopt (sock, IPPROTO_IP, IP_PKTINFO, (const void *)&pktinfo,
+          sizeof (pktinfo)) < 0)
+  {
+    g_set_error (error, FS_ERROR, FS_ERROR_NETWORK,
+        "Error enabling IP_PKTINFO: %s", g_strerror (errno));
+    goto error;
+  }
+
+#ifdef IP_MULTICAST_ALL
+  /* Only get the groups we joined, the others are filtered out by the
+   * FsMulticastSrc anyway */
+  if (setsockopt (sock, IPPROTO_IP, IP_MULTICAST_ALL,
+          (const void *)&mcast_all, sizeof (mcast_all)) < 0)
+    GST_WARNING ("could not unset IP_MULTICAST_ALL: %s", g_strerror (errno));
+#endif
+
+  if (local_ip)
+    _bind_to_local_ip_device (sock, local_ip);
+
+  if (bind (sock, (struct sockaddr *) &address, sizeof (address)) != 0)
+  {
+    g_set_error (error, FS_ERROR, FS_ERROR_NETWORK,
+        "Could not bind to port %d", port);
+    goto error;
+  }
+
+  return sock;
+
+ error:
+  if (sock >= 0)
+    close (sock);
+  return -1;
+}
+
+#endif
+
 static GstElement *
-_create_sinksource (gchar *elementname, GstBin *bin,
-    GstElement *teefunnel, GstElement *filter, gint fd,
+_add_sinksource (GstElement *elem, const gchar *elementname, GstBin *bin,
+    GstElement *teefunnel, GstElement *filter,
     GstPadDirection direction, GstPad **requested_pad, GError **error)
 {
-  GstElement *elem;
   GstPadLinkReturn ret = GST_PAD_LINK_OK;
   GstPad *elempad = NULL;
   GstStateChangeReturn state_ret;
 
   g_assert (direction == GST_PAD_SINK || direction == GST_PAD_SRC);
 
-  elem = gst_element_factory_make (elementname, NULL);
-  if (!elem) {
-    g_set_error (error, FS_ERROR, FS_ERROR_CONSTRUCTION,
-      "Could not create the %s element", elementname);
-    return NULL;
-  }
-
-  g_object_set (elem,
-    "closefd", FALSE,
-    "sockfd", fd,
-    "auto-multicast", FALSE,
-    NULL);
-
   if (!gst_bin_add (bin, elem)) {
     g_set_error (error, FS_ERROR, FS_ERROR_CONSTRUCTION,
       "Could not add the %s element to the gst %s bin", elementname,
@@ -841,6 +1100,417 @@ _create_sinksource (gchar *elementname, GstBin *bin,
   return NULL;
 }
 
+static GstElement *
+_create_sinksource (gchar *elementname, GstBin *bin,
+    GstElement *teefunnel, GstElement *filter, gint fd,
+    GstPadDirection direction, GstPad **requested_pad, GError **error)
+{
+  GstElement *elem;
+
+  elem = gst_element_factory_make (elementname, NULL);
+  if (!elem) {
+    g_set_error (error, FS_ERROR, FS_ERROR_CONSTRUCTION,
+      "Could not create the %s element", elementname);
+    return NULL;
+  }
+
+  g_object_set (elem,
+    "closefd", FALSE,
+    "sockfd", fd,
+    "auto-multicast", FALSE,
+    NULL);
+
+  return _add_sinksource (elem, elementname, bin, teefunnel, filter,
+      direction, requested_pad, error);
+}
+
+#ifdef HAVE_MULTICAST_SRC
+
+static void
+_remove_sinksource (GstElement *elem, const gchar *elementname, GstBin *bin)
+{
+  GstStateChangeReturn ret;
+
+  gst_element_set_locked_state (elem, TRUE);
+  ret = gst_element_set_state (elem, GST_STATE_NULL);
+  if (ret != GST_STATE_CHANGE_SUCCESS)
+    GST_ERROR ("Error changing state of %s: %s", elementname,
+        gst_element_state_change_return_get_name (ret));
+  if (!gst_bin_remove (bin, elem))
+    GST_ERROR ("Could not remove %s element from transmitter bin",
+        elementname);
+}
+
+#endif
+
+static guint
+udpsock_hash (gconstpointer v)
+{
+  const UdpSock *udpsock = v;
+  guint hash = g_str_hash (udpsock->multicast_ip) ^ udpsock->port;
+
+  if (udpsock->local_ip)
+    hash ^= g_str_hash (udpsock->local_ip) << 1;
+
+  return hash;
+}
+
+static gboolean
+udpsock_equal (gconstpointer v1, gconstpointer v2)
+{
+  const UdpSock *udpsock1 = v1;
+  const UdpSock *udpsock2 = v2;
+
+  return udpsock1->port == udpsock2->port &&
+    !strcmp (udpsock1->multicast_ip, udpsock2->multicast_ip) &&
+    ((udpsock1->local_ip == NULL && udpsock2->local_ip == NULL) ||
+        (udpsock1->local_ip && udpsock2->local_ip &&
+            !strcmp (udpsock1->local_ip, udpsock2->local_ip)));
+}
+
+static void
+udpsock_add_ttl_locked (UdpSock *udpsock, guint8 ttl)
+{
+  udpsock->ttl_counts[ttl]++;
+  udpsock->ttl_refcount++;
+}
+
+/*
+ * Returns: the new max TTL, or 0 if the last TTL was removed
+ */
+
+static guint8
+udpsock_remove_ttl_locked (UdpSock *udpsock, guint8 ttl)
+{
+  guint max;
+
+  g_return_val_if_fail (udpsock->ttl_counts[ttl] > 0, udpsock->current_ttl);
+
+  udpsock->ttl_counts[ttl]--;
+  udpsock->ttl_refcount--;
+
+  if (udpsock->ttl_refcount == 0)
+    return 0;
+
+  for (max = udpsock->current_ttl; max > 1; max--)
+    if (udpsock->ttl_counts[max])
+      break;
+
+  return max;
+}
+
+static guint
+recvsock_hash (gconstpointer v)
+{
+  const RecvSock *recvsock = v;
+
+  if (recvsock->local_ip)
+    return g_str_hash (recvsock->local_ip) ^ recvsock->port;
+  else
+    return recvsock->port;
+}
+
+static gboolean
+recvsock_equal (gconstpointer v1, gconstpointer v2)
+{
+  const RecvSock *recvsock1 = v1;
+  const RecvSock *recvsock2 = v2;
+
+  return recvsock1->port == recvsock2->port &&
+    ((recvsock1->local_ip == NULL && recvsock2->local_ip == NULL) ||
+        (recvsock1->local_ip && recvsock2->local_ip &&
+            !strcmp (recvsock1->local_ip, recvsock2->local_ip)));
+}
+
+#ifdef HAVE_MULTICAST_SRC
+
+static void
+fs_multicast_transmitter_free_recvsock (FsMulticastTransmitter *trans,
+    RecvSock *recvsock)
+{
+  if (recvsock->src)
+    _remove_sinksource (recvsock->src, "multicast source",
+        GST_BIN (trans->priv->gst_src));
+
+  if (recvsock->src_requested_pad)
+  {
+    gst_element_release_request_pad (recvsock->funnel,
+        recvsock->src_requested_pad);
+    gst_object_unref (recvsock->src_requested_pad);
+  }
+
+  if (recvsock->fd >= 0)
+    close (recvsock->fd);
+
+  g_free (recvsock->local_ip);
+  g_slice_free (RecvSock, recvsock);
+}
+
+/*
+ * Creates a new RecvSock, without adding it to the recvsocks table, this is
+ * done without holding the udpsocks mutex.
+ */
+
+static RecvSock *
+fs_multicast_transmitter_new_recvsock (FsMulticastTransmitter *trans,
+    guint component_id,
+    const gchar *local_ip,
+    guint16 port,
+    GError **error)
+{
+  RecvSock *recvsock = g_slice_new0 (RecvSock);
+
+  recvsock->local_ip = g_strdup (local_ip);
+  recvsock->port = port;
+  recvsock->component_id = component_id;
+  recvsock->funnel = trans->priv->udpsrc_funnels[component_id];
+
+  recvsock->fd = _bind_shared_port (local_ip, port, error);
+  if (recvsock->fd < 0)
+    goto error;
+
+  recvsock->src = _add_sinksource (fs_multicast_src_new (recvsock->fd),
+      "multicast source", GST_BIN (trans->priv->gst_src), recvsock->funnel,
+      NULL, GST_PAD_SRC, &recvsock->src_requested_pad, error);
+  if (!recvsock->src)
+    goto error;
+
+  return recvsock;
+
+ error:
+  fs_multicast_transmitter_free_recvsock (trans, recvsock);
+  return NULL;
+}
+
+/*
+ * Adds the group to the RecvSock of this local_ip:port that has already
+ * joined it, or else to the first one that can still join it. The RecvSocks
+ * that can't join any more groups are marked as full and skipped.
+ *
+ * Returns: the RecvSock or %NULL if there is none or they are all full,
+ *  @error is only set if joining failed for another reason
+ */
+
+static RecvSock *
+fs_multicast_transmitter_join_recvsock_locked (FsMulticastTransmitter *trans,
+    guint component_id,
+    const gchar *local_ip,
+    const gchar *multicast_ip,
+    const struct in_addr *group,
+    guint16 port,
+    GError **error)
+{
+  RecvSock key;
+  RecvSock *head;
+  RecvSock *recvsock;
+
+  key.local_ip = (gchar *) local_ip;
+  key.port = port;
+
+  head = g_hash_table_lookup (trans->priv->recvsocks[component_id], &key);
+
+  for (recvsock = head; recvsock; recvsock = recvsock->next)
+  {
+    if (fs_multicast_src_has_group (FS_MULTICAST_SRC (recvsock->src), group))
+    {
+      fs_multicast_src_add_group (FS_MULTICAST_SRC (recvsock->src), group);
+      recvsock->refcount++;
+      return recvsock;
+    }
+  }
+
+  for (recvsock = head; recvsock; recvsock = recvsock->next)
+  {
+    GError *local_error = NULL;
+    gint errsv;
+
+    if (recvsock->full)
+      continue;
+
+    fs_multicast_src_add_group (FS_MULTICAST_SRC (recvsock->src), group);
+    if (_set_membership (recvsock->fd, local_ip, multicast_ip, TRUE,
+            &local_error))
+    {
+      recvsock->refcount++;
+      return recvsock;
+    }
+    errsv = errno;
+    fs_multicast_src_remove_group (FS_MULTICAST_SRC (recvsock->src), group);
+
+    if (errsv != ENOBUFS)
+    {
+      g_propagate_error (error, local_error);
+      return NULL;
+    }
+
+    GST_DEBUG ("Socket %d can not join more groups, trying the next one",
+        recvsock->fd);
+    g_clear_error (&local_error);
+    recvsock->full = TRUE;
+  }
+
+  return NULL;
+}
+
+static void
+fs_multicast_transmitter_append_recvsock_locked (FsMulticastTransmitter *trans,
+    RecvSock *recvsock)
+{
+  RecvSock *last;
+
+  last = g_hash_table_lookup (trans->priv->recvsocks[recvsock->component_id],
+      recvsock);
+
+  if (!last)
+  {
+    g_hash_table_insert (trans->priv->recvsocks[recvsock->component_id],
+        recvsock, recvsock);
+    return;
+  }
+
+  while (last->next)
+    last = last->next;
+  last->next = recvsock;
+}
+
+static void
+fs_multicast_transmitter_unlink_recvsock_locked (FsMulticastTransmitter *trans,
+    RecvSock *recvsock)
+{
+  GHashTable *recvsocks = trans->priv->recvsocks[recvsock->component_id];
+  RecvSock *prev;
+
+  prev = g_hash_table_lookup (recvsocks, recvsock);
+
+  if (prev == recvsock)
+  {
+    g_hash_table_remove (recvsocks, recvsock);
+    if (recvsock->next)
+      g_hash_table_insert (recvsocks, recvsock->next, recvsock->next);
+  }
+  else
+  {
+    while (prev->next != recvsock)
+      prev = prev->next;
+    prev->next = recvsock->next;
+  }
+
+  recvsock->next = NULL;
+}
+
+/*
+ * Gets a RecvSock for this local_ip:port that has joined the group,
+ * creating a new one if there is none yet or if they are all full.
+ */
+
+static RecvSock *
+fs_multicast_transmitter_get_recvsock (FsMulticastTransmitter *trans,
+    guint component_id,
+    const gchar *local_ip,
+    const gchar *multicast_ip,
+    guint16 port,
+    GError **error)
+{
+  GMutex *mutex = trans->priv->udpsocks_mutexes[component_id];
+  RecvSock *recvsock;
+  RecvSock *newsock;
+  struct sockaddr_in group;
+  GError *local_error = NULL;
+
+  if (!_ip_string_into_sockaddr_in (multicast_ip, &group, error))
+    return NULL;
+
+  g_mutex_lock (mutex);
+  recvsock = fs_multicast_transmitter_join_recvsock_locked (trans,
+      component_id, local_ip, multicast_ip, &group.sin_addr, port,
+      &local_error);
+  g_mutex_unlock (mutex);
+
+  if (recvsock)
+    return recvsock;
+
+  if (local_error)
+  {
+    g_propagate_error (error, local_error);
+    return NULL;
+  }
+
+  newsock = fs_multicast_transmitter_new_recvsock (trans, component_id,
+      local_ip, port, error);
+  if (!newsock)
+    return NULL;
+
+  g_mutex_lock (mutex);
+  /* Someone else may have joined this group or left another one while the
+   * new socket was being created */
+  recvsock = fs_multicast_transmitter_join_recvsock_locked (trans,
+      component_id, local_ip, multicast_ip, &group.sin_addr, port,
+      &local_error);
+  if (!recvsock && !local_error)
+  {
+    fs_multicast_src_add_group (FS_MULTICAST_SRC (newsock->src),
+        &group.sin_addr);
+    if (_set_membership (newsock->fd, local_ip, multicast_ip, TRUE,
+            &local_error))
+    {
+      newsock->refcount++;
+      fs_multicast_transmitter_append_recvsock_locked (trans, newsock);
+      recvsock = newsock;
+      newsock = NULL;
+    }
+  }
+  g_mutex_unlock (mutex);
+
+  if (newsock)
+    fs_multicast_transmitter_free_recvsock (trans, newsock);
+
+  if (local_error)
+    g_propagate_error (error, local_error);
+
+  return recvsock;
+}
+
+static void
+fs_multicast_transmitter_put_recvsock (FsMulticastTransmitter *trans,
+    RecvSock *recvsock, const gchar *multicast_ip)
+{
+  GMutex *mutex = trans->priv->udpsocks_mutexes[recvsock->component_id];
+  struct sockaddr_in group;
+  GError *error = NULL;
+
+  g_mutex_lock (mutex);
+
+  if (_ip_string_into_sockaddr_in (multicast_ip, &group, NULL) &&
+      fs_multicast_src_remove_group (FS_MULTICAST_SRC (recvsock->src),
+          &group.sin_addr))
+  {
+    if (_set_membership (recvsock->fd, recvsock->local_ip, multicast_ip,
+            FALSE, &error))
+    {
+      recvsock->full = FALSE;
+    }
+    else
+    {
+      GST_WARNING ("%s", error->message);
+      g_clear_error (&error);
+    }
+  }
+
+  recvsock->refcount--;
+  if (recvsock->refcount > 0)
+  {
+    g_mutex_unlock (mutex);
+    return;
+  }
+
+  fs_multicast_transmitter_unlink_recvsock_locked (trans, recvsock);
+  g_mutex_unlock (mutex);
+
+  fs_multicast_transmitter_free_recvsock (trans, recvsock);
+}
+
+#endif /* HAVE_MULTICAST_SRC */
+
 static UdpSock *
 fs_multicast_transmitter_get_udpsock_locked (FsMulticastTransmitter *trans,
     guint component_id,
@@ -851,40 +1521,33 @@ fs_multicast_transmitter_get_udpsock_locked (FsMulticastTransmitter *trans,
     gboolean sending,
     GError **error)
 {
+  UdpSock key;
   UdpSock *udpsock;
-  GList *udpsock_e;
 
-  for (udpsock_e = g_list_first (trans->priv->udpsocks[component_id]);
-       udpsock_e;
-       udpsock_e = g_list_next (udpsock_e))
-  {
-    udpsock = udpsock_e->data;
+  key.local_ip = (gchar *) local_ip;
+  key.multicast_ip = (gchar *) multicast_ip;
+  key.port = port;
 
-    if (port == udpsock->port &&
-        !strcmp (multicast_ip, udpsock->multicast_ip) &&
-        ((local_ip == NULL && udpsock->local_ip == NULL) ||
-            (local_ip && udpsock->local_ip &&
-                !strcmp (local_ip, udpsock->local_ip))))
-    {
-      if (ttl > udpsock->current_ttl)
-      {
+  udpsock = g_hash_table_lookup (trans->priv->udpsocks[component_id], &key);
+  if (!udpsock)
+    return NULL;
 
-        if (setsockopt (udpsock->fd, IPPROTO_IP, IP_MULTICAST_TTL,
-                (const void *)&ttl, sizeof (ttl)) < 0)
-        {
-          g_set_error (error, FS_ERROR, FS_ERROR_INVALID_ARGUMENTS,
-              "Error setting the multicast TTL: %s",
-              g_strerror (errno));
-          return NULL;
-        }
-        udpsock->current_ttl = ttl;
-      }
-      g_byte_array_append (udpsock->ttls, &ttl, 1);
+  if (ttl > udpsock->current_ttl)
+  {
 
-      return udpsock;
+    if (setsockopt (udpsock->fd, IPPROTO_IP, IP_MULTICAST_TTL,
+            (const void *)&ttl, sizeof (ttl)) < 0)
+    {
+      g_set_error (error, FS_ERROR, FS_ERROR_INVALID_ARGUMENTS,
+          "Error setting the multicast TTL: %s",
+          g_strerror (errno));
+      return NULL;
     }
+    udpsock->current_ttl = ttl;
   }
-  return NULL;
+  udpsock_add_ttl_locked (udpsock, ttl);
+
+  return udpsock;
 }
 
 UdpSock *
@@ -901,6 +1564,7 @@ fs_multicast_transmitter_get_udpsock (FsMulticastTransmitter *trans,
   UdpSock *tmpudpsock;
   GError *local_error = NULL;
   int tos;
+  gboolean shared_receive;
 
   /* First lets check if we already have one */
   if (component_id > trans->components)
@@ -911,11 +1575,19 @@ fs_multicast_transmitter_get_udpsock (FsMulticastTransmitter *trans,
   }
 
   g_mutex_lock (trans->priv->mutex);
-  udpsock = fs_multicast_transmitter_get_udpsock_locked (trans, component_id,
-      local_ip, multicast_ip, port, ttl, sending, &local_error);
   tos = trans->priv->type_of_service;
+#ifdef HAVE_MULTICAST_SRC
+  shared_receive = trans->priv->shared_receive;
+#else
+  shared_receive = FALSE;
+#endif
   g_mutex_unlock (trans->priv->mutex);
 
+  g_mutex_lock (trans->priv->udpsocks_mutexes[component_id]);
+  udpsock = fs_multicast_transmitter_get_udpsock_locked (trans, component_id,
+      local_ip, multicast_ip, port, ttl, sending, &local_error);
+  g_mutex_unlock (trans->priv->udpsocks_mutexes[component_id]);
+
   if (local_error)
   {
     g_propagate_error (error, local_error);
@@ -937,12 +1609,12 @@ fs_multicast_transmitter_get_udpsock (FsMulticastTransmitter *trans,
   udpsock->component_id = component_id;
   udpsock->port = port;
   udpsock->current_ttl = ttl;
-  udpsock->ttls = g_byte_array_new ();
-  g_byte_array_append (udpsock->ttls, &ttl, 1);
+  udpsock_add_ttl_locked (udpsock, ttl);
 
   /* Now lets bind both ports */
 
-  udpsock->fd = _bind_port (local_ip, multicast_ip, port, ttl, tos, error);
+  udpsock->fd = _bind_port (local_ip, multicast_ip, port, ttl, tos,
+      !shared_receive, error);
   if (udpsock->fd < 0)
     goto error;
 
@@ -951,11 +1623,23 @@ fs_multicast_transmitter_get_udpsock (FsMulticastTransmitter *trans,
   udpsock->tee = trans->priv->udpsink_tees[component_id];
   udpsock->funnel = trans->priv->udpsrc_funnels[component_id];
 
-  udpsock->udpsrc = _create_sinksource ("udpsrc",
-      GST_BIN (trans->priv->gst_src), udpsock->funnel, NULL, udpsock->fd,
-      GST_PAD_SRC, &udpsock->udpsrc_requested_pad, error);
-  if (!udpsock->udpsrc)
-    goto error;
+#ifdef HAVE_MULTICAST_SRC
+  if (shared_receive)
+  {
+    udpsock->recvsock = fs_multicast_transmitter_get_recvsock (trans,
+        component_id, local_ip, multicast_ip, port, error);
+    if (!udpsock->recvsock)
+      goto error;
+  }
+  else
+#endif
+  {
+    udpsock->udpsrc = _create_sinksource ("udpsrc",
+        GST_BIN (trans->priv->gst_src), udpsock->funnel, NULL, udpsock->fd,
+        GST_PAD_SRC, &udpsock->udpsrc_requested_pad, error);
+    if (!udpsock->udpsrc)
+      goto error;
+  }
 
   udpsock->udpsink_recvonly_filter = fs_transmitter_get_recvonly_filter (
       FS_TRANSMITTER (trans), udpsock->component_id);
@@ -972,14 +1656,14 @@ fs_multicast_transmitter_get_udpsock (FsMulticastTransmitter *trans,
       "sync", FALSE,
       NULL);
 
-  g_mutex_lock (trans->priv->mutex);
+  g_mutex_lock (trans->priv->udpsocks_mutexes[component_id]);
   /* Check if someone else has added the same thing at the same time */
   tmpudpsock = fs_multicast_transmitter_get_udpsock_locked (trans, component_id,
       local_ip, multicast_ip, port, ttl, sending, &local_error);
 
   if (tmpudpsock || local_error)
   {
-    g_mutex_unlock (trans->priv->mutex);
+    g_mutex_unlock (trans->priv->udpsocks_mutexes[component_id]);
     fs_multicast_transmitter_put_udpsock (trans, udpsock, ttl);
     if (local_error)
     {
@@ -991,9 +1675,8 @@ fs_multicast_transmitter_get_udpsock (FsMulticastTransmitter *trans,
     return tmpudpsock;
   }
 
-  trans->priv->udpsocks[component_id] =
-    g_list_prepend (trans->priv->udpsocks[component_id], udpsock);
-  g_mutex_unlock (trans->priv->mutex);
+  g_hash_table_insert (trans->priv->udpsocks[component_id], udpsock, udpsock);
+  g_mutex_unlock (trans->priv->udpsocks_mutexes[component_id]);
 
   if (udpsock->udpsink_recvonly_filter)
   {
@@ -1019,54 +1702,39 @@ void
 fs_multicast_transmitter_put_udpsock (FsMulticastTransmitter *trans,
     UdpSock *udpsock, guint8 ttl)
 {
-  guint i;
+  GMutex *mutex = trans->priv->udpsocks_mutexes[udpsock->component_id];
+  guint8 max;
 
-  g_mutex_lock (trans->priv->mutex);
-  for (i = udpsock->ttls->len - 1;; i--)
-  {
-    if (udpsock->ttls->data[i] == ttl)
-    {
-      g_byte_array_remove_index_fast (udpsock->ttls, i);
-      break;
-    }
-
-    g_return_if_fail (i > 0);
-  }
+  g_mutex_lock (mutex);
+  max = udpsock_remove_ttl_locked (udpsock, ttl);
 
-  if (udpsock->ttls->len > 0)
+  if (max > 0)
   {
-    /* If we were the max, check if there is a new max */
-    if (udpsock->current_ttl == ttl && ttl > 1)
+    /* If we were the max, there may be a new max */
+    if (max != udpsock->current_ttl)
     {
-      guint8 max = 1;
-      for (i = 0; i < udpsock->ttls->len; i++)
-      {
-        if (udpsock->ttls->data[i] > max)
-          max = udpsock->ttls->data[i];
-      }
-
-      if (max != udpsock->current_ttl)
+      if (setsockopt (udpsock->fd, IPPROTO_IP, IP_MULTICAST_TTL,
+              (const void *)&max, sizeof (max)) < 0)
       {
-
-        if (setsockopt (udpsock->fd, IPPROTO_IP, IP_MULTICAST_TTL,
-                (const void *)&max, sizeof (max)) < 0)
-        {
-          GST_WARNING ("Error setting the multicast TTL to %u: %s", max,
-              g_strerror (errno));
-          g_mutex_unlock (trans->priv->mutex);
-          return;
-        }
-        udpsock->current_ttl = max;
+        GST_WARNING ("Error setting the multicast TTL to %u: %s", max,
+            g_strerror (errno));
+        g_mutex_unlock (mutex);
+        return;
       }
+      udpsock->current_ttl = max;
     }
-    g_mutex_unlock (trans->priv->mutex);
+    g_mutex_unlock (mutex);
     return;
   }
 
-  trans->priv->udpsocks[udpsock->component_id] =
-    g_list_remove (trans->priv->udpsocks[udpsock->component_id], udpsock);
+  /* Only remove it if it is the one in the table, it may be a duplicate
+   * created by a concurrent get_udpsock () */
+  if (g_hash_table_lookup (trans->priv->udpsocks[udpsock->component_id],
+          udpsock) == udpsock)
+    g_hash_table_remove (trans->priv->udpsocks[udpsock->component_id],
+        udpsock);
 
-  g_mutex_unlock (trans->priv->mutex);
+  g_mutex_unlock (mutex);
 
   if (udpsock->udpsrc)
   {
@@ -1087,6 +1755,12 @@ fs_multicast_transmitter_put_udpsock (FsMulticastTransmitter *trans,
     gst_object_unref (udpsock->udpsrc_requested_pad);
   }
 
+#ifdef HAVE_MULTICAST_SRC
+  if (udpsock->recvsock)
+    fs_multicast_transmitter_put_recvsock (trans, udpsock->recvsock,
+        udpsock->multicast_ip);
+#endif
+
   if (udpsock->udpsink_requested_pad)
   {
     gst_element_release_request_pad (udpsock->tee,
@@ -1123,7 +1797,6 @@ fs_multicast_transmitter_put_udpsock (FsMulticastTransmitter *trans,
   if (udpsock->fd >= 0)
     close (udpsock->fd);
 
-  g_byte_array_free (udpsock->ttls, TRUE);
   g_free (udpsock->multicast_ip);
   g_free (udpsock->local_ip);
   g_slice_free (UdpSock, udpsock);
@@ -1172,9 +1845,11 @@ void
 fs_multicast_transmitter_udpsock_ref (FsMulticastTransmitter *trans,
     UdpSock *udpsock, guint8 ttl)
 {
-  g_mutex_lock (trans->priv->mutex);
-  g_byte_array_append (udpsock->ttls, &ttl, 1);
-  g_mutex_unlock (trans->priv->mutex);
+  GMutex *mutex = trans->priv->udpsocks_mutexes[udpsock->component_id];
+
+  g_mutex_lock (mutex);
+  udpsock_add_ttl_locked (udpsock, ttl);
+  g_mutex_unlock (mutex);
 }
 
 
@@ -1190,13 +1865,16 @@ fs_multicast_transmitter_set_type_of_service (FsMulticastTransmitter *self,
 
   self->priv->type_of_service = tos;
 
-  for (i = 0; i < self->components; i++)
+  for (i = 1; i <= self->components; i++)
   {
-    GList *item;
+    GHashTableIter iter;
+    gpointer value;
 
-    for (item = self->priv->udpsocks[i]; item; item = item->next)
+    g_mutex_lock (self->priv->udpsocks_mutexes[i]);
+    g_hash_table_iter_init (&iter, self->priv->udpsocks[i]);
+    while (g_hash_table_iter_next (&iter, NULL, &value))
     {
-      UdpSock *udpsock = item->data;
+      UdpSock *udpsock = value;
 
       if (setsockopt (udpsock->fd, IPPROTO_IP, IP_TOS,
               &tos, sizeof (tos)) < 0)
@@ -1208,6 +1886,7 @@ fs_multicast_transmitter_set_type_of_service (FsMulticastTransmitter *self,
         GST_WARNING ("could not set TCLASS: %s", g_strerror (errno));
 #endif
     }
+    g_mutex_unlock (self->priv->udpsocks_mutexes[i]);
   }
 
  out:
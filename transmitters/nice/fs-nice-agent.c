@@ -39,6 +39,7 @@
 
 #include <nice/nice.h>
 
+#include <stdlib.h>
 #include <string.h>
 #include <sys/types.h>
 
@@ -58,11 +59,40 @@ enum
   PROP_PREFERRED_LOCAL_CANDIDATES,
 };
 
+/*
+ * If the agent-threads property of the transmitter is set to a number N,
+ * its agents share the first N threads of a process-wide pool, each running
+ * its own GMainContext, instead of every agent running its own thread. New
+ * agents go to the one of those threads with the fewest agents.
+ */
+
+typedef struct _AgentThread AgentThread;
+
+struct _AgentThread
+{
+  GMainContext *main_context;
+  GMainLoop *main_loop;
+  GThread *thread;
+
+  /* Protected by the pool mutex */
+  guint n_agents;
+};
+
+static GStaticMutex pool_mutex = G_STATIC_MUTEX_INIT;
+/* Everything below is protected by the pool_mutex */
+/* Of AgentThread, which are never freed */
+static GPtrArray *pool = NULL;
+static guint pool_next = 0;
+
 struct _FsNiceAgentPrivate
 {
   GMainContext *main_context;
+  /* NULL if the agent is in a pool thread */
   GMainLoop *main_loop;
 
+  /* The pool thread that runs this agent, if any */
+  AgentThread *pool_thread;
+
   guint compatibility_mode;
 
   GList *preferred_local_candidates;
@@ -72,6 +102,10 @@ struct _FsNiceAgentPrivate
   /* Everything below is protected by the mutex */
 
   GThread *thread;
+
+  /* The sources added with fs_nice_agent_add_idle() and
+   * fs_nice_agent_add_timeout(), destroyed with the agent */
+  GSList *sources;
 };
 
 #define FS_NICE_AGENT_GET_PRIVATE(o)  \
@@ -88,6 +122,8 @@ static void fs_nice_agent_init (FsNiceAgent *self);
 static void fs_nice_agent_dispose (GObject *object);
 static void fs_nice_agent_finalize (GObject *object);
 static void fs_nice_agent_stop_thread (FsNiceAgent *self);
+static void fs_nice_agent_pool_release (FsNiceAgent *self);
+static void fs_nice_agent_destroy_sources (FsNiceAgent *self);
 
 static void fs_nice_agent_set_property (GObject *object,
     guint prop_id,
@@ -177,9 +213,6 @@ fs_nice_agent_init (FsNiceAgent *self)
 
   self->priv->mutex = g_mutex_new ();
 
-  self->priv->main_context = g_main_context_new ();
-  self->priv->main_loop = g_main_loop_new (self->priv->main_context, FALSE);
-
   self->priv->compatibility_mode = NICE_COMPATIBILITY_DRAFT19;
 }
 
@@ -189,7 +222,12 @@ fs_nice_agent_dispose (GObject *object)
 {
   FsNiceAgent *self = FS_NICE_AGENT (object);
 
-  fs_nice_agent_stop_thread (self);
+  fs_nice_agent_destroy_sources (self);
+
+  if (self->priv->pool_thread)
+    fs_nice_agent_pool_release (self);
+  else
+    fs_nice_agent_stop_thread (self);
 
   if (self->agent)
     g_object_unref (self->agent);
@@ -265,6 +303,176 @@ fs_nice_agent_get_property (GObject *object,
 }
 
 
+static gpointer
+fs_nice_agent_pool_thread (gpointer data)
+{
+  AgentThread *thread = data;
+
+  g_main_loop_run (thread->main_loop);
+
+  return NULL;
+}
+
+/*
+ * Returns: the number of pool threads used by default, from the
+ * FS_NICE_AGENT_THREADS environment variable
+ */
+
+guint
+fs_nice_agent_get_default_threads (void)
+{
+  static gsize threads = 0;
+
+  if (g_once_init_enter (&threads))
+  {
+    const gchar *env = g_getenv ("FS_NICE_AGENT_THREADS");
+
+    /* Stored plus one, g_once_init_leave() doesn't accept 0 */
+    g_once_init_leave (&threads, (env ? MAX (atoi (env), 0) : 0) + 1);
+  }
+
+  return threads - 1;
+}
+
+/*
+ * Gives the agent one of the first @threads threads of the pool, starting
+ * the thread if needed. Leaves pool_thread NULL if @threads is 0.
+ */
+
+static gboolean
+fs_nice_agent_pool_attach (FsNiceAgent *self, guint threads, GError **error)
+{
+  AgentThread *thread = NULL;
+  guint index = 0;
+  guint i;
+
+  if (threads == 0)
+    return TRUE;
+
+  g_static_mutex_lock (&pool_mutex);
+
+  if (!pool)
+    pool = g_ptr_array_new ();
+  while (pool->len < threads)
+    g_ptr_array_add (pool, g_new0 (AgentThread, 1));
+
+  /* Least loaded thread, going round-robin between equally loaded ones */
+  for (i = 0; i < threads; i++)
+  {
+    AgentThread *candidate = g_ptr_array_index (pool,
+        (pool_next + i) % threads);
+
+    if (!thread || candidate->n_agents < thread->n_agents)
+    {
+      thread = candidate;
+      index = (pool_next + i) % threads;
+    }
+  }
+  pool_next = (index + 1) % threads;
+
+  if (!thread->thread)
+  {
+    thread->main_context = g_main_context_new ();
+    thread->main_loop = g_main_loop_new (thread->main_context, FALSE);
+    /* Pool threads run until the process exits */
+    thread->thread = g_thread_create (fs_nice_agent_pool_thread, thread,
+        FALSE, error);
+
+    if (!thread->thread)
+    {
+      g_main_loop_unref (thread->main_loop);
+      thread->main_loop = NULL;
+      g_main_context_unref (thread->main_context);
+      thread->main_context = NULL;
+      g_static_mutex_unlock (&pool_mutex);
+      return FALSE;
+    }
+  }
+
+  thread->n_agents++;
+  GST_DEBUG ("Agent %p uses pool thread %u which now has %u agents", self,
+      index, thread->n_agents);
+
+  g_static_mutex_unlock (&pool_mutex);
+
+  self->priv->pool_thread = thread;
+  self->priv->main_context = g_main_context_ref (thread->main_context);
+
+  return TRUE;
+}
+
+static gboolean
+agent_unref_idler (gpointer data)
+{
+  g_object_unref (data);
+
+  return FALSE;
+}
+
+/*
+ * The NiceAgent is unreffed from the pool thread, so that it is never
+ * finalized while one of its sources is being dispatched there. This is
+ * done asynchronously, nothing waits for the pool thread.
+ */
+
+static void
+fs_nice_agent_pool_release (FsNiceAgent *self)
+{
+  AgentThread *thread = self->priv->pool_thread;
+
+  if (self->agent)
+  {
+    if (thread->thread == g_thread_self ())
+    {
+      g_object_unref (self->agent);
+    }
+    else
+    {
+      GSource *idle_source = g_idle_source_new ();
+
+      g_source_set_priority (idle_source, G_PRIORITY_HIGH);
+      g_source_set_callback (idle_source, agent_unref_idler, self->agent,
+          NULL);
+      g_source_attach (idle_source, thread->main_context);
+      g_source_unref (idle_source);
+    }
+    self->agent = NULL;
+  }
+
+  g_static_mutex_lock (&pool_mutex);
+  thread->n_agents--;
+  g_static_mutex_unlock (&pool_mutex);
+
+  self->priv->pool_thread = NULL;
+}
+
+/*
+ * Returns: a #GValueArray with the number of agents of each pool thread
+ */
+
+GValueArray *
+fs_nice_agent_get_thread_loads (void)
+{
+  GValueArray *loads;
+  guint i;
+
+  g_static_mutex_lock (&pool_mutex);
+  loads = g_value_array_new (pool ? pool->len : 0);
+  for (i = 0; pool && i < pool->len; i++)
+  {
+    AgentThread *thread = g_ptr_array_index (pool, i);
+    GValue value = {0};
+
+    g_value_init (&value, G_TYPE_UINT);
+    g_value_set_uint (&value, thread->n_agents);
+    g_value_array_append (loads, &value);
+    g_value_unset (&value);
+  }
+  g_static_mutex_unlock (&pool_mutex);
+
+  return loads;
+}
+
 static gboolean
 thread_unlock_idler (gpointer data)
 {
@@ -280,6 +488,9 @@ fs_nice_agent_stop_thread (FsNiceAgent *self)
 {
   GSource *idle_source;
 
+  if (!self->priv->main_loop)
+    return;
+
   g_main_loop_quit (self->priv->main_loop);
 
   FS_NICE_AGENT_LOCK(self);
@@ -387,9 +598,15 @@ fs_nice_agent_init_agent (FsNiceAgent *self, GError **error)
   return TRUE;
 }
 
+/*
+ * @threads: the number of pool threads the agent can be run by, or 0 to
+ *  give it its own thread
+ */
+
 FsNiceAgent *
 fs_nice_agent_new (guint compatibility_mode,
     GList *preferred_local_candidates,
+    guint threads,
     GError **error)
 {
   FsNiceAgent *self = NULL;
@@ -399,6 +616,18 @@ fs_nice_agent_new (guint compatibility_mode,
       "preferred-local-candidates", preferred_local_candidates,
       NULL);
 
+  if (!fs_nice_agent_pool_attach (self, threads, error))
+  {
+    g_object_unref (self);
+    return NULL;
+  }
+
+  if (!self->priv->pool_thread)
+  {
+    self->priv->main_context = g_main_context_new ();
+    self->priv->main_loop = g_main_loop_new (self->priv->main_context, FALSE);
+  }
+
   self->agent = nice_agent_new (self->priv->main_context,
       self->priv->compatibility_mode);
 
@@ -416,6 +645,9 @@ fs_nice_agent_new (guint compatibility_mode,
     return NULL;
   }
 
+  if (self->priv->pool_thread)
+    return self;
+
   FS_NICE_AGENT_LOCK (self);
 
   self->priv->thread = g_thread_create (fs_nice_agent_main_thread,
@@ -433,6 +665,112 @@ fs_nice_agent_new (guint compatibility_mode,
 }
 
 
+static void
+fs_nice_agent_track_source (FsNiceAgent *self, GSource *source)
+{
+  GSList *item, *next;
+
+  FS_NICE_AGENT_LOCK (self);
+  /* Forget the sources that are already gone */
+  for (item = self->priv->sources; item; item = next)
+  {
+    next = item->next;
+    if (g_source_is_destroyed (item->data))
+    {
+      g_source_unref (item->data);
+      self->priv->sources = g_slist_delete_link (self->priv->sources, item);
+    }
+  }
+  self->priv->sources = g_slist_prepend (self->priv->sources,
+      g_source_ref (source));
+  FS_NICE_AGENT_UNLOCK (self);
+}
+
+typedef struct {
+  GSList *sources;
+  GMutex *mutex;
+  GCond *cond;
+  gboolean done;
+} DestroySources;
+
+static void
+destroy_source_list (GSList *sources)
+{
+  GSList *item;
+
+  for (item = sources; item; item = item->next)
+  {
+    g_source_destroy (item->data);
+    g_source_unref (item->data);
+  }
+  g_slist_free (sources);
+}
+
+static gboolean
+destroy_sources_idler (gpointer data)
+{
+  DestroySources *ds = data;
+
+  destroy_source_list (ds->sources);
+
+  g_mutex_lock (ds->mutex);
+  ds->done = TRUE;
+  g_cond_signal (ds->cond);
+  g_mutex_unlock (ds->mutex);
+
+  return FALSE;
+}
+
+/*
+ * The pool threads outlive the agents, so their sources must be removed
+ * from the shared context explicitly. This is done from the thread that
+ * runs the context, waiting for it, so none of their callbacks can still be
+ * running once this returns.
+ */
+
+static void
+fs_nice_agent_destroy_sources (FsNiceAgent *self)
+{
+  DestroySources ds = {0};
+  GSource *idle_source;
+  GThread *thread;
+
+  FS_NICE_AGENT_LOCK (self);
+  ds.sources = self->priv->sources;
+  self->priv->sources = NULL;
+  thread = self->priv->thread;
+  FS_NICE_AGENT_UNLOCK (self);
+
+  if (!ds.sources)
+    return;
+
+  if (self->priv->pool_thread)
+    thread = self->priv->pool_thread->thread;
+
+  if (thread == NULL || thread == g_thread_self ())
+  {
+    destroy_source_list (ds.sources);
+    return;
+  }
+
+  ds.mutex = g_mutex_new ();
+  ds.cond = g_cond_new ();
+
+  idle_source = g_idle_source_new ();
+  g_source_set_priority (idle_source, G_PRIORITY_HIGH);
+  g_source_set_callback (idle_source, destroy_sources_idler, &ds, NULL);
+  g_source_attach (idle_source, self->priv->main_context);
+  g_source_unref (idle_source);
+
+  g_mutex_lock (ds.mutex);
+  while (!ds.done)
+    g_cond_wait (ds.cond, ds.mutex);
+  g_mutex_unlock (ds.mutex);
+
+  g_cond_free (ds.cond);
+  g_mutex_free (ds.mutex);
+}
+
 void
 fs_nice_agent_add_idle (FsNiceAgent *agent, GSourceFunc func,
     gpointer data, GDestroyNotify destroy_notify)
@@ -444,6 +782,29 @@ fs_nice_agent_add_idle (FsNiceAgent *agent, GSourceFunc func,
   source = g_idle_source_new ();
   g_source_set_priority (source, G_PRIORITY_HIGH);
   g_source_set_callback (source, func, data, destroy_notify);
+  fs_nice_agent_track_source (agent, source);
   g_source_attach (source, agent->priv->main_context);
   g_source_unref (source);
 }
+
+/*
+ * Runs @func every @interval milliseconds in the agent's thread.
+ * Returns: the new source, to be released with g_source_destroy() and
+ * g_source_unref()
+ */
+
+GSource *
+fs_nice_agent_add_timeout (FsNiceAgent *agent, guint interval,
+    GSourceFunc func, gpointer data, GDestroyNotify destroy_notify)
+{
+  GSource *source;
+
+  g_return_val_if_fail (func != NULL, NULL);
+
+  source = g_timeout_source_new (interval);
+  g_source_set_callback (source, func, data, destroy_notify);
+  fs_nice_agent_track_source (agent, source);
+  g_source_attach (source, agent->priv->main_context);
+
+  return source;
+}
@@ -85,11 +85,19 @@ GType fs_nice_agent_get_type (void);
 
 FsNiceAgent *fs_nice_agent_new (guint compatibility_mode,
     GList *preferred_local_candidates,
+    guint threads,
     GError **error);
 
 void fs_nice_agent_add_idle (FsNiceAgent *agent, GSourceFunc func,
     gpointer data, GDestroyNotify destroy_notify);
 
+GSource *fs_nice_agent_add_timeout (FsNiceAgent *agent, guint interval,
+    GSourceFunc func, gpointer data, GDestroyNotify destroy_notify);
+
+GValueArray *fs_nice_agent_get_thread_loads (void);
+
+guint fs_nice_agent_get_default_threads (void);
+
 
 GType
 fs_nice_agent_register_type (FsPlugin *module);
@@ -66,7 +66,9 @@ enum
   PROP_COMPATIBILITY_MODE,
   PROP_ASSOCIATE_ON_SOURCE,
   PROP_RELAY_INFO,
-  PROP_DEBUG
+  PROP_DEBUG,
+  PROP_EVENT_DISPATCHES,
+  PROP_STATS_INTERVAL
 };
 
 struct _FsNiceStreamTransmitterPrivate
@@ -100,6 +102,16 @@ struct _FsNiceStreamTransmitterPrivate
   volatile gint associate_on_source;
 
   gboolean *component_has_been_ready; /* only from NiceAgent main thread */
+  /* The last state queued for each component, only from NiceAgent main
+   * thread */
+  FsStreamState *queued_state;
+
+  /* Number of times the queued agent events have been flushed */
+  volatile gint event_dispatches;
+
+  /* In milliseconds, 0 if the stats are not posted */
+  guint stats_interval;
+  GSource *stats_source;
 
   /* Everything below is protected by the mutex */
 
@@ -116,6 +128,12 @@ struct _FsNiceStreamTransmitterPrivate
   gboolean gathered;
 
   NiceGstStream *gststream;
+
+  /* Events from the agent waiting to be emitted from an idle */
+  GQueue pending_events;
+  gboolean flush_scheduled;
+  /* The last state emitted for each component */
+  FsStreamState *emitted_state;
 };
 
 #define FS_NICE_STREAM_TRANSMITTER_GET_PRIVATE(o)  \
@@ -176,6 +194,11 @@ static gboolean known_buffer_have_buffer_handler (GstPad *pad,
     GstBuffer *buffer,
     gpointer user_data);
 
+static gboolean post_component_stats (gpointer user_data);
+
+typedef struct _AgentEvent AgentEvent;
+static void agent_event_free (AgentEvent *event);
+
 
 static GObjectClass *parent_class = NULL;
 // static guint signals[LAST_SIGNAL] = { 0 };
@@ -347,6 +370,46 @@ fs_nice_stream_transmitter_class_init (FsNiceStreamTransmitterClass *klass)
           FALSE,
           G_PARAM_WRITABLE | G_PARAM_STATIC_STRINGS));
 
+  /**
+   * FsNiceStreamTransmitter:event-dispatches:
+   *
+   * The number of idle dispatches used to emit the signals coming from the
+   * ICE agent. Events that happen close together are emitted from a single
+   * dispatch, so this is normally much lower than the number of signals.
+   */
+  g_object_class_install_property (gobject_class, PROP_EVENT_DISPATCHES,
+      g_param_spec_uint (
+          "event-dispatches",
+          "Agent event dispatches",
+          "The number of idle dispatches used to emit the agent's events",
+          0, G_MAXUINT,
+          0,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * FsNiceStreamTransmitter:stats-interval:
+   *
+   * If not 0, a "farstream-component-stats" element message is posted on
+   * the bus every stats-interval milliseconds for each component. It
+   * contains the stream transmitter ("stream-transmitter"), the component
+   * ("component"), its #FsStreamState ("state"), the media packets and bytes
+   * sent and received ("packets-sent", "bytes-sent", "packets-received" and
+   * "bytes-received", as guint64) and the number of milliseconds since the
+   * last media packet in either direction ("media-idle-time", a guint64,
+   * G_MAXUINT64 if there has been none). The ICE agent only needs to send
+   * keepalives while the media is idle.
+   */
+  g_object_class_install_property (gobject_class, PROP_STATS_INTERVAL,
+      g_param_spec_uint (
+          "stats-interval",
+          "Statistics interval",
+          "How often to post the component statistics in milliseconds"
+          " (0 = never)",
+          0, G_MAXUINT,
+          0,
+          G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY |
+          G_PARAM_STATIC_STRINGS));
+
 }
 
 static void
@@ -416,18 +479,27 @@ fs_nice_stream_transmitter_stop (FsStreamTransmitter *streamtransmitter)
   FsNiceStreamTransmitter *self =
     FS_NICE_STREAM_TRANSMITTER (streamtransmitter);
   NiceGstStream *gststream;
+  GSource *stats_source;
   guint stream_id;
 
 
   FS_NICE_STREAM_TRANSMITTER_LOCK (self);
   gststream = self->priv->gststream;
   self->priv->gststream = NULL;
+  stats_source = self->priv->stats_source;
+  self->priv->stats_source = NULL;
   stream_id = self->priv->stream_id;
   /* We can't unset the stream id because it gets messy fast, just leave it as
    * is, all calls should fail anyway
    */
   FS_NICE_STREAM_TRANSMITTER_UNLOCK (self);
 
+  if (stats_source)
+  {
+    g_source_destroy (stats_source);
+    g_source_unref (stats_source);
+  }
+
   if (gststream)
     fs_nice_transmitter_free_gst_stream (self->priv->transmitter, gststream);
   if (stream_id)
@@ -456,6 +528,11 @@ fs_nice_stream_transmitter_finalize (GObject *object)
   g_free (self->priv->password);
 
   g_free (self->priv->component_has_been_ready);
+  g_free (self->priv->queued_state);
+  g_free (self->priv->emitted_state);
+
+  while (!g_queue_is_empty (&self->priv->pending_events))
+    agent_event_free (g_queue_pop_head (&self->priv->pending_events));
 
   parent_class->finalize (object);
 }
@@ -499,6 +576,13 @@ fs_nice_stream_transmitter_get_property (GObject *object,
       else
         g_value_set_boolean (value, self->priv->controlling_mode);
       break;
+    case PROP_EVENT_DISPATCHES:
+      g_value_set_uint (value,
+          g_atomic_int_get (&self->priv->event_dispatches));
+      break;
+    case PROP_STATS_INTERVAL:
+      g_value_set_uint (value, self->priv->stats_interval);
+      break;
     case PROP_STREAM_ID:
       FS_NICE_STREAM_TRANSMITTER_LOCK (self);
       g_value_set_uint (value, self->priv->stream_id);
@@ -544,6 +628,9 @@ fs_nice_stream_transmitter_set_property (GObject *object,
     case PROP_STUN_PORT:
       self->priv->stun_port = g_value_get_uint (value);
       break;
+    case PROP_STATS_INTERVAL:
+      self->priv->stats_interval = g_value_get_uint (value);
+      break;
     case PROP_CONTROLLING_MODE:
       self->priv->controlling_mode = g_value_get_boolean (value);
       if (self->priv->transmitter && self->priv->agent)
@@ -1298,8 +1385,14 @@ fs_nice_stream_transmitter_build (FsNiceStreamTransmitter *self,
   /* In this case we need to build a new agent */
   if (item == NULL)
   {
+    guint agent_threads;
+
+    g_object_get (self->priv->transmitter, "agent-threads", &agent_threads,
+        NULL);
+
     agent = fs_nice_agent_new (self->priv->compatibility_mode,
         self->priv->preferred_local_candidates,
+        agent_threads,
         error);
 
     if (!agent)
@@ -1329,6 +1422,15 @@ fs_nice_stream_transmitter_build (FsNiceStreamTransmitter *self,
 
   self->priv->component_has_been_ready = g_new0 (gboolean,
       self->priv->transmitter->components);
+  self->priv->queued_state = g_new0 (FsStreamState,
+      self->priv->transmitter->components);
+  self->priv->emitted_state = g_new0 (FsStreamState,
+      self->priv->transmitter->components);
+  for (i = 0; i < self->priv->transmitter->components; i++)
+  {
+    self->priv->queued_state[i] = (FsStreamState) -1;
+    self->priv->emitted_state[i] = (FsStreamState) -1;
+  }
 
   self->priv->stream_id = nice_agent_add_stream (
       self->priv->agent->agent,
@@ -1399,10 +1501,16 @@ fs_nice_stream_transmitter_build (FsNiceStreamTransmitter *self,
       self->priv->agent->agent,
       self->priv->stream_id,
       G_CALLBACK (known_buffer_have_buffer_handler), self,
+      self->priv->stats_interval != 0,
       error);
   if (self->priv->gststream == NULL)
     return FALSE;
 
+  if (self->priv->stats_interval)
+    self->priv->stats_source = fs_nice_agent_add_timeout (self->priv->agent,
+        self->priv->stats_interval, post_component_stats,
+        g_object_ref (self), g_object_unref);
+
   GST_DEBUG ("Created a stream with %u components",
       self->priv->transmitter->components);
 
@@ -1448,31 +1556,153 @@ nice_component_state_to_fs_stream_state (NiceComponentState state)
   }
 }
 
-struct state_changed_signal_data
+/*
+ * The events coming from the agent are queued and emitted together from a
+ * single idle, so a burst of candidates does not create one idle per
+ * candidate. A newer state or selected pair for a component removes the
+ * one still waiting in the queue and is queued at the end, so it is still
+ * emitted after the events that came before it. A state equal to the last
+ * one emitted for the component is dropped.
+ */
+
+typedef enum {
+  AGENT_EVENT_STATE_CHANGED,
+  AGENT_EVENT_NEW_LOCAL_CANDIDATE,
+  AGENT_EVENT_NEW_ACTIVE_CANDIDATE_PAIR,
+  AGENT_EVENT_GATHERING_DONE
+} AgentEventType;
+
+struct _AgentEvent
 {
-  FsNiceStreamTransmitter *self;
+  AgentEventType type;
   guint component_id;
   FsStreamState fs_state;
+  FsCandidate *candidate1;
+  FsCandidate *candidate2;
 };
 
+static gboolean agent_gathering_done_idle (gpointer data);
+
 static void
-free_state_changed_signal_data (gpointer user_data)
+agent_event_free (AgentEvent *event)
 {
-  struct state_changed_signal_data *data = user_data;
-  g_object_unref (data->self);
-  g_slice_free (struct state_changed_signal_data, data);
+  if (event->candidate1)
+    fs_candidate_destroy (event->candidate1);
+  if (event->candidate2)
+    fs_candidate_destroy (event->candidate2);
+  g_slice_free (AgentEvent, event);
 }
 
 static gboolean
-state_changed_signal_idle (gpointer userdata)
+agent_events_flush_idle (gpointer data)
 {
-  struct state_changed_signal_data *data = userdata;
+  FsNiceStreamTransmitter *self = data;
+  GQueue events;
+  GList *item;
+  AgentEvent *event;
+
+  FS_NICE_STREAM_TRANSMITTER_LOCK (self);
+  events = self->priv->pending_events;
+  g_queue_init (&self->priv->pending_events);
+  self->priv->flush_scheduled = FALSE;
+  for (item = events.head; item; item = item->next)
+  {
+    event = item->data;
+    if (event->type == AGENT_EVENT_STATE_CHANGED)
+      self->priv->emitted_state[event->component_id - 1] = event->fs_state;
+  }
+  FS_NICE_STREAM_TRANSMITTER_UNLOCK (self);
+
+  g_atomic_int_inc (&self->priv->event_dispatches);
+
+  while ((event = g_queue_pop_head (&events)))
+  {
+    switch (event->type)
+    {
+      case AGENT_EVENT_STATE_CHANGED:
+        g_signal_emit_by_name (self, "state-changed", event->component_id,
+            event->fs_state);
+        break;
+      case AGENT_EVENT_NEW_LOCAL_CANDIDATE:
+        g_signal_emit_by_name (self, "new-local-candidate",
+            event->candidate1);
+        break;
+      case AGENT_EVENT_NEW_ACTIVE_CANDIDATE_PAIR:
+        g_signal_emit_by_name (self, "new-active-candidate-pair",
+            event->candidate1, event->candidate2);
+        break;
+      case AGENT_EVENT_GATHERING_DONE:
+        agent_gathering_done_idle (self);
+        break;
+    }
+    agent_event_free (event);
+  }
 
-  g_signal_emit_by_name (data->self, "state-changed", data->component_id,
-      data->fs_state);
   return FALSE;
 }
 
+static void
+agent_event_queue (FsNiceStreamTransmitter *self, AgentEventType type,
+    guint component_id, FsStreamState fs_state, FsCandidate *candidate1,
+    FsCandidate *candidate2)
+{
+  AgentEvent *event = g_slice_new0 (AgentEvent);
+  gboolean schedule;
+
+  event->type = type;
+  event->component_id = component_id;
+  event->fs_state = fs_state;
+  event->candidate1 = candidate1;
+  event->candidate2 = candidate2;
+
+  FS_NICE_STREAM_TRANSMITTER_LOCK (self);
+
+  if (type == AGENT_EVENT_STATE_CHANGED ||
+      type == AGENT_EVENT_NEW_ACTIVE_CANDIDATE_PAIR)
+  {
+    GList *item;
+
+    for (item = self->priv->pending_events.head; item; item = item->next)
+    {
+      AgentEvent *old = item->data;
+
+      if (old->type == type && old->component_id == component_id)
+        break;
+    }
+
+    /* The new one goes to the tail, after the events queued since */
+    if (item)
+    {
+      agent_event_free (item->data);
+      g_queue_delete_link (&self->priv->pending_events, item);
+    }
+
+    /* Back to the state that was last emitted before anything else */
+    if (type == AGENT_EVENT_STATE_CHANGED &&
+        self->priv->emitted_state[component_id - 1] == fs_state)
+    {
+      agent_event_free (event);
+      event = NULL;
+    }
+  }
+
+  if (!event)
+  {
+    FS_NICE_STREAM_TRANSMITTER_UNLOCK (self);
+    return;
+  }
+
+  g_queue_push_tail (&self->priv->pending_events, event);
+
+  schedule = !self->priv->flush_scheduled;
+  self->priv->flush_scheduled = TRUE;
+  FS_NICE_STREAM_TRANSMITTER_UNLOCK (self);
+
+  if (schedule)
+    fs_nice_agent_add_idle (self->priv->agent, agent_events_flush_idle,
+        g_object_ref (self), g_object_unref);
+}
+
 static void
 agent_state_changed (NiceAgent *agent,
     guint stream_id,
@@ -1482,7 +1712,6 @@ agent_state_changed (NiceAgent *agent,
 {
   FsNiceStreamTransmitter *self = FS_NICE_STREAM_TRANSMITTER (user_data);
   FsStreamState fs_state;
-  struct state_changed_signal_data *data;
 
   if (stream_id != self->priv->stream_id)
     return;
@@ -1500,16 +1729,16 @@ agent_state_changed (NiceAgent *agent,
     self->priv->component_has_been_ready[component_id - 1] = TRUE;
 
   fs_state = nice_component_state_to_fs_stream_state (state);
-  data = g_slice_new (struct state_changed_signal_data);
 
   GST_DEBUG ("Stream: %u Component %u has state %u",
       self->priv->stream_id, component_id, state);
 
-  data->self = g_object_ref (self);
-  data->component_id = component_id;
-  data->fs_state = fs_state;
-  fs_nice_agent_add_idle (self->priv->agent, state_changed_signal_idle,
-      data, free_state_changed_signal_data);
+  if (self->priv->queued_state[component_id - 1] != fs_state)
+  {
+    self->priv->queued_state[component_id - 1] = fs_state;
+    agent_event_queue (self, AGENT_EVENT_STATE_CHANGED, component_id,
+        fs_state, NULL, NULL);
+  }
 
   if (fs_state >= FS_STREAM_STATE_CONNECTED)
   {
@@ -1522,36 +1751,6 @@ agent_state_changed (NiceAgent *agent,
 }
 
 
-struct candidate_signal_data
-{
-  FsNiceStreamTransmitter *self;
-  const gchar *signal_name;
-  FsCandidate *candidate1;
-  FsCandidate *candidate2;
-};
-
-static void
-free_candidate_signal_data (gpointer user_data)
-{
-  struct candidate_signal_data *data = user_data;
-  fs_candidate_destroy (data->candidate1);
-  if (data->candidate2)
-    fs_candidate_destroy (data->candidate2);
-  g_object_unref (data->self);
-  g_slice_free (struct candidate_signal_data, data);
-}
-
-static gboolean
-agent_candidate_signal_idle (gpointer userdata)
-{
-  struct candidate_signal_data *data = userdata;
-
-  g_signal_emit_by_name (data->self, data->signal_name, data->candidate1,
-                         data->candidate2);
-  return FALSE;
-}
-
-
 static void
 agent_new_selected_pair (NiceAgent *agent,
     guint stream_id,
@@ -1603,14 +1802,8 @@ agent_new_selected_pair (NiceAgent *agent,
 
   if (local && remote)
   {
-    struct candidate_signal_data *data =
-      g_slice_new (struct candidate_signal_data);
-    data->self = g_object_ref (self);
-    data->signal_name = "new-active-candidate-pair";
-    data->candidate1 = local;
-    data->candidate2 = remote;
-    fs_nice_agent_add_idle (self->priv->agent, agent_candidate_signal_idle,
-        data, free_candidate_signal_data);
+    agent_event_queue (self, AGENT_EVENT_NEW_ACTIVE_CANDIDATE_PAIR,
+        component_id, 0, local, remote);
   }
   else
   {
@@ -1674,17 +1867,10 @@ agent_new_candidate (NiceAgent *agent,
     }
     else
     {
-      struct candidate_signal_data *data =
-        g_slice_new (struct candidate_signal_data);
-
       FS_NICE_STREAM_TRANSMITTER_UNLOCK (self);
 
-      data->self = g_object_ref (self);
-      data->signal_name = "new-local-candidate";
-      data->candidate1 = fscandidate;
-      data->candidate2 = NULL;
-      fs_nice_agent_add_idle (self->priv->agent, agent_candidate_signal_idle,
-        data, free_candidate_signal_data);
+      agent_event_queue (self, AGENT_EVENT_NEW_LOCAL_CANDIDATE, component_id,
+          0, fscandidate, NULL);
     }
   }
   else
@@ -1790,8 +1976,7 @@ agent_gathering_done (NiceAgent *agent, guint stream_id, gpointer user_data)
   if (stream_id != self->priv->stream_id)
     return;
 
-  fs_nice_agent_add_idle (self->priv->agent, agent_gathering_done_idle,
-      g_object_ref (self), g_object_unref);
+  agent_event_queue (self, AGENT_EVENT_GATHERING_DONE, 0, 0, NULL, NULL);
 }
 
 
@@ -1851,3 +2036,60 @@ known_buffer_have_buffer_handler (GstPad *pad, GstBuffer *buffer,
 
   return TRUE;
 }
+
+static gboolean
+post_component_stats (gpointer user_data)
+{
+  FsNiceStreamTransmitter *self = FS_NICE_STREAM_TRANSMITTER (user_data);
+  gint64 now = g_get_monotonic_time ();
+  GPtrArray *messages = g_ptr_array_new ();
+  guint c;
+
+  FS_NICE_STREAM_TRANSMITTER_LOCK (self);
+
+  if (!self->priv->gststream)
+  {
+    FS_NICE_STREAM_TRANSMITTER_UNLOCK (self);
+    g_ptr_array_free (messages, TRUE);
+    return FALSE;
+  }
+
+  for (c = 1; c <= self->priv->transmitter->components; c++)
+  {
+    FsNiceComponentStats stats;
+    FsStreamState state = self->priv->queued_state[c - 1];
+    guint64 idle_time = G_MAXUINT64;
+
+    if (!fs_nice_transmitter_get_stats (self->priv->transmitter,
+            self->priv->gststream, c, &stats))
+      break;
+
+    if (stats.last_media_time)
+      idle_time = (now - stats.last_media_time) / 1000;
+
+    /* The state is only written from this thread */
+    if (state == (FsStreamState) -1)
+      state = FS_STREAM_STATE_GATHERING;
+
+    g_ptr_array_add (messages,
+        gst_structure_new ("farstream-component-stats",
+            "stream-transmitter", FS_TYPE_STREAM_TRANSMITTER, self,
+            "component", G_TYPE_UINT, c,
+            "state", FS_TYPE_STREAM_STATE, state,
+            "packets-sent", G_TYPE_UINT64, stats.packets_sent,
+            "bytes-sent", G_TYPE_UINT64, stats.bytes_sent,
+            "packets-received", G_TYPE_UINT64, stats.packets_received,
+            "bytes-received", G_TYPE_UINT64, stats.bytes_received,
+            "media-idle-time", G_TYPE_UINT64, idle_time,
+            NULL));
+  }
+
+  FS_NICE_STREAM_TRANSMITTER_UNLOCK (self);
+
+  for (c = 0; c < messages->len; c++)
+    fs_nice_transmitter_post_message (self->priv->transmitter,
+        g_ptr_array_index (messages, c));
+  g_ptr_array_free (messages, TRUE);
+
+  return TRUE;
+}
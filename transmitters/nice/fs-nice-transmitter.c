@@ -64,7 +64,11 @@ enum
   PROP_GST_SRC,
   PROP_COMPONENTS,
   PROP_TOS,
-  PROP_DO_TIMESTAMP
+  PROP_DO_TIMESTAMP,
+  PROP_AGENT_THREADS,
+  PROP_AGENT_THREAD_LOADS,
+  PROP_PERMANENT_SINKS,
+  PROP_KEYUNIT_SUPPRESS_WINDOW
 };
 
 struct _FsNiceTransmitterPrivate
@@ -81,6 +85,13 @@ struct _FsNiceTransmitterPrivate
 
   gint tos;
   gboolean do_timestamp;
+
+  /* Only read when a new stream is added */
+  gboolean permanent_sinks;
+  guint keyunit_suppress_window;
+
+  /* Only read when a new agent is created */
+  guint agent_threads;
 };
 
 #define FS_NICE_TRANSMITTER_GET_PRIVATE(o)  \
@@ -178,6 +189,75 @@ fs_nice_transmitter_class_init (FsNiceTransmitterClass *klass)
   g_object_class_override_property (gobject_class, PROP_DO_TIMESTAMP,
       "do-timestamp");
 
+  /**
+   * FsNiceTransmitter:agent-threads:
+   *
+   * If not 0, the agents created after this is set share this number of
+   * threads of a pool instead of each running its own thread. The pool is
+   * shared by all the nice transmitters in the process. The default is the
+   * value of the FS_NICE_AGENT_THREADS environment variable, or 0.
+   */
+  g_object_class_install_property (gobject_class,
+      PROP_AGENT_THREADS,
+      g_param_spec_uint ("agent-threads",
+          "Agent threads",
+          "The number of pool threads running the agents, 0 for one thread"
+          " per agent",
+          0, G_MAXUINT,
+          0,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * FsNiceTransmitter:agent-thread-loads:
+   *
+   * The number of agents run by each thread of the agent thread pool, as a
+   * #GValueArray of guints. It is empty until an agent is created with
+   * #FsNiceTransmitter:agent-threads set. The pool is shared by all the
+   * nice transmitters in the process.
+   */
+  g_object_class_install_property (gobject_class,
+      PROP_AGENT_THREAD_LOADS,
+      g_param_spec_boxed ("agent-thread-loads",
+          "Agent thread loads",
+          "The number of agents run by each thread of the pool",
+          G_TYPE_VALUE_ARRAY,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * FsNiceTransmitter:permanent-sinks:
+   *
+   * If %TRUE, the nicesink elements of the streams created after this is set
+   * stay linked when sending is disabled and the buffers are dropped in front
+   * of them instead. This makes toggling the sending much cheaper.
+   * It has no effect on the components that have a recvonly filter.
+   */
+  g_object_class_install_property (gobject_class,
+      PROP_PERMANENT_SINKS,
+      g_param_spec_boolean ("permanent-sinks",
+          "Permanent sinks",
+          "Keep the sinks linked and drop the buffers when not sending",
+          FALSE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * FsNiceTransmitter:keyunit-suppress-window:
+   *
+   * When sending is re-enabled less than this number of milliseconds after
+   * it was disabled, no key unit is requested from upstream. 0 means that a
+   * key unit is always requested. This only applies to the permanent sinks,
+   * see #FsNiceTransmitter:permanent-sinks, a key unit is always requested
+   * when a sink is linked again.
+   */
+  g_object_class_install_property (gobject_class,
+      PROP_KEYUNIT_SUPPRESS_WINDOW,
+      g_param_spec_uint ("keyunit-suppress-window",
+          "Key unit suppression window",
+          "Do not request a key unit when sending resumes within this number"
+          " of milliseconds",
+          0, G_MAXUINT,
+          0,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   transmitter_class->new_stream_transmitter =
     fs_nice_transmitter_new_stream_transmitter;
   transmitter_class->get_stream_transmitter_type =
@@ -198,6 +278,7 @@ fs_nice_transmitter_init (FsNiceTransmitter *self)
 
   self->components = 2;
   self->priv->do_timestamp = TRUE;
+  self->priv->agent_threads = fs_nice_agent_get_default_threads ();
 }
 
 static void
@@ -421,6 +502,18 @@ fs_nice_transmitter_get_property (GObject *object,
     case PROP_DO_TIMESTAMP:
       g_value_set_boolean (value, self->priv->do_timestamp);
       break;
+    case PROP_AGENT_THREADS:
+      g_value_set_uint (value, self->priv->agent_threads);
+      break;
+    case PROP_AGENT_THREAD_LOADS:
+      g_value_take_boxed (value, fs_nice_agent_get_thread_loads ());
+      break;
+    case PROP_PERMANENT_SINKS:
+      g_value_set_boolean (value, self->priv->permanent_sinks);
+      break;
+    case PROP_KEYUNIT_SUPPRESS_WINDOW:
+      g_value_set_uint (value, self->priv->keyunit_suppress_window);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -446,6 +539,15 @@ fs_nice_transmitter_set_property (GObject *object,
     case PROP_DO_TIMESTAMP:
       self->priv->do_timestamp = g_value_get_boolean (value);
       break;
+    case PROP_PERMANENT_SINKS:
+      self->priv->permanent_sinks = g_value_get_boolean (value);
+      break;
+    case PROP_KEYUNIT_SUPPRESS_WINDOW:
+      self->priv->keyunit_suppress_window = g_value_get_uint (value);
+      break;
+    case PROP_AGENT_THREADS:
+      self->priv->agent_threads = g_value_get_uint (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -697,20 +799,121 @@ struct _NiceGstStream {
 
   gulong *probe_ids;
 
+  /* Buffer probes dropping the buffers in front of the permanent sinks,
+   * 0 for the components whose sink is added and removed */
+  gulong *gate_probe_ids;
+  volatile gint gate_open;
+
   /* Protects the sending field and the addition/state of the elements */
   GMutex *mutex;
 
   gboolean sending;
   gboolean desired_sending;
   gboolean modifying;
+
+  /* Monotonic time at which sending was last disabled */
+  gint64 paused_time;
+  guint keyunit_suppress_window;
+
+  /* Only allocated if the stream counts its packets, one per component */
+  GMutex *stats_mutex;
+  struct _NiceGstComponentStats *component_stats;
+  /* Monotonic time the last_media_ms of the components are relative to */
+  gint64 stats_base_time;
 };
 
+/*
+ * The probes only add to the counters atomically, they are folded into the
+ * 64 bit totals under the stats_mutex when the stats are read. The counters
+ * wrap at 2^32, so they must be read more often than that.
+ */
+
+typedef struct _NiceGstComponentStats {
+  NiceGstStream *ns;
+
+  volatile gint packets_sent;
+  volatile gint bytes_sent;
+  volatile gint packets_received;
+  volatile gint bytes_received;
+  /* Milliseconds since stats_base_time, modulo 2^32 */
+  volatile gint last_media_ms;
+
+  /* Protected by the stream's stats_mutex */
+  FsNiceComponentStats stats;
+
+  gulong src_probe_id;
+  gulong sink_probe_id;
+} NiceGstComponentStats;
+
+static gint
+stats_media_ms (NiceGstStream *ns, gint64 now)
+{
+  return (gint) (guint32) ((now - ns->stats_base_time) / 1000);
+}
+
+static gboolean
+sink_gate_probe (GstPad *pad, GstBuffer *buffer, gpointer user_data)
+{
+  NiceGstStream *ns = user_data;
+
+  return g_atomic_int_get (&ns->gate_open);
+}
+
+static gboolean
+stats_src_probe (GstPad *pad, GstBuffer *buffer, gpointer user_data)
+{
+  NiceGstComponentStats *cs = user_data;
+
+  g_atomic_int_inc (&cs->packets_received);
+  g_atomic_int_add (&cs->bytes_received, GST_BUFFER_SIZE (buffer));
+  g_atomic_int_set (&cs->last_media_ms,
+      stats_media_ms (cs->ns, g_get_monotonic_time ()));
+
+  return TRUE;
+}
+
+static gboolean
+stats_sink_probe (GstPad *pad, GstBuffer *buffer, gpointer user_data)
+{
+  NiceGstComponentStats *cs = user_data;
+
+  g_atomic_int_inc (&cs->packets_sent);
+  g_atomic_int_add (&cs->bytes_sent, GST_BUFFER_SIZE (buffer));
+  g_atomic_int_set (&cs->last_media_ms,
+      stats_media_ms (cs->ns, g_get_monotonic_time ()));
+
+  return TRUE;
+}
+
+static gulong
+add_buffer_probe (GstElement *element, const gchar *padname,
+    GCallback callback, gpointer user_data)
+{
+  GstPad *pad = gst_element_get_static_pad (element, padname);
+  gulong id;
+
+  id = gst_pad_add_buffer_probe (pad, callback, user_data);
+  gst_object_unref (pad);
+
+  return id;
+}
+
+static void
+remove_buffer_probe (GstElement *element, const gchar *padname, gulong id)
+{
+  GstPad *pad = gst_element_get_static_pad (element, padname);
+
+  gst_pad_remove_buffer_probe (pad, id);
+  gst_object_unref (pad);
+}
+
 NiceGstStream *
 fs_nice_transmitter_add_gst_stream (FsNiceTransmitter *self,
     NiceAgent *agent,
     guint stream_id,
     GCallback have_buffer_callback,
     gpointer have_buffer_user_data,
+    gboolean count_stats,
     GError **error)
 {
   guint c;
@@ -719,6 +922,8 @@ fs_nice_transmitter_add_gst_stream (FsNiceTransmitter *self,
   ns = g_slice_new0 (NiceGstStream);
   ns->sending = TRUE;
   ns->desired_sending = TRUE;
+  ns->gate_open = TRUE;
+  ns->keyunit_suppress_window = self->priv->keyunit_suppress_window;
   ns->mutex = g_mutex_new ();
   ns->nicesrcs = g_new0 (GstElement *, self->components + 1);
   ns->nicesinks = g_new0 (GstElement *, self->components + 1);
@@ -726,6 +931,17 @@ fs_nice_transmitter_add_gst_stream (FsNiceTransmitter *self,
   ns->requested_tee_pads = g_new0 (GstPad *, self->components + 1);
   ns->requested_funnel_pads = g_new0 (GstPad *, self->components + 1);
   ns->probe_ids = g_new0 (gulong, self->components + 1);
+  ns->gate_probe_ids = g_new0 (gulong, self->components + 1);
+
+  if (count_stats)
+  {
+    ns->stats_mutex = g_mutex_new ();
+    ns->stats_base_time = g_get_monotonic_time ();
+    ns->component_stats = g_new0 (NiceGstComponentStats,
+        self->components + 1);
+    for (c = 1; c <= self->components; c++)
+      ns->component_stats[c].ns = ns;
+  }
 
   for (c = 1; c <= self->components; c++)
   {
@@ -767,6 +983,21 @@ fs_nice_transmitter_add_gst_stream (FsNiceTransmitter *self,
 
     if (ns->nicesinks[c] == NULL)
       goto error;
+
+    if (self->priv->permanent_sinks && !ns->recvonly_filters[c])
+      ns->gate_probe_ids[c] = add_buffer_probe (ns->nicesinks[c], "sink",
+          G_CALLBACK (sink_gate_probe), ns);
+
+    /* Added after the gate so the dropped buffers are not counted */
+    if (ns->component_stats)
+    {
+      ns->component_stats[c].src_probe_id = add_buffer_probe (
+          ns->nicesrcs[c], "src", G_CALLBACK (stats_src_probe),
+          &ns->component_stats[c]);
+      ns->component_stats[c].sink_probe_id = add_buffer_probe (
+          ns->nicesinks[c], "sink", G_CALLBACK (stats_sink_probe),
+          &ns->component_stats[c]);
+    }
   }
 
   return ns;
@@ -813,6 +1044,11 @@ fs_nice_transmitter_free_gst_stream (FsNiceTransmitter *self,
     if (ns->nicesrcs[c])
     {
       GstStateChangeReturn ret;
+
+      if (ns->component_stats && ns->component_stats[c].src_probe_id)
+        remove_buffer_probe (ns->nicesrcs[c], "src",
+            ns->component_stats[c].src_probe_id);
+
       if (!gst_bin_remove (GST_BIN (self->priv->gst_src), ns->nicesrcs[c]))
         GST_ERROR ("Could not remove nicesrc element from transmitter source");
       ret = gst_element_set_state (ns->nicesrcs[c], GST_STATE_NULL);
@@ -831,6 +1067,12 @@ fs_nice_transmitter_free_gst_stream (FsNiceTransmitter *self,
 
     if (ns->nicesinks[c])
     {
+      if (ns->gate_probe_ids[c])
+        remove_buffer_probe (ns->nicesinks[c], "sink", ns->gate_probe_ids[c]);
+      if (ns->component_stats && ns->component_stats[c].sink_probe_id)
+        remove_buffer_probe (ns->nicesinks[c], "sink",
+            ns->component_stats[c].sink_probe_id);
+
       remove_sink (self, ns, c);
       gst_object_unref (ns->nicesinks[c]);
     }
@@ -857,6 +1099,10 @@ fs_nice_transmitter_free_gst_stream (FsNiceTransmitter *self,
   g_free (ns->requested_tee_pads);
   g_free (ns->requested_funnel_pads);
   g_free (ns->probe_ids);
+  g_free (ns->gate_probe_ids);
+  if (ns->stats_mutex)
+    g_mutex_free (ns->stats_mutex);
+  g_free (ns->component_stats);
   g_mutex_free (ns->mutex);
   g_slice_free (NiceGstStream, ns);
 }
@@ -884,18 +1130,34 @@ fs_nice_transmitter_set_sending (FsNiceTransmitter *self,
   while (ns->sending != ns->desired_sending)
   {
     gboolean current_sending = ns->sending;
+    gboolean request_keyunit = TRUE;
+
+    if (current_sending)
+    {
+      ns->paused_time = g_get_monotonic_time ();
+    }
+    else if (ns->keyunit_suppress_window &&
+        g_get_monotonic_time () - ns->paused_time <
+        (gint64) ns->keyunit_suppress_window * 1000)
+    {
+      GST_DEBUG ("Sending resumed within %u ms, not requesting a key unit",
+          ns->keyunit_suppress_window);
+      request_keyunit = FALSE;
+    }
 
     g_mutex_unlock (ns->mutex);
 
     GST_DEBUG ("Changing gst stream sending status to %d", !current_sending);
 
+    g_atomic_int_set (&ns->gate_open, !current_sending);
+
     if (current_sending)
     {
       for (c = 1; c <= self->components; c++)
       {
         if (ns->recvonly_filters[c])
           g_object_set (ns->recvonly_filters[c], "sending", FALSE, NULL);
-        else
+        else if (!ns->gate_probe_ids[c])
           remove_sink (self, ns, c);
       }
     }
@@ -905,6 +1167,11 @@ fs_nice_transmitter_set_sending (FsNiceTransmitter *self,
       {
         if (ns->recvonly_filters[c])
           g_object_set (ns->recvonly_filters[c], "sending", TRUE, NULL);
+        else if (ns->gate_probe_ids[c])
+        {
+          if (request_keyunit)
+            fs_nice_transmitter_request_keyunit (self, ns, c);
+        }
         else
         {
           GstPadLinkReturn ret;
@@ -930,6 +1197,7 @@ fs_nice_transmitter_set_sending (FsNiceTransmitter *self,
             GST_ERROR ("Could not link nicesink to its tee pad");
           gst_object_unref (elempad);
 
+          /* The sink has been relinked, so always start with a key unit */
           fs_nice_transmitter_request_keyunit (self, ns, c);
         }
       }
@@ -937,7 +1205,7 @@ fs_nice_transmitter_set_sending (FsNiceTransmitter *self,
 
     g_mutex_lock (ns->mutex);
 
-    ns->sending = sending;
+    ns->sending = !current_sending;
 
   }
 
@@ -960,3 +1228,69 @@ fs_nice_transmitter_request_keyunit (FsNiceTransmitter *self,
               "all-headers", G_TYPE_BOOLEAN, TRUE,
               NULL)));
 }
+
+static guint
+take_counter (volatile gint *counter)
+{
+  gint value = g_atomic_int_get (counter);
+
+  g_atomic_int_add (counter, -value);
+
+  return (guint) value;
+}
+
+gboolean
+fs_nice_transmitter_get_stats (FsNiceTransmitter *self,
+    NiceGstStream *ns, guint component, FsNiceComponentStats *stats)
+{
+  NiceGstComponentStats *cs;
+  guint sent, received;
+
+  g_return_val_if_fail (component >= 1 && component <= self->components,
+      FALSE);
+
+  if (!ns->component_stats)
+    return FALSE;
+
+  cs = &ns->component_stats[component];
+
+  g_mutex_lock (ns->stats_mutex);
+  sent = take_counter (&cs->packets_sent);
+  received = take_counter (&cs->packets_received);
+  cs->stats.packets_sent += sent;
+  cs->stats.bytes_sent += take_counter (&cs->bytes_sent);
+  cs->stats.packets_received += received;
+  cs->stats.bytes_received += take_counter (&cs->bytes_received);
+
+  if (sent || received)
+  {
+    gint64 now = g_get_monotonic_time ();
+    guint32 age = (guint32) stats_media_ms (ns, now) -
+        (guint32) g_atomic_int_get (&cs->last_media_ms);
+
+    /* A packet that went through after now was taken */
+    if (age > G_MAXINT32)
+      age = 0;
+
+    cs->stats.last_media_time = now - (gint64) age * 1000;
+  }
+
+  *stats = cs->stats;
+  g_mutex_unlock (ns->stats_mutex);
+
+  return TRUE;
+}
+
+/*
+ * Posts an element message on the bus of the pipeline containing the
+ * transmitter's sink, takes ownership of the structure
+ */
+
+void
+fs_nice_transmitter_post_message (FsNiceTransmitter *self,
+    GstStructure *structure)
+{
+  gst_element_post_message (self->priv->gst_sink,
+      gst_message_new_element (GST_OBJECT (self->priv->gst_sink),
+          structure));
+}
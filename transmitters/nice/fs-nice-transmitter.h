@@ -90,11 +90,27 @@ GType fs_nice_transmitter_get_type (void);
 struct _NiceGstStream;
 typedef struct _NiceGstStream NiceGstStream;
 
+/*
+ * FsNiceComponentStats:
+ *
+ * The media packets going through one component of a #NiceGstStream. The
+ * last_media_time is the monotonic time of the last packet in either
+ * direction, or 0 if there has been none.
+ */
+typedef struct {
+  guint64 packets_sent;
+  guint64 bytes_sent;
+  guint64 packets_received;
+  guint64 bytes_received;
+  gint64 last_media_time;
+} FsNiceComponentStats;
+
 NiceGstStream *fs_nice_transmitter_add_gst_stream (FsNiceTransmitter *self,
     NiceAgent *agent,
     guint stream_id,
     GCallback have_buffer_callback,
     gpointer have_buffer_user_data,
+    gboolean count_stats,
     GError **error);
 
 void fs_nice_transmitter_free_gst_stream (FsNiceTransmitter *self,
@@ -106,6 +122,12 @@ void fs_nice_transmitter_set_sending (FsNiceTransmitter *self,
 void fs_nice_transmitter_request_keyunit (FsNiceTransmitter *self,
     NiceGstStream *ns, guint component);
 
+gboolean fs_nice_transmitter_get_stats (FsNiceTransmitter *self,
+    NiceGstStream *ns, guint component, FsNiceComponentStats *stats);
+
+void fs_nice_transmitter_post_message (FsNiceTransmitter *self,
+    GstStructure *structure);
+
 
 G_END_DECLS
 
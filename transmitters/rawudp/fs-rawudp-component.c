@@ -84,8 +84,7 @@ enum
   PROP_COMPONENT,
   PROP_IP,
   PROP_PORT,
-  PROP_STUN_IP,
-  PROP_STUN_PORT,
+  PROP_STUN_SERVERS,
   PROP_STUN_TIMEOUT,
   PROP_SENDING,
   PROP_TRANSMITTER,
@@ -101,6 +100,22 @@ enum
 };
 
 
+typedef struct {
+  /* "ip:port" as configured, the key of the cache on the UdpPort */
+  gchar *key;
+
+  StunMessage message;
+  guchar buffer[STUN_MAX_MESSAGE_SIZE_IPV6];
+  struct sockaddr_storage sockaddr;
+  StunTimer timer;
+  StunUsageTimerReturn timer_ret;
+
+  /* The server redirected us and the timer must be restarted */
+  gboolean changed;
+  /* The server never replied */
+  gboolean timed_out;
+} StunServer;
+
 struct _FsRawUdpComponentPrivate
 {
   gboolean disposed;
@@ -114,17 +129,16 @@ struct _FsRawUdpComponentPrivate
   gchar *ip;
   guint port;
 
-  gchar *stun_ip;
-  guint stun_port;
+  /* GValueArray of GstStructures with an "ip" and a "port" */
+  GValueArray *stun_server_list;
   guint stun_timeout;
 
   GMutex *mutex;
 
+  /* Requests are sent to all the servers at once */
   StunAgent stun_agent;
-  StunMessage stun_message;
-  guchar stun_buffer[STUN_MAX_MESSAGE_SIZE_IPV6];
-  struct sockaddr_storage stun_sockaddr;
-  gboolean stun_server_changed;
+  StunServer *stun_servers;
+  guint n_stun_servers;
 
   gboolean associate_on_source;
 
@@ -157,6 +171,7 @@ struct _FsRawUdpComponentPrivate
   GstClockID stun_timeout_id;
   GThread *stun_timeout_thread;
   gboolean stun_stop;
+  guint stun_cache_ttl;
 
   gboolean sending;
 
@@ -231,6 +246,8 @@ remote_is_unique_cb (gboolean unique, const GstNetAddress *address,
 static gboolean
 fs_rawudp_component_start_stun (FsRawUdpComponent *self, GError **error);
 static void
+fs_rawudp_component_free_stun_servers (FsRawUdpComponent *self);
+static void
 fs_rawudp_component_stop_stun_locked (FsRawUdpComponent *self);
 
 #ifdef HAVE_GUPNP
@@ -317,19 +334,12 @@ fs_rawudp_component_class_init (FsRawUdpComponentClass *klass)
 
 
   g_object_class_install_property (gobject_class,
-      PROP_STUN_IP,
-      g_param_spec_string ("stun-ip",
-          "The IP address of the STUN server",
-          "The IPv4 address of the STUN server as a x.x.x.x string",
-          NULL,
-          G_PARAM_CONSTRUCT_ONLY | G_PARAM_WRITABLE | G_PARAM_STATIC_STRINGS));
-
-  g_object_class_install_property (gobject_class,
-      PROP_STUN_PORT,
-      g_param_spec_uint ("stun-port",
-          "The port of the STUN server",
-          "The IPv4 UDP port of the STUN server as a ",
-          0, 65535, 3478,
+      PROP_STUN_SERVERS,
+      g_param_spec_boxed ("stun-servers",
+          "The STUN servers",
+          "A GValueArray of GstStructures with the \"ip\" and \"port\" of"
+          " the STUN servers to query in parallel",
+          G_TYPE_VALUE_ARRAY,
           G_PARAM_CONSTRUCT_ONLY | G_PARAM_WRITABLE | G_PARAM_STATIC_STRINGS));
 
   g_object_class_install_property (gobject_class,
@@ -698,7 +708,9 @@ fs_rawudp_component_finalize (GObject *object)
 #endif
 
   g_free (self->priv->ip);
-  g_free (self->priv->stun_ip);
+  if (self->priv->stun_server_list)
+    g_value_array_free (self->priv->stun_server_list);
+  fs_rawudp_component_free_stun_servers (self);
 
   g_mutex_free (self->priv->mutex);
 
@@ -805,12 +817,10 @@ fs_rawudp_component_set_property (GObject *object,
     case PROP_PORT:
       self->priv->port = g_value_get_uint (value);
       break;
-    case PROP_STUN_IP:
-      g_free (self->priv->stun_ip);
-      self->priv->stun_ip = g_value_dup_string (value);
-      break;
-    case PROP_STUN_PORT:
-      self->priv->stun_port = g_value_get_uint (value);
+    case PROP_STUN_SERVERS:
+      if (self->priv->stun_server_list)
+        g_value_array_free (self->priv->stun_server_list);
+      self->priv->stun_server_list = g_value_dup_boxed (value);
       break;
     case PROP_STUN_TIMEOUT:
       self->priv->stun_timeout = g_value_get_uint (value);
@@ -860,8 +870,7 @@ fs_rawudp_component_new (
     gboolean associate_on_source,
     const gchar *ip,
     guint port,
-    const gchar *stun_ip,
-    guint stun_port,
+    GValueArray *stun_servers,
     guint stun_timeout,
     gboolean upnp_mapping,
     gboolean upnp_discovery,
@@ -879,8 +888,7 @@ fs_rawudp_component_new (
       "associate-on-source", associate_on_source,
       "ip", ip,
       "port", port,
-      "stun-ip", stun_ip,
-      "stun-port", stun_port,
+      "stun-servers", stun_servers,
       "stun-timeout", stun_timeout,
 #ifdef HAVE_GUPNP
       "upnp-mapping", upnp_mapping,
@@ -1258,7 +1266,7 @@ fs_rawudp_component_gather_local_candidates (FsRawUdpComponent *self,
   }
 #endif
 
-  if (self->priv->stun_ip)
+  if (self->priv->stun_server_list && self->priv->stun_server_list->n_values)
     return fs_rawudp_component_start_stun (self, error);
 #ifdef HAVE_GUPNP
   else if (!self->priv->upnp_signal_id)
@@ -1272,11 +1280,12 @@ fs_rawudp_component_gather_local_candidates (FsRawUdpComponent *self,
 }
 
 static gboolean
-fs_rawudp_component_send_stun_locked (FsRawUdpComponent *self, GError **error)
+fs_rawudp_component_send_stun_locked (FsRawUdpComponent *self,
+    StunServer *server, GError **error)
 {
   socklen_t socklen = 0;
 
-  switch (self->priv->stun_sockaddr.ss_family)
+  switch (server->sockaddr.ss_family)
   {
     case AF_INET:
       socklen = sizeof(struct sockaddr_in);
@@ -1291,19 +1300,133 @@ fs_rawudp_component_send_stun_locked (FsRawUdpComponent *self, GError **error)
   }
 
   return fs_rawudp_transmitter_udpport_sendto (self->priv->udpport,
-      (gchar*) self->priv->stun_buffer,
-      stun_message_length (&self->priv->stun_message),
-      (const struct sockaddr *)&self->priv->stun_sockaddr, socklen, error);
+      (gchar*) server->buffer,
+      stun_message_length (&server->message),
+      (const struct sockaddr *)&server->sockaddr, socklen, error);
+}
+
+static void
+fs_rawudp_component_free_stun_servers (FsRawUdpComponent *self)
+{
+  guint i;
+
+  for (i = 0; i < self->priv->n_stun_servers; i++)
+    g_free (self->priv->stun_servers[i].key);
+  g_free (self->priv->stun_servers);
+  self->priv->stun_servers = NULL;
+  self->priv->n_stun_servers = 0;
+}
+
+static gboolean
+fs_rawudp_component_parse_stun_servers (FsRawUdpComponent *self,
+    GError **error)
+{
+  guint i;
+
+  self->priv->stun_servers = g_new0 (StunServer,
+      self->priv->stun_server_list->n_values);
+
+  for (i = 0; i < self->priv->stun_server_list->n_values; i++)
+  {
+    StunServer *server = &self->priv->stun_servers[i];
+    const GstStructure *s = gst_value_get_structure (
+        g_value_array_get_nth (self->priv->stun_server_list, i));
+    const gchar *ip = gst_structure_get_string (s, "ip");
+    guint port = 3478;
+    NiceAddress niceaddr;
+
+    gst_structure_get_uint (s, "port", &port);
+
+    nice_address_init (&niceaddr);
+    if (!ip || !nice_address_set_from_string (&niceaddr, ip))
+    {
+      g_set_error (error, FS_ERROR, FS_ERROR_INVALID_ARGUMENTS,
+          "Invalid IP address %s passed for STUN", ip);
+      fs_rawudp_component_free_stun_servers (self);
+      return FALSE;
+    }
+    nice_address_set_port (&niceaddr, port);
+    nice_address_copy_to_sockaddr (&niceaddr,
+        (struct sockaddr *) &server->sockaddr);
+
+    server->key = g_strdup_printf ("%s:%u", ip, port);
+    self->priv->n_stun_servers++;
+  }
+
+  return TRUE;
+}
+
+/*
+ * Emits the address found by an earlier STUN request from the same port
+ * if there is one
+ */
+
+static gboolean
+fs_rawudp_component_use_stun_cache (FsRawUdpComponent *self)
+{
+  FsCandidate *candidate = NULL;
+  guint i;
+
+  FS_RAWUDP_COMPONENT_LOCK (self);
+  for (i = 0; i < self->priv->n_stun_servers; i++)
+  {
+    gchar *ip;
+    guint port;
+
+    if (fs_rawudp_transmitter_udpport_lookup_stun_cache (self->priv->udpport,
+            self->priv->stun_servers[i].key, &ip, &port))
+    {
+      candidate = fs_candidate_new ("L1",
+          self->priv->component,
+          FS_CANDIDATE_TYPE_SRFLX,
+          FS_NETWORK_PROTOCOL_UDP,
+          ip,
+          port);
+      g_free (ip);
+      break;
+    }
+  }
+
+  if (!candidate)
+  {
+    FS_RAWUDP_COMPONENT_UNLOCK (self);
+    return FALSE;
+  }
+
+#ifdef HAVE_GUPNP
+  fs_rawudp_component_stop_upnp_discovery_locked (self);
+#endif
+  self->priv->local_active_candidate = fs_candidate_copy (candidate);
+  FS_RAWUDP_COMPONENT_UNLOCK (self);
+
+  GST_DEBUG ("C:%d Emitting cached STUN candidate: %s:%u",
+      self->priv->component, candidate->ip, candidate->port);
+  fs_rawudp_component_emit_candidate (self, candidate);
+  fs_candidate_destroy (candidate);
+
+  return TRUE;
 }
 
 static gboolean
 fs_rawudp_component_start_stun (FsRawUdpComponent *self, GError **error)
 {
-  NiceAddress niceaddr;
   gboolean res = TRUE;
+  guint i;
+
+  if (!self->priv->stun_servers &&
+      !fs_rawudp_component_parse_stun_servers (self, error))
+    return FALSE;
 
-  GST_DEBUG ("C:%d starting the STUN process with server %s:%u",
-      self->priv->component, self->priv->stun_ip, self->priv->stun_port);
+  self->priv->stun_cache_ttl = 0;
+  if (self->priv->transmitter)
+    g_object_get (self->priv->transmitter,
+        "stun-cache-ttl", &self->priv->stun_cache_ttl, NULL);
+
+  if (fs_rawudp_component_use_stun_cache (self))
+    return TRUE;
+
+  GST_DEBUG ("C:%d starting the STUN process with %u servers",
+      self->priv->component, self->priv->n_stun_servers);
 
   FS_RAWUDP_COMPONENT_LOCK (self);
   self->priv->stun_recv_id =
@@ -1311,31 +1434,38 @@ fs_rawudp_component_start_stun (FsRawUdpComponent *self, GError **error)
         self->priv->udpport,
         G_CALLBACK (stun_recv_cb), self);
 
-
-  nice_address_init (&niceaddr);
-  if (!nice_address_set_from_string (&niceaddr, self->priv->stun_ip))
+  for (i = 0; i < self->priv->n_stun_servers; i++)
   {
-    g_set_error (error, FS_ERROR, FS_ERROR_INVALID_ARGUMENTS,
-        "Invalid IP address %s passed for STUN", self->priv->stun_ip);
-    FS_RAWUDP_COMPONENT_UNLOCK (self);
-    return FALSE;
-  }
-  nice_address_set_port (&niceaddr, self->priv->stun_port);
-  nice_address_copy_to_sockaddr (&niceaddr,
-      (struct sockaddr *) &self->priv->stun_sockaddr);
-
-  stun_usage_bind_create (
-      &self->priv->stun_agent,
-      &self->priv->stun_message,
-      self->priv->stun_buffer,
-      sizeof(self->priv->stun_buffer));
+    StunServer *server = &self->priv->stun_servers[i];
 
+    stun_usage_bind_create (
+        &self->priv->stun_agent,
+        &server->message,
+        server->buffer,
+        sizeof(server->buffer));
+  }
 
   /* only create a new thread if the old one was stopped. Otherwise we can
    * just reuse the currently running one. */
   if (self->priv->stun_timeout_thread == NULL)
   {
-    if (!fs_rawudp_component_send_stun_locked (self, error))
+    gboolean sent = FALSE;
+
+    /* It is enough for one of the servers to be reachable */
+    for (i = 0; i < self->priv->n_stun_servers; i++)
+    {
+      GError *send_error = NULL;
+
+      if (fs_rawudp_component_send_stun_locked (self,
+              &self->priv->stun_servers[i], &send_error))
+        sent = TRUE;
+      else if (!sent && i == self->priv->n_stun_servers - 1)
+        g_propagate_error (error, send_error);
+      else
+        g_clear_error (&send_error);
+    }
+
+    if (!sent)
     {
       FS_RAWUDP_COMPONENT_UNLOCK (self);
       return FALSE;
@@ -1374,7 +1504,26 @@ fs_rawudp_component_stop_stun_locked (FsRawUdpComponent *self)
     gst_clock_id_unschedule (self->priv->stun_timeout_id);
 }
 
+static StunServer *
+fs_rawudp_component_find_stun_server_locked (FsRawUdpComponent *self,
+    StunMessage *msg)
+{
+  StunTransactionId id;
+  guint i;
 
+  stun_message_id (msg, id);
+
+  for (i = 0; i < self->priv->n_stun_servers; i++)
+  {
+    StunTransactionId server_id;
+
+    stun_message_id (&self->priv->stun_servers[i].message, server_id);
+    if (!memcmp (id, server_id, sizeof (StunTransactionId)))
+      return &self->priv->stun_servers[i];
+  }
+
+  return NULL;
+}
 
 static gboolean
 stun_recv_cb (GstPad *pad, GstBuffer *buffer,
@@ -1385,6 +1534,7 @@ stun_recv_cb (GstPad *pad, GstBuffer *buffer,
   StunMessage msg;
   StunValidationStatus stunv;
   StunUsageBindReturn stunr;
+  StunServer *server;
   struct sockaddr_storage addr;
   socklen_t addr_len = sizeof(addr);
   struct sockaddr_storage alt_addr;
@@ -1427,20 +1577,27 @@ stun_recv_cb (GstPad *pad, GstBuffer *buffer,
     case STUN_USAGE_BIND_RETURN_ALTERNATE_SERVER:
       /* Change servers and reset timeouts */
       FS_RAWUDP_COMPONENT_LOCK(self);
-      memcpy (&self->priv->stun_sockaddr, &alt_addr,
-          MIN (sizeof(self->priv->stun_sockaddr), alt_addr_len));
-      self->priv->stun_server_changed = TRUE;
+      server = fs_rawudp_component_find_stun_server_locked (self, &msg);
+      if (!server)
+      {
+        FS_RAWUDP_COMPONENT_UNLOCK(self);
+        return FALSE;
+      }
+      memcpy (&server->sockaddr, &alt_addr,
+          MIN (sizeof(server->sockaddr), alt_addr_len));
+      server->changed = TRUE;
+      server->timed_out = FALSE;
       stun_usage_bind_create (
           &self->priv->stun_agent,
-          &self->priv->stun_message,
-          self->priv->stun_buffer,
-          sizeof(self->priv->stun_buffer));
+          &server->message,
+          server->buffer,
+          sizeof(server->buffer));
       nice_address_init (&niceaddr);
       nice_address_set_from_sockaddr (&niceaddr,
           (const struct sockaddr *) &alt_addr);
       nice_address_to_string (&niceaddr, addr_str);
-      GST_DEBUG ("Stun server redirected us to alternate server %s:%d",
-          addr_str, nice_address_get_port (&niceaddr));
+      GST_DEBUG ("Stun server %s redirected us to alternate server %s:%d",
+          server->key, addr_str, nice_address_get_port (&niceaddr));
       if (self->priv->stun_timeout_id)
         gst_clock_id_unschedule (self->priv->stun_timeout_id);
       FS_RAWUDP_COMPONENT_UNLOCK(self);
@@ -1456,6 +1613,26 @@ stun_recv_cb (GstPad *pad, GstBuffer *buffer,
   nice_address_set_from_sockaddr (&niceaddr, (const struct sockaddr *) &addr);
   nice_address_to_string (&niceaddr, addr_str);
 
+  FS_RAWUDP_COMPONENT_LOCK(self);
+
+  /* Another server may have already answered */
+  if (self->priv->local_active_candidate)
+  {
+    FS_RAWUDP_COMPONENT_UNLOCK(self);
+    return FALSE;
+  }
+
+  server = fs_rawudp_component_find_stun_server_locked (self, &msg);
+
+  GST_DEBUG ("Stun server %s says we are %s:%u",
+      server ? server->key : "(unknown)", addr_str,
+      nice_address_get_port (&niceaddr));
+
+  if (server)
+    fs_rawudp_transmitter_udpport_add_stun_cache (self->priv->udpport,
+        server->key, addr_str, nice_address_get_port (&niceaddr),
+        self->priv->stun_cache_ttl);
+
   candidate = fs_candidate_new ("L1",
       self->priv->component,
       FS_CANDIDATE_TYPE_SRFLX,
@@ -1463,10 +1640,6 @@ stun_recv_cb (GstPad *pad, GstBuffer *buffer,
       addr_str,
       nice_address_get_port (&niceaddr));
 
-  GST_DEBUG ("Stun server says we are %s:%u\n", addr_str,
-      nice_address_get_port (&niceaddr));
-
-  FS_RAWUDP_COMPONENT_LOCK(self);
   fs_rawudp_component_stop_stun_locked (self);
 #ifdef HAVE_GUPNP
   fs_rawudp_component_stop_upnp_discovery_locked (self);
@@ -1497,9 +1670,7 @@ stun_timeout_func (gpointer user_data)
   GError *error = NULL;
   guint timeout_accum_ms = 0;
   guint remainder;
-  StunUsageTimerReturn timer_ret = STUN_USAGE_TIMER_RETURN_SUCCESS;
-  StunTransactionId stunid;
-  StunTimer stun_timer;
+  guint i;
 
   sysclock = gst_system_clock_obtain ();
   if (sysclock == NULL)
@@ -1511,22 +1682,63 @@ stun_timeout_func (gpointer user_data)
   }
 
   FS_RAWUDP_COMPONENT_LOCK(self);
-  stun_timer_start (&stun_timer, STUN_TIMER_DEFAULT_TIMEOUT,
-      STUN_TIMER_DEFAULT_MAX_RETRANSMISSIONS);
+  for (i = 0; i < self->priv->n_stun_servers; i++)
+  {
+    stun_timer_start (&self->priv->stun_servers[i].timer,
+        STUN_TIMER_DEFAULT_TIMEOUT, STUN_TIMER_DEFAULT_MAX_RETRANSMISSIONS);
+    self->priv->stun_servers[i].timer_ret = STUN_USAGE_TIMER_RETURN_SUCCESS;
+    self->priv->stun_servers[i].changed = FALSE;
+    self->priv->stun_servers[i].timed_out = FALSE;
+  }
 
   while (!self->priv->stun_stop &&
       timeout_accum_ms < self->priv->stun_timeout * 1000)
   {
-    if (self->priv->stun_server_changed)
+    gboolean sent = FALSE;
+
+    remainder = G_MAXUINT;
+
+    for (i = 0; i < self->priv->n_stun_servers; i++)
     {
-      stun_timer_start (&stun_timer, STUN_TIMER_DEFAULT_TIMEOUT,
-          STUN_TIMER_DEFAULT_MAX_RETRANSMISSIONS);
-      self->priv->stun_server_changed = FALSE;
-      timer_ret = STUN_USAGE_TIMER_RETURN_RETRANSMIT;
+      StunServer *server = &self->priv->stun_servers[i];
+
+      if (server->changed)
+      {
+        stun_timer_start (&server->timer, STUN_TIMER_DEFAULT_TIMEOUT,
+            STUN_TIMER_DEFAULT_MAX_RETRANSMISSIONS);
+        server->changed = FALSE;
+        server->timer_ret = STUN_USAGE_TIMER_RETURN_RETRANSMIT;
+      }
+
+      if (server->timed_out)
+        continue;
+
+      if (server->timer_ret == STUN_USAGE_TIMER_RETURN_RETRANSMIT)
+      {
+        GError *send_error = NULL;
+
+        if (!fs_rawudp_component_send_stun_locked (self, server,
+                &send_error))
+        {
+          GST_DEBUG ("C:%u Could not send to STUN server %s: %s",
+              self->priv->component, server->key, send_error->message);
+          server->timed_out = TRUE;
+          g_clear_error (&error);
+          error = send_error;
+          continue;
+        }
+        sent = TRUE;
+      }
+      else if (server->timer_ret == STUN_USAGE_TIMER_RETURN_SUCCESS)
+      {
+        sent = TRUE;
+      }
+
+      remainder = MIN (remainder, stun_timer_remainder (&server->timer));
     }
 
-    if (timer_ret == STUN_USAGE_TIMER_RETURN_RETRANSMIT &&
-        !fs_rawudp_component_send_stun_locked (self, &error))
+    /* Only report an error if no server could be reached at all */
+    if (!sent && error)
     {
       FS_RAWUDP_COMPONENT_UNLOCK(self);
       fs_rawudp_component_emit_error (self, error->code, error->message);
@@ -1535,11 +1747,14 @@ stun_timeout_func (gpointer user_data)
       fs_rawudp_component_stop_stun_locked (self);
       goto interrupt;
     }
+    g_clear_error (&error);
 
     if (self->priv->stun_stop)
       goto interrupt;
 
-    remainder = stun_timer_remainder (&stun_timer);
+    /* All the servers have timed out */
+    if (remainder == G_MAXUINT)
+      break;
 
     next_stun_timeout = gst_clock_get_time (sysclock) +
       remainder * GST_MSECOND;
@@ -1557,11 +1772,19 @@ stun_timeout_func (gpointer user_data)
     gst_clock_id_unref (id);
     self->priv->stun_timeout_id = NULL;
 
-    timer_ret = stun_timer_refresh (&stun_timer);
-    timeout_accum_ms += remainder;
+    for (i = 0; i < self->priv->n_stun_servers; i++)
+    {
+      StunServer *server = &self->priv->stun_servers[i];
 
-    if (timer_ret == STUN_USAGE_TIMER_RETURN_TIMEOUT)
-      break;
+      if (server->timed_out || server->changed)
+        continue;
+
+      server->timer_ret = stun_timer_refresh (&server->timer);
+      if (server->timer_ret == STUN_USAGE_TIMER_RETURN_TIMEOUT)
+        server->timed_out = TRUE;
+    }
+
+    timeout_accum_ms += remainder;
   }
 
  interrupt:
@@ -1573,12 +1796,18 @@ stun_timeout_func (gpointer user_data)
 
   fs_rawudp_component_stop_stun_locked (self);
 
-  stun_message_id (&self->priv->stun_message, stunid);
-  stun_agent_forget_transaction (&self->priv->stun_agent, stunid);
+  for (i = 0; i < self->priv->n_stun_servers; i++)
+  {
+    StunTransactionId stunid;
+
+    stun_message_id (&self->priv->stun_servers[i].message, stunid);
+    stun_agent_forget_transaction (&self->priv->stun_agent, stunid);
+  }
 
   FS_RAWUDP_COMPONENT_UNLOCK(self);
 
-  gst_object_unref (sysclock);
+  if (sysclock)
+    gst_object_unref (sysclock);
 
   if (emit)
     fs_rawudp_component_maybe_emit_local_candidates (self);
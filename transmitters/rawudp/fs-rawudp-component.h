@@ -100,8 +100,7 @@ fs_rawudp_component_new (
     gboolean associate_on_source,
     const gchar *ip,
     guint port,
-    const gchar *stun_ip,
-    guint stun_port,
+    GValueArray *stun_servers,
     guint stun_timeout,
     gboolean upnp_mapping,
     gboolean upnp_discovery,
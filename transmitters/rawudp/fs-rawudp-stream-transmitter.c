@@ -37,6 +37,13 @@
  * network interfaces, listing link-local addresses after other addresses
  * and the loopback interface last.
  *
+ * More STUN servers can be listed in the
+ * #FsRawUdpStreamTransmitter:stun-servers property, all of them are queried
+ * at the same time and the first reply is used. The address found is
+ * remembered for each local port and server for
+ * #FsRawUdpTransmitter:stun-cache-ttl seconds, so a stream re-using a port
+ * does not need to wait for the servers again.
+ *
  * You can configure the address and port it will listen on by setting the
  * "preferred-local-candidates" property. This property will contain a #GList
  * of #FsCandidate. These #FsCandidate must be for #FS_NETWORK_PROTOCOL_UDP.
@@ -98,6 +105,7 @@ enum
   PROP_ASSOCIATE_ON_SOURCE,
   PROP_STUN_IP,
   PROP_STUN_PORT,
+  PROP_STUN_SERVERS,
   PROP_STUN_TIMEOUT,
   PROP_UPNP_MAPPING,
   PROP_UPNP_DISCOVERY,
@@ -122,8 +130,12 @@ struct _FsRawUdpStreamTransmitterPrivate
 
   gchar *stun_ip;
   guint stun_port;
+  GValueArray *stun_servers;
   guint stun_timeout;
 
+  /* stun-ip/stun-port followed by the stun-servers, set at build time */
+  GValueArray *all_stun_servers;
+
   GList *preferred_local_candidates;
   guint next_candidate_id;
 
@@ -272,6 +284,16 @@ fs_rawudp_stream_transmitter_class_init (FsRawUdpStreamTransmitterClass *klass)
           0, 65535, 3478,
           G_PARAM_CONSTRUCT_ONLY | G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  g_object_class_install_property (gobject_class,
+      PROP_STUN_SERVERS,
+      g_param_spec_boxed ("stun-servers",
+          "Additional STUN servers",
+          "A GValueArray of GstStructures with an \"ip\" string and an"
+          " optional \"port\" uint (defaults to 3478), they are queried"
+          " in parallel with the stun-ip server",
+          G_TYPE_VALUE_ARRAY,
+          G_PARAM_CONSTRUCT_ONLY | G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   g_object_class_install_property (gobject_class,
       PROP_STUN_TIMEOUT,
       g_param_spec_uint ("stun-timeout",
@@ -395,6 +417,10 @@ fs_rawudp_stream_transmitter_finalize (GObject *object)
   FsRawUdpStreamTransmitter *self = FS_RAWUDP_STREAM_TRANSMITTER (object);
 
   g_free (self->priv->stun_ip);
+  if (self->priv->stun_servers)
+    g_value_array_free (self->priv->stun_servers);
+  if (self->priv->all_stun_servers)
+    g_value_array_free (self->priv->all_stun_servers);
 
   if (self->priv->preferred_local_candidates)
     fs_candidate_list_destroy (self->priv->preferred_local_candidates);
@@ -437,6 +463,9 @@ fs_rawudp_stream_transmitter_get_property (GObject *object,
     case PROP_STUN_PORT:
       g_value_set_uint (value, self->priv->stun_port);
       break;
+    case PROP_STUN_SERVERS:
+      g_value_set_boxed (value, self->priv->stun_servers);
+      break;
     case PROP_STUN_TIMEOUT:
       g_value_set_uint (value, self->priv->stun_timeout);
       break;
@@ -503,6 +532,11 @@ fs_rawudp_stream_transmitter_set_property (GObject *object,
     case PROP_STUN_PORT:
       self->priv->stun_port = g_value_get_uint (value);
       break;
+    case PROP_STUN_SERVERS:
+      if (self->priv->stun_servers)
+        g_value_array_free (self->priv->stun_servers);
+      self->priv->stun_servers = g_value_dup_boxed (value);
+      break;
     case PROP_STUN_TIMEOUT:
       self->priv->stun_timeout = g_value_get_uint (value);
       break;
@@ -532,6 +566,73 @@ fs_rawudp_stream_transmitter_set_property (GObject *object,
   }
 }
 
+static void
+append_stun_server (GValueArray *array, const gchar *ip, guint port)
+{
+  GValue val = {0};
+
+  g_value_init (&val, GST_TYPE_STRUCTURE);
+  gst_value_take_structure (&val, gst_structure_new ("stun-server",
+          "ip", G_TYPE_STRING, ip,
+          "port", G_TYPE_UINT, port,
+          NULL));
+  g_value_array_append (array, &val);
+  g_value_unset (&val);
+}
+
+static gboolean
+fs_rawudp_stream_transmitter_build_stun_servers (
+    FsRawUdpStreamTransmitter *self,
+    GError **error)
+{
+  guint i;
+
+  self->priv->all_stun_servers = g_value_array_new (1);
+
+  if (self->priv->stun_ip)
+    append_stun_server (self->priv->all_stun_servers, self->priv->stun_ip,
+        self->priv->stun_port);
+
+  if (!self->priv->stun_servers)
+    return TRUE;
+
+  for (i = 0; i < self->priv->stun_servers->n_values; i++)
+  {
+    GValue *val = g_value_array_get_nth (self->priv->stun_servers, i);
+    const GstStructure *s;
+    const gchar *ip;
+    guint port = 3478;
+
+    if (!GST_VALUE_HOLDS_STRUCTURE (val))
+    {
+      g_set_error (error, FS_ERROR, FS_ERROR_INVALID_ARGUMENTS,
+          "Entry %u of the stun-servers is not a GstStructure", i);
+      return FALSE;
+    }
+
+    s = gst_value_get_structure (val);
+    ip = gst_structure_get_string (s, "ip");
+    if (!ip)
+    {
+      g_set_error (error, FS_ERROR, FS_ERROR_INVALID_ARGUMENTS,
+          "Entry %u of the stun-servers has no \"ip\"", i);
+      return FALSE;
+    }
+
+    if (gst_structure_has_field (s, "port") &&
+        (!gst_structure_get_uint (s, "port", &port) || port > 65535))
+    {
+      g_set_error (error, FS_ERROR, FS_ERROR_INVALID_ARGUMENTS,
+          "Entry %u of the stun-servers has an invalid \"port\"", i);
+      return FALSE;
+    }
+
+    append_stun_server (self->priv->all_stun_servers, ip, port);
+  }
+
+  return TRUE;
+}
+
 static gboolean
 fs_rawudp_stream_transmitter_build (FsRawUdpStreamTransmitter *self,
     GError **error)
@@ -544,9 +645,13 @@ fs_rawudp_stream_transmitter_build (FsRawUdpStreamTransmitter *self,
   gint c;
   guint16 next_port;
 
+  if (!fs_rawudp_stream_transmitter_build_stun_servers (self, error))
+    goto error;
+
 #ifdef HAVE_GUPNP
   if (self->priv->upnp_mapping ||
-      (self->priv->upnp_discovery && !self->priv->stun_ip))
+      (self->priv->upnp_discovery &&
+          self->priv->all_stun_servers->n_values == 0))
     self->priv->upnp_igd = gupnp_simple_igd_thread_new ();
 #endif
 
@@ -622,8 +727,7 @@ fs_rawudp_stream_transmitter_build (FsRawUdpStreamTransmitter *self,
         self->priv->associate_on_source,
         ips[c],
         requested_port,
-        self->priv->stun_ip,
-        self->priv->stun_port,
+        self->priv->all_stun_servers,
         self->priv->stun_timeout,
 #ifdef HAVE_GUPNP
         self->priv->upnp_mapping,
@@ -74,9 +74,12 @@ enum
   PROP_GST_SRC,
   PROP_COMPONENTS,
   PROP_TYPE_OF_SERVICE,
-  PROP_DO_TIMESTAMP
+  PROP_DO_TIMESTAMP,
+  PROP_STUN_CACHE_TTL
 };
 
+#define DEFAULT_STUN_CACHE_TTL (60)
+
 struct _FsRawUdpTransmitterPrivate
 {
   /* We hold references to this element */
@@ -95,6 +98,7 @@ struct _FsRawUdpTransmitterPrivate
 
   gint type_of_service;
   gboolean do_timestamp;
+  volatile gint stun_cache_ttl;
 
   gboolean disposed;
 };
@@ -201,6 +205,21 @@ fs_rawudp_transmitter_class_init (FsRawUdpTransmitterClass *klass)
   g_object_class_override_property (gobject_class, PROP_DO_TIMESTAMP,
       "do-timestamp");
 
+  /**
+   * FsRawUdpTransmitter:stun-cache-ttl:
+   *
+   * How long, in seconds, the address found with a STUN server is reused
+   * for the other streams using the same local port and server, instead of
+   * asking the server again. 0 disables the cache.
+   */
+  g_object_class_install_property (gobject_class,
+      PROP_STUN_CACHE_TTL,
+      g_param_spec_uint ("stun-cache-ttl",
+          "STUN cache lifetime",
+          "How long to reuse the address found with STUN (in seconds)",
+          0, G_MAXUINT32, DEFAULT_STUN_CACHE_TTL,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   transmitter_class->new_stream_transmitter =
     fs_rawudp_transmitter_new_stream_transmitter;
   transmitter_class->get_stream_transmitter_type =
@@ -223,6 +242,7 @@ fs_rawudp_transmitter_init (FsRawUdpTransmitter *self)
   self->components = 2;
   self->priv->mutex = g_mutex_new ();
   self->priv->do_timestamp = TRUE;
+  self->priv->stun_cache_ttl = DEFAULT_STUN_CACHE_TTL;
 }
 
 static void
@@ -464,6 +484,9 @@ fs_rawudp_transmitter_get_property (GObject *object,
     case PROP_DO_TIMESTAMP:
       g_value_set_boolean (value, self->priv->do_timestamp);
       break;
+    case PROP_STUN_CACHE_TTL:
+      g_value_set_uint (value, g_atomic_int_get (&self->priv->stun_cache_ttl));
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -490,6 +513,9 @@ fs_rawudp_transmitter_set_property (GObject *object,
     case PROP_DO_TIMESTAMP:
       self->priv->do_timestamp = g_value_get_boolean (value);
       break;
+    case PROP_STUN_CACHE_TTL:
+      g_atomic_int_set (&self->priv->stun_cache_ttl, g_value_get_uint (value));
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -559,6 +585,9 @@ struct _UdpPort {
   /* Everything below is protected by the mutex */
   GMutex *mutex;
   GArray *known_addresses;
+
+  /* STUN server "ip:port" -> struct StunCacheEntry */
+  GHashTable *stun_cache;
 };
 
 struct KnownAddress {
@@ -567,6 +596,22 @@ struct KnownAddress {
   GstNetAddress addr;
 };
 
+struct StunCacheEntry {
+  gchar *ip;
+  guint port;
+  /* Monotonic time */
+  gint64 expires;
+};
+
+static void
+stun_cache_entry_free (gpointer data)
+{
+  struct StunCacheEntry *entry = data;
+
+  g_free (entry->ip);
+  g_slice_free (struct StunCacheEntry, entry);
+}
+
 static gint
 _bind_port (
     const gchar *ip,
@@ -877,6 +922,8 @@ fs_rawudp_transmitter_get_udpport (FsRawUdpTransmitter *trans,
   udpport->mutex = g_mutex_new ();
   udpport->known_addresses = g_array_new (TRUE, FALSE,
       sizeof (struct KnownAddress));
+  udpport->stun_cache = g_hash_table_new_full (g_str_hash, g_str_equal,
+      g_free, stun_cache_entry_free);
 
   /* Now lets bind both ports */
 
@@ -1025,6 +1072,8 @@ fs_rawudp_transmitter_put_udpport (FsRawUdpTransmitter *trans,
     g_mutex_free (udpport->mutex);
   if (udpport->known_addresses)
     g_array_free (udpport->known_addresses, TRUE);
+  if (udpport->stun_cache)
+    g_hash_table_destroy (udpport->stun_cache);
 
   g_free (udpport->requested_ip);
   g_slice_free (UdpPort, udpport);
@@ -1307,3 +1356,77 @@ fs_rawudp_transmitter_set_type_of_service (FsRawUdpTransmitter *self,
  out:
   g_mutex_unlock (self->priv->mutex);
 }
+
+/**
+ * fs_rawudp_transmitter_udpport_lookup_stun_cache:
+ * @udpport: a #UdpPort
+ * @server: the STUN server as a "ip:port" string
+ * @ip: location for the mapped IP, free with g_free()
+ * @port: location for the mapped port
+ *
+ * Looks for an address previously found by asking @server from this port.
+ *
+ * Returns: %TRUE if a mapping that has not expired was found
+ */
+
+gboolean
+fs_rawudp_transmitter_udpport_lookup_stun_cache (UdpPort *udpport,
+    const gchar *server,
+    gchar **ip,
+    guint *port)
+{
+  struct StunCacheEntry *entry;
+  gboolean found = FALSE;
+
+  g_mutex_lock (udpport->mutex);
+  entry = g_hash_table_lookup (udpport->stun_cache, server);
+  if (entry)
+  {
+    if (entry->expires > g_get_monotonic_time ())
+    {
+      *ip = g_strdup (entry->ip);
+      *port = entry->port;
+      found = TRUE;
+    }
+    else
+    {
+      g_hash_table_remove (udpport->stun_cache, server);
+    }
+  }
+  g_mutex_unlock (udpport->mutex);
+
+  return found;
+}
+
+/**
+ * fs_rawudp_transmitter_udpport_add_stun_cache:
+ * @udpport: a #UdpPort
+ * @server: the STUN server as a "ip:port" string
+ * @ip: the mapped IP returned by the server
+ * @port: the mapped port returned by the server
+ * @ttl: how long the mapping can be reused, in seconds
+ *
+ * Remembers the address @server returned for this port.
+ */
+
+void
+fs_rawudp_transmitter_udpport_add_stun_cache (UdpPort *udpport,
+    const gchar *server,
+    const gchar *ip,
+    guint port,
+    guint ttl)
+{
+  struct StunCacheEntry *entry;
+
+  if (ttl == 0)
+    return;
+
+  entry = g_slice_new (struct StunCacheEntry);
+  entry->ip = g_strdup (ip);
+  entry->port = port;
+  entry->expires = g_get_monotonic_time () + (gint64) ttl * G_USEC_PER_SEC;
+
+  g_mutex_lock (udpport->mutex);
+  g_hash_table_replace (udpport->stun_cache, g_strdup (server), entry);
+  g_mutex_unlock (udpport->mutex);
+}
@@ -152,6 +152,17 @@ void fs_rawudp_transmitter_udpport_remove_recvonly_dest (UdpPort *udpport,
     const gchar *ip,
     gint port);
 
+gboolean fs_rawudp_transmitter_udpport_lookup_stun_cache (UdpPort *udpport,
+    const gchar *server,
+    gchar **ip,
+    guint *port);
+
+void fs_rawudp_transmitter_udpport_add_stun_cache (UdpPort *udpport,
+    const gchar *server,
+    const gchar *ip,
+    guint port,
+    guint ttl);
+
 G_END_DECLS
 
 #endif /* __FS_RAWUDP_TRANSMITTER_H__ */